@@ -1,23 +1,30 @@
-function(add_astc TARGET SHADER SRGB)
+# astcencの変換結果を置くディレクトリ
+# 入力の画素と設定から求めたキーをファイル名にするので、ビルドディレクトリを消しても再利用できる
+if( NOT "$ENV{HOME}" STREQUAL "" )
+  set( SAMPLES_ASTC_CACHE_DEFAULT "$ENV{HOME}/.cache/raspi_vulkan_samples/astc" )
+else()
+  set( SAMPLES_ASTC_CACHE_DEFAULT "${CMAKE_BINARY_DIR}/astc_cache" )
+endif()
+set( SAMPLES_ASTC_CACHE_DIR "${SAMPLES_ASTC_CACHE_DEFAULT}" CACHE PATH "directory to cache ASTC encoded textures" )
 
-	set(current-input-path ${CMAKE_CURRENT_SOURCE_DIR}/${SHADER})
-  set(current-output-path ${CMAKE_CURRENT_BINARY_DIR}/${SHADER}.astc)
+# IMAGEのミップマップを全てのレベルについてASTCに変換し、${IMAGE}.astc.jsonにレベルの一覧を書く
+# 全てのレベルは${IMAGE}.ktx2にもまとめる
+# ROLEはcolor, normal, roughnessのいずれかで、ブロックの大きさと色空間はROLEから決まる
+function(add_astc TARGET IMAGE ROLE)
+
+	set(current-input-path ${CMAKE_CURRENT_SOURCE_DIR}/${IMAGE})
+  set(current-output-path ${CMAKE_CURRENT_BINARY_DIR}/${IMAGE}.astc.json)
+  set(current-ktx2-path ${CMAKE_CURRENT_BINARY_DIR}/${IMAGE}.ktx2)
 
 	get_filename_component(current-output-dir ${current-output-path} DIRECTORY)
 	file(MAKE_DIRECTORY ${current-output-dir})
-  if( SRGB )
-    set( astc-color-mode "-cs" )
-  else()
-    set( astc-color-mode "-cl" )
-  endif()
 	add_custom_command(
-		OUTPUT ${current-output-path}
-    COMMAND ${ASTCENC} ${astc-color-mode} ${current-input-path} ${current-output-path} 8x8 100
-		DEPENDS ${current-input-path}
+		OUTPUT ${current-output-path} ${current-ktx2-path}
+    COMMAND $<TARGET_FILE:astc_encode> --astcenc ${ASTCENC} --input ${current-input-path} --output ${current-output-path} --ktx2 ${current-ktx2-path} --role ${ROLE} --cache ${SAMPLES_ASTC_CACHE_DIR}
+		DEPENDS ${current-input-path} astc_encode
 		IMPLICIT_DEPENDS CXX ${current-input-path}
 		VERBATIM)
 
-	set_source_files_properties(${current-output-path} PROPERTIES GENERATED TRUE)
-	target_sources(${TARGET} PRIVATE ${current-output-path})
+	set_source_files_properties(${current-output-path} ${current-ktx2-path} PROPERTIES GENERATED TRUE)
+	target_sources(${TARGET} PRIVATE ${current-output-path} ${current-ktx2-path})
 endfunction(add_astc)
-
@@ -14,5 +14,22 @@ function(add_shader TARGET SHADER)
 
 	set_source_files_properties(${current-output-path} PROPERTIES GENERATED TRUE)
 	target_sources(${TARGET} PRIVATE ${current-output-path})
+	set_property(TARGET ${TARGET} APPEND PROPERTY SHADER_OUTPUTS ${current-output-path})
 endfunction(add_shader)
 
+# TARGETにadd_shaderで追加された全てのSPIR-Vを${CMAKE_CURRENT_BINARY_DIR}/shaders.spvbにまとめる
+# 中の名前はCMAKE_CURRENT_BINARY_DIRからの相対パス
+# 全てのadd_shaderの後に呼ぶ
+function(add_shader_bundle TARGET)
+
+	get_property(current-shaders TARGET ${TARGET} PROPERTY SHADER_OUTPUTS)
+	set(current-output-path ${CMAKE_CURRENT_BINARY_DIR}/shaders.spvb)
+	add_custom_command(
+		OUTPUT ${current-output-path}
+		COMMAND $<TARGET_FILE:spirv_bundle_pack> ${current-output-path} ${CMAKE_CURRENT_BINARY_DIR} ${current-shaders}
+		DEPENDS ${current-shaders} spirv_bundle_pack
+		VERBATIM)
+
+	set_source_files_properties(${current-output-path} PROPERTIES GENERATED TRUE)
+	target_sources(${TARGET} PRIVATE ${current-output-path})
+endfunction(add_shader_bundle)
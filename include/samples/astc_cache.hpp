@@ -0,0 +1,141 @@
+#ifndef SAMPLES_ASTC_CACHE_HPP
+#define SAMPLES_ASTC_CACHE_HPP
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vulkan/vulkan.hpp>
+
+namespace samples {
+  // add_astcでASTCに変換するテクスチャの用途
+  enum class astc_role_t {
+    // sRGBの色
+    color,
+    // 法線マップ
+    normal,
+    // ラフネスなど線形の値
+    roughness
+  };
+  inline astc_role_t get_astc_role( const std::string &name ) {
+    if( name == "color" ) return astc_role_t::color;
+    else if( name == "normal" ) return astc_role_t::normal;
+    else if( name == "roughness" ) return astc_role_t::roughness;
+    throw std::runtime_error( "get_astc_role : unknown role " + name );
+  }
+  inline std::string to_string( astc_role_t role ) {
+    if( role == astc_role_t::color ) return "color";
+    else if( role == astc_role_t::normal ) return "normal";
+    return "roughness";
+  }
+  // astcencに渡す設定
+  struct astc_settings_t {
+    // ブロックの大きさ 例: 6x6
+    std::string block;
+    // 品質 0から100の数値またはastcencのプリセット名
+    std::string quality;
+    bool srgb = false;
+  };
+  // 用途毎の既定の設定
+  // 色は誤差が目立ちにくいので大きめのブロック、法線マップは誤差が陰影に出るので小さいブロックにする
+  // ラフネスは低周波なので一番大きいブロックで足りる
+  inline astc_settings_t get_astc_settings( astc_role_t role ) {
+    if( role == astc_role_t::color ) return astc_settings_t{ "6x6", "100", true };
+    else if( role == astc_role_t::normal ) return astc_settings_t{ "5x5", "100", false };
+    return astc_settings_t{ "8x8", "100", false };
+  }
+
+  // 2DのLDRのASTCのフォーマット
+  struct astc_format_entry_t {
+    std::uint32_t width;
+    std::uint32_t height;
+    vk::Format unorm;
+    vk::Format srgb;
+  };
+  inline constexpr astc_format_entry_t astc_formats[]{
+    { 4u, 4u, vk::Format::eAstc4x4UnormBlock, vk::Format::eAstc4x4SrgbBlock },
+    { 5u, 4u, vk::Format::eAstc5x4UnormBlock, vk::Format::eAstc5x4SrgbBlock },
+    { 5u, 5u, vk::Format::eAstc5x5UnormBlock, vk::Format::eAstc5x5SrgbBlock },
+    { 6u, 5u, vk::Format::eAstc6x5UnormBlock, vk::Format::eAstc6x5SrgbBlock },
+    { 6u, 6u, vk::Format::eAstc6x6UnormBlock, vk::Format::eAstc6x6SrgbBlock },
+    { 8u, 5u, vk::Format::eAstc8x5UnormBlock, vk::Format::eAstc8x5SrgbBlock },
+    { 8u, 6u, vk::Format::eAstc8x6UnormBlock, vk::Format::eAstc8x6SrgbBlock },
+    { 8u, 8u, vk::Format::eAstc8x8UnormBlock, vk::Format::eAstc8x8SrgbBlock },
+    { 10u, 5u, vk::Format::eAstc10x5UnormBlock, vk::Format::eAstc10x5SrgbBlock },
+    { 10u, 6u, vk::Format::eAstc10x6UnormBlock, vk::Format::eAstc10x6SrgbBlock },
+    { 10u, 8u, vk::Format::eAstc10x8UnormBlock, vk::Format::eAstc10x8SrgbBlock },
+    { 10u, 10u, vk::Format::eAstc10x10UnormBlock, vk::Format::eAstc10x10SrgbBlock },
+    { 12u, 10u, vk::Format::eAstc12x10UnormBlock, vk::Format::eAstc12x10SrgbBlock },
+    { 12u, 12u, vk::Format::eAstc12x12UnormBlock, vk::Format::eAstc12x12SrgbBlock }
+  };
+  // ブロックの大きさに対応するVulkanのフォーマット
+  // 2DのLDRのブロックの大きさでなければeUndefined
+  inline vk::Format get_astc_format( std::uint32_t block_width, std::uint32_t block_height, bool srgb ) {
+    for( const auto &f: astc_formats )
+      if( f.width == block_width && f.height == block_height ) return srgb ? f.srgb : f.unorm;
+    return vk::Format::eUndefined;
+  }
+  // get_astc_formatの逆
+  // formatが2DのLDRのASTCでなければfalse
+  inline bool get_astc_block( vk::Format format, std::uint32_t &block_width, std::uint32_t &block_height, bool &srgb ) {
+    for( const auto &f: astc_formats ) {
+      if( f.unorm == format || f.srgb == format ) {
+        block_width = f.width;
+        block_height = f.height;
+        srgb = f.srgb == format;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // astcencが出力する.astcファイルの先頭
+  // 大きさは24bitのリトルエンディアン
+  constexpr std::uint32_t astc_file_magic = 0x5CA1AB13u;
+  struct astc_file_header_t {
+    std::uint32_t magic = astc_file_magic;
+    std::uint8_t block_x = 0u;
+    std::uint8_t block_y = 0u;
+    std::uint8_t block_z = 0u;
+    std::uint8_t x_size[ 3 ] = { 0u, 0u, 0u };
+    std::uint8_t y_size[ 3 ] = { 0u, 0u, 0u };
+    std::uint8_t z_size[ 3 ] = { 0u, 0u, 0u };
+  };
+  static_assert( sizeof( astc_file_header_t ) == 16u );
+  inline std::uint32_t get_astc_file_size( const std::uint8_t *value ) {
+    return std::uint32_t( value[ 0 ] ) | ( std::uint32_t( value[ 1 ] ) << 8 ) | ( std::uint32_t( value[ 2 ] ) << 16 );
+  }
+
+  // エンコード結果のキャッシュのキーを作る為のFNV-1a
+  // 入力の画素と設定が同じならキーも同じになる
+  class astc_hash_t {
+  public:
+    astc_hash_t &add( const void *data, std::size_t size ) {
+      const auto head = reinterpret_cast< const std::uint8_t* >( data );
+      for( std::size_t i = 0u; i != size; ++i ) {
+        hash ^= head[ i ];
+        hash *= 0x100000001b3ull;
+      }
+      return *this;
+    }
+    astc_hash_t &add( std::string_view value ) {
+      // 区切りが曖昧にならないように長さも混ぜる
+      const std::uint64_t size = value.size();
+      add( &size, sizeof( size ) );
+      return add( value.data(), value.size() );
+    }
+    std::uint64_t get() const {
+      return hash;
+    }
+    std::string get_hex() const {
+      char buf[ 17 ];
+      std::snprintf( buf, sizeof( buf ), "%016llx", static_cast< unsigned long long >( hash ) );
+      return buf;
+    }
+  private:
+    std::uint64_t hash = 0xcbf29ce484222325ull;
+  };
+}
+
+#endif
+
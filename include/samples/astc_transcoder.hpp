@@ -0,0 +1,337 @@
+#ifndef SAMPLES_ASTC_TRANSCODER_HPP
+#define SAMPLES_ASTC_TRANSCODER_HPP
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include <vulkan/vulkan.hpp>
+#include <gct/device.hpp>
+#include <gct/allocator.hpp>
+#include <gct/buffer.hpp>
+#include <gct/image.hpp>
+#include <gct/image_create_info.hpp>
+#include <gct/image_view_create_info.hpp>
+#include <gct/descriptor_pool.hpp>
+#include <gct/descriptor_set_layout.hpp>
+#include <gct/pipeline_cache.hpp>
+#include <gct/pipeline_layout_create_info.hpp>
+#include <gct/shader_module.hpp>
+#include <gct/compute_pipeline_create_info.hpp>
+#include <gct/compute_pipeline.hpp>
+#include <gct/write_descriptor_set.hpp>
+#include <gct/command_buffer_recorder.hpp>
+#include <samples/ktx2.hpp>
+#include <samples/pipeline_telemetry.hpp>
+
+namespace samples {
+  // ASTCのKTX2ファイルを読む
+  //
+  // デバイスがASTCをサンプルできる場合はそのままktx2_loader_tで転送する
+  // できない場合はASTCのまま転送し、astc_decode.compでR8G8B8A8に展開する
+  // 展開した結果はディスクに保存しない
+  // R8G8B8A8は8x8のASTCの16倍の大きさがあり、読み込む度にそれを転送するより毎回GPUで展開する方が速い
+  //
+  // 展開先はストレージイメージとして書くので、eR8G8B8A8Unormのビューで書けるようにeMutableFormatとeExtendedUsageを付けて作る
+  // 展開先はeStorageを持つので、サンプルするビューにはvk::ImageViewUsageCreateInfoでeSampledだけを指定する
+  // 扱えるのは2DのLDRのASTC
+  class astc_transcoder_t {
+  public:
+    astc_transcoder_t(
+      const std::shared_ptr< gct::device_t > &device_,
+      const vk::PhysicalDevice &physical_device_,
+      const std::shared_ptr< gct::allocator_t > &allocator_,
+      const std::shared_ptr< gct::pipeline_cache_t > &pipeline_cache_,
+      const std::string &shader_path,
+      bool force_transcode_ = false
+    ) :
+      device( device_ ),
+      physical_device( physical_device_ ),
+      allocator( allocator_ ),
+      pipeline_cache( pipeline_cache_ ),
+      force_transcode( force_transcode_ ),
+      loader( allocator_ ) {
+      shader = device->get_shader_module( shader_path );
+      descriptor_set_layout = device->get_descriptor_set_layout(
+        gct::descriptor_set_layout_create_info_t()
+          .add_binding( shader->get_props().get_reflection() )
+          .rebuild_chain()
+      );
+      pipeline_layout = device->get_pipeline_layout(
+        gct::pipeline_layout_create_info_t()
+          .add_descriptor_set_layout( descriptor_set_layout )
+          .add_push_constant_range(
+            vk::PushConstantRange()
+              .setStageFlags( vk::ShaderStageFlagBits::eCompute )
+              .setOffset( 0 )
+              .setSize( sizeof( push_constants_t ) )
+          )
+      );
+    }
+    // formatのイメージを線形補間でサンプルできるか
+    bool is_sampleable( vk::Format format ) const {
+      const auto features = physical_device.getFormatProperties( format ).optimalTilingFeatures;
+      return
+        ( features & vk::FormatFeatureFlagBits::eSampledImage ) &&
+        ( features & vk::FormatFeatureFlagBits::eSampledImageFilterLinear );
+    }
+    // pathのKTX2ファイルを読み、サンプルできるイメージを作るコマンドを記録する
+    // 最後にイメージのレイアウトはシェーダから読むのに適した物になる
+    // イメージのフォーマットはファイルのフォーマットか、展開した場合はeR8G8B8A8SrgbまたはeR8G8B8A8Unormになる
+    std::shared_ptr< gct::image_t > load(
+      gct::command_buffer_recorder_t &rec,
+      const std::filesystem::path &path,
+      vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eSampled
+    ) {
+      const ktx2_file_t file( path );
+      std::uint32_t block_width = 0u;
+      std::uint32_t block_height = 0u;
+      bool srgb = false;
+      const bool astc = get_astc_block( file.get_format(), block_width, block_height, srgb );
+      if( !astc || ( !force_transcode && is_sampleable( file.get_format() ) ) ) {
+        ++native_count;
+        return loader.load( rec, file, usage );
+      }
+      if( file.get_image_type() != vk::ImageType::e2D )
+        throw std::runtime_error( "astc_transcoder_t::load : " + path.string() + " is not a 2D texture" );
+      const auto format = srgb ? vk::Format::eR8G8B8A8Srgb : vk::Format::eR8G8B8A8Unorm;
+      if( !is_sampleable( format ) )
+        throw std::runtime_error( "astc_transcoder_t::load : " + vk::to_string( format ) + " is not sampleable" );
+      if( !( physical_device.getFormatProperties( vk::Format::eR8G8B8A8Unorm ).optimalTilingFeatures & vk::FormatFeatureFlagBits::eStorageImage ) )
+        throw std::runtime_error( "astc_transcoder_t::load : eR8G8B8A8Unorm is not a storage image format" );
+      ++transcoded_count;
+      return transcode( rec, file, block_width, block_height, srgb, format, usage );
+    }
+    // load()で記録したコマンドの実行が終わった後に呼ぶ
+    // それまでに使った一時的な資源を捨てる
+    void release() {
+      in_use.clear();
+      in_use_sets.clear();
+      in_use_pools.clear();
+      level_views.clear();
+      loader.release();
+    }
+    // これまでのload()の結果の内訳
+    nlohmann::json dump() const {
+      nlohmann::json root;
+      root[ "native" ] = native_count;
+      root[ "transcoded" ] = transcoded_count;
+      return root;
+    }
+  private:
+    struct push_constants_t {
+      std::uint32_t block_offset;
+      std::uint32_t srgb;
+      std::int32_t width;
+      std::int32_t height;
+      std::int32_t block_width;
+      std::int32_t block_height;
+    };
+    struct spec_t {
+      std::uint32_t local_size_x = 8u;
+      std::uint32_t local_size_y = 8u;
+    };
+    std::shared_ptr< gct::image_t > transcode(
+      gct::command_buffer_recorder_t &rec,
+      const ktx2_file_t &file,
+      std::uint32_t block_width,
+      std::uint32_t block_height,
+      bool srgb,
+      vk::Format format,
+      vk::ImageUsageFlags usage
+    ) {
+      const auto mip_levels = file.get_mip_levels();
+      const auto array_layers = file.get_array_layers();
+      // ASTCのブロックのまま転送する
+      std::vector< vk::DeviceSize > block_offsets;
+      const auto blocks_size = get_ktx2_staging_layout( file, block_offsets );
+      auto blocks = allocator->create_buffer(
+        gct::buffer_create_info_t()
+          .set_basic(
+            vk::BufferCreateInfo()
+              .setSize( std::max( blocks_size, vk::DeviceSize( 16u ) ) )
+              .setUsage( vk::BufferUsageFlagBits::eStorageBuffer )
+          ),
+        VMA_MEMORY_USAGE_CPU_TO_GPU
+      );
+      {
+        auto mapped = blocks->map< std::uint8_t >();
+        write_ktx2_levels( file, block_offsets, &*mapped.begin() );
+      }
+      auto image = allocator->create_image(
+        gct::image_create_info_t()
+          .set_basic(
+            vk::ImageCreateInfo()
+              .setFlags(
+                vk::ImageCreateFlagBits::eMutableFormat |
+                vk::ImageCreateFlagBits::eExtendedUsage |
+                ( file.is_cube() ? vk::ImageCreateFlagBits::eCubeCompatible : vk::ImageCreateFlags() )
+              )
+              .setImageType( vk::ImageType::e2D )
+              .setFormat( format )
+              .setExtent( file.get_extent() )
+              .setMipLevels( mip_levels )
+              .setArrayLayers( array_layers )
+              .setSamples( vk::SampleCountFlagBits::e1 )
+              .setTiling( vk::ImageTiling::eOptimal )
+              .setUsage(
+                usage |
+                vk::ImageUsageFlagBits::eStorage
+              )
+              .setInitialLayout( vk::ImageLayout::eUndefined )
+          ),
+          VMA_MEMORY_USAGE_GPU_ONLY
+      );
+      auto descriptor_pool = device->get_descriptor_pool(
+        gct::descriptor_pool_create_info_t()
+          .set_basic(
+            vk::DescriptorPoolCreateInfo()
+              .setFlags( vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet )
+              .setMaxSets( mip_levels * array_layers )
+          )
+          .set_descriptor_pool_size( vk::DescriptorType::eStorageImage, mip_levels * array_layers )
+          .set_descriptor_pool_size( vk::DescriptorType::eStorageBuffer, mip_levels * array_layers )
+          .rebuild_chain()
+      );
+      rec.convert_image( image, vk::ImageLayout::eGeneral );
+      rec.bind_pipeline( get_pipeline() );
+      const spec_t spec;
+      for( std::uint32_t level = 0u; level != mip_levels; ++level ) {
+        const auto extent = file.get_extent( level );
+        const std::uint32_t block_count_x = ( extent.width + block_width - 1u ) / block_width;
+        const std::uint32_t block_count_y = ( extent.height + block_height - 1u ) / block_height;
+        for( std::uint32_t layer = 0u; layer != array_layers; ++layer ) {
+          auto descriptor_set = descriptor_pool->allocate( descriptor_set_layout );
+          descriptor_set->update(
+            {
+              gct::write_descriptor_set_t()
+                .set_basic(
+                  (*descriptor_set)[ "blocks_buffer" ]
+                )
+                .add_buffer(
+                  gct::descriptor_buffer_info_t()
+                    .set_buffer( blocks )
+                    .set_basic(
+                      vk::DescriptorBufferInfo()
+                        .setOffset( 0 )
+                        .setRange( VK_WHOLE_SIZE )
+                    )
+                ),
+              gct::write_descriptor_set_t()
+                .set_basic(
+                  (*descriptor_set)[ "dest_image" ]
+                )
+                .add_image(
+                  gct::descriptor_image_info_t()
+                    .set_basic(
+                      vk::DescriptorImageInfo()
+                        .setImageLayout( vk::ImageLayout::eGeneral )
+                    )
+                    .set_image_view( get_level_view( image, level, layer ) )
+                )
+            }
+          );
+          rec.bind_descriptor_set(
+            vk::PipelineBindPoint::eCompute,
+            pipeline_layout,
+            descriptor_set
+          );
+          // KTX2のレベルの中ではレイヤーが順に並ぶ
+          const push_constants_t push_constants{
+            std::uint32_t( ( block_offsets[ level ] + vk::DeviceSize( layer ) * block_count_x * block_count_y * 16u ) / 16u ),
+            srgb ? 1u : 0u,
+            std::int32_t( extent.width ),
+            std::int32_t( extent.height ),
+            std::int32_t( block_width ),
+            std::int32_t( block_height )
+          };
+          rec->pushConstants(
+            **pipeline_layout,
+            vk::ShaderStageFlagBits::eCompute,
+            0u,
+            sizeof( push_constants_t ),
+            &push_constants
+          );
+          rec->dispatch(
+            ( block_count_x + spec.local_size_x - 1u ) / spec.local_size_x,
+            ( block_count_y + spec.local_size_y - 1u ) / spec.local_size_y,
+            1u
+          );
+          in_use_sets.push_back( descriptor_set );
+        }
+      }
+      rec->pipelineBarrier(
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eVertexShader|vk::PipelineStageFlagBits::eFragmentShader|vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlagBits( 0 ),
+        { vk::MemoryBarrier().setSrcAccessMask( vk::AccessFlagBits::eShaderWrite ).setDstAccessMask( vk::AccessFlagBits::eShaderRead ) },
+        {},
+        {}
+      );
+      rec.convert_image( image, vk::ImageLayout::eShaderReadOnlyOptimal );
+      in_use.push_back( blocks );
+      in_use_pools.push_back( descriptor_pool );
+      return image;
+    }
+    std::shared_ptr< gct::image_view_t > get_level_view( const std::shared_ptr< gct::image_t > &image, std::uint32_t level, std::uint32_t layer ) {
+      auto view = image->get_view(
+        gct::image_view_create_info_t()
+          .set_basic(
+            vk::ImageViewCreateInfo()
+              .setSubresourceRange(
+                vk::ImageSubresourceRange()
+                  .setAspectMask( vk::ImageAspectFlagBits::eColor )
+                  .setBaseMipLevel( level )
+                  .setLevelCount( 1 )
+                  .setBaseArrayLayer( layer )
+                  .setLayerCount( 1 )
+              )
+              .setViewType( vk::ImageViewType::e2D )
+              .setFormat( vk::Format::eR8G8B8A8Unorm )
+          )
+          .rebuild_chain()
+      );
+      level_views.push_back( view );
+      return view;
+    }
+    std::shared_ptr< gct::compute_pipeline_t > get_pipeline() {
+      if( pipeline ) return pipeline;
+      pipeline = instrumented_pipeline_cache_t( pipeline_cache ).get_pipeline(
+        gct::compute_pipeline_create_info_t()
+          .set_stage(
+            gct::pipeline_shader_stage_create_info_t()
+              .set_shader_module( shader )
+              .set_specialization_info(
+                gct::specialization_info_t< spec_t >()
+                  .set_data( spec_t() )
+                  .add_map< std::uint32_t >( 1, offsetof( spec_t, local_size_x ) )
+                  .add_map< std::uint32_t >( 2, offsetof( spec_t, local_size_y ) )
+              )
+          )
+          .set_layout( pipeline_layout ),
+        "astc_decode"
+      );
+      return pipeline;
+    }
+    std::shared_ptr< gct::device_t > device;
+    vk::PhysicalDevice physical_device;
+    std::shared_ptr< gct::allocator_t > allocator;
+    std::shared_ptr< gct::pipeline_cache_t > pipeline_cache;
+    bool force_transcode = false;
+    ktx2_loader_t loader;
+    std::shared_ptr< gct::shader_module_t > shader;
+    std::shared_ptr< gct::descriptor_set_layout_t > descriptor_set_layout;
+    std::shared_ptr< gct::pipeline_layout_t > pipeline_layout;
+    std::shared_ptr< gct::compute_pipeline_t > pipeline;
+    std::vector< std::shared_ptr< gct::buffer_t > > in_use;
+    std::vector< std::shared_ptr< gct::descriptor_set_t > > in_use_sets;
+    std::vector< std::shared_ptr< gct::descriptor_pool_t > > in_use_pools;
+    std::vector< std::shared_ptr< gct::image_view_t > > level_views;
+    std::uint32_t native_count = 0u;
+    std::uint32_t transcoded_count = 0u;
+  };
+}
+
+#endif
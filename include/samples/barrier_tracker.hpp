@@ -0,0 +1,363 @@
+#ifndef SAMPLES_BARRIER_TRACKER_HPP
+#define SAMPLES_BARRIER_TRACKER_HPP
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include <nlohmann/json.hpp>
+#include <gct/buffer.hpp>
+#include <gct/image.hpp>
+#include <gct/command_buffer_recorder.hpp>
+
+namespace samples {
+  // コマンドが触るバッファとイメージをコマンドの前に申告すると、
+  // それまでのアクセスとの間に必要なバリアだけを1回のvkCmdPipelineBarrierにまとめて積む
+  //
+  //   tracker.write( buffer, vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eShaderWrite );
+  //   tracker.flush( rec );
+  //   rec->dispatch( ... );
+  //
+  // - 書き込みの後の読み込み(RAW)と書き込みの後の書き込み(WAW)にはメモリバリアを張る
+  // - 読み込みの後の書き込み(WAR)には実行の依存だけを張る
+  // - 同じステージとアクセスに対して既に可視になっている書き込みにはバリアを張らない
+  // - イメージのレイアウトが要求と同じ場合はレイアウト変更をしない
+  //
+  // バッファとイメージは全体を1つの資源として扱う
+  // 追跡しているイメージのレイアウトはこのクラスが変更するので、
+  // 同じイメージに対してgctのconvert_image等を混ぜて使ってはいけない
+  class barrier_tracker_t {
+    struct access_t {
+      vk::PipelineStageFlags stage;
+      vk::AccessFlags access;
+      bool write = false;
+      vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+    };
+    struct state_t {
+      // 最後の書き込み
+      vk::PipelineStageFlags write_stage;
+      vk::AccessFlags write_access;
+      // 最後の書き込みの結果が既に見えているステージとアクセス
+      vk::PipelineStageFlags visible_stage;
+      vk::AccessFlags visible_access;
+      // 最後の書き込みより後に読んだステージ
+      vk::PipelineStageFlags read_stage;
+      vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+    };
+    struct buffer_entry_t {
+      std::shared_ptr< gct::buffer_t > buffer;
+      access_t access;
+    };
+    struct image_entry_t {
+      std::shared_ptr< gct::image_t > image;
+      access_t access;
+    };
+  public:
+    void read(
+      const std::shared_ptr< gct::buffer_t > &buffer,
+      vk::PipelineStageFlags stage,
+      vk::AccessFlags access
+    ) {
+      add( buffer, access_t{ stage, access, false } );
+    }
+    void write(
+      const std::shared_ptr< gct::buffer_t > &buffer,
+      vk::PipelineStageFlags stage,
+      vk::AccessFlags access
+    ) {
+      add( buffer, access_t{ stage, access, true } );
+    }
+    // layoutはコマンドの実行時にイメージがとっているべきレイアウト
+    void read(
+      const std::shared_ptr< gct::image_t > &image,
+      vk::ImageLayout layout,
+      vk::PipelineStageFlags stage,
+      vk::AccessFlags access
+    ) {
+      add( image, access_t{ stage, access, false, layout } );
+    }
+    void write(
+      const std::shared_ptr< gct::image_t > &image,
+      vk::ImageLayout layout,
+      vk::PipelineStageFlags stage,
+      vk::AccessFlags access
+    ) {
+      add( image, access_t{ stage, access, true, layout } );
+    }
+    // ダンプに出す名前を付ける
+    void set_name( const std::shared_ptr< gct::buffer_t > &buffer, const std::string &name ) {
+      names[ get_key( **buffer ) ] = name;
+    }
+    void set_name( const std::shared_ptr< gct::image_t > &image, const std::string &name ) {
+      names[ get_key( **image ) ] = name;
+    }
+    // 申告されたアクセスの為に必要なバリアを積む
+    // 必要なバリアが無い場合は何も積まない
+    void flush( gct::command_buffer_recorder_t &rec ) {
+      vk::PipelineStageFlags src_stage;
+      vk::PipelineStageFlags dst_stage;
+      std::vector< vk::BufferMemoryBarrier > buffer_barriers;
+      std::vector< vk::ImageMemoryBarrier > image_barriers;
+      nlohmann::json log;
+      log[ "buffers" ] = nlohmann::json::array();
+      log[ "images" ] = nlohmann::json::array();
+      bool execution_dependency = false;
+      for( const auto &entry: pending_buffers ) {
+        auto &state = buffer_states[ get_key( **entry.buffer ) ];
+        vk::PipelineStageFlags src;
+        vk::AccessFlags src_access;
+        vk::AccessFlags dst_access;
+        if( need_barrier( state, entry.access, src, src_access, dst_access ) ) {
+          src_stage |= src;
+          dst_stage |= entry.access.stage;
+          if( src_access || dst_access ) {
+            buffer_barriers.push_back(
+              vk::BufferMemoryBarrier()
+                .setSrcAccessMask( src_access )
+                .setDstAccessMask( dst_access )
+                .setSrcQueueFamilyIndex( VK_QUEUE_FAMILY_IGNORED )
+                .setDstQueueFamilyIndex( VK_QUEUE_FAMILY_IGNORED )
+                .setBuffer( **entry.buffer )
+                .setOffset( 0 )
+                .setSize( VK_WHOLE_SIZE )
+            );
+          }
+          else execution_dependency = true;
+          log[ "buffers" ].push_back( {
+            { "name", get_name( **entry.buffer ) },
+            { "src_stage", vk::to_string( src ) },
+            { "dst_stage", vk::to_string( entry.access.stage ) },
+            { "src_access", vk::to_string( src_access ) },
+            { "dst_access", vk::to_string( dst_access ) }
+          } );
+          ++emitted_buffer_barriers;
+        }
+        else ++elided_barriers;
+        commit( state, entry.access );
+      }
+      for( const auto &entry: pending_images ) {
+        auto state_iter = image_states.find( get_key( **entry.image ) );
+        if( state_iter == image_states.end() ) {
+          state_t initial;
+          initial.layout = entry.image->get_layout().get_uniform_layout();
+          state_iter = image_states.emplace( get_key( **entry.image ), initial ).first;
+        }
+        auto &state = state_iter->second;
+        vk::PipelineStageFlags src;
+        vk::AccessFlags src_access;
+        vk::AccessFlags dst_access;
+        const bool transition = state.layout != entry.access.layout;
+        const bool barrier = need_barrier( state, entry.access, src, src_access, dst_access );
+        if( transition || barrier ) {
+          // レイアウトの変更は書き込みとして扱うので、前の読み書きの全てを待つ
+          if( transition ) {
+            src = state.write_stage | state.read_stage;
+            src_access = state.write_access;
+            dst_access = entry.access.access;
+          }
+          src_stage |= src;
+          dst_stage |= entry.access.stage;
+          if( transition || src_access || dst_access ) {
+            const auto &props = entry.image->get_props().get_basic();
+            image_barriers.push_back(
+              vk::ImageMemoryBarrier()
+                .setSrcAccessMask( src_access )
+                .setDstAccessMask( dst_access )
+                .setOldLayout( state.layout )
+                .setNewLayout( entry.access.layout )
+                .setSrcQueueFamilyIndex( VK_QUEUE_FAMILY_IGNORED )
+                .setDstQueueFamilyIndex( VK_QUEUE_FAMILY_IGNORED )
+                .setImage( **entry.image )
+                .setSubresourceRange(
+                  vk::ImageSubresourceRange()
+                    .setAspectMask( get_aspect( props.format ) )
+                    .setBaseMipLevel( 0 )
+                    .setLevelCount( props.mipLevels )
+                    .setBaseArrayLayer( 0 )
+                    .setLayerCount( props.arrayLayers )
+                )
+            );
+          }
+          else execution_dependency = true;
+          log[ "images" ].push_back( {
+            { "name", get_name( **entry.image ) },
+            { "src_stage", vk::to_string( src ) },
+            { "dst_stage", vk::to_string( entry.access.stage ) },
+            { "src_access", vk::to_string( src_access ) },
+            { "dst_access", vk::to_string( dst_access ) },
+            { "old_layout", vk::to_string( state.layout ) },
+            { "new_layout", vk::to_string( entry.access.layout ) }
+          } );
+          ++emitted_image_barriers;
+          if( transition ) {
+            // レイアウトの変更の結果は申告されたステージとアクセスに対して見えている
+            state.layout = entry.access.layout;
+            state.write_stage = entry.access.stage;
+            state.write_access = vk::AccessFlags();
+            state.visible_stage = entry.access.stage;
+            state.visible_access = entry.access.access;
+            state.read_stage = vk::PipelineStageFlags();
+          }
+        }
+        else ++elided_barriers;
+        commit( state, entry.access );
+      }
+      pending_buffers.clear();
+      pending_images.clear();
+      if( buffer_barriers.empty() && image_barriers.empty() && !execution_dependency ) return;
+      // 前に何も無い資源のレイアウト変更だけの場合は待つべきステージが無い
+      if( !src_stage ) src_stage = vk::PipelineStageFlagBits::eTopOfPipe;
+      rec->pipelineBarrier(
+        src_stage,
+        dst_stage,
+        vk::DependencyFlagBits( 0 ),
+        {},
+        buffer_barriers,
+        image_barriers
+      );
+      log[ "src_stage" ] = vk::to_string( src_stage );
+      log[ "dst_stage" ] = vk::to_string( dst_stage );
+      history.push_back( log );
+    }
+    // これまでに積んだバリアの一覧と統計
+    nlohmann::json dump() const {
+      nlohmann::json root;
+      root[ "pipeline_barriers" ] = history.size();
+      root[ "buffer_barriers" ] = emitted_buffer_barriers;
+      root[ "image_barriers" ] = emitted_image_barriers;
+      root[ "elided" ] = elided_barriers;
+      root[ "history" ] = history;
+      return root;
+    }
+  private:
+    template< typename Handle >
+    static std::uint64_t get_key( const Handle &handle ) {
+      return std::uint64_t( typename Handle::CType( handle ) );
+    }
+    template< typename Handle >
+    std::string get_name( const Handle &handle ) const {
+      const auto name = names.find( get_key( handle ) );
+      if( name != names.end() ) return name->second;
+      std::stringstream stream;
+      stream << std::hex << "0x" << get_key( handle );
+      return stream.str();
+    }
+    static vk::ImageAspectFlags get_aspect( vk::Format format ) {
+      switch( format ) {
+        case vk::Format::eD16Unorm:
+        case vk::Format::eX8D24UnormPack32:
+        case vk::Format::eD32Sfloat:
+          return vk::ImageAspectFlagBits::eDepth;
+        case vk::Format::eS8Uint:
+          return vk::ImageAspectFlagBits::eStencil;
+        case vk::Format::eD16UnormS8Uint:
+        case vk::Format::eD24UnormS8Uint:
+        case vk::Format::eD32SfloatS8Uint:
+          return vk::ImageAspectFlagBits::eDepth|vk::ImageAspectFlagBits::eStencil;
+        default:
+          return vk::ImageAspectFlagBits::eColor;
+      }
+    }
+    // 同じコマンドに対する同じ資源の申告は1つにまとめる
+    void add( const std::shared_ptr< gct::buffer_t > &buffer, const access_t &access ) {
+      for( auto &entry: pending_buffers ) {
+        if( entry.buffer == buffer ) {
+          merge( entry.access, access );
+          return;
+        }
+      }
+      pending_buffers.push_back( buffer_entry_t{ buffer, access } );
+    }
+    void add( const std::shared_ptr< gct::image_t > &image, const access_t &access ) {
+      for( auto &entry: pending_images ) {
+        if( entry.image == image ) {
+          if( entry.access.layout != access.layout )
+            throw std::runtime_error( "barrier_tracker_t : an image can not be used in two layouts by one command" );
+          merge( entry.access, access );
+          return;
+        }
+      }
+      pending_images.push_back( image_entry_t{ image, access } );
+    }
+    static void merge( access_t &dest, const access_t &src ) {
+      dest.stage |= src.stage;
+      dest.access |= src.access;
+      dest.write = dest.write || src.write;
+    }
+    // 資源の状態と次のアクセスから必要なバリアを求める
+    static bool need_barrier(
+      const state_t &state,
+      const access_t &access,
+      vk::PipelineStageFlags &src_stage,
+      vk::AccessFlags &src_access,
+      vk::AccessFlags &dst_access
+    ) {
+      const bool written = bool( state.write_stage );
+      if( access.write ) {
+        if( written ) {
+          // WAW: 前の書き込みの後に書く
+          // 前の書き込みの後に読んだステージも待つ
+          src_stage = state.write_stage | state.read_stage;
+          src_access = state.write_access;
+          dst_access = access.access;
+          return true;
+        }
+        if( state.read_stage ) {
+          // WAR: 読み終わるのを待つだけでよい
+          src_stage = state.read_stage;
+          return true;
+        }
+        return false;
+      }
+      if( !written ) return false;
+      // RAW: 同じステージの同じアクセスに既に見えている場合は何もしなくてよい
+      if( ( state.visible_stage & access.stage ) == access.stage &&
+          ( state.visible_access & access.access ) == access.access ) return false;
+      src_stage = state.write_stage;
+      src_access = state.write_access;
+      dst_access = access.access;
+      return true;
+    }
+    // アクセスを実行した後の状態にする
+    static void commit( state_t &state, const access_t &access ) {
+      if( access.write ) {
+        // 読み込みと書き込みを1つにまとめた申告から書き込みのアクセスだけを残す
+        // 読み込みのアクセスをsrcAccessMaskに入れるのは誤り
+        state.write_stage = access.stage;
+        state.write_access = access.access & write_access_mask;
+        state.visible_stage = vk::PipelineStageFlags();
+        state.visible_access = vk::AccessFlags();
+        state.read_stage = vk::PipelineStageFlags();
+      }
+      else {
+        if( state.write_stage ) {
+          state.visible_stage |= access.stage;
+          state.visible_access |= access.access;
+        }
+        state.read_stage |= access.stage;
+      }
+    }
+    static constexpr vk::AccessFlags write_access_mask =
+      vk::AccessFlagBits::eShaderWrite |
+      vk::AccessFlagBits::eColorAttachmentWrite |
+      vk::AccessFlagBits::eDepthStencilAttachmentWrite |
+      vk::AccessFlagBits::eTransferWrite |
+      vk::AccessFlagBits::eHostWrite |
+      vk::AccessFlagBits::eMemoryWrite;
+    std::vector< buffer_entry_t > pending_buffers;
+    std::vector< image_entry_t > pending_images;
+    std::unordered_map< std::uint64_t, state_t > buffer_states;
+    std::unordered_map< std::uint64_t, state_t > image_states;
+    std::unordered_map< std::uint64_t, std::string > names;
+    std::vector< nlohmann::json > history;
+    std::size_t emitted_buffer_barriers = 0u;
+    std::size_t emitted_image_barriers = 0u;
+    std::size_t elided_barriers = 0u;
+  };
+}
+
+#endif
+
@@ -0,0 +1,171 @@
+#ifndef SAMPLES_COMMAND_BUFFER_RECYCLER_HPP
+#define SAMPLES_COMMAND_BUFFER_RECYCLER_HPP
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include <nlohmann/json.hpp>
+#include <gct/device.hpp>
+#include <gct/queue.hpp>
+#include <gct/command_buffer.hpp>
+#include <gct/command_buffer_recorder.hpp>
+#include <gct/command_pool.hpp>
+
+namespace samples {
+  // 使い捨てのコマンドバッファを実行が終わった後で使い回す
+  //
+  // キューから取ったコマンドプールを1つ持ち、そこから確保したコマンドバッファを
+  // 実行中のリストと空きリストで管理する
+  // コマンドバッファは使い回すフェンスと一緒にキューに送り、フェンスの状態で実行の完了を確かめる
+  // acquireはフェンスを待たずに状態を見るだけなので、実行中のものがあってもそこで止まらない
+  // 完了したものは次のacquireで空きリストに戻り、フェンスも使い回す
+  //
+  // コマンドプールは外部同期が必要なので、1つのインスタンスは作ったスレッドからだけ使う
+  // 複数のスレッドから記録する場合はスレッド毎にインスタンスを作る
+  class command_buffer_recycler_t {
+  public:
+    command_buffer_recycler_t(
+      const std::shared_ptr< gct::device_t > &device_,
+      const std::shared_ptr< gct::queue_t > &queue_
+    ) :
+      device( device_ ),
+      queue( queue_ ),
+      command_pool( queue_->get_command_pool() ),
+      owner( std::this_thread::get_id() ) {}
+    ~command_buffer_recycler_t() {
+      // 実行中のコマンドバッファを捨てる前に完了を待つ
+      try {
+        for( const auto &v: in_flight ) wait_for_fence( *v.fence );
+      }
+      catch( ... ) {}
+    }
+    command_buffer_recycler_t( const command_buffer_recycler_t& ) = delete;
+    command_buffer_recycler_t &operator=( const command_buffer_recycler_t& ) = delete;
+    // 記録できる状態のコマンドバッファを返す
+    // 実行が終わったものがあればそれを使い、無ければ新しく確保する
+    std::shared_ptr< gct::bound_command_buffer_t > acquire() {
+      check_thread();
+      reclaim();
+      if( !free_command_buffers.empty() ) {
+        auto command_buffer = free_command_buffers.back();
+        free_command_buffers.pop_back();
+        ++reused;
+        return command_buffer;
+      }
+      ++allocated;
+      return command_pool->allocate();
+    }
+    // acquire()で得たコマンドバッファをキューに送る
+    // 完了はvkQueueSubmitに渡したフェンスで通知される
+    void submit( const std::shared_ptr< gct::bound_command_buffer_t > &command_buffer ) {
+      check_thread();
+      auto fence = get_fence();
+      const auto raw_command_buffer = **command_buffer;
+      (**queue).submit(
+        vk::SubmitInfo()
+          .setCommandBufferCount( 1u )
+          .setPCommandBuffers( &raw_command_buffer ),
+        *fence
+      );
+      in_flight.push_back( in_flight_t{ command_buffer, std::move( fence ) } );
+    }
+    // コマンドバッファの実行が完了するまで待つ
+    void wait( const std::shared_ptr< gct::bound_command_buffer_t > &command_buffer ) {
+      check_thread();
+      for( const auto &v: in_flight ) {
+        if( v.command_buffer == command_buffer ) wait_for_fence( *v.fence );
+      }
+    }
+    // コマンドを記録して実行し、完了するまで待つ
+    // 一度だけ行う転送や変換に使う
+    template< typename F >
+    void execute( F &&f ) {
+      auto command_buffer = acquire();
+      {
+        auto rec = command_buffer->begin();
+        f( rec );
+      }
+      submit( command_buffer );
+      wait( command_buffer );
+    }
+    // 利用者が参照を持っておらず、実行が完了したコマンドバッファを空きリストに戻す
+    // フェンスの状態を見るだけで待たないので、実行中のものは実行中のリストに残る
+    void reclaim() {
+      check_thread();
+      std::vector< in_flight_t > running;
+      for( auto &v: in_flight ) {
+        if(
+          v.command_buffer.use_count() == 1 &&
+          (*device)->getFenceStatus( *v.fence ) == vk::Result::eSuccess
+        ) {
+          (**v.command_buffer).reset( vk::CommandBufferResetFlags() );
+          free_command_buffers.push_back( std::move( v.command_buffer ) );
+          free_fences.push_back( std::move( v.fence ) );
+        }
+        else running.push_back( std::move( v ) );
+      }
+      in_flight = std::move( running );
+    }
+    // 新しく確保したコマンドバッファの数
+    std::uint64_t get_allocated() const {
+      return allocated;
+    }
+    // 使い回した事で確保せずに済んだ回数
+    std::uint64_t get_reused() const {
+      return reused;
+    }
+    std::uint64_t get_in_flight() const {
+      return in_flight.size();
+    }
+    std::uint64_t get_free() const {
+      return free_command_buffers.size();
+    }
+    nlohmann::json dump() const {
+      nlohmann::json root;
+      root[ "allocated" ] = allocated;
+      root[ "reused" ] = reused;
+      root[ "in_flight" ] = in_flight.size();
+      root[ "free" ] = free_command_buffers.size();
+      return root;
+    }
+  private:
+    struct in_flight_t {
+      std::shared_ptr< gct::bound_command_buffer_t > command_buffer;
+      vk::UniqueFence fence;
+    };
+    // シグナルされていないフェンスを返す
+    vk::UniqueFence get_fence() {
+      if( !free_fences.empty() ) {
+        auto fence = std::move( free_fences.back() );
+        free_fences.pop_back();
+        (*device)->resetFences( *fence );
+        return fence;
+      }
+      return (*device)->createFenceUnique( vk::FenceCreateInfo() );
+    }
+    void wait_for_fence( vk::Fence fence ) const {
+      const auto result = (*device)->waitForFences( fence, VK_TRUE, std::numeric_limits< std::uint64_t >::max() );
+      if( result != vk::Result::eSuccess )
+        vk::throwResultException( result, "waitForFences failed" );
+    }
+    void check_thread() const {
+      if( std::this_thread::get_id() != owner )
+        throw std::runtime_error( "command_buffer_recycler_t : used from a thread other than the owner" );
+    }
+    std::shared_ptr< gct::device_t > device;
+    std::shared_ptr< gct::queue_t > queue;
+    std::shared_ptr< gct::command_pool_t > command_pool;
+    std::thread::id owner;
+    std::vector< in_flight_t > in_flight;
+    std::vector< std::shared_ptr< gct::bound_command_buffer_t > > free_command_buffers;
+    std::vector< vk::UniqueFence > free_fences;
+    std::uint64_t allocated = 0u;
+    std::uint64_t reused = 0u;
+  };
+}
+
+#endif
+
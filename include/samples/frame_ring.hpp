@@ -0,0 +1,145 @@
+#ifndef SAMPLES_FRAME_RING_HPP
+#define SAMPLES_FRAME_RING_HPP
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include <gct/device.hpp>
+#include <gct/queue.hpp>
+#include <gct/semaphore.hpp>
+#include <gct/command_buffer.hpp>
+#include <gct/command_pool.hpp>
+
+namespace samples {
+  // 同時にGPUに積んでおくフレームの数を決めてフレーム毎の資源を使い回す
+  //
+  // n番目のフレームのコマンドバッファの実行が完了するとタイムラインセマフォの値がn+1になる
+  // n番目のフレームはn-depth番目のフレームと同じスロットを使うので、
+  // begin()はセマフォの値がn-depth+1になるまで待ってからスロットを返す
+  // スワップチェーンのイメージの数とは独立にCPUとGPUの重なりを決められる
+  //
+  // デバイスでtimelineSemaphoreが有効になっている必要がある
+  class frame_ring_t {
+  public:
+    // 1フレーム分の資源
+    struct frame_t {
+      // スロットの番号 0からdepth-1まで
+      std::uint32_t index = 0u;
+      // 何番目のフレームか
+      std::uint64_t serial = 0u;
+      std::shared_ptr< gct::bound_command_buffer_t > command_buffer;
+      // スワップチェーンのイメージを取得したときに通知されるセマフォ
+      std::shared_ptr< gct::semaphore_t > image_acquired;
+    };
+    frame_ring_t(
+      const std::shared_ptr< gct::device_t > &device_,
+      const std::shared_ptr< gct::queue_t > &queue_,
+      std::uint32_t depth
+    ) : device( device_ ), queue( queue_ ) {
+      if( depth == 0u )
+        throw std::runtime_error( "frame_ring_t : depth must not be 0" );
+      vk::StructureChain< vk::SemaphoreCreateInfo, vk::SemaphoreTypeCreateInfo > create_info{
+        vk::SemaphoreCreateInfo(),
+        vk::SemaphoreTypeCreateInfo()
+          .setSemaphoreType( vk::SemaphoreType::eTimeline )
+          .setInitialValue( 0u )
+      };
+      timeline = (*device)->createSemaphoreUnique( create_info.get< vk::SemaphoreCreateInfo >() );
+      for( std::uint32_t i = 0u; i != depth; ++i ) {
+        frame_t frame;
+        frame.index = i;
+        frame.command_buffer = queue->get_command_pool()->allocate();
+        frame.image_acquired = device->get_semaphore();
+        frames.push_back( frame );
+      }
+    }
+    // 次のフレームの資源を返す
+    // スロットを前に使ったフレームの実行が完了するまで待つ
+    const frame_t &begin() {
+      auto &frame = frames[ next_serial % frames.size() ];
+      if( next_serial >= frames.size() ) {
+        const auto begin_time = std::chrono::high_resolution_clock::now();
+        wait( next_serial - frames.size() + 1u );
+        const auto end_time = std::chrono::high_resolution_clock::now();
+        wait_ns += double( std::chrono::duration_cast< std::chrono::nanoseconds >( end_time - begin_time ).count() );
+      }
+      frame.serial = next_serial;
+      return frame;
+    }
+    // フレームのコマンドバッファをキューに送る
+    // image_acquiredをwait_stageで待ち、完了したらsignalとタイムラインセマフォに通知する
+    void submit(
+      const frame_t &frame,
+      vk::PipelineStageFlags wait_stage,
+      const std::shared_ptr< gct::semaphore_t > &signal
+    ) {
+      if( frame.serial != next_serial )
+        throw std::runtime_error( "frame_ring_t : frames must be submitted in the order of begin()" );
+      const auto command_buffer = **frame.command_buffer;
+      const vk::Semaphore wait_semaphore = **frame.image_acquired;
+      const std::vector< vk::Semaphore > signal_semaphores{ **signal, *timeline };
+      // バイナリセマフォの値は無視される
+      const std::uint64_t wait_value = 0u;
+      const std::vector< std::uint64_t > signal_values{ 0u, frame.serial + 1u };
+      const auto timeline_info = vk::TimelineSemaphoreSubmitInfo()
+        .setWaitSemaphoreValueCount( 1u )
+        .setPWaitSemaphoreValues( &wait_value )
+        .setSignalSemaphoreValues( signal_values );
+      (**queue).submit(
+        vk::SubmitInfo()
+          .setPNext( &timeline_info )
+          .setWaitSemaphoreCount( 1u )
+          .setPWaitSemaphores( &wait_semaphore )
+          .setPWaitDstStageMask( &wait_stage )
+          .setCommandBufferCount( 1u )
+          .setPCommandBuffers( &command_buffer )
+          .setSignalSemaphores( signal_semaphores ),
+        vk::Fence()
+      );
+      ++next_serial;
+    }
+    // 送った全てのフレームの実行が完了するまで待つ
+    void wait_idle() const {
+      wait( next_serial );
+    }
+    std::uint32_t get_depth() const {
+      return frames.size();
+    }
+    // 実行が完了したフレームの数
+    std::uint64_t get_completed() const {
+      return (*device)->getSemaphoreCounterValue( *timeline );
+    }
+    std::uint64_t get_submitted() const {
+      return next_serial;
+    }
+    // スロットが空くのをCPUが待っていた時間の合計
+    double get_wait_ns() const {
+      return wait_ns;
+    }
+  private:
+    void wait( std::uint64_t value ) const {
+      const vk::Semaphore semaphore = *timeline;
+      const auto result = (*device)->waitSemaphores(
+        vk::SemaphoreWaitInfo()
+          .setSemaphoreCount( 1u )
+          .setPSemaphores( &semaphore )
+          .setPValues( &value ),
+        std::numeric_limits< std::uint64_t >::max()
+      );
+      if( result != vk::Result::eSuccess )
+        vk::throwResultException( result, "waitSemaphores failed" );
+    }
+    std::shared_ptr< gct::device_t > device;
+    std::shared_ptr< gct::queue_t > queue;
+    vk::UniqueSemaphore timeline;
+    std::vector< frame_t > frames;
+    std::uint64_t next_serial = 0u;
+    double wait_ns = 0.0;
+  };
+}
+
+#endif
+
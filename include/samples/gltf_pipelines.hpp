@@ -0,0 +1,239 @@
+#ifndef SAMPLES_GLTF_PIPELINES_HPP
+#define SAMPLES_GLTF_PIPELINES_HPP
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include <gct/device.hpp>
+#include <gct/descriptor_set_layout.hpp>
+#include <gct/pipeline_layout_create_info.hpp>
+#include <gct/pipeline_viewport_state_create_info.hpp>
+#include <gct/pipeline_dynamic_state_create_info.hpp>
+#include <gct/pipeline_input_assembly_state_create_info.hpp>
+#include <gct/pipeline_vertex_input_state_create_info.hpp>
+#include <gct/pipeline_multisample_state_create_info.hpp>
+#include <gct/pipeline_rasterization_state_create_info.hpp>
+#include <gct/pipeline_depth_stencil_state_create_info.hpp>
+#include <gct/pipeline_color_blend_state_create_info.hpp>
+#include <gct/pipeline_shader_stage_create_info.hpp>
+#include <gct/graphics_pipeline_create_info.hpp>
+#include <gct/pipeline_layout.hpp>
+#include <gct/render_pass.hpp>
+#include <gct/shader_module.hpp>
+#include <gct/vertex_attributes.hpp>
+
+namespace samples {
+  // glTFのマテリアルとプリミティブの頂点属性から、37_gltfのフラグメントシェーダの変種のファイル名を得る
+  // 名前の付け方はshaders/の変種と同じで、接ベクトルを持つプリミティブだけがtangentと法線マップを使う
+  // 影を使うかどうかはgct::gltf::load_gltfの中で決まるので、shadowがtrueの場合は_sh付きの変種も含める
+  inline std::vector< std::string > get_gltf_variant_names( const std::filesystem::path &path, bool shadow ) {
+    std::ifstream file( path );
+    if( !file )
+      throw std::runtime_error( "get_gltf_variant_names : unable to open " + path.string() );
+    const auto doc = nlohmann::json::parse( file );
+    const auto materials = doc.value( "materials", nlohmann::json::array() );
+    std::set< std::string > names;
+    for( const auto &mesh: doc.value( "meshes", nlohmann::json::array() ) ) {
+      for( const auto &primitive: mesh.value( "primitives", nlohmann::json::array() ) ) {
+        const bool tangent = primitive.value( "attributes", nlohmann::json::object() ).contains( "TANGENT" );
+        std::string name = tangent ? "tangent" : "world";
+        if( primitive.contains( "material" ) ) {
+          const auto index = primitive[ "material" ].get< std::size_t >();
+          if( index >= materials.size() )
+            throw std::runtime_error( "get_gltf_variant_names : " + path.string() + " refers to a missing material" );
+          const auto &material = materials[ index ];
+          const auto pbr = material.value( "pbrMetallicRoughness", nlohmann::json::object() );
+          if( pbr.contains( "baseColorTexture" ) ) name += "_bc";
+          if( pbr.contains( "metallicRoughnessTexture" ) ) name += "_mr";
+          if( material.contains( "occlusionTexture" ) ) name += "_oc";
+          if( material.contains( "emissiveTexture" ) ) name += "_em";
+          if( tangent && material.contains( "normalTexture" ) ) name += "_no";
+        }
+        names.insert( name + ".frag.spv" );
+        if( shadow ) names.insert( name + "_sh.frag.spv" );
+      }
+    }
+    return std::vector< std::string >( names.begin(), names.end() );
+  }
+
+  // 37_gltfのglTFの描画に使うパイプラインの作成情報を作る
+  //
+  // 変種毎に違うのはフラグメントシェーダと、接ベクトルを使うかどうかで決まる頂点シェーダと頂点入力だけ
+  // それ以外のステートとパイプラインレイアウトは全ての変種で共有する
+  class gltf_pipeline_factory_t {
+  public:
+    gltf_pipeline_factory_t(
+      const std::shared_ptr< gct::device_t > &device_,
+      const std::shared_ptr< gct::render_pass_t > &render_pass_,
+      const std::filesystem::path &shader_dir_,
+      const std::shared_ptr< gct::descriptor_set_layout_t > &dynamic_descriptor_set_layout,
+      const std::shared_ptr< gct::descriptor_set_layout_t > &env_descriptor_set_layout,
+      const vk::Extent2D &extent
+    ) : device( device_ ), render_pass( render_pass_ ), shader_dir( shader_dir_ ) {
+      // マテリアル毎に変わるデスクリプタ
+      // 変種によって使うテクスチャが違うので、全ての変種が使う物を含むレイアウトにする
+      auto material_layout_create_info = gct::descriptor_set_layout_create_info_t()
+        .add_binding(
+          vk::DescriptorSetLayoutBinding()
+            .setBinding( 0 )
+            .setDescriptorType( vk::DescriptorType::eUniformBuffer )
+            .setDescriptorCount( 1u )
+            .setStageFlags( vk::ShaderStageFlagBits::eVertex|vk::ShaderStageFlagBits::eFragment )
+        );
+      for( std::uint32_t binding = 1u; binding != 11u; ++binding ) {
+        material_layout_create_info.add_binding(
+          vk::DescriptorSetLayoutBinding()
+            .setBinding( binding )
+            .setDescriptorType( vk::DescriptorType::eCombinedImageSampler )
+            .setDescriptorCount( 1u )
+            .setStageFlags( vk::ShaderStageFlagBits::eFragment )
+        );
+      }
+      const auto material_descriptor_set_layout = device->get_descriptor_set_layout( material_layout_create_info );
+      // push_constants.hのPushConstants
+      pipeline_layout = device->get_pipeline_layout(
+        gct::pipeline_layout_create_info_t()
+          .add_descriptor_set_layout( material_descriptor_set_layout )
+          .add_descriptor_set_layout( dynamic_descriptor_set_layout )
+          .add_descriptor_set_layout( env_descriptor_set_layout )
+          .add_push_constant_range(
+            vk::PushConstantRange()
+              .setStageFlags( vk::ShaderStageFlagBits::eVertex|vk::ShaderStageFlagBits::eFragment )
+              .setOffset( 0 )
+              .setSize( sizeof( float ) * 16u + sizeof( std::int32_t ) )
+          )
+      );
+
+      const auto stencil_op = vk::StencilOpState()
+        .setCompareOp( vk::CompareOp::eAlways )
+        .setFailOp( vk::StencilOp::eKeep )
+        .setPassOp( vk::StencilOp::eKeep );
+      input_assembly
+        .set_basic(
+          vk::PipelineInputAssemblyStateCreateInfo()
+            .setTopology( vk::PrimitiveTopology::eTriangleList )
+        );
+      viewport
+        .add_viewport(
+          vk::Viewport()
+            .setWidth( extent.width )
+            .setHeight( extent.height )
+            .setMinDepth( 0.0f )
+            .setMaxDepth( 1.0f )
+        )
+        .add_scissor(
+          vk::Rect2D()
+            .setOffset( { 0, 0 } )
+            .setExtent( extent )
+        )
+        .rebuild_chain();
+      rasterization
+        .set_basic(
+          vk::PipelineRasterizationStateCreateInfo()
+            .setDepthClampEnable( false )
+            .setRasterizerDiscardEnable( false )
+            .setPolygonMode( vk::PolygonMode::eFill )
+            .setCullMode( vk::CullModeFlagBits::eBack )
+            .setFrontFace( vk::FrontFace::eCounterClockwise )
+            .setDepthBiasEnable( false )
+            .setLineWidth( 1.0f )
+        );
+      multisample
+        .set_basic(
+          vk::PipelineMultisampleStateCreateInfo()
+        );
+      depth_stencil
+        .set_basic(
+          vk::PipelineDepthStencilStateCreateInfo()
+            .setDepthTestEnable( true )
+            .setDepthWriteEnable( true )
+            .setDepthCompareOp( vk::CompareOp::eLessOrEqual )
+            .setDepthBoundsTestEnable( false )
+            .setStencilTestEnable( false )
+            .setFront( stencil_op )
+            .setBack( stencil_op )
+        );
+      color_blend
+        .add_attachment(
+          vk::PipelineColorBlendAttachmentState()
+            .setBlendEnable( false )
+            .setColorWriteMask(
+              vk::ColorComponentFlagBits::eR |
+              vk::ColorComponentFlagBits::eG |
+              vk::ColorComponentFlagBits::eB |
+              vk::ColorComponentFlagBits::eA
+            )
+        );
+
+      // 頂点シェーダは接ベクトルを使うかどうかで2種類
+      world_vs = device->get_shader_module( ( shader_dir / "world.vert.spv" ).string() );
+      tangent_vs = device->get_shader_module( ( shader_dir / "tangent.vert.spv" ).string() );
+      world_vertex_input = std::get< 0 >( gct::get_vertex_attributes(
+        *device,
+        world_vs->get_props().get_reflection()
+      ) );
+      tangent_vertex_input = std::get< 0 >( gct::get_vertex_attributes(
+        *device,
+        tangent_vs->get_props().get_reflection()
+      ) );
+    }
+    // shader_dirにある変種(例: world_bc_mr.frag.spv)を使うパイプライン
+    gct::graphics_pipeline_create_info_t get_create_info( const std::string &name ) const {
+      const bool tangent = name.compare( 0u, 7u, "tangent" ) == 0;
+      auto create_info = get_common_create_info( tangent );
+      create_info.add_stage( device->get_shader_module( ( shader_dir / name ).string() ) );
+      return create_info;
+    }
+    // 任意のフラグメントシェーダのステージを使うパイプライン
+    gct::graphics_pipeline_create_info_t get_create_info(
+      bool tangent,
+      const gct::pipeline_shader_stage_create_info_t &fragment_stage
+    ) const {
+      auto create_info = get_common_create_info( tangent );
+      create_info.add_stage( fragment_stage );
+      return create_info;
+    }
+    const std::filesystem::path &get_shader_dir() const {
+      return shader_dir;
+    }
+  private:
+    gct::graphics_pipeline_create_info_t get_common_create_info( bool tangent ) const {
+      return gct::graphics_pipeline_create_info_t()
+        .add_stage( tangent ? tangent_vs : world_vs )
+        .set_vertex_input( tangent ? tangent_vertex_input : world_vertex_input )
+        .set_input_assembly( input_assembly )
+        .set_viewport( viewport )
+        .set_rasterization( rasterization )
+        .set_multisample( multisample )
+        .set_depth_stencil( depth_stencil )
+        .set_color_blend( color_blend )
+        .set_dynamic(
+          gct::pipeline_dynamic_state_create_info_t()
+        )
+        .set_layout( pipeline_layout )
+        .set_render_pass( render_pass, 0 );
+    }
+    std::shared_ptr< gct::device_t > device;
+    std::shared_ptr< gct::render_pass_t > render_pass;
+    std::filesystem::path shader_dir;
+    std::shared_ptr< gct::pipeline_layout_t > pipeline_layout;
+    std::shared_ptr< gct::shader_module_t > world_vs;
+    std::shared_ptr< gct::shader_module_t > tangent_vs;
+    gct::pipeline_vertex_input_state_create_info_t world_vertex_input;
+    gct::pipeline_vertex_input_state_create_info_t tangent_vertex_input;
+    gct::pipeline_input_assembly_state_create_info_t input_assembly;
+    gct::pipeline_viewport_state_create_info_t viewport;
+    gct::pipeline_rasterization_state_create_info_t rasterization;
+    gct::pipeline_multisample_state_create_info_t multisample;
+    gct::pipeline_depth_stencil_state_create_info_t depth_stencil;
+    gct::pipeline_color_blend_state_create_info_t color_blend;
+  };
+}
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef SAMPLES_IMAGE_TILER_HPP
+#define SAMPLES_IMAGE_TILER_HPP
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace samples {
+  // 大きな画像を決まった大きさのタイルに分けて処理する為の分割
+  //
+  // 出力画像をtile_size四方のタイルに分け、各々のタイルを作るのに必要な入力画像の範囲を求める
+  // 入力の範囲は出力のタイルに対応する範囲の周りにhaloピクセルの糊代を付けた物で、画像の端で切り詰める
+  // フィルタの半径をhaloにすれば、タイルの境界でも画像全体を一度に処理した場合と同じ結果になる
+  // 入力と出力の大きさが違う場合は比率に応じて入力の範囲を求める
+  struct image_tile_t {
+    // タイルの番号
+    std::uint32_t column = 0u;
+    std::uint32_t row = 0u;
+    // 出力画像の中でのタイルの範囲
+    std::uint32_t dest_x = 0u;
+    std::uint32_t dest_y = 0u;
+    std::uint32_t dest_width = 0u;
+    std::uint32_t dest_height = 0u;
+    // 入力画像の中で読む必要がある範囲(糊代を含む)
+    std::uint32_t src_x = 0u;
+    std::uint32_t src_y = 0u;
+    std::uint32_t src_width = 0u;
+    std::uint32_t src_height = 0u;
+  };
+  class image_tiler_t {
+  public:
+    image_tiler_t(
+      std::uint32_t src_width_,
+      std::uint32_t src_height_,
+      std::uint32_t dest_width_,
+      std::uint32_t dest_height_,
+      std::uint32_t tile_size_,
+      std::uint32_t halo_
+    ) :
+      src_width( src_width_ ),
+      src_height( src_height_ ),
+      dest_width( dest_width_ ),
+      dest_height( dest_height_ ),
+      tile_size( tile_size_ ),
+      halo( halo_ ) {
+      if( src_width == 0u || src_height == 0u || dest_width == 0u || dest_height == 0u )
+        throw std::runtime_error( "image_tiler_t : empty image" );
+      if( tile_size == 0u )
+        throw std::runtime_error( "image_tiler_t : tile_size must not be 0" );
+      columns = ( dest_width + tile_size - 1u ) / tile_size;
+      rows = ( dest_height + tile_size - 1u ) / tile_size;
+    }
+    // 入力と出力が同じ大きさの場合
+    image_tiler_t(
+      std::uint32_t width,
+      std::uint32_t height,
+      std::uint32_t tile_size_,
+      std::uint32_t halo_
+    ) : image_tiler_t( width, height, width, height, tile_size_, halo_ ) {}
+    std::uint32_t get_columns() const { return columns; }
+    std::uint32_t get_rows() const { return rows; }
+    std::uint32_t size() const { return columns * rows; }
+    // 左上から行毎に並べた時のindex番目のタイル
+    image_tile_t operator[]( std::uint32_t index ) const {
+      image_tile_t tile;
+      tile.column = index % columns;
+      tile.row = index / columns;
+      tile.dest_x = tile.column * tile_size;
+      tile.dest_y = tile.row * tile_size;
+      tile.dest_width = std::min( tile_size, dest_width - tile.dest_x );
+      tile.dest_height = std::min( tile_size, dest_height - tile.dest_y );
+      const auto [src_x0,src_x1] = get_src_range( tile.dest_x, tile.dest_width, src_width, dest_width );
+      const auto [src_y0,src_y1] = get_src_range( tile.dest_y, tile.dest_height, src_height, dest_height );
+      tile.src_x = src_x0;
+      tile.src_y = src_y0;
+      tile.src_width = src_x1 - src_x0;
+      tile.src_height = src_y1 - src_y0;
+      return tile;
+    }
+    // row行目のタイルが読む入力画像の行の範囲[first,second)
+    std::pair< std::uint32_t, std::uint32_t > get_src_rows( std::uint32_t row ) const {
+      const auto y = row * tile_size;
+      return get_src_range( y, std::min( tile_size, dest_height - y ), src_height, dest_height );
+    }
+    // 1つのタイルが必要とする入力の最大の大きさ
+    // タイル毎に確保するイメージやバッファはこの大きさで作る
+    std::uint32_t get_max_src_width() const {
+      return std::min( src_width, get_max_src_extent( src_width, dest_width ) );
+    }
+    std::uint32_t get_max_src_height() const {
+      return std::min( src_height, get_max_src_extent( src_height, dest_height ) );
+    }
+    std::uint32_t get_tile_size() const { return tile_size; }
+    std::uint32_t get_halo() const { return halo; }
+  private:
+    std::pair< std::uint32_t, std::uint32_t > get_src_range(
+      std::uint32_t dest_begin,
+      std::uint32_t dest_size,
+      std::uint32_t src_extent,
+      std::uint32_t dest_extent
+    ) const {
+      // 出力の範囲を入力の座標に変換し、外側に丸めてから糊代を付ける
+      const std::uint64_t begin = std::uint64_t( dest_begin ) * src_extent / dest_extent;
+      const std::uint64_t end = ( std::uint64_t( dest_begin + dest_size ) * src_extent + dest_extent - 1u ) / dest_extent;
+      return std::make_pair(
+        std::uint32_t( begin > halo ? begin - halo : 0u ),
+        std::uint32_t( std::min< std::uint64_t >( end + halo, src_extent ) )
+      );
+    }
+    std::uint32_t get_max_src_extent( std::uint32_t src_extent, std::uint32_t dest_extent ) const {
+      return std::uint32_t( ( std::uint64_t( tile_size ) * src_extent + dest_extent - 1u ) / dest_extent + 1u + 2u * halo );
+    }
+    std::uint32_t src_width;
+    std::uint32_t src_height;
+    std::uint32_t dest_width;
+    std::uint32_t dest_height;
+    std::uint32_t tile_size;
+    std::uint32_t halo;
+    std::uint32_t columns = 0u;
+    std::uint32_t rows = 0u;
+  };
+}
+
+#endif
+
@@ -0,0 +1,553 @@
+#ifndef SAMPLES_KTX2_HPP
+#define SAMPLES_KTX2_HPP
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include <gct/mmaped_file.hpp>
+#include <gct/allocator.hpp>
+#include <gct/buffer.hpp>
+#include <gct/image.hpp>
+#include <gct/image_create_info.hpp>
+#include <gct/command_buffer_recorder.hpp>
+#ifdef SAMPLES_ENABLE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace samples {
+  // KTX2コンテナ
+  //
+  // +------------------+
+  // | ktx2_header_t    |
+  // +------------------+
+  // | ktx2_level_t * levelCount | レベル0から順
+  // +------------------+
+  // | Data Format Descriptor    |
+  // +------------------+
+  // | Key/Value Data   |
+  // +------------------+
+  // | Supercompression Global Data |
+  // +------------------+
+  // | レベル毎のデータ | 小さいレベルから順に並ぶ
+  // +------------------+
+  //
+  // 1つのレベルの中はレイヤー、面、奥行き、行の順に並んでいて、
+  // レイヤーと面をVulkanの配列レイヤーとして扱えばvkCmdCopyBufferToImageが読む並びと一致する
+  // 数値は全てリトルエンディアン
+  constexpr std::array< std::uint8_t, 12u > ktx2_identifier{
+    0xABu, 0x4Bu, 0x54u, 0x58u, 0x20u, 0x32u, 0x30u, 0xBBu, 0x0Du, 0x0Au, 0x1Au, 0x0Au
+  };
+  enum class ktx2_supercompression_t : std::uint32_t {
+    none = 0u,
+    basis_lz = 1u,
+    zstd = 2u,
+    zlib = 3u
+  };
+  struct ktx2_header_t {
+    std::array< std::uint8_t, 12u > identifier = ktx2_identifier;
+    std::uint32_t vk_format = 0u;
+    std::uint32_t type_size = 0u;
+    std::uint32_t pixel_width = 0u;
+    std::uint32_t pixel_height = 0u;
+    // 3Dテクスチャでなければ0
+    std::uint32_t pixel_depth = 0u;
+    // 配列テクスチャでなければ0
+    std::uint32_t layer_count = 0u;
+    // キューブマップの場合は6
+    std::uint32_t face_count = 1u;
+    // 0の場合は実行時にミップマップを作る事を求めている
+    std::uint32_t level_count = 0u;
+    std::uint32_t supercompression_scheme = 0u;
+    std::uint32_t dfd_byte_offset = 0u;
+    std::uint32_t dfd_byte_length = 0u;
+    std::uint32_t kvd_byte_offset = 0u;
+    std::uint32_t kvd_byte_length = 0u;
+    std::uint64_t sgd_byte_offset = 0u;
+    std::uint64_t sgd_byte_length = 0u;
+  };
+  struct ktx2_level_t {
+    std::uint64_t byte_offset = 0u;
+    std::uint64_t byte_length = 0u;
+    std::uint64_t uncompressed_byte_length = 0u;
+  };
+  static_assert( sizeof( ktx2_header_t ) == 80u );
+  static_assert( sizeof( ktx2_level_t ) == 24u );
+
+  // Vulkan 1.0のフォーマットのテクセルブロックの大きさと、ブロックが覆うテクセルの数
+  // 知らないフォーマットと深度ステンシルが両方あるフォーマットの場合はfalseを返す
+  // VkFormatの値はコア仕様の列挙の順に並んでいるので範囲で引く
+  inline bool get_texel_block( vk::Format format, std::array< std::uint32_t, 3u > &dimension, std::uint32_t &bytes ) {
+    const auto v = std::uint32_t( format );
+    dimension = { 1u, 1u, 1u };
+    bytes = 0u;
+    // 非圧縮
+    struct range_t {
+      std::uint32_t begin;
+      std::uint32_t end;
+      std::uint32_t bytes;
+    };
+    constexpr range_t uncompressed[]{
+      { 1u, 2u, 1u },     // R4G4
+      { 2u, 9u, 2u },     // 16bitにパックされた物
+      { 9u, 16u, 1u },    // R8
+      { 16u, 23u, 2u },   // R8G8
+      { 23u, 37u, 3u },   // R8G8B8, B8G8R8
+      { 37u, 58u, 4u },   // R8G8B8A8, B8G8R8A8, A8B8G8R8
+      { 58u, 70u, 4u },   // A2R10G10B10, A2B10G10R10
+      { 70u, 77u, 2u },   // R16
+      { 77u, 84u, 4u },   // R16G16
+      { 84u, 91u, 6u },   // R16G16B16
+      { 91u, 98u, 8u },   // R16G16B16A16
+      { 98u, 101u, 4u },  // R32
+      { 101u, 104u, 8u }, // R32G32
+      { 104u, 107u, 12u },// R32G32B32
+      { 107u, 110u, 16u },// R32G32B32A32
+      { 110u, 113u, 8u }, // R64
+      { 113u, 116u, 16u },// R64G64
+      { 116u, 119u, 24u },// R64G64B64
+      { 119u, 122u, 32u },// R64G64B64A64
+      { 122u, 124u, 4u }, // B10G11R11, E5B9G9R9
+      { 124u, 125u, 2u }, // D16
+      { 125u, 127u, 4u }, // X8D24, D32
+      { 127u, 128u, 1u }  // S8
+    };
+    for( const auto &r: uncompressed ) {
+      if( v >= r.begin && v < r.end ) {
+        bytes = r.bytes;
+        return true;
+      }
+    }
+    // BC1からBC7とETC2、EAC
+    constexpr range_t block4x4[]{
+      { 131u, 135u, 8u }, // BC1
+      { 135u, 139u, 16u },// BC2, BC3
+      { 139u, 141u, 8u }, // BC4
+      { 141u, 147u, 16u },// BC5, BC6H, BC7
+      { 147u, 151u, 8u }, // ETC2 RGB, RGBA1
+      { 151u, 153u, 16u },// ETC2 RGBA8
+      { 153u, 155u, 8u }, // EAC R11
+      { 155u, 157u, 16u } // EAC R11G11
+    };
+    for( const auto &r: block4x4 ) {
+      if( v >= r.begin && v < r.end ) {
+        dimension = { 4u, 4u, 1u };
+        bytes = r.bytes;
+        return true;
+      }
+    }
+    // ASTCはUNORMとSRGBが交互に並ぶ
+    if( v >= 157u && v < 185u ) {
+      constexpr std::array< std::uint32_t, 2u > astc[]{
+        { 4u, 4u }, { 5u, 4u }, { 5u, 5u }, { 6u, 5u }, { 6u, 6u }, { 8u, 5u }, { 8u, 6u },
+        { 8u, 8u }, { 10u, 5u }, { 10u, 6u }, { 10u, 8u }, { 10u, 10u }, { 12u, 10u }, { 12u, 12u }
+      };
+      const auto &d = astc[ ( v - 157u ) / 2u ];
+      dimension = { d[ 0 ], d[ 1 ], 1u };
+      bytes = 16u;
+      return true;
+    }
+    return false;
+  }
+
+  // KTX2ファイルをmmapして読む
+  // レベルのデータはマップされた領域を指すので、複製せずにステージングバッファに書ける
+  class ktx2_file_t {
+  public:
+    explicit ktx2_file_t( const std::filesystem::path &path_ ) :
+      path( path_ ),
+      file( new gct::mmaped_file( path_ ) ) {
+      size = std::size_t( std::distance( file->begin(), file->end() ) );
+      head = reinterpret_cast< const std::uint8_t* >( &*file->begin() );
+      if( size < sizeof( ktx2_header_t ) )
+        throw std::runtime_error( "ktx2_file_t : " + path.string() + " is truncated" );
+      std::memcpy( &header, head, sizeof( header ) );
+      if( header.identifier != ktx2_identifier )
+        throw std::runtime_error( "ktx2_file_t : " + path.string() + " is not a KTX2 file" );
+      if( header.vk_format == 0u )
+        throw std::runtime_error( "ktx2_file_t : " + path.string() + " has no Vulkan format (BasisLZ or UASTC payload needs a transcoder)" );
+      if( header.pixel_width == 0u || ( header.pixel_depth != 0u && header.pixel_height == 0u ) )
+        throw std::runtime_error( "ktx2_file_t : " + path.string() + " has invalid size" );
+      if( header.face_count != 1u && header.face_count != 6u )
+        throw std::runtime_error( "ktx2_file_t : " + path.string() + " has invalid face count" );
+      if( header.face_count == 6u && ( header.pixel_depth != 0u || header.pixel_width != header.pixel_height ) )
+        throw std::runtime_error( "ktx2_file_t : " + path.string() + " is not a valid cube map" );
+      if( header.pixel_depth != 0u && header.layer_count != 0u )
+        throw std::runtime_error( "ktx2_file_t : " + path.string() + " is an array of 3D textures" );
+      // レベル0の大きさから作れる数より多いレベルは作れない
+      std::uint32_t max_level_count = 1u;
+      for( std::uint32_t extent = std::max( { header.pixel_width, header.pixel_height, header.pixel_depth } ); extent > 1u; extent /= 2u ) ++max_level_count;
+      if( header.level_count > max_level_count )
+        throw std::runtime_error( "ktx2_file_t : " + path.string() + " has more levels than its size allows" );
+      const std::uint32_t level_count = std::max( header.level_count, 1u );
+      if( size < sizeof( ktx2_header_t ) + std::size_t( level_count ) * sizeof( ktx2_level_t ) )
+        throw std::runtime_error( "ktx2_file_t : " + path.string() + " is truncated" );
+      levels.resize( level_count );
+      std::memcpy( levels.data(), head + sizeof( ktx2_header_t ), levels.size() * sizeof( ktx2_level_t ) );
+      const auto scheme = get_supercompression();
+      if( scheme == ktx2_supercompression_t::basis_lz || scheme == ktx2_supercompression_t::zlib )
+        throw std::runtime_error( "ktx2_file_t : " + path.string() + " uses unsupported supercompression" );
+#ifndef SAMPLES_ENABLE_ZSTD
+      if( scheme == ktx2_supercompression_t::zstd )
+        throw std::runtime_error( "ktx2_file_t : " + path.string() + " is Zstandard compressed but libzstd is not available" );
+#endif
+      if( scheme > ktx2_supercompression_t::zlib )
+        throw std::runtime_error( "ktx2_file_t : " + path.string() + " has unknown supercompression" );
+      if( std::uint64_t( header.dfd_byte_offset ) + header.dfd_byte_length > size )
+        throw std::runtime_error( "ktx2_file_t : " + path.string() + " has data format descriptor out of range" );
+      read_texel_block();
+      if( !texel_block_bytes )
+        throw std::runtime_error( "ktx2_file_t : " + path.string() + " has a format whose texel block size is unknown" );
+      for( std::uint32_t i = 0u; i != level_count; ++i ) {
+        const auto &l = levels[ i ];
+        if( l.byte_offset > size || l.byte_length > size - l.byte_offset )
+          throw std::runtime_error( "ktx2_file_t : " + path.string() + " has level " + std::to_string( i ) + " out of range" );
+        if( scheme == ktx2_supercompression_t::none && l.uncompressed_byte_length != l.byte_length )
+          throw std::runtime_error( "ktx2_file_t : " + path.string() + " has level " + std::to_string( i ) + " with inconsistent length" );
+        // 展開した後の大きさがフォーマットから求めた大きさと違う場合、転送がステージングバッファの外を読む
+        if( l.uncompressed_byte_length != get_expected_size( i ) )
+          throw std::runtime_error( "ktx2_file_t : " + path.string() + " has level " + std::to_string( i ) + " with unexpected size" );
+      }
+    }
+    const ktx2_header_t &get_header() const {
+      return header;
+    }
+    const std::vector< ktx2_level_t > &get_levels() const {
+      return levels;
+    }
+    ktx2_supercompression_t get_supercompression() const {
+      return ktx2_supercompression_t( header.supercompression_scheme );
+    }
+    vk::Format get_format() const {
+      return vk::Format( header.vk_format );
+    }
+    vk::ImageType get_image_type() const {
+      if( header.pixel_depth != 0u ) return vk::ImageType::e3D;
+      if( header.pixel_height != 0u ) return vk::ImageType::e2D;
+      return vk::ImageType::e1D;
+    }
+    vk::Extent3D get_extent( std::uint32_t level = 0u ) const {
+      return vk::Extent3D(
+        std::max( header.pixel_width >> level, 1u ),
+        std::max( header.pixel_height >> level, 1u ),
+        std::max( header.pixel_depth >> level, 1u )
+      );
+    }
+    std::uint32_t get_mip_levels() const {
+      return levels.size();
+    }
+    // キューブマップの面も配列レイヤーとして数える
+    std::uint32_t get_array_layers() const {
+      return std::max( header.layer_count, 1u ) * header.face_count;
+    }
+    bool is_cube() const {
+      return header.face_count == 6u;
+    }
+    vk::ImageViewType get_view_type() const {
+      if( is_cube() ) return header.layer_count ? vk::ImageViewType::eCubeArray : vk::ImageViewType::eCube;
+      if( header.pixel_depth != 0u ) return vk::ImageViewType::e3D;
+      if( header.pixel_height != 0u ) return header.layer_count ? vk::ImageViewType::e2DArray : vk::ImageViewType::e2D;
+      return header.layer_count ? vk::ImageViewType::e1DArray : vk::ImageViewType::e1D;
+    }
+    // levelのファイル上のデータ
+    // このオブジェクトが生きている間だけ有効
+    const std::uint8_t *get_data( std::uint32_t level ) const {
+      return head + levels[ level ].byte_offset;
+    }
+    const std::uint8_t *get_head() const {
+      return head;
+    }
+    std::size_t get_size() const {
+      return size;
+    }
+    const std::filesystem::path &get_path() const {
+      return path;
+    }
+  private:
+    // テクセルブロックの大きさをフォーマットから求める
+    // 表に無いフォーマットの場合は基本記述子ブロックから読む
+    // 超圧縮されている場合はbytesPlane0が0なので基本記述子ブロックからは分からない
+    void read_texel_block() {
+      if( get_texel_block( get_format(), texel_block_dimension, texel_block_bytes ) ) return;
+      constexpr std::size_t block_offset = 4u;
+      constexpr std::size_t dimension_offset = block_offset + 12u;
+      constexpr std::size_t bytes_offset = block_offset + 16u;
+      if( header.dfd_byte_length < bytes_offset + 1u ) return;
+      const auto dfd = head + header.dfd_byte_offset;
+      std::uint32_t descriptor = 0u;
+      std::memcpy( &descriptor, dfd + block_offset, sizeof( descriptor ) );
+      // vendorId 0 (Khronos), descriptorType 0 (基本記述子ブロック) 以外は知らない
+      if( descriptor != 0u ) return;
+      for( std::size_t i = 0u; i != 3u; ++i )
+        texel_block_dimension[ i ] = std::uint32_t( dfd[ dimension_offset + i ] ) + 1u;
+      texel_block_bytes = dfd[ bytes_offset ];
+    }
+    std::uint64_t get_expected_size( std::uint32_t level ) const {
+      const auto extent = get_extent( level );
+      const std::uint64_t x = ( extent.width + texel_block_dimension[ 0 ] - 1u ) / texel_block_dimension[ 0 ];
+      const std::uint64_t y = ( extent.height + texel_block_dimension[ 1 ] - 1u ) / texel_block_dimension[ 1 ];
+      const std::uint64_t z = ( extent.depth + texel_block_dimension[ 2 ] - 1u ) / texel_block_dimension[ 2 ];
+      return x * y * z * texel_block_bytes * get_array_layers();
+    }
+    std::filesystem::path path;
+    std::shared_ptr< gct::mmaped_file > file;
+    std::size_t size = 0u;
+    const std::uint8_t *head = nullptr;
+    ktx2_header_t header;
+    std::vector< ktx2_level_t > levels;
+    std::array< std::uint32_t, 3u > texel_block_dimension{ 1u, 1u, 1u };
+    // 0の場合は分からない
+    std::uint32_t texel_block_bytes = 0u;
+  };
+
+  // KTX2ファイルのレベルをステージングバッファに並べる時の各レベルの先頭の位置をoffsetsに返す
+  // 戻り値は全体の大きさ
+  // 超圧縮されていなければファイル上の並びをそのまま使う
+  // レベルの先頭はファイルの先頭からテクセルブロックの大きさと4の公倍数の位置にあるので、差も公倍数になる
+  inline vk::DeviceSize get_ktx2_staging_layout( const ktx2_file_t &file, std::vector< vk::DeviceSize > &offsets ) {
+    const auto &levels = file.get_levels();
+    offsets.assign( levels.size(), 0u );
+    if( file.get_supercompression() == ktx2_supercompression_t::none ) {
+      std::uint64_t begin = levels[ 0 ].byte_offset;
+      std::uint64_t end = 0u;
+      for( const auto &l: levels ) {
+        begin = std::min( begin, l.byte_offset );
+        end = std::max( end, l.byte_offset + l.byte_length );
+      }
+      for( std::size_t i = 0u; i != levels.size(); ++i )
+        offsets[ i ] = levels[ i ].byte_offset - begin;
+      return end - begin;
+    }
+    // 展開したレベルを並べる
+    // テクセルブロックの大きさが分からないので、全てのフォーマットのテクセルブロックの大きさの公倍数に揃える
+    constexpr vk::DeviceSize alignment = 96u;
+    vk::DeviceSize size = 0u;
+    for( std::size_t i = 0u; i != levels.size(); ++i ) {
+      offsets[ i ] = size;
+      size = ( size + levels[ i ].uncompressed_byte_length + alignment - 1u ) / alignment * alignment;
+    }
+    return size;
+  }
+  // get_ktx2_staging_layoutで決めた位置にレベルのデータを書く
+  // 超圧縮されていなければマップされたファイルからの1回のmemcpyになる
+  inline void write_ktx2_levels( const ktx2_file_t &file, const std::vector< vk::DeviceSize > &offsets, std::uint8_t *dest ) {
+    const auto &levels = file.get_levels();
+    if( file.get_supercompression() == ktx2_supercompression_t::none ) {
+      std::uint64_t begin = levels[ 0 ].byte_offset;
+      std::uint64_t end = 0u;
+      for( const auto &l: levels ) {
+        begin = std::min( begin, l.byte_offset );
+        end = std::max( end, l.byte_offset + l.byte_length );
+      }
+      std::memcpy( dest, file.get_head() + begin, end - begin );
+      return;
+    }
+#ifdef SAMPLES_ENABLE_ZSTD
+    for( std::uint32_t i = 0u; i != levels.size(); ++i ) {
+      const auto written = ZSTD_decompress( dest + offsets[ i ], levels[ i ].uncompressed_byte_length, file.get_data( i ), levels[ i ].byte_length );
+      if( ZSTD_isError( written ) || written != levels[ i ].uncompressed_byte_length )
+        throw std::runtime_error( "write_ktx2_levels : unable to decompress level " + std::to_string( i ) + " of " + file.get_path().string() );
+    }
+#else
+    static_cast< void >( offsets );
+    throw std::runtime_error( "write_ktx2_levels : " + file.get_path().string() + " is supercompressed" );
+#endif
+  }
+
+  // KTX2ファイルのミップマップを全て含むイメージを作り、転送するコマンドを記録する
+  //
+  // ファイルはmmapし、レベルのデータはデコードせずに1つのステージングバッファへ書く
+  // 超圧縮されていなければ全てのレベルがファイル上で連続しているので、ステージングバッファへの書き込みは1回のmemcpyになる
+  // 転送は全てのレベルを1回のvkCmdCopyBufferToImageで行う
+  // ステージングバッファは記録したコマンドの実行が終わるまで必要なので、release()を呼ぶまで保持する
+  class ktx2_loader_t {
+  public:
+    explicit ktx2_loader_t(
+      const std::shared_ptr< gct::allocator_t > &allocator_
+    ) : allocator( allocator_ ) {}
+    std::shared_ptr< gct::image_t > load(
+      gct::command_buffer_recorder_t &rec,
+      const std::filesystem::path &path,
+      vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eSampled
+    ) {
+      return load( rec, ktx2_file_t( path ), usage );
+    }
+    std::shared_ptr< gct::image_t > load(
+      gct::command_buffer_recorder_t &rec,
+      const ktx2_file_t &file,
+      vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eSampled
+    ) {
+      const auto &levels = file.get_levels();
+      std::vector< vk::DeviceSize > offsets;
+      const auto staging_size = get_ktx2_staging_layout( file, offsets );
+      auto staging = allocator->create_buffer(
+        gct::buffer_create_info_t()
+          .set_basic(
+            vk::BufferCreateInfo()
+              .setSize( std::max( staging_size, vk::DeviceSize( 1u ) ) )
+              .setUsage( vk::BufferUsageFlagBits::eTransferSrc )
+          ),
+        VMA_MEMORY_USAGE_CPU_TO_GPU
+      );
+      {
+        auto mapped = staging->map< std::uint8_t >();
+        write_ktx2_levels( file, offsets, &*mapped.begin() );
+      }
+      auto image = allocator->create_image(
+        gct::image_create_info_t()
+          .set_basic(
+            vk::ImageCreateInfo()
+              .setFlags( file.is_cube() ? vk::ImageCreateFlagBits::eCubeCompatible : vk::ImageCreateFlags() )
+              .setImageType( file.get_image_type() )
+              .setFormat( file.get_format() )
+              .setExtent( file.get_extent() )
+              .setMipLevels( file.get_mip_levels() )
+              .setArrayLayers( file.get_array_layers() )
+              .setSamples( vk::SampleCountFlagBits::e1 )
+              .setTiling( vk::ImageTiling::eOptimal )
+              .setUsage( usage|vk::ImageUsageFlagBits::eTransferDst )
+              .setInitialLayout( vk::ImageLayout::eUndefined )
+          ),
+          VMA_MEMORY_USAGE_GPU_ONLY
+      );
+      std::vector< vk::BufferImageCopy > regions;
+      for( std::uint32_t i = 0u; i != levels.size(); ++i ) {
+        regions.push_back(
+          vk::BufferImageCopy()
+            .setBufferOffset( offsets[ i ] )
+            .setBufferRowLength( 0 )
+            .setBufferImageHeight( 0 )
+            .setImageSubresource( vk::ImageSubresourceLayers( vk::ImageAspectFlagBits::eColor, i, 0, file.get_array_layers() ) )
+            .setImageOffset( { 0, 0, 0 } )
+            .setImageExtent( file.get_extent( i ) )
+        );
+      }
+      rec.convert_image( image, vk::ImageLayout::eTransferDstOptimal );
+      rec->copyBufferToImage(
+        **staging,
+        **image,
+        vk::ImageLayout::eTransferDstOptimal,
+        regions
+      );
+      rec->pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eVertexShader|vk::PipelineStageFlagBits::eFragmentShader|vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlagBits( 0 ),
+        { vk::MemoryBarrier().setSrcAccessMask( vk::AccessFlagBits::eTransferWrite ).setDstAccessMask( vk::AccessFlagBits::eShaderRead ) },
+        {},
+        {}
+      );
+      rec.convert_image( image, vk::ImageLayout::eShaderReadOnlyOptimal );
+      staging_buffers.push_back( staging );
+      loaded_bytes += staging_size;
+      return image;
+    }
+    // load()で記録したコマンドの実行が終わった後に呼ぶ
+    void release() {
+      staging_buffers.clear();
+    }
+    // これまでにステージングバッファに書いたバイト数
+    std::uint64_t get_loaded_bytes() const {
+      return loaded_bytes;
+    }
+  private:
+    std::shared_ptr< gct::allocator_t > allocator;
+    std::vector< std::shared_ptr< gct::buffer_t > > staging_buffers;
+    std::uint64_t loaded_bytes = 0u;
+  };
+
+  // ASTCの基本記述子ブロックを含むData Format Descriptorを作る
+  inline std::vector< std::uint8_t > create_astc_dfd( std::uint32_t block_width, std::uint32_t block_height, bool srgb ) {
+    constexpr std::uint32_t block_size = 24u + 16u;
+    std::vector< std::uint32_t > words{
+      // dfdTotalSize
+      4u + block_size,
+      // vendorId = Khronos, descriptorType = 基本記述子ブロック
+      0u,
+      // versionNumber = 1.3, descriptorBlockSize
+      2u | ( block_size << 16 ),
+      // colorModel = ASTC, colorPrimaries = BT709, transferFunction = sRGBまたは線形, flags = 0
+      162u | ( 1u << 8 ) | ( ( srgb ? 2u : 1u ) << 16 ),
+      // texelBlockDimension
+      ( block_width - 1u ) | ( ( block_height - 1u ) << 8 ),
+      // bytesPlane0 = 16
+      16u,
+      0u,
+      // サンプル: bitOffset = 0, bitLength = 128, channelType = ASTCのデータ
+      ( 127u << 16 ),
+      0u,
+      // sampleLower, sampleUpper
+      0u,
+      0xFFFFFFFFu
+    };
+    std::vector< std::uint8_t > dfd( words.size() * sizeof( std::uint32_t ) );
+    std::memcpy( dfd.data(), words.data(), dfd.size() );
+    return dfd;
+  }
+
+  // レベル0から順に並んだlevelsからKTX2ファイルを作ってpathに書く
+  // headerのidentifier, level_count, 各オフセットと長さはこの関数が埋める
+  // 超圧縮はしない
+  inline void write_ktx2(
+    const std::filesystem::path &path,
+    ktx2_header_t header,
+    const std::vector< std::uint8_t > &dfd,
+    std::uint32_t texel_block_bytes,
+    const std::vector< std::vector< std::uint8_t > > &levels
+  ) {
+    if( levels.empty() )
+      throw std::runtime_error( "write_ktx2 : no levels" );
+    if( texel_block_bytes == 0u )
+      throw std::runtime_error( "write_ktx2 : texel block size must not be 0" );
+    header.identifier = ktx2_identifier;
+    header.level_count = levels.size();
+    header.supercompression_scheme = std::uint32_t( ktx2_supercompression_t::none );
+    header.dfd_byte_offset = sizeof( ktx2_header_t ) + levels.size() * sizeof( ktx2_level_t );
+    header.dfd_byte_length = dfd.size();
+    header.kvd_byte_offset = 0u;
+    header.kvd_byte_length = 0u;
+    header.sgd_byte_offset = 0u;
+    header.sgd_byte_length = 0u;
+    // レベルの先頭はテクセルブロックの大きさと4の最小公倍数に揃える
+    std::uint64_t alignment = texel_block_bytes;
+    while( alignment % 4u ) alignment += texel_block_bytes;
+    const auto align = [&]( std::uint64_t v ) {
+      return ( v + alignment - 1u ) / alignment * alignment;
+    };
+    std::vector< ktx2_level_t > index( levels.size() );
+    std::uint64_t tail = header.dfd_byte_offset + header.dfd_byte_length;
+    // 小さいレベルから順に置く
+    for( std::size_t i = levels.size(); i != 0u; --i ) {
+      auto &l = index[ i - 1u ];
+      tail = align( tail );
+      l.byte_offset = tail;
+      l.byte_length = levels[ i - 1u ].size();
+      l.uncompressed_byte_length = l.byte_length;
+      tail += l.byte_length;
+    }
+    std::ofstream file( path, std::ios::out|std::ios::binary|std::ios::trunc );
+    if( !file )
+      throw std::runtime_error( "write_ktx2 : unable to open " + path.string() );
+    file.write( reinterpret_cast< const char* >( &header ), sizeof( header ) );
+    file.write( reinterpret_cast< const char* >( index.data() ), index.size() * sizeof( ktx2_level_t ) );
+    file.write( reinterpret_cast< const char* >( dfd.data() ), dfd.size() );
+    std::uint64_t written = header.dfd_byte_offset + header.dfd_byte_length;
+    const std::vector< char > padding( alignment, 0 );
+    for( std::size_t i = levels.size(); i != 0u; --i ) {
+      file.write( padding.data(), index[ i - 1u ].byte_offset - written );
+      file.write( reinterpret_cast< const char* >( levels[ i - 1u ].data() ), levels[ i - 1u ].size() );
+      written = index[ i - 1u ].byte_offset + levels[ i - 1u ].size();
+    }
+    if( !file )
+      throw std::runtime_error( "write_ktx2 : unable to write " + path.string() );
+  }
+}
+
+#endif
+
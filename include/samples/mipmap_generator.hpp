@@ -0,0 +1,319 @@
+#ifndef SAMPLES_MIPMAP_GENERATOR_HPP
+#define SAMPLES_MIPMAP_GENERATOR_HPP
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include <gct/device.hpp>
+#include <gct/allocator.hpp>
+#include <gct/buffer.hpp>
+#include <gct/image.hpp>
+#include <gct/image_create_info.hpp>
+#include <gct/image_view_create_info.hpp>
+#include <gct/descriptor_pool.hpp>
+#include <gct/descriptor_set_layout.hpp>
+#include <gct/pipeline_cache.hpp>
+#include <gct/pipeline_layout_create_info.hpp>
+#include <gct/shader_module.hpp>
+#include <gct/compute_pipeline_create_info.hpp>
+#include <gct/compute_pipeline.hpp>
+#include <gct/write_descriptor_set.hpp>
+#include <gct/command_buffer_recorder.hpp>
+#include <samples/pipeline_telemetry.hpp>
+
+namespace samples {
+  // ミップマップを作る時の平均の取り方
+  enum class mipmap_filter_t : std::uint32_t {
+    // 値をそのまま平均する
+    linear = 0u,
+    // sRGBの値を線形に戻してから平均する
+    srgb = 1u,
+    // 法線マップとして平均し、正規化し直す
+    normal = 2u
+  };
+
+  // 1回のディスパッチでミップマップを全て作る
+  //
+  // 縮小はmipmap.compで行う
+  // レベル毎にblitとバリアを繰り返す代わりに、ワークグループが64x64ピクセルからレベル6までを共有メモリの上で作り、
+  // 最後に終わったワークグループが残りのレベルを作る
+  // 扱えるのは2Dの1レイヤーで、レベル0の大きさが4096x4096以下のイメージ
+  // イメージはストレージイメージとして書くので、フォーマットはeR8G8B8A8Unormで作りeMutableFormatを付けておく
+  // create_image()はそのようなイメージを作る
+  class mipmap_generator_t {
+  public:
+    static constexpr std::uint32_t max_mip_levels = 13u;
+    mipmap_generator_t(
+      const std::shared_ptr< gct::device_t > &device_,
+      const std::shared_ptr< gct::allocator_t > &allocator_,
+      const std::shared_ptr< gct::pipeline_cache_t > &pipeline_cache_,
+      const std::string &shader_path
+    ) :
+      device( device_ ),
+      allocator( allocator_ ),
+      pipeline_cache( pipeline_cache_ ) {
+      shader = device->get_shader_module( shader_path );
+      descriptor_set_layout = device->get_descriptor_set_layout(
+        gct::descriptor_set_layout_create_info_t()
+          .add_binding( shader->get_props().get_reflection() )
+          .rebuild_chain()
+      );
+      pipeline_layout = device->get_pipeline_layout(
+        gct::pipeline_layout_create_info_t()
+          .add_descriptor_set_layout( descriptor_set_layout )
+          .add_push_constant_range(
+            vk::PushConstantRange()
+              .setStageFlags( vk::ShaderStageFlagBits::eCompute )
+              .setOffset( 0 )
+              .setSize( sizeof( push_constants_t ) )
+          )
+      );
+      descriptor_pool = device->get_descriptor_pool(
+        gct::descriptor_pool_create_info_t()
+          .set_basic(
+            vk::DescriptorPoolCreateInfo()
+              .setFlags( vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet )
+              .setMaxSets( max_sets )
+          )
+          .set_descriptor_pool_size( vk::DescriptorType::eStorageImage, max_mip_levels * max_sets )
+          .set_descriptor_pool_size( vk::DescriptorType::eStorageBuffer, max_sets )
+          .rebuild_chain()
+      );
+    }
+    // extentの画像に必要なレベルの数
+    static std::uint32_t get_mip_levels( const vk::Extent3D &extent ) {
+      std::uint32_t levels = 1u;
+      for( std::uint32_t size = std::max( extent.width, extent.height ); size > 1u; size /= 2u ) ++levels;
+      return levels;
+    }
+    // 全てのレベルを持ち、このクラスで書けるイメージを作る
+    // サンプルする時はeR8G8B8A8SrgbとeR8G8B8A8Unormのどちらのビューでも作れる
+    // イメージはeStorageを持つので、sRGBのビューにはvk::ImageViewUsageCreateInfoでeSampledだけを指定する
+    std::shared_ptr< gct::image_t > create_image(
+      const vk::Extent3D &extent,
+      vk::ImageUsageFlags usage
+    ) {
+      return allocator->create_image(
+        gct::image_create_info_t()
+          .set_basic(
+            vk::ImageCreateInfo()
+              .setFlags( vk::ImageCreateFlagBits::eMutableFormat )
+              .setImageType( vk::ImageType::e2D )
+              .setFormat( vk::Format::eR8G8B8A8Unorm )
+              .setExtent( { extent.width, extent.height, 1 } )
+              .setMipLevels( get_mip_levels( extent ) )
+              .setArrayLayers( 1 )
+              .setSamples( vk::SampleCountFlagBits::e1 )
+              .setTiling( vk::ImageTiling::eOptimal )
+              .setUsage(
+                usage |
+                vk::ImageUsageFlagBits::eTransferDst |
+                vk::ImageUsageFlagBits::eStorage
+              )
+              .setInitialLayout( vk::ImageLayout::eUndefined )
+          ),
+          VMA_MEMORY_USAGE_GPU_ONLY
+      );
+    }
+    // 画像ファイルを読み、レベル0に転送してからミップマップを作るコマンドを記録する
+    // 最後にイメージのレイアウトはシェーダから読むのに適した物になる
+    std::shared_ptr< gct::image_t > load_image(
+      gct::command_buffer_recorder_t &rec,
+      const std::string &filename,
+      vk::ImageUsageFlags usage,
+      mipmap_filter_t filter
+    ) {
+      const auto staging = allocator->load_image( filename, filter == mipmap_filter_t::srgb );
+      const auto extent = staging->get_extent();
+      auto image = create_image( extent, usage );
+      rec.convert_image( image, vk::ImageLayout::eGeneral );
+      rec->copyBufferToImage(
+        **staging,
+        **image,
+        vk::ImageLayout::eGeneral,
+        vk::BufferImageCopy()
+          .setBufferOffset( 0 )
+          .setBufferRowLength( 0 )
+          .setBufferImageHeight( 0 )
+          .setImageSubresource( vk::ImageSubresourceLayers( vk::ImageAspectFlagBits::eColor, 0, 0, 1 ) )
+          .setImageOffset( { 0, 0, 0 } )
+          .setImageExtent( { extent.width, extent.height, 1 } )
+      );
+      rec->pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlagBits( 0 ),
+        { vk::MemoryBarrier().setSrcAccessMask( vk::AccessFlagBits::eTransferWrite ).setDstAccessMask( vk::AccessFlagBits::eShaderRead ) },
+        {},
+        {}
+      );
+      in_use.push_back( staging );
+      generate( rec, image, filter );
+      return image;
+    }
+    // レベル0の内容からそれ以外のレベルを作るコマンドを記録する
+    // imageはeGeneralレイアウトで、レベル0への書き込みはコンピュートシェーダから見える状態にしておく
+    void generate(
+      gct::command_buffer_recorder_t &rec,
+      const std::shared_ptr< gct::image_t > &image,
+      mipmap_filter_t filter
+    ) {
+      const auto &basic = image->get_props().get_basic();
+      if( basic.mipLevels > max_mip_levels )
+        throw std::runtime_error( "mipmap_generator_t::generate : too many mip levels" );
+      if( basic.mipLevels <= 1u ) return;
+      // ワークグループの数を数えるカウンタ
+      auto counter = allocator->create_buffer(
+        gct::buffer_create_info_t()
+          .set_basic(
+            vk::BufferCreateInfo()
+              .setSize( sizeof( std::uint32_t ) )
+              .setUsage( vk::BufferUsageFlagBits::eStorageBuffer|vk::BufferUsageFlagBits::eTransferDst )
+          ),
+        VMA_MEMORY_USAGE_GPU_ONLY
+      );
+      auto descriptor_set = descriptor_pool->allocate( descriptor_set_layout );
+      auto mips = gct::write_descriptor_set_t()
+        .set_basic(
+          (*descriptor_set)[ "mips" ]
+        );
+      for( std::uint32_t level = 0u; level != max_mip_levels; ++level ) {
+        mips.add_image(
+          gct::descriptor_image_info_t()
+            .set_basic(
+              vk::DescriptorImageInfo()
+                .setImageLayout( vk::ImageLayout::eGeneral )
+            )
+            .set_image_view( get_level_view( image, std::min( level, basic.mipLevels - 1u ) ) )
+        );
+      }
+      descriptor_set->update(
+        {
+          mips,
+          gct::write_descriptor_set_t()
+            .set_basic(
+              (*descriptor_set)[ "counter_buffer" ]
+            )
+            .add_buffer(
+              gct::descriptor_buffer_info_t()
+                .set_buffer( counter )
+                .set_basic(
+                  vk::DescriptorBufferInfo()
+                    .setOffset( 0 )
+                    .setRange( sizeof( std::uint32_t ) )
+                )
+            )
+        }
+      );
+      rec->fillBuffer( **counter, 0, sizeof( std::uint32_t ), 0u );
+      rec->pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlagBits( 0 ),
+        { vk::MemoryBarrier().setSrcAccessMask( vk::AccessFlagBits::eTransferWrite ).setDstAccessMask( vk::AccessFlagBits::eShaderRead|vk::AccessFlagBits::eShaderWrite ) },
+        {},
+        {}
+      );
+      rec.bind_descriptor_set(
+        vk::PipelineBindPoint::eCompute,
+        pipeline_layout,
+        descriptor_set
+      );
+      rec.bind_pipeline( get_pipeline( filter ) );
+      const push_constants_t push_constants{ std::int32_t( basic.mipLevels ) };
+      rec->pushConstants(
+        **pipeline_layout,
+        vk::ShaderStageFlagBits::eCompute,
+        0u,
+        sizeof( push_constants_t ),
+        &push_constants
+      );
+      rec->dispatch( ( basic.extent.width + 63u ) / 64u, ( basic.extent.height + 63u ) / 64u, 1u );
+      rec->pipelineBarrier(
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eVertexShader|vk::PipelineStageFlagBits::eFragmentShader|vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlagBits( 0 ),
+        { vk::MemoryBarrier().setSrcAccessMask( vk::AccessFlagBits::eShaderWrite ).setDstAccessMask( vk::AccessFlagBits::eShaderRead ) },
+        {},
+        {}
+      );
+      rec.convert_image( image, vk::ImageLayout::eShaderReadOnlyOptimal );
+      in_use.push_back( counter );
+      in_use_sets.push_back( descriptor_set );
+    }
+    // 記録したコマンドの実行が終わった後に呼び、それまでに使った一時的な資源を捨てる
+    void release() {
+      in_use.clear();
+      in_use_sets.clear();
+      level_views.clear();
+    }
+  private:
+    struct push_constants_t {
+      std::int32_t mip_levels;
+    };
+    struct spec_t {
+      std::uint32_t filter_mode = 0u;
+    };
+    static constexpr std::uint32_t max_sets = 16u;
+    std::shared_ptr< gct::image_view_t > get_level_view( const std::shared_ptr< gct::image_t > &image, std::uint32_t level ) {
+      auto view = image->get_view(
+        gct::image_view_create_info_t()
+          .set_basic(
+            vk::ImageViewCreateInfo()
+              .setSubresourceRange(
+                vk::ImageSubresourceRange()
+                  .setAspectMask( vk::ImageAspectFlagBits::eColor )
+                  .setBaseMipLevel( level )
+                  .setLevelCount( 1 )
+                  .setBaseArrayLayer( 0 )
+                  .setLayerCount( 1 )
+              )
+              .setViewType( vk::ImageViewType::e2D )
+              .setFormat( vk::Format::eR8G8B8A8Unorm )
+          )
+          .rebuild_chain()
+      );
+      level_views.push_back( view );
+      return view;
+    }
+    std::shared_ptr< gct::compute_pipeline_t > get_pipeline( mipmap_filter_t filter ) {
+      auto &pipeline = pipelines[ std::uint32_t( filter ) ];
+      if( pipeline ) return pipeline;
+      pipeline = instrumented_pipeline_cache_t( pipeline_cache ).get_pipeline(
+        gct::compute_pipeline_create_info_t()
+          .set_stage(
+            gct::pipeline_shader_stage_create_info_t()
+              .set_shader_module( shader )
+              .set_specialization_info(
+                gct::specialization_info_t< spec_t >()
+                  .set_data(
+                    spec_t{ std::uint32_t( filter ) }
+                  )
+                  .add_map< std::uint32_t >( 3, offsetof( spec_t, filter_mode ) )
+              )
+          )
+          .set_layout( pipeline_layout ),
+        "mipmap" + std::to_string( std::uint32_t( filter ) )
+      );
+      return pipeline;
+    }
+    std::shared_ptr< gct::device_t > device;
+    std::shared_ptr< gct::allocator_t > allocator;
+    std::shared_ptr< gct::pipeline_cache_t > pipeline_cache;
+    std::shared_ptr< gct::shader_module_t > shader;
+    std::shared_ptr< gct::descriptor_set_layout_t > descriptor_set_layout;
+    std::shared_ptr< gct::pipeline_layout_t > pipeline_layout;
+    std::shared_ptr< gct::descriptor_pool_t > descriptor_pool;
+    std::array< std::shared_ptr< gct::compute_pipeline_t >, 3u > pipelines;
+    std::vector< std::shared_ptr< gct::buffer_t > > in_use;
+    std::vector< std::shared_ptr< gct::descriptor_set_t > > in_use_sets;
+    std::vector< std::shared_ptr< gct::image_view_t > > level_views;
+  };
+}
+
+#endif
+
@@ -0,0 +1,193 @@
+#ifndef SAMPLES_PARALLEL_RECORDER_HPP
+#define SAMPLES_PARALLEL_RECORDER_HPP
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include <gct/device.hpp>
+
+namespace samples {
+  // レンダーパスの中の描画コマンドを複数のスレッドでセカンダリコマンドバッファに記録する
+  //
+  // 描画する物を0からitem_count-1までの番号で表し、連続した範囲に分けてスレッドに割り当てる
+  // i番目のスレッドが記録したセカンダリコマンドバッファはrecord()が返す配列のi番目に入るので、
+  // プライマリコマンドバッファでその順にvkCmdExecuteCommandsすれば1スレッドで記録した場合と同じ順序で描かれる
+  //
+  // コマンドプールは外部同期が必要なので、スレッド毎かつスロット毎に1つ持つ
+  // スロットは同時にGPUに積んでおくフレームを区別する為の物で、
+  // 同じスロットのコマンドバッファを使ったフレームの実行が完了してから次のrecord()を呼ぶ
+  //
+  // 記録する関数が受け取るのは生のvk::CommandBufferなので、gct::command_buffer_recorder_tを要求する
+  // gct::gltf::draw_nodeはこれでは記録できない 37_gltfの描画は今も1スレッドで記録している
+  class parallel_recorder_t {
+  public:
+    // begin番目からend-1番目までの描画コマンドをcommand_bufferに記録する関数
+    using record_function_t = std::function< void( vk::CommandBuffer command_buffer, std::size_t begin, std::size_t end ) >;
+    parallel_recorder_t(
+      const std::shared_ptr< gct::device_t > &device_,
+      std::uint32_t queue_family_index,
+      std::uint32_t thread_count,
+      std::uint32_t slot_count = 1u
+    ) : device( device_ ) {
+      if( thread_count == 0u )
+        throw std::runtime_error( "parallel_recorder_t : thread_count must not be 0" );
+      if( slot_count == 0u )
+        throw std::runtime_error( "parallel_recorder_t : slot_count must not be 0" );
+      for( std::uint32_t slot = 0u; slot != slot_count; ++slot ) {
+        slots.emplace_back();
+        for( std::uint32_t i = 0u; i != thread_count; ++i ) {
+          per_thread_t per_thread;
+          // 毎回プールごとリセットするので個別のリセットは要らない
+          per_thread.pool = (*device)->createCommandPoolUnique(
+            vk::CommandPoolCreateInfo()
+              .setFlags( vk::CommandPoolCreateFlagBits::eTransient )
+              .setQueueFamilyIndex( queue_family_index )
+          );
+          per_thread.command_buffer = std::move( (*device)->allocateCommandBuffersUnique(
+            vk::CommandBufferAllocateInfo()
+              .setCommandPool( *per_thread.pool )
+              .setLevel( vk::CommandBufferLevel::eSecondary )
+              .setCommandBufferCount( 1u )
+          )[ 0 ] );
+          slots.back().push_back( std::move( per_thread ) );
+        }
+      }
+      errors.resize( thread_count );
+      for( std::uint32_t i = 0u; i != thread_count; ++i )
+        workers.emplace_back( [this,i]() { run( i ); } );
+    }
+    ~parallel_recorder_t() {
+      {
+        std::unique_lock< std::mutex > lock( guard );
+        exit = true;
+      }
+      job_ready.notify_all();
+      for( auto &w: workers ) w.join();
+      // コマンドバッファはプールより先に解放する
+      for( auto &s: slots )
+        for( auto &t: s )
+          t.command_buffer.reset();
+    }
+    parallel_recorder_t( const parallel_recorder_t& ) = delete;
+    parallel_recorder_t &operator=( const parallel_recorder_t& ) = delete;
+    // item_count個の描画コマンドをスレッドの数に分けて記録する
+    // inheritanceにはセカンダリコマンドバッファを実行するレンダーパスとサブパスを設定しておく
+    // 返したセカンダリコマンドバッファはレンダーパスをeSecondaryCommandBuffersで開始して順に実行する
+    std::vector< vk::CommandBuffer > record(
+      std::uint32_t slot,
+      const vk::CommandBufferInheritanceInfo &inheritance,
+      std::size_t item_count,
+      const record_function_t &f
+    ) {
+      if( slot >= slots.size() )
+        throw std::runtime_error( "parallel_recorder_t : slot out of range" );
+      {
+        std::unique_lock< std::mutex > lock( guard );
+        current_slot = slot;
+        current_inheritance = inheritance;
+        current_item_count = item_count;
+        current_function = &f;
+        remaining = slots[ slot ].size();
+        ++generation;
+      }
+      job_ready.notify_all();
+      {
+        std::unique_lock< std::mutex > lock( guard );
+        job_done.wait( lock, [&]() { return remaining == 0u; } );
+        current_function = nullptr;
+      }
+      for( auto &e: errors ) {
+        if( e ) {
+          auto error = e;
+          for( auto &e_: errors ) e_ = nullptr;
+          std::rethrow_exception( error );
+        }
+      }
+      std::vector< vk::CommandBuffer > command_buffers;
+      for( const auto &t: slots[ slot ] )
+        command_buffers.push_back( *t.command_buffer );
+      return command_buffers;
+    }
+    std::uint32_t get_thread_count() const {
+      return slots[ 0 ].size();
+    }
+    std::uint32_t get_slot_count() const {
+      return slots.size();
+    }
+  private:
+    struct per_thread_t {
+      vk::UniqueCommandPool pool;
+      vk::UniqueCommandBuffer command_buffer;
+    };
+    void run( std::uint32_t index ) {
+      std::uint64_t seen = 0u;
+      while( true ) {
+        std::uint32_t slot = 0u;
+        vk::CommandBufferInheritanceInfo inheritance;
+        std::size_t item_count = 0u;
+        const record_function_t *f = nullptr;
+        {
+          std::unique_lock< std::mutex > lock( guard );
+          job_ready.wait( lock, [&]() { return exit || generation != seen; } );
+          if( exit ) return;
+          seen = generation;
+          slot = current_slot;
+          inheritance = current_inheritance;
+          item_count = current_item_count;
+          f = current_function;
+        }
+        try {
+          // 連続した範囲に分けるので記録した順序が元の順序と一致する
+          const std::size_t thread_count = slots[ slot ].size();
+          const std::size_t begin = item_count * index / thread_count;
+          const std::size_t end = item_count * ( index + 1u ) / thread_count;
+          auto &t = slots[ slot ][ index ];
+          (*device)->resetCommandPool( *t.pool, vk::CommandPoolResetFlags() );
+          t.command_buffer->begin(
+            vk::CommandBufferBeginInfo()
+              .setFlags(
+                vk::CommandBufferUsageFlagBits::eRenderPassContinue |
+                vk::CommandBufferUsageFlagBits::eOneTimeSubmit
+              )
+              .setPInheritanceInfo( &inheritance )
+          );
+          if( begin != end ) ( *f )( *t.command_buffer, begin, end );
+          t.command_buffer->end();
+        }
+        catch( ... ) {
+          errors[ index ] = std::current_exception();
+        }
+        {
+          std::unique_lock< std::mutex > lock( guard );
+          --remaining;
+          if( remaining == 0u ) job_done.notify_one();
+        }
+      }
+    }
+    std::shared_ptr< gct::device_t > device;
+    // slots[ スロット ][ スレッド ]
+    std::vector< std::vector< per_thread_t > > slots;
+    std::vector< std::thread > workers;
+    std::vector< std::exception_ptr > errors;
+    std::mutex guard;
+    std::condition_variable job_ready;
+    std::condition_variable job_done;
+    std::uint64_t generation = 0u;
+    std::size_t remaining = 0u;
+    bool exit = false;
+    std::uint32_t current_slot = 0u;
+    vk::CommandBufferInheritanceInfo current_inheritance;
+    std::size_t current_item_count = 0u;
+    const record_function_t *current_function = nullptr;
+  };
+}
+
+#endif
+
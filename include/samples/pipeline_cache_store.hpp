@@ -0,0 +1,239 @@
+#ifndef SAMPLES_PIPELINE_CACHE_STORE_HPP
+#define SAMPLES_PIPELINE_CACHE_STORE_HPP
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#include <vulkan/vulkan.hpp>
+#include <gct/device.hpp>
+#include <gct/pipeline_cache.hpp>
+#include <samples/pipeline_telemetry.hpp>
+
+namespace samples {
+  // パイプラインキャッシュをファイルに保存し、次に起動した時に読み戻す
+  //
+  // ファイルの先頭のVkPipelineCacheHeaderVersionOneのベンダID、デバイスID、UUIDを
+  // 今のデバイスの物と比べ、一致しない物や途中で切れている物は使わない
+  // 今のデバイスのヘッダは空のパイプラインキャッシュをシリアライズして得る
+  //
+  // 同じファイルを複数のプロセスが同時に更新する事を想定している
+  // 保存する時はロックファイルで排他した上でファイルの今の内容をvkMergePipelineCachesで取り込み、
+  // 一時ファイルに書いてからrenameで置き換える
+  // 読む側は書きかけのファイルを見る事が無い
+  class pipeline_cache_store_t {
+  public:
+    pipeline_cache_store_t(
+      vk::Device device_,
+      const std::filesystem::path &path_
+    ) : device( device_ ), path( path_ ) {
+      const auto empty = device.createPipelineCacheUnique( vk::PipelineCacheCreateInfo() );
+      const auto data = device.getPipelineCacheData( *empty );
+      if( data.size() < header_size )
+        throw std::runtime_error( "pipeline_cache_store_t : the driver returned a pipeline cache without a header" );
+      std::copy( data.begin(), std::next( data.begin(), header_size ), expected_header.begin() );
+    }
+    // ファイルの内容を読み、今のデバイスで使える物であれば返す
+    // 使えない場合は空の配列を返し、理由をget_status()で返す
+    std::vector< std::uint8_t > load() {
+      std::ifstream file( path, std::ios::in|std::ios::binary );
+      if( !file ) {
+        status = "missing";
+        return std::vector< std::uint8_t >();
+      }
+      std::vector< std::uint8_t > data(
+        ( std::istreambuf_iterator< char >( file ) ),
+        std::istreambuf_iterator< char >()
+      );
+      status = validate( data );
+      if( status != "loaded" ) return std::vector< std::uint8_t >();
+      return data;
+    }
+    // ファイルの内容をdstに取り込む
+    // 取り込めた場合はtrueを返す
+    bool restore( vk::PipelineCache dst ) {
+      const auto data = load();
+      if( data.empty() ) return false;
+      const auto loaded = create_cache( data );
+      device.mergePipelineCaches( dst, *loaded );
+      return true;
+    }
+    // srcの内容をファイルに保存する
+    // 他のプロセスが先に保存した内容も失わないように、ファイルの今の内容と合わせて書く
+    void save( vk::PipelineCache src ) {
+      const lock_t lock( path.string() + ".lock" );
+      std::vector< std::uint8_t > on_disk;
+      {
+        std::ifstream file( path, std::ios::in|std::ios::binary );
+        if( file ) {
+          on_disk.assign(
+            ( std::istreambuf_iterator< char >( file ) ),
+            std::istreambuf_iterator< char >()
+          );
+          if( validate( on_disk ) != "loaded" ) on_disk.clear();
+        }
+      }
+      const auto merged = create_cache( on_disk );
+      device.mergePipelineCaches( *merged, src );
+      const auto serialized = device.getPipelineCacheData( *merged );
+      // 同じディレクトリに一時ファイルを作るのでrenameはアトミックに行われる
+      const auto temporary = path.string() + ".tmp." + std::to_string( getpid() );
+      write_file( temporary, serialized );
+      std::error_code ec;
+      std::filesystem::rename( temporary, path, ec );
+      if( ec ) {
+        std::filesystem::remove( temporary );
+        throw std::system_error( ec, "pipeline_cache_store_t : rename failed" );
+      }
+    }
+    // 直前のload()の結果
+    // loaded、missingまたは使わなかった理由
+    const std::string &get_status() const {
+      return status;
+    }
+    const std::filesystem::path &get_path() const {
+      return path;
+    }
+  private:
+    // VkPipelineCacheHeaderVersionOneの大きさ
+    static constexpr std::size_t header_size = 16u + VK_UUID_SIZE;
+    static std::uint32_t get_u32( const std::uint8_t *data ) {
+      std::uint32_t value = 0u;
+      std::memcpy( &value, data, sizeof( value ) );
+      return value;
+    }
+    std::string validate( const std::vector< std::uint8_t > &data ) const {
+      if( data.size() < header_size ) return "rejected: truncated header";
+      const auto size = get_u32( data.data() );
+      if( size < header_size || size > data.size() ) return "rejected: invalid header size";
+      if( get_u32( data.data() + 4u ) != std::uint32_t( VK_PIPELINE_CACHE_HEADER_VERSION_ONE ) )
+        return "rejected: unknown header version";
+      if( get_u32( data.data() + 8u ) != get_u32( expected_header.data() + 8u ) )
+        return "rejected: vendor id mismatch";
+      if( get_u32( data.data() + 12u ) != get_u32( expected_header.data() + 12u ) )
+        return "rejected: device id mismatch";
+      if( !std::equal( data.begin() + 16u, data.begin() + header_size, expected_header.begin() + 16u ) )
+        return "rejected: pipeline cache uuid mismatch";
+      return "loaded";
+    }
+    vk::UniquePipelineCache create_cache( const std::vector< std::uint8_t > &data ) const {
+      return device.createPipelineCacheUnique(
+        vk::PipelineCacheCreateInfo()
+          .setInitialDataSize( data.size() )
+          .setPInitialData( data.empty() ? nullptr : data.data() )
+      );
+    }
+    static void write_file( const std::string &filename, const std::vector< std::uint8_t > &data ) {
+      const int fd = open( filename.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644 );
+      if( fd < 0 )
+        throw std::system_error( errno, std::generic_category(), "pipeline_cache_store_t : open failed" );
+      std::size_t written = 0u;
+      while( written != data.size() ) {
+        const auto result = write( fd, data.data() + written, data.size() - written );
+        if( result < 0 ) {
+          if( errno == EINTR ) continue;
+          const int e = errno;
+          close( fd );
+          unlink( filename.c_str() );
+          throw std::system_error( e, std::generic_category(), "pipeline_cache_store_t : write failed" );
+        }
+        written += result;
+      }
+      // renameより前に内容がディスクに届いている必要がある
+      if( fsync( fd ) < 0 ) {
+        const int e = errno;
+        close( fd );
+        unlink( filename.c_str() );
+        throw std::system_error( e, std::generic_category(), "pipeline_cache_store_t : fsync failed" );
+      }
+      close( fd );
+    }
+    // ロックファイルに対するflockをスコープの間保持する
+    class lock_t {
+    public:
+      lock_t( const std::string &filename ) {
+        fd = open( filename.c_str(), O_RDWR|O_CREAT, 0644 );
+        if( fd < 0 )
+          throw std::system_error( errno, std::generic_category(), "pipeline_cache_store_t : unable to open the lock file" );
+        while( flock( fd, LOCK_EX ) < 0 ) {
+          if( errno != EINTR ) {
+            const int e = errno;
+            close( fd );
+            throw std::system_error( e, std::generic_category(), "pipeline_cache_store_t : flock failed" );
+          }
+        }
+      }
+      ~lock_t() {
+        flock( fd, LOCK_UN );
+        close( fd );
+      }
+      lock_t( const lock_t& ) = delete;
+      lock_t &operator=( const lock_t& ) = delete;
+    private:
+      int fd = -1;
+    };
+    vk::Device device;
+    std::filesystem::path path;
+    std::array< std::uint8_t, header_size > expected_header;
+    std::string status = "missing";
+  };
+
+  // device->get_pipeline_cache()で作ったパイプラインキャッシュにファイルの内容を取り込み、
+  // 破棄する時にファイルに保存する
+  // get_pipeline_cache()の戻り値と同じように->でパイプラインを作れる
+  // ->で作ったパイプラインはget_pipeline_telemetry()に記録される
+  class persistent_pipeline_cache_t {
+  public:
+    persistent_pipeline_cache_t(
+      const std::shared_ptr< gct::device_t > &device_,
+      const std::filesystem::path &path
+    ) :
+      device( device_ ),
+      cache( device_->get_pipeline_cache() ),
+      instrumented( cache ),
+      store( **device_, path ) {
+      store.restore( **cache );
+      get_pipeline_telemetry().record_cache( path.string(), store.get_status() );
+    }
+    ~persistent_pipeline_cache_t() {
+      // 保存に失敗してもキャッシュが使えないだけなので無視する
+      try {
+        store.save( **cache );
+      }
+      catch( ... ) {}
+    }
+    persistent_pipeline_cache_t( const persistent_pipeline_cache_t& ) = delete;
+    persistent_pipeline_cache_t &operator=( const persistent_pipeline_cache_t& ) = delete;
+    const instrumented_pipeline_cache_t *operator->() const {
+      return &instrumented;
+    }
+    const std::shared_ptr< gct::pipeline_cache_t > &get() const {
+      return cache;
+    }
+    // 別のパイプラインキャッシュで作ったパイプラインを取り込み、破棄する時に一緒に保存する
+    void merge( const std::shared_ptr< gct::pipeline_cache_t > &src ) const {
+      (**device).mergePipelineCaches( **cache, **src );
+    }
+    const pipeline_cache_store_t &get_store() const {
+      return store;
+    }
+  private:
+    std::shared_ptr< gct::device_t > device;
+    std::shared_ptr< gct::pipeline_cache_t > cache;
+    instrumented_pipeline_cache_t instrumented;
+    pipeline_cache_store_t store;
+  };
+}
+
+#endif
+
@@ -0,0 +1,171 @@
+#ifndef SAMPLES_PIPELINE_COMPILER_HPP
+#define SAMPLES_PIPELINE_COMPILER_HPP
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include <gct/pipeline_cache.hpp>
+#include <gct/graphics_pipeline_create_info.hpp>
+#include <gct/graphics_pipeline.hpp>
+#include <samples/statistics.hpp>
+#include <samples/pipeline_telemetry.hpp>
+
+namespace samples {
+  // 必要なグラフィクスパイプラインの作成情報を先に全て集めてから、複数のスレッドで同時に作る
+  //
+  // 全てのスレッドが同じパイプラインキャッシュを使う
+  // VK_PIPELINE_CACHE_CREATE_EXTERNALLY_SYNCHRONIZED_BITを付けずに作ったパイプラインキャッシュは
+  // 複数のスレッドから同時にvkCreateGraphicsPipelinesに渡してよい
+  //
+  // VK_EXT_pipeline_creation_feedbackが有効な場合は、ドライバが報告したパイプライン毎の作成時間と
+  // パイプラインキャッシュに当たったかどうかを集計する
+  class pipeline_compiler_t {
+  public:
+    // 1つのパイプラインの結果
+    struct result_t {
+      std::string name;
+      std::shared_ptr< gct::graphics_pipeline_t > pipeline;
+      // CPUで測ったget_pipelineの時間
+      double host_ns = 0.0;
+      // VkPipelineCreationFeedbackのduration 報告されなかった場合は負
+      double feedback_ns = -1.0;
+      bool cache_hit = false;
+    };
+    explicit pipeline_compiler_t(
+      const std::shared_ptr< gct::pipeline_cache_t > &pipeline_cache_
+    ) : pipeline_cache( pipeline_cache_ ) {}
+    // 作るパイプラインを追加する
+    // 戻り値はcompile()の結果の中での位置
+    std::size_t add( const std::string &name, const gct::graphics_pipeline_create_info_t &create_info ) {
+      requests.push_back( request_t{ name, create_info } );
+      return requests.size() - 1u;
+    }
+    std::size_t size() const {
+      return requests.size();
+    }
+    // 追加された全てのパイプラインをthread_count個のスレッドで作る
+    // 結果はadd()した順に並ぶ
+    const std::vector< result_t > &compile( std::uint32_t thread_count ) {
+      thread_count = std::max( std::min< std::uint32_t >( thread_count, requests.size() ), 1u );
+      results.clear();
+      results.resize( requests.size() );
+      std::atomic< std::size_t > next( 0u );
+      std::vector< std::exception_ptr > errors( thread_count );
+      const auto worker = [&]( std::uint32_t thread_index ) {
+        try {
+          // 早く終わったスレッドが次のパイプラインを取りに行く
+          for( std::size_t i = next++; i < requests.size(); i = next++ ) {
+            auto &result = results[ i ];
+            result.name = requests[ i ].name;
+            const auto begin_time = std::chrono::high_resolution_clock::now();
+            result.pipeline = pipeline_cache->get_pipeline( requests[ i ].create_info );
+            const auto end_time = std::chrono::high_resolution_clock::now();
+            result.host_ns = double( std::chrono::duration_cast< std::chrono::nanoseconds >( end_time - begin_time ).count() );
+            get_pipeline_telemetry().record( result.name, result.pipeline, result.host_ns );
+            if( result.pipeline->get_props().has_creation_feedback() ) {
+              const auto &feedback = *result.pipeline->get_props().get_creation_feedback().pPipelineCreationFeedback;
+              if( feedback.flags & vk::PipelineCreationFeedbackFlagBitsEXT::eValid ) {
+                result.feedback_ns = double( feedback.duration );
+                result.cache_hit = bool( feedback.flags & vk::PipelineCreationFeedbackFlagBitsEXT::eApplicationPipelineCacheHit );
+              }
+            }
+          }
+        }
+        catch( ... ) {
+          errors[ thread_index ] = std::current_exception();
+        }
+      };
+      const auto begin_time = std::chrono::high_resolution_clock::now();
+      {
+        std::vector< std::thread > threads;
+        for( std::uint32_t i = 1u; i < thread_count; ++i )
+          threads.emplace_back( worker, i );
+        // 呼び出したスレッドも作業に加わる
+        worker( 0u );
+        for( auto &t: threads ) t.join();
+      }
+      const auto end_time = std::chrono::high_resolution_clock::now();
+      wall_ns = double( std::chrono::duration_cast< std::chrono::nanoseconds >( end_time - begin_time ).count() );
+      used_threads = thread_count;
+      for( const auto &e: errors )
+        if( e ) std::rethrow_exception( e );
+      return results;
+    }
+    const std::vector< result_t > &get_results() const {
+      return results;
+    }
+    double get_wall_ns() const {
+      return wall_ns;
+    }
+    // 直前のcompile()の結果の要約
+    // histogramは作成時間を1ms未満、1ms以上2ms未満、2ms以上4ms未満...に分けて数えた物
+    nlohmann::json dump() const {
+      nlohmann::json root;
+      root[ "threads" ] = used_threads;
+      root[ "pipelines" ] = results.size();
+      root[ "wall_ns" ] = wall_ns;
+      std::vector< double > host;
+      std::vector< double > feedback;
+      std::size_t hit = 0u;
+      for( const auto &r: results ) {
+        host.push_back( r.host_ns );
+        if( r.feedback_ns >= 0.0 ) feedback.push_back( r.feedback_ns );
+        if( r.cache_hit ) ++hit;
+      }
+      root[ "host_ns" ] = get_statistics( host );
+      if( !feedback.empty() ) {
+        root[ "feedback_ns" ] = get_statistics( feedback );
+        root[ "cache_hits" ] = hit;
+        root[ "histogram" ] = get_histogram( feedback );
+      }
+      else {
+        // ドライバが作成時間を報告しなかった場合はCPUで測った時間で代用する
+        root[ "feedback_ns" ] = nullptr;
+        root[ "cache_hits" ] = nullptr;
+        root[ "histogram" ] = get_histogram( host );
+      }
+      return root;
+    }
+  private:
+    struct request_t {
+      std::string name;
+      gct::graphics_pipeline_create_info_t create_info;
+    };
+    static nlohmann::json get_histogram( const std::vector< double > &values ) {
+      std::vector< std::uint32_t > counts;
+      for( const auto v: values ) {
+        std::size_t bucket = 0u;
+        for( double upper = 1.0e6; v >= upper; upper *= 2.0 ) ++bucket;
+        if( counts.size() <= bucket ) counts.resize( bucket + 1u, 0u );
+        ++counts[ bucket ];
+      }
+      auto histogram = nlohmann::json::array();
+      double lower = 0.0;
+      double upper = 1.0e6;
+      for( const auto c: counts ) {
+        nlohmann::json bucket;
+        bucket[ "min_ns" ] = lower;
+        bucket[ "max_ns" ] = upper;
+        bucket[ "count" ] = c;
+        histogram.push_back( bucket );
+        lower = upper;
+        upper *= 2.0;
+      }
+      return histogram;
+    }
+    std::shared_ptr< gct::pipeline_cache_t > pipeline_cache;
+    std::vector< request_t > requests;
+    std::vector< result_t > results;
+    double wall_ns = 0.0;
+    std::uint32_t used_threads = 0u;
+  };
+}
+
+#endif
+
@@ -0,0 +1,123 @@
+#ifndef SAMPLES_PIPELINE_STATISTICS_HPP
+#define SAMPLES_PIPELINE_STATISTICS_HPP
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include <vulkan/vulkan.hpp>
+
+namespace samples {
+  // VK_KHR_pipeline_executable_propertiesでパイプラインの実行可能な部分毎の統計情報を取り出す
+  // パイプラインはvk::PipelineCreateFlagBits::eCaptureStatisticsKHRを付けて作っておく
+  //
+  // 結果は
+  // [ { "name": 実行可能な部分の名前, "stages": ステージのフラグ, "subgroup_size": ..., "statistics": { 統計の名前: 値 } } ]
+  // 値はboolの物はbool、それ以外は数値
+  inline nlohmann::json get_pipeline_statistics( vk::Device device, vk::Pipeline pipeline ) {
+    auto executables = nlohmann::json::array();
+    const auto props = device.getPipelineExecutablePropertiesKHR(
+      vk::PipelineInfoKHR()
+        .setPipeline( pipeline )
+    );
+    for( std::uint32_t ei = 0u; ei != props.size(); ++ei ) {
+      nlohmann::json executable;
+      executable[ "name" ] = std::string( props[ ei ].name.data() );
+      executable[ "stages" ] = std::uint32_t( props[ ei ].stages );
+      executable[ "subgroup_size" ] = props[ ei ].subgroupSize;
+      executable[ "statistics" ] = nlohmann::json::object();
+      const auto stats = device.getPipelineExecutableStatisticsKHR(
+        vk::PipelineExecutableInfoKHR()
+          .setPipeline( pipeline )
+          .setExecutableIndex( ei )
+      );
+      for( const auto &s: stats ) {
+        const std::string name( s.name.data() );
+        if( s.format == vk::PipelineExecutableStatisticFormatKHR::eBool32 )
+          executable[ "statistics" ][ name ] = bool( s.value.b32 );
+        else if( s.format == vk::PipelineExecutableStatisticFormatKHR::eInt64 )
+          executable[ "statistics" ][ name ] = s.value.i64;
+        else if( s.format == vk::PipelineExecutableStatisticFormatKHR::eUint64 )
+          executable[ "statistics" ][ name ] = s.value.u64;
+        else if( s.format == vk::PipelineExecutableStatisticFormatKHR::eFloat64 )
+          executable[ "statistics" ][ name ] = s.value.f64;
+      }
+      executables.push_back( executable );
+    }
+    return executables;
+  }
+
+  // 統計の値が基準からどれだけ増えたら退行と見做すか
+  // 値が増えると悪くなる物(レジスタ数、スピル、命令数など)を想定している
+  struct statistics_threshold_t {
+    // 全ての統計に使う相対的な許容量 0.1なら10%まで
+    double default_ratio = 0.1;
+    // 統計の名前毎の相対的な許容量
+    std::unordered_map< std::string, double > ratio;
+    double get( const std::string &name ) const {
+      const auto found = ratio.find( name );
+      return found != ratio.end() ? found->second : default_ratio;
+    }
+  };
+
+  // baselineとcurrentは{ "pipelines": { パイプラインの名前: { "executables": get_pipeline_statistics()の結果 } } }
+  // 戻り値は
+  // { "regressions": [...], "improvements": [...], "missing": [...], "added": [...] }
+  // 実行可能な部分は名前で対応を取る
+  inline nlohmann::json compare_pipeline_statistics(
+    const nlohmann::json &baseline,
+    const nlohmann::json &current,
+    const statistics_threshold_t &threshold
+  ) {
+    nlohmann::json report;
+    report[ "regressions" ] = nlohmann::json::array();
+    report[ "improvements" ] = nlohmann::json::array();
+    report[ "missing" ] = nlohmann::json::array();
+    report[ "added" ] = nlohmann::json::array();
+    const auto &base_pipelines = baseline[ "pipelines" ];
+    const auto &current_pipelines = current[ "pipelines" ];
+    for( const auto &[name,base]: base_pipelines.items() ) {
+      if( !current_pipelines.contains( name ) ) {
+        report[ "missing" ].push_back( name );
+        continue;
+      }
+      const auto &cur = current_pipelines[ name ];
+      if( !base.contains( "executables" ) || !cur.contains( "executables" ) ) continue;
+      for( const auto &base_executable: base[ "executables" ] ) {
+        const nlohmann::json *cur_executable = nullptr;
+        for( const auto &e: cur[ "executables" ] )
+          if( e[ "name" ] == base_executable[ "name" ] ) cur_executable = &e;
+        if( !cur_executable ) {
+          report[ "missing" ].push_back( name + "/" + base_executable[ "name" ].get< std::string >() );
+          continue;
+        }
+        for( const auto &[stat_name,base_value]: base_executable[ "statistics" ].items() ) {
+          if( !( *cur_executable )[ "statistics" ].contains( stat_name ) ) continue;
+          const auto &cur_value = ( *cur_executable )[ "statistics" ][ stat_name ];
+          if( !base_value.is_number() || !cur_value.is_number() ) continue;
+          const auto b = base_value.get< double >();
+          const auto c = cur_value.get< double >();
+          if( b == c ) continue;
+          nlohmann::json entry;
+          entry[ "pipeline" ] = name;
+          entry[ "executable" ] = base_executable[ "name" ];
+          entry[ "statistic" ] = stat_name;
+          entry[ "baseline" ] = base_value;
+          entry[ "current" ] = cur_value;
+          if( b != 0.0 ) entry[ "ratio" ] = c / b;
+          if( c > b * ( 1.0 + threshold.get( stat_name ) ) || ( b == 0.0 && c > 0.0 ) )
+            report[ "regressions" ].push_back( entry );
+          else if( c < b )
+            report[ "improvements" ].push_back( entry );
+        }
+      }
+    }
+    for( const auto &[name,cur]: current_pipelines.items() ) {
+      if( !base_pipelines.contains( name ) ) report[ "added" ].push_back( name );
+    }
+    return report;
+  }
+}
+
+#endif
+
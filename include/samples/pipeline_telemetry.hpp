@@ -0,0 +1,196 @@
+#ifndef SAMPLES_PIPELINE_TELEMETRY_HPP
+#define SAMPLES_PIPELINE_TELEMETRY_HPP
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <utility>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include <vulkan/vulkan.hpp>
+#include <gct/pipeline_cache.hpp>
+#include <samples/statistics.hpp>
+
+namespace samples {
+  // プロセスが作った全てのパイプラインの作成時間とパイプラインキャッシュに当たったかどうかを記録する
+  //
+  // 環境変数SAMPLES_PIPELINE_TELEMETRYが設定されている場合は、プロセスの終了時に要約をそのファイルにJSONで書く
+  // -の場合は標準エラー出力に書く
+  // 作成時間はCPUで測った時間と、VK_EXT_pipeline_creation_feedbackが有効な場合はドライバが報告した時間の両方を記録する
+  class pipeline_telemetry_t {
+  public:
+    struct stage_t {
+      double duration_ns = 0.0;
+      bool cache_hit = false;
+    };
+    struct record_t {
+      std::string label;
+      std::uint32_t serial = 0u;
+      double host_ns = 0.0;
+      // ドライバが報告しなかった場合は負
+      double feedback_ns = -1.0;
+      bool cache_hit = false;
+      std::vector< stage_t > stages;
+    };
+    ~pipeline_telemetry_t() {
+      const char *path = std::getenv( "SAMPLES_PIPELINE_TELEMETRY" );
+      if( !path || !*path ) return;
+      try {
+        const auto serialized = dump().dump( 2 );
+        if( std::string( path ) == "-" ) std::cerr << serialized << std::endl;
+        else {
+          std::ofstream file( path, std::ios::out|std::ios::trunc );
+          file << serialized << std::endl;
+        }
+      }
+      catch( ... ) {}
+    }
+    // パイプラインを1つ記録する
+    // pipelineはgct::graphics_pipeline_tまたはgct::compute_pipeline_t
+    template< typename Pipeline >
+    void record( const std::string &label, const std::shared_ptr< Pipeline > &pipeline, double host_ns ) {
+      record_t r;
+      r.label = label;
+      r.host_ns = host_ns;
+      if constexpr ( requires { pipeline->get_props().has_creation_feedback(); } ) {
+        if( pipeline->get_props().has_creation_feedback() ) {
+          const auto &feedback = pipeline->get_props().get_creation_feedback();
+          if( feedback.pPipelineCreationFeedback && ( feedback.pPipelineCreationFeedback->flags & vk::PipelineCreationFeedbackFlagBitsEXT::eValid ) ) {
+            r.feedback_ns = double( feedback.pPipelineCreationFeedback->duration );
+            r.cache_hit = bool( feedback.pPipelineCreationFeedback->flags & vk::PipelineCreationFeedbackFlagBitsEXT::eApplicationPipelineCacheHit );
+          }
+          for( std::uint32_t i = 0u; i != feedback.pipelineStageCreationFeedbackCount; ++i ) {
+            const auto &s = feedback.pPipelineStageCreationFeedbacks[ i ];
+            if( !( s.flags & vk::PipelineCreationFeedbackFlagBitsEXT::eValid ) ) continue;
+            r.stages.push_back( stage_t{
+              double( s.duration ),
+              bool( s.flags & vk::PipelineCreationFeedbackFlagBitsEXT::eApplicationPipelineCacheHit )
+            } );
+          }
+        }
+      }
+      std::lock_guard< std::mutex > lock( guard );
+      r.serial = records.size();
+      if( r.label.empty() ) r.label = "pipeline" + std::to_string( r.serial );
+      records.push_back( std::move( r ) );
+    }
+    // ファイルから読み戻したパイプラインキャッシュを記録する
+    void record_cache( const std::string &path, const std::string &status ) {
+      std::lock_guard< std::mutex > lock( guard );
+      caches.push_back( std::make_pair( path, status ) );
+    }
+    std::vector< record_t > get_records() const {
+      std::lock_guard< std::mutex > lock( guard );
+      return records;
+    }
+    // slowestは作成時間が長い順にslowest_count個
+    nlohmann::json dump( std::size_t slowest_count = 10u ) const {
+      std::lock_guard< std::mutex > lock( guard );
+      nlohmann::json root;
+      root[ "pipelines" ] = records.size();
+      std::vector< double > host;
+      std::vector< double > feedback;
+      std::size_t hit = 0u;
+      for( const auto &r: records ) {
+        host.push_back( r.host_ns );
+        if( r.feedback_ns >= 0.0 ) {
+          feedback.push_back( r.feedback_ns );
+          if( r.cache_hit ) ++hit;
+        }
+      }
+      root[ "host_ns" ] = get_statistics( host );
+      root[ "host_ns" ][ "total" ] = std::accumulate( host.begin(), host.end(), 0.0 );
+      if( !feedback.empty() ) {
+        root[ "feedback_ns" ] = get_statistics( feedback );
+        root[ "feedback_ns" ][ "total" ] = std::accumulate( feedback.begin(), feedback.end(), 0.0 );
+        root[ "cache_hits" ] = hit;
+        // 作成時間が報告されたパイプラインの中で当たった物の割合
+        root[ "hit_ratio" ] = double( hit ) / feedback.size();
+      }
+      else {
+        root[ "feedback_ns" ] = nullptr;
+        root[ "cache_hits" ] = nullptr;
+        root[ "hit_ratio" ] = nullptr;
+      }
+      std::vector< const record_t* > sorted;
+      for( const auto &r: records ) sorted.push_back( &r );
+      std::sort(
+        sorted.begin(), sorted.end(),
+        []( const record_t *l, const record_t *r ) {
+          return std::max( l->host_ns, l->feedback_ns ) > std::max( r->host_ns, r->feedback_ns );
+        }
+      );
+      root[ "slowest" ] = nlohmann::json::array();
+      for( std::size_t i = 0u; i != std::min( sorted.size(), slowest_count ); ++i ) {
+        const auto &r = *sorted[ i ];
+        nlohmann::json entry;
+        entry[ "label" ] = r.label;
+        entry[ "serial" ] = r.serial;
+        entry[ "host_ns" ] = r.host_ns;
+        if( r.feedback_ns >= 0.0 ) {
+          entry[ "feedback_ns" ] = r.feedback_ns;
+          entry[ "cache_hit" ] = r.cache_hit;
+        }
+        entry[ "stages" ] = nlohmann::json::array();
+        for( const auto &s: r.stages ) {
+          nlohmann::json stage;
+          stage[ "duration_ns" ] = s.duration_ns;
+          stage[ "cache_hit" ] = s.cache_hit;
+          entry[ "stages" ].push_back( stage );
+        }
+        root[ "slowest" ].push_back( entry );
+      }
+      root[ "caches" ] = nlohmann::json::array();
+      for( const auto &[path,status]: caches ) {
+        nlohmann::json cache;
+        cache[ "path" ] = path;
+        cache[ "status" ] = status;
+        root[ "caches" ].push_back( cache );
+      }
+      return root;
+    }
+  private:
+    mutable std::mutex guard;
+    std::vector< record_t > records;
+    std::vector< std::pair< std::string, std::string > > caches;
+  };
+  // プロセスに1つのpipeline_telemetry_t
+  inline pipeline_telemetry_t &get_pipeline_telemetry() {
+    static pipeline_telemetry_t telemetry;
+    return telemetry;
+  }
+
+  // gct::pipeline_cache_tのget_pipelineを呼び、作ったパイプラインをget_pipeline_telemetry()に記録する
+  class instrumented_pipeline_cache_t {
+  public:
+    explicit instrumented_pipeline_cache_t(
+      const std::shared_ptr< gct::pipeline_cache_t > &cache_
+    ) : cache( cache_ ) {}
+    template< typename CreateInfo >
+    auto get_pipeline( const CreateInfo &create_info, const std::string &label = "" ) const {
+      const auto begin_time = std::chrono::high_resolution_clock::now();
+      auto pipeline = cache->get_pipeline( create_info );
+      const auto end_time = std::chrono::high_resolution_clock::now();
+      get_pipeline_telemetry().record(
+        label,
+        pipeline,
+        double( std::chrono::duration_cast< std::chrono::nanoseconds >( end_time - begin_time ).count() )
+      );
+      return pipeline;
+    }
+    const std::shared_ptr< gct::pipeline_cache_t > &get() const {
+      return cache;
+    }
+  private:
+    std::shared_ptr< gct::pipeline_cache_t > cache;
+  };
+}
+
+#endif
+
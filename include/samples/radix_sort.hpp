@@ -0,0 +1,266 @@
+#ifndef SAMPLES_RADIX_SORT_HPP
+#define SAMPLES_RADIX_SORT_HPP
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <gct/device.hpp>
+#include <gct/allocator.hpp>
+#include <gct/buffer.hpp>
+#include <gct/descriptor_pool.hpp>
+#include <gct/descriptor_set_layout.hpp>
+#include <gct/descriptor_set.hpp>
+#include <gct/pipeline_cache.hpp>
+#include <gct/pipeline_layout.hpp>
+#include <gct/pipeline_layout_create_info.hpp>
+#include <gct/shader_module.hpp>
+#include <gct/compute_pipeline_create_info.hpp>
+#include <gct/compute_pipeline.hpp>
+#include <gct/write_descriptor_set.hpp>
+#include <gct/command_buffer_recorder.hpp>
+#include <samples/pipeline_telemetry.hpp>
+#include <samples/scan.hpp>
+
+namespace samples {
+  // 32bitの符号なし整数のキーを昇順に安定に並べ替える(LSD基数ソート)
+  //
+  // 下の桁から4ビットずつ以下を8回繰り返す
+  // 1. ブロック毎に桁の値のヒストグラムを作る
+  // 2. 桁の値毎にブロックを並べたヒストグラムの排他的プレフィックス和を求める
+  // 3. ブロック内で桁の値の順に並べ直し、ヒストグラムから求まる位置に書く
+  //
+  // valuesを渡した場合はキーと同じ順番に値も並べ替える
+  // histogram.comp.spvとscatter.comp.spvがshader_dirに、
+  // scan.comp.spvとscan_add.comp.spvがscan_shader_dirにある必要がある
+  class radix_sort_t {
+    struct spec_t {
+      std::uint32_t local_x_size = 0u;
+      std::uint32_t key_value = 0u;
+    };
+    struct push_constant_t {
+      std::uint32_t count = 0u;
+      std::uint32_t shift = 0u;
+      std::uint32_t block_count = 0u;
+    };
+    static constexpr std::uint32_t radix_bits = 4u;
+    static constexpr std::uint32_t radix = 1u << radix_bits;
+  public:
+    radix_sort_t(
+      const std::shared_ptr< gct::device_t > &device,
+      const std::shared_ptr< gct::allocator_t > &allocator,
+      const std::shared_ptr< gct::pipeline_cache_t > &pipeline_cache,
+      const vk::PhysicalDeviceLimits &limits,
+      const std::string &shader_dir,
+      const std::string &scan_shader_dir,
+      const std::shared_ptr< gct::buffer_t > &keys_,
+      const std::shared_ptr< gct::buffer_t > &values_,
+      std::uint32_t count_,
+      std::uint32_t local_size = 256u
+    ) : keys( keys_ ), values( values_ ), count( count_ ) {
+      if( local_size < radix || ( local_size & ( local_size - 1u ) ) )
+        throw std::runtime_error( "radix_sort_t : local_size must be a power of 2 and not less than 16" );
+      block_count = ( count + local_size - 1u ) / local_size;
+      // 1次元で並べきれない数のブロックは2次元に並べる
+      group_count_x = std::min( block_count, limits.maxComputeWorkGroupCount[ 0 ] );
+      group_count_y = ( block_count + group_count_x - 1u ) / group_count_x;
+
+      const auto histogram_shader = device->get_shader_module( shader_dir + "/histogram.comp.spv" );
+      const auto scatter_shader = device->get_shader_module( shader_dir + "/scatter.comp.spv" );
+      // scatter.compが全てのバインディングを使うのでこちらからレイアウトを作る
+      const auto descriptor_set_layout = device->get_descriptor_set_layout(
+        gct::descriptor_set_layout_create_info_t()
+          .add_binding( scatter_shader->get_props().get_reflection() )
+          .rebuild_chain()
+      );
+      pipeline_layout = device->get_pipeline_layout(
+        gct::pipeline_layout_create_info_t()
+          .add_descriptor_set_layout( descriptor_set_layout )
+          .add_push_constant_range(
+            vk::PushConstantRange()
+              .setStageFlags( vk::ShaderStageFlagBits::eCompute )
+              .setOffset( 0 )
+              .setSize( sizeof( push_constant_t ) )
+          )
+      );
+      const instrumented_pipeline_cache_t instrumented( pipeline_cache );
+      const auto create_pipeline = [&]( const std::shared_ptr< gct::shader_module_t > &shader, const std::string &label ) {
+        return instrumented.get_pipeline(
+          gct::compute_pipeline_create_info_t()
+            .set_stage(
+              gct::pipeline_shader_stage_create_info_t()
+                .set_shader_module( shader )
+                .set_specialization_info(
+                  gct::specialization_info_t< spec_t >()
+                    .set_data(
+                      spec_t{ local_size, values ? 1u : 0u }
+                    )
+                    .add_map< std::uint32_t >( 1, offsetof( spec_t, local_x_size ) )
+                    .add_map< std::uint32_t >( 3, offsetof( spec_t, key_value ) )
+                )
+            )
+            .set_layout( pipeline_layout ),
+          label
+        );
+      };
+      histogram_pipeline = create_pipeline( histogram_shader, "radix_sort_histogram" );
+      scatter_pipeline = create_pipeline( scatter_shader, "radix_sort_scatter" );
+
+      // 1回並べ替える毎に書き込み先を入れ替える為のバッファ
+      const auto create_buffer = [&]( std::uint64_t size ) {
+        return allocator->create_buffer(
+          gct::buffer_create_info_t()
+            .set_basic(
+              vk::BufferCreateInfo()
+                .setSize( size )
+                .setUsage( vk::BufferUsageFlagBits::eStorageBuffer )
+            ),
+          VMA_MEMORY_USAGE_GPU_ONLY
+        );
+      };
+      const std::uint64_t buffer_size = std::uint64_t( count ) * sizeof( std::uint32_t );
+      temporary_keys = create_buffer( buffer_size );
+      if( values ) temporary_values = create_buffer( buffer_size );
+      histogram = create_buffer( std::uint64_t( block_count ) * radix * sizeof( std::uint32_t ) );
+      scan.reset( new scan_t(
+        device,
+        allocator,
+        pipeline_cache,
+        limits,
+        scan_shader_dir,
+        histogram,
+        block_count * radix,
+        scan_value_type_t::uint32,
+        local_size
+      ) );
+
+      descriptor_pool = device->get_descriptor_pool(
+        gct::descriptor_pool_create_info_t()
+          .set_basic(
+            vk::DescriptorPoolCreateInfo()
+              .setFlags( vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet )
+              .setMaxSets( 2 )
+          )
+          .set_descriptor_pool_size( vk::DescriptorType::eStorageBuffer, 10 )
+          .rebuild_chain()
+      );
+      // 偶数回目はkeysからtemporary_keysへ、奇数回目はtemporary_keysからkeysへ並べ替える
+      // 回数が偶数なので結果は元のバッファに戻る
+      // キーだけを並べ替える場合は値のバインディングにもキーのバッファを繋いでおく
+      // (シェーダはこれらにアクセスしない)
+      const auto &src_values = values ? values : keys;
+      const auto &dst_values = values ? temporary_values : temporary_keys;
+      descriptor_sets[ 0 ] = create_descriptor_set( descriptor_set_layout, keys, temporary_keys, src_values, dst_values );
+      descriptor_sets[ 1 ] = create_descriptor_set( descriptor_set_layout, temporary_keys, keys, dst_values, src_values );
+    }
+    // 並べ替えるコマンドを積む
+    // キーと値のバッファへの書き込みは予め完了している必要がある
+    // 結果を読むコマンドとの間には呼び出し側でバリアを張る必要がある
+    void operator()( gct::command_buffer_recorder_t &rec ) const {
+      for( std::uint32_t pass = 0u; pass != 32u / radix_bits; ++pass ) {
+        const push_constant_t push_constant{ count, pass * radix_bits, block_count };
+        const auto &descriptor_set = descriptor_sets[ pass % 2u ];
+        dispatch( rec, histogram_pipeline, descriptor_set, push_constant );
+        barrier( rec );
+        ( *scan )( rec );
+        barrier( rec );
+        dispatch( rec, scatter_pipeline, descriptor_set, push_constant );
+        if( pass + 1u != 32u / radix_bits ) barrier( rec );
+      }
+    }
+    std::uint32_t get_block_count() const {
+      return block_count;
+    }
+  private:
+    std::shared_ptr< gct::descriptor_set_t > create_descriptor_set(
+      const std::shared_ptr< gct::descriptor_set_layout_t > &descriptor_set_layout,
+      const std::shared_ptr< gct::buffer_t > &src_keys,
+      const std::shared_ptr< gct::buffer_t > &dst_keys,
+      const std::shared_ptr< gct::buffer_t > &src_values,
+      const std::shared_ptr< gct::buffer_t > &dst_values
+    ) const {
+      const auto descriptor_set = descriptor_pool->allocate( descriptor_set_layout );
+      const auto write = [&]( const char *name, const std::shared_ptr< gct::buffer_t > &buffer, std::uint64_t size ) {
+        return gct::write_descriptor_set_t()
+          .set_basic( (*descriptor_set)[ name ] )
+          .add_buffer(
+            gct::descriptor_buffer_info_t()
+              .set_buffer( buffer )
+              .set_basic(
+                vk::DescriptorBufferInfo()
+                  .setOffset( 0 )
+                  .setRange( size )
+              )
+          );
+      };
+      const std::uint64_t buffer_size = std::uint64_t( count ) * sizeof( std::uint32_t );
+      descriptor_set->update(
+        {
+          write( "src_keys", src_keys, buffer_size ),
+          write( "dst_keys", dst_keys, buffer_size ),
+          write( "src_values", src_values, buffer_size ),
+          write( "dst_values", dst_values, buffer_size ),
+          write( "histogram", histogram, std::uint64_t( block_count ) * radix * sizeof( std::uint32_t ) )
+        }
+      );
+      return descriptor_set;
+    }
+    void dispatch(
+      gct::command_buffer_recorder_t &rec,
+      const std::shared_ptr< gct::compute_pipeline_t > &pipeline,
+      const std::shared_ptr< gct::descriptor_set_t > &descriptor_set,
+      const push_constant_t &push_constant
+    ) const {
+      rec.bind_descriptor_set(
+        vk::PipelineBindPoint::eCompute,
+        pipeline_layout,
+        descriptor_set
+      );
+      rec.bind_pipeline( pipeline );
+      rec->pushConstants(
+        **pipeline_layout,
+        vk::ShaderStageFlagBits::eCompute,
+        0u,
+        sizeof( push_constant_t ),
+        reinterpret_cast< const void* >( &push_constant )
+      );
+      rec->dispatch( group_count_x, group_count_y, 1 );
+    }
+    // 前のDispatchの書き込みが終わるまで次のDispatchを始めない
+    void barrier( gct::command_buffer_recorder_t &rec ) const {
+      std::vector< std::shared_ptr< gct::buffer_t > > buffers{ keys, temporary_keys, histogram };
+      if( values ) {
+        buffers.push_back( values );
+        buffers.push_back( temporary_values );
+      }
+      rec.barrier(
+        vk::AccessFlagBits::eShaderWrite,
+        vk::AccessFlagBits::eShaderRead|vk::AccessFlagBits::eShaderWrite,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlagBits( 0 ),
+        buffers,
+        {}
+      );
+    }
+    std::shared_ptr< gct::buffer_t > keys;
+    std::shared_ptr< gct::buffer_t > values;
+    std::shared_ptr< gct::buffer_t > temporary_keys;
+    std::shared_ptr< gct::buffer_t > temporary_values;
+    std::shared_ptr< gct::buffer_t > histogram;
+    std::uint32_t count = 0u;
+    std::uint32_t block_count = 0u;
+    std::uint32_t group_count_x = 0u;
+    std::uint32_t group_count_y = 0u;
+    std::shared_ptr< gct::pipeline_layout_t > pipeline_layout;
+    std::shared_ptr< gct::compute_pipeline_t > histogram_pipeline;
+    std::shared_ptr< gct::compute_pipeline_t > scatter_pipeline;
+    std::shared_ptr< gct::descriptor_pool_t > descriptor_pool;
+    std::shared_ptr< gct::descriptor_set_t > descriptor_sets[ 2 ];
+    std::unique_ptr< scan_t > scan;
+  };
+}
+
+#endif
+
@@ -0,0 +1,240 @@
+#ifndef SAMPLES_SCAN_HPP
+#define SAMPLES_SCAN_HPP
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <gct/device.hpp>
+#include <gct/allocator.hpp>
+#include <gct/buffer.hpp>
+#include <gct/descriptor_pool.hpp>
+#include <gct/descriptor_set_layout.hpp>
+#include <gct/descriptor_set.hpp>
+#include <gct/pipeline_cache.hpp>
+#include <gct/pipeline_layout.hpp>
+#include <gct/pipeline_layout_create_info.hpp>
+#include <gct/shader_module.hpp>
+#include <gct/compute_pipeline_create_info.hpp>
+#include <gct/compute_pipeline.hpp>
+#include <gct/write_descriptor_set.hpp>
+#include <gct/command_buffer_recorder.hpp>
+#include <samples/pipeline_telemetry.hpp>
+
+namespace samples {
+  // プレフィックス和を求める要素の型
+  enum class scan_value_type_t : std::uint32_t {
+    uint32 = 0u,
+    float32 = 1u
+  };
+
+  // バッファ上の任意の個数の要素の排他的プレフィックス和を求める
+  //
+  // 要素を local_size * 2 個ずつのブロックに分けてブロック内のプレフィックス和を求め、
+  // ブロック毎の総和を1つ上の段のバッファに書く
+  // 上の段の要素が1ブロックに収まるまでこれを繰り返した後、
+  // 上の段から順に下の段の各ブロックに前のブロックまでの和を足していく
+  //
+  // scan.comp.spvとscan_add.comp.spvがshader_dirにある必要がある
+  class scan_t {
+    struct spec_t {
+      std::uint32_t local_x_size = 0u;
+      std::uint32_t value_type = 0u;
+    };
+    struct push_constant_t {
+      std::uint32_t count = 0u;
+      std::uint32_t write_block_sums = 0u;
+    };
+    // 段毎の設定
+    struct level_t {
+      std::shared_ptr< gct::buffer_t > data;
+      std::uint32_t count = 0u;
+      std::uint32_t group_count_x = 0u;
+      std::uint32_t group_count_y = 0u;
+      std::shared_ptr< gct::descriptor_set_t > descriptor_set;
+    };
+  public:
+    scan_t(
+      const std::shared_ptr< gct::device_t > &device,
+      const std::shared_ptr< gct::allocator_t > &allocator,
+      const std::shared_ptr< gct::pipeline_cache_t > &pipeline_cache,
+      const vk::PhysicalDeviceLimits &limits,
+      const std::string &shader_dir,
+      const std::shared_ptr< gct::buffer_t > &data,
+      std::uint32_t count,
+      scan_value_type_t value_type = scan_value_type_t::uint32,
+      std::uint32_t local_size = 256u
+    ) : block_size( local_size * 2u ) {
+      const auto scan_shader = device->get_shader_module( shader_dir + "/scan.comp.spv" );
+      const auto add_shader = device->get_shader_module( shader_dir + "/scan_add.comp.spv" );
+      const auto descriptor_set_layout = device->get_descriptor_set_layout(
+        gct::descriptor_set_layout_create_info_t()
+          .add_binding( scan_shader->get_props().get_reflection() )
+          .rebuild_chain()
+      );
+      pipeline_layout = device->get_pipeline_layout(
+        gct::pipeline_layout_create_info_t()
+          .add_descriptor_set_layout( descriptor_set_layout )
+          .add_push_constant_range(
+            vk::PushConstantRange()
+              .setStageFlags( vk::ShaderStageFlagBits::eCompute )
+              .setOffset( 0 )
+              .setSize( sizeof( push_constant_t ) )
+          )
+      );
+      const instrumented_pipeline_cache_t instrumented( pipeline_cache );
+      const auto create_pipeline = [&]( const std::shared_ptr< gct::shader_module_t > &shader, const std::string &label ) {
+        return instrumented.get_pipeline(
+          gct::compute_pipeline_create_info_t()
+            .set_stage(
+              gct::pipeline_shader_stage_create_info_t()
+                .set_shader_module( shader )
+                .set_specialization_info(
+                  gct::specialization_info_t< spec_t >()
+                    .set_data(
+                      spec_t{ local_size, static_cast< std::uint32_t >( value_type ) }
+                    )
+                    .add_map< std::uint32_t >( 1, offsetof( spec_t, local_x_size ) )
+                    .add_map< std::uint32_t >( 3, offsetof( spec_t, value_type ) )
+                )
+            )
+            .set_layout( pipeline_layout ),
+          label
+        );
+      };
+      scan_pipeline = create_pipeline( scan_shader, "scan" );
+      add_pipeline = create_pipeline( add_shader, "scan_add" );
+
+      // 段毎の要素の数を決める
+      std::vector< std::uint32_t > counts{ count };
+      while( counts.back() > block_size )
+        counts.push_back( ( counts.back() + block_size - 1u ) / block_size );
+
+      descriptor_pool = device->get_descriptor_pool(
+        gct::descriptor_pool_create_info_t()
+          .set_basic(
+            vk::DescriptorPoolCreateInfo()
+              .setFlags( vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet )
+              .setMaxSets( counts.size() )
+          )
+          .set_descriptor_pool_size( vk::DescriptorType::eStorageBuffer, counts.size() * 2u )
+          .rebuild_chain()
+      );
+      for( std::size_t i = 0u; i != counts.size(); ++i ) {
+        level_t level;
+        level.count = counts[ i ];
+        level.data = i == 0u ? data :
+          allocator->create_buffer(
+            gct::buffer_create_info_t()
+              .set_basic(
+                vk::BufferCreateInfo()
+                  .setSize( counts[ i ] * sizeof( std::uint32_t ) )
+                  .setUsage( vk::BufferUsageFlagBits::eStorageBuffer )
+              ),
+            VMA_MEMORY_USAGE_GPU_ONLY
+          );
+        // 1次元で並べきれない数のブロックは2次元に並べる
+        const std::uint32_t group_count = ( counts[ i ] + block_size - 1u ) / block_size;
+        level.group_count_x = std::min( group_count, limits.maxComputeWorkGroupCount[ 0 ] );
+        level.group_count_y = ( group_count + level.group_count_x - 1u ) / level.group_count_x;
+        level.descriptor_set = descriptor_pool->allocate( descriptor_set_layout );
+        levels.push_back( level );
+      }
+      for( std::size_t i = 0u; i != levels.size(); ++i ) {
+        // 最上段はブロック毎の総和を書かないので自分自身を繋いでおく
+        const auto &block_sums = i + 1u != levels.size() ? levels[ i + 1u ] : levels[ i ];
+        levels[ i ].descriptor_set->update(
+          {
+            gct::write_descriptor_set_t()
+              .set_basic( (*levels[ i ].descriptor_set)[ "layout1" ] )
+              .add_buffer(
+                gct::descriptor_buffer_info_t()
+                  .set_buffer( levels[ i ].data )
+                  .set_basic(
+                    vk::DescriptorBufferInfo()
+                      .setOffset( 0 )
+                      .setRange( levels[ i ].count * sizeof( std::uint32_t ) )
+                  )
+              ),
+            gct::write_descriptor_set_t()
+              .set_basic( (*levels[ i ].descriptor_set)[ "layout2" ] )
+              .add_buffer(
+                gct::descriptor_buffer_info_t()
+                  .set_buffer( block_sums.data )
+                  .set_basic(
+                    vk::DescriptorBufferInfo()
+                      .setOffset( 0 )
+                      .setRange( block_sums.count * sizeof( std::uint32_t ) )
+                  )
+              )
+          }
+        );
+      }
+    }
+    // プレフィックス和を求めるコマンドを積む
+    // 入力のバッファへの書き込みは予め完了している必要がある
+    // 結果を読むコマンドとの間には呼び出し側でバリアを張る必要がある
+    void operator()( gct::command_buffer_recorder_t &rec ) const {
+      for( std::size_t i = 0u; i != levels.size(); ++i ) {
+        dispatch( rec, scan_pipeline, levels[ i ], i + 1u != levels.size() );
+        barrier( rec );
+      }
+      for( std::size_t i = levels.size() - 1u; i != 0u; --i ) {
+        dispatch( rec, add_pipeline, levels[ i - 1u ], false );
+        if( i != 1u ) barrier( rec );
+      }
+    }
+    std::uint32_t get_block_size() const {
+      return block_size;
+    }
+    std::size_t get_level_count() const {
+      return levels.size();
+    }
+  private:
+    void dispatch(
+      gct::command_buffer_recorder_t &rec,
+      const std::shared_ptr< gct::compute_pipeline_t > &pipeline,
+      const level_t &level,
+      bool write_block_sums
+    ) const {
+      const push_constant_t push_constant{ level.count, write_block_sums ? 1u : 0u };
+      rec.bind_descriptor_set(
+        vk::PipelineBindPoint::eCompute,
+        pipeline_layout,
+        level.descriptor_set
+      );
+      rec.bind_pipeline( pipeline );
+      rec->pushConstants(
+        **pipeline_layout,
+        vk::ShaderStageFlagBits::eCompute,
+        0u,
+        sizeof( push_constant_t ),
+        reinterpret_cast< const void* >( &push_constant )
+      );
+      rec->dispatch( level.group_count_x, level.group_count_y, 1 );
+    }
+    // 全ての段のバッファについて前のDispatchの書き込みが終わるまで次のDispatchを始めない
+    void barrier( gct::command_buffer_recorder_t &rec ) const {
+      std::vector< std::shared_ptr< gct::buffer_t > > buffers;
+      for( const auto &level: levels ) buffers.push_back( level.data );
+      rec.barrier(
+        vk::AccessFlagBits::eShaderWrite,
+        vk::AccessFlagBits::eShaderRead|vk::AccessFlagBits::eShaderWrite,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlagBits( 0 ),
+        buffers,
+        {}
+      );
+    }
+    std::uint32_t block_size = 0u;
+    std::shared_ptr< gct::pipeline_layout_t > pipeline_layout;
+    std::shared_ptr< gct::compute_pipeline_t > scan_pipeline;
+    std::shared_ptr< gct::compute_pipeline_t > add_pipeline;
+    std::shared_ptr< gct::descriptor_pool_t > descriptor_pool;
+    std::vector< level_t > levels;
+  };
+}
+
+#endif
+
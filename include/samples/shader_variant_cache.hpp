@@ -0,0 +1,180 @@
+#ifndef SAMPLES_SHADER_VARIANT_CACHE_HPP
+#define SAMPLES_SHADER_VARIANT_CACHE_HPP
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include <gct/pipeline_cache.hpp>
+#include <gct/specialization_info.hpp>
+#include <gct/graphics_pipeline_create_info.hpp>
+#include <gct/graphics_pipeline.hpp>
+#include <samples/statistics.hpp>
+#include <samples/pipeline_telemetry.hpp>
+
+namespace samples {
+  // 37_gltfのuber_world.fragとuber_tangent.fragが持つ機能
+  // ビットの位置はuber.hの特殊化定数のconstant_idと同じ
+  enum class shader_feature_t : std::uint32_t {
+    base_color = 0u,
+    metallic_roughness = 1u,
+    occlusion = 2u,
+    emissive = 3u,
+    normal_map = 4u,
+    shadow = 5u,
+    // 特殊化定数ではなく、uber_tangent.fragとtangent.vertを使う事を表す
+    tangent = 6u
+  };
+  inline std::uint32_t get_feature_bit( shader_feature_t feature ) {
+    return 1u << std::uint32_t( feature );
+  }
+  inline bool has_feature( std::uint32_t mask, shader_feature_t feature ) {
+    return mask & get_feature_bit( feature );
+  }
+  // world_bc_mr_shやtangent_no.fragのような変種の名前を機能のマスクに変換する
+  inline std::uint32_t get_feature_mask( std::string name ) {
+    const auto dot = name.find( '.' );
+    if( dot != std::string::npos ) name = name.substr( 0u, dot );
+    std::uint32_t mask = 0u;
+    std::size_t begin = 0u;
+    while( begin <= name.size() ) {
+      auto end = name.find( '_', begin );
+      if( end == std::string::npos ) end = name.size();
+      const auto token = name.substr( begin, end - begin );
+      if( token == "tangent" ) mask |= get_feature_bit( shader_feature_t::tangent );
+      else if( token == "bc" ) mask |= get_feature_bit( shader_feature_t::base_color );
+      else if( token == "mr" ) mask |= get_feature_bit( shader_feature_t::metallic_roughness );
+      else if( token == "oc" ) mask |= get_feature_bit( shader_feature_t::occlusion );
+      else if( token == "em" ) mask |= get_feature_bit( shader_feature_t::emissive );
+      else if( token == "no" ) mask |= get_feature_bit( shader_feature_t::normal_map );
+      else if( token == "sh" ) mask |= get_feature_bit( shader_feature_t::shadow );
+      begin = end + 1u;
+    }
+    return mask;
+  }
+  // uber.hの特殊化定数に渡す値
+  // GLSLのboolはVkBool32として渡す
+  struct shader_feature_spec_t {
+    vk::Bool32 base_color = VK_FALSE;
+    vk::Bool32 metallic_roughness = VK_FALSE;
+    vk::Bool32 occlusion = VK_FALSE;
+    vk::Bool32 emissive = VK_FALSE;
+    vk::Bool32 normal_map = VK_FALSE;
+    vk::Bool32 shadow = VK_FALSE;
+  };
+  inline gct::specialization_info_t< shader_feature_spec_t > get_specialization_info( std::uint32_t mask ) {
+    const auto flag = [&]( shader_feature_t feature ) -> vk::Bool32 {
+      return has_feature( mask, feature ) ? VK_TRUE : VK_FALSE;
+    };
+    return gct::specialization_info_t< shader_feature_spec_t >()
+      .set_data(
+        shader_feature_spec_t{
+          flag( shader_feature_t::base_color ),
+          flag( shader_feature_t::metallic_roughness ),
+          flag( shader_feature_t::occlusion ),
+          flag( shader_feature_t::emissive ),
+          // 接ベクトルが無い場合は法線マップを使えない
+          has_feature( mask, shader_feature_t::tangent ) ? flag( shader_feature_t::normal_map ) : VK_FALSE,
+          flag( shader_feature_t::shadow )
+        }
+      )
+      .add_map< vk::Bool32 >( 0, offsetof( shader_feature_spec_t, base_color ) )
+      .add_map< vk::Bool32 >( 1, offsetof( shader_feature_spec_t, metallic_roughness ) )
+      .add_map< vk::Bool32 >( 2, offsetof( shader_feature_spec_t, occlusion ) )
+      .add_map< vk::Bool32 >( 3, offsetof( shader_feature_spec_t, emissive ) )
+      .add_map< vk::Bool32 >( 4, offsetof( shader_feature_spec_t, normal_map ) )
+      .add_map< vk::Bool32 >( 5, offsetof( shader_feature_spec_t, shadow ) );
+  }
+
+  // 機能のマスク毎のパイプラインを最初に必要になった時に作り、以後は同じ物を返す
+  //
+  // SPIR-Vはuberシェーダ1つだけで、変種の違いは特殊化定数の値だけなので
+  // 作成情報はマスクからcreate_info_generatorで作る
+  // 複数のスレッドから同時にget()してよい
+  // 同じマスクを同時に要求された場合は1つのスレッドだけがパイプラインを作り、他のスレッドはその完了を待つ
+  //
+  // 今のところ使っているのはgct-gltf_compile_pipelinesの比較だけ
+  // gct-gltfのパイプラインはgct::gltf::load_gltfがシェーダのディレクトリから変種の.spvを名前で選んで作るので
+  // load_gltfが特殊化定数付きのステージを受け取れるようになるまでは変種の.spvが必要
+  class shader_variant_cache_t {
+  public:
+    using create_info_generator_t = std::function< gct::graphics_pipeline_create_info_t( std::uint32_t mask ) >;
+    shader_variant_cache_t(
+      const std::shared_ptr< gct::pipeline_cache_t > &pipeline_cache_,
+      const create_info_generator_t &create_info_generator_
+    ) : pipeline_cache( pipeline_cache_ ), create_info_generator( create_info_generator_ ) {}
+    std::shared_ptr< gct::graphics_pipeline_t > get( std::uint32_t mask ) {
+      std::promise< std::shared_ptr< gct::graphics_pipeline_t > > promise;
+      std::shared_future< std::shared_ptr< gct::graphics_pipeline_t > > future;
+      bool owner = false;
+      {
+        std::lock_guard< std::mutex > lock( guard );
+        const auto existing = variants.find( mask );
+        if( existing != variants.end() ) {
+          ++hit;
+          future = existing->second;
+        }
+        else {
+          future = promise.get_future().share();
+          variants.emplace( mask, future );
+          owner = true;
+        }
+      }
+      if( owner ) {
+        try {
+          const auto begin_time = std::chrono::high_resolution_clock::now();
+          auto pipeline = pipeline_cache->get_pipeline( create_info_generator( mask ) );
+          const auto end_time = std::chrono::high_resolution_clock::now();
+          const auto ns = double( std::chrono::duration_cast< std::chrono::nanoseconds >( end_time - begin_time ).count() );
+          get_pipeline_telemetry().record( "variant" + std::to_string( mask ), pipeline, ns );
+          {
+            std::lock_guard< std::mutex > lock( guard );
+            compile_ns.push_back( ns );
+          }
+          promise.set_value( pipeline );
+        }
+        catch( ... ) {
+          // 失敗したマスクは次に要求された時にもう一度作る
+          {
+            std::lock_guard< std::mutex > lock( guard );
+            variants.erase( mask );
+          }
+          promise.set_exception( std::current_exception() );
+        }
+      }
+      return future.get();
+    }
+    // 今までに作った変種の数
+    std::size_t size() const {
+      std::lock_guard< std::mutex > lock( guard );
+      return compile_ns.size();
+    }
+    nlohmann::json dump() const {
+      std::lock_guard< std::mutex > lock( guard );
+      nlohmann::json root;
+      root[ "compiled" ] = compile_ns.size();
+      root[ "hit" ] = hit;
+      root[ "compile_ns" ] = get_statistics( compile_ns );
+      root[ "masks" ] = nlohmann::json::array();
+      for( const auto &v: variants )
+        root[ "masks" ].push_back( v.first );
+      return root;
+    }
+  private:
+    std::shared_ptr< gct::pipeline_cache_t > pipeline_cache;
+    create_info_generator_t create_info_generator;
+    mutable std::mutex guard;
+    std::unordered_map< std::uint32_t, std::shared_future< std::shared_ptr< gct::graphics_pipeline_t > > > variants;
+    std::vector< double > compile_ns;
+    std::uint32_t hit = 0u;
+  };
+}
+
+#endif
+
@@ -0,0 +1,202 @@
+#ifndef SAMPLES_SPIRV_BUNDLE_HPP
+#define SAMPLES_SPIRV_BUNDLE_HPP
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include <gct/mmaped_file.hpp>
+
+namespace samples {
+  // 複数のSPIR-Vを1つのファイルにまとめた物
+  //
+  // +------------------+
+  // | spirv_bundle_header_t |
+  // +------------------+
+  // | spirv_bundle_entry_t * bucket_count | 名前のハッシュで引くオープンアドレス法のハッシュ表
+  // +------------------+
+  // | 名前                |
+  // +------------------+
+  // | SPIR-V            | 各々spirv_bundle_alignmentバイト境界に置く
+  // +------------------+
+  //
+  // ファイル全体をmmapし、SPIR-Vはマップされた領域を直接VkShaderModuleCreateInfoに渡す
+  // 数値は全てリトルエンディアン
+  constexpr std::uint32_t spirv_bundle_magic = 0x42565053u; // "SPVB"
+  constexpr std::uint32_t spirv_bundle_version = 1u;
+  constexpr std::uint64_t spirv_bundle_alignment = 16u;
+  struct spirv_bundle_header_t {
+    std::uint32_t magic = spirv_bundle_magic;
+    std::uint32_t version = spirv_bundle_version;
+    std::uint32_t entry_count = 0u;
+    // 2の冪
+    std::uint32_t bucket_count = 0u;
+  };
+  struct spirv_bundle_entry_t {
+    std::uint64_t hash = 0u;
+    std::uint32_t name_offset = 0u;
+    // 0の場合は空のバケット
+    std::uint32_t name_size = 0u;
+    std::uint64_t data_offset = 0u;
+    std::uint64_t data_size = 0u;
+  };
+  static_assert( sizeof( spirv_bundle_header_t ) == 16u );
+  static_assert( sizeof( spirv_bundle_entry_t ) == 32u );
+  // FNV-1a
+  inline std::uint64_t get_spirv_bundle_hash( std::string_view name ) {
+    std::uint64_t hash = 0xcbf29ce484222325ull;
+    for( const auto c: name ) {
+      hash ^= std::uint8_t( c );
+      hash *= 0x100000001b3ull;
+    }
+    return hash;
+  }
+
+  // add_shader_bundleが生成したファイルを読む
+  // 名前はadd_shaderの出力のCMAKE_CURRENT_BINARY_DIRからの相対パス(例: shaders/world.vert.spv)
+  //
+  // 作れるのはリフレクションを持たないvk::ShaderModuleだけ
+  // サンプルはデスクリプタセットレイアウトや頂点入力をgct::shader_module_tのリフレクションから作るが
+  // gct::device_t::get_shader_moduleはファイルのパスしか受け取らないので、サンプルはまだこれを使っていない
+  class spirv_bundle_t {
+  public:
+    explicit spirv_bundle_t( const std::filesystem::path &path ) :
+      file( new gct::mmaped_file( path ) ) {
+      const auto size = std::size_t( std::distance( file->begin(), file->end() ) );
+      head = reinterpret_cast< const std::uint8_t* >( &*file->begin() );
+      if( size < sizeof( spirv_bundle_header_t ) )
+        throw std::runtime_error( "spirv_bundle_t : " + path.string() + " is truncated" );
+      std::memcpy( &header, head, sizeof( header ) );
+      if( header.magic != spirv_bundle_magic )
+        throw std::runtime_error( "spirv_bundle_t : " + path.string() + " is not a SPIR-V bundle" );
+      if( header.version != spirv_bundle_version )
+        throw std::runtime_error( "spirv_bundle_t : " + path.string() + " has unsupported version" );
+      if( header.bucket_count == 0u || ( header.bucket_count & ( header.bucket_count - 1u ) ) )
+        throw std::runtime_error( "spirv_bundle_t : " + path.string() + " has broken table of contents" );
+      const auto toc_end = sizeof( spirv_bundle_header_t ) + std::size_t( header.bucket_count ) * sizeof( spirv_bundle_entry_t );
+      if( size < toc_end )
+        throw std::runtime_error( "spirv_bundle_t : " + path.string() + " is truncated" );
+      entries = reinterpret_cast< const spirv_bundle_entry_t* >( head + sizeof( spirv_bundle_header_t ) );
+      for( std::uint32_t i = 0u; i != header.bucket_count; ++i ) {
+        const auto &e = entries[ i ];
+        if( e.name_size == 0u ) continue;
+        if( std::uint64_t( e.name_offset ) + e.name_size > size || e.data_offset + e.data_size > size || e.data_offset % 4u || e.data_size % 4u )
+          throw std::runtime_error( "spirv_bundle_t : " + path.string() + " has an entry out of range" );
+      }
+    }
+    // nameのSPIR-Vを返す
+    // 見つからない場合は{ nullptr, 0 }
+    // 戻り値はこのオブジェクトが生きている間だけ有効
+    std::pair< const std::uint32_t*, std::size_t > find( std::string_view name ) const {
+      const auto hash = get_spirv_bundle_hash( name );
+      const std::uint32_t mask = header.bucket_count - 1u;
+      for( std::uint32_t i = 0u; i != header.bucket_count; ++i ) {
+        const auto &e = entries[ ( hash + i ) & mask ];
+        if( e.name_size == 0u ) break;
+        if( e.hash != hash ) continue;
+        if( std::string_view( reinterpret_cast< const char* >( head + e.name_offset ), e.name_size ) != name ) continue;
+        return std::make_pair( reinterpret_cast< const std::uint32_t* >( head + e.data_offset ), std::size_t( e.data_size ) );
+      }
+      return std::make_pair( nullptr, std::size_t( 0u ) );
+    }
+    bool contains( std::string_view name ) const {
+      return find( name ).first != nullptr;
+    }
+    // マップされたSPIR-Vを複製せずにシェーダモジュールを作る
+    vk::UniqueShaderModule create_shader_module( vk::Device device, std::string_view name ) const {
+      const auto [code,size] = find( name );
+      if( !code )
+        throw std::runtime_error( "spirv_bundle_t : " + std::string( name ) + " is not in the bundle" );
+      return device.createShaderModuleUnique(
+        vk::ShaderModuleCreateInfo()
+          .setCodeSize( size )
+          .setPCode( code )
+      );
+    }
+    std::vector< std::string > get_names() const {
+      std::vector< std::string > names;
+      for( std::uint32_t i = 0u; i != header.bucket_count; ++i ) {
+        const auto &e = entries[ i ];
+        if( e.name_size == 0u ) continue;
+        names.emplace_back( reinterpret_cast< const char* >( head + e.name_offset ), e.name_size );
+      }
+      return names;
+    }
+    std::uint32_t size() const {
+      return header.entry_count;
+    }
+  private:
+    std::shared_ptr< gct::mmaped_file > file;
+    const std::uint8_t *head = nullptr;
+    spirv_bundle_header_t header;
+    const spirv_bundle_entry_t *entries = nullptr;
+  };
+
+  // (名前, SPIR-V)の組からバンドルを作ってpathに書く
+  inline void write_spirv_bundle(
+    const std::filesystem::path &path,
+    const std::vector< std::pair< std::string, std::vector< std::uint8_t > > > &shaders
+  ) {
+    spirv_bundle_header_t header;
+    header.entry_count = shaders.size();
+    // 負荷率が1/2以下になるようにする
+    header.bucket_count = 1u;
+    while( header.bucket_count < header.entry_count * 2u ) header.bucket_count <<= 1;
+    std::vector< spirv_bundle_entry_t > entries( header.bucket_count );
+    const auto align = []( std::uint64_t v ) {
+      return ( v + spirv_bundle_alignment - 1u ) / spirv_bundle_alignment * spirv_bundle_alignment;
+    };
+    const std::uint64_t names_offset = sizeof( spirv_bundle_header_t ) + entries.size() * sizeof( spirv_bundle_entry_t );
+    std::uint64_t names_size = 0u;
+    for( const auto &s: shaders ) names_size += s.first.size();
+    std::string names;
+    std::uint64_t tail = align( names_offset + names_size );
+    const std::uint32_t mask = header.bucket_count - 1u;
+    for( const auto &[name,code]: shaders ) {
+      if( name.empty() )
+        throw std::runtime_error( "write_spirv_bundle : empty name" );
+      if( code.size() % 4u )
+        throw std::runtime_error( "write_spirv_bundle : " + name + " is not a SPIR-V" );
+      spirv_bundle_entry_t e;
+      e.hash = get_spirv_bundle_hash( name );
+      e.name_offset = names_offset + names.size();
+      e.name_size = name.size();
+      e.data_offset = tail;
+      e.data_size = code.size();
+      std::uint32_t bucket = e.hash & mask;
+      while( entries[ bucket ].name_size != 0u ) {
+        if( entries[ bucket ].hash == e.hash && names.compare( entries[ bucket ].name_offset - names_offset, entries[ bucket ].name_size, name ) == 0 )
+          throw std::runtime_error( "write_spirv_bundle : " + name + " appears twice" );
+        bucket = ( bucket + 1u ) & mask;
+      }
+      entries[ bucket ] = e;
+      names += name;
+      tail = align( tail + code.size() );
+    }
+    std::ofstream file( path, std::ios::out|std::ios::binary|std::ios::trunc );
+    if( !file )
+      throw std::runtime_error( "write_spirv_bundle : unable to open " + path.string() );
+    file.write( reinterpret_cast< const char* >( &header ), sizeof( header ) );
+    file.write( reinterpret_cast< const char* >( entries.data() ), entries.size() * sizeof( spirv_bundle_entry_t ) );
+    file.write( names.data(), names.size() );
+    std::uint64_t written = names_offset + names.size();
+    const std::vector< char > padding( spirv_bundle_alignment, 0 );
+    for( const auto &[name,code]: shaders ) {
+      file.write( padding.data(), align( written ) - written );
+      written = align( written );
+      file.write( reinterpret_cast< const char* >( code.data() ), code.size() );
+      written += code.size();
+    }
+    if( !file )
+      throw std::runtime_error( "write_spirv_bundle : unable to write " + path.string() );
+  }
+}
+
+#endif
+
@@ -0,0 +1,194 @@
+#ifndef SAMPLES_STAGING_RING_HPP
+#define SAMPLES_STAGING_RING_HPP
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include <nlohmann/json.hpp>
+#include <gct/allocator.hpp>
+#include <gct/buffer.hpp>
+#include <gct/command_buffer_recorder.hpp>
+
+namespace samples {
+  // 毎フレームGPUに送る小さなデータの為のリングバッファ
+  //
+  // CPUから見えるバッファを1つだけ作ってずっとマップしたままにしておき、
+  // 先頭から順に切り出して使う
+  // 切り出した領域はそのフレームの実行が完了した事が分かるまで再利用しない
+  //
+  // 切り出した領域はそのまま頂点バッファやユニフォームバッファとして使ってもよいし、
+  // upload()でGPU専用のバッファへの転送を予約してflush()で纏めて転送してもよい
+  // flush()が積むvkCmdCopyBufferは転送先のバッファ毎に1つだけになる
+  //
+  // 書いた後にフラッシュしないので、バッファはHOST_COHERENTなメモリに置く必要がある
+  // VMA_MEMORY_USAGE_CPU_TO_GPUはHOST_COHERENTを保証しないので、それを必須とするVMA_MEMORY_USAGE_CPU_ONLYで作る
+  class staging_ring_t {
+  public:
+    // 切り出した領域
+    struct allocation_t {
+      std::shared_ptr< gct::buffer_t > buffer;
+      vk::DeviceSize offset = 0u;
+      vk::DeviceSize size = 0u;
+      // CPUから書き込む為のアドレス
+      std::uint8_t *data = nullptr;
+    };
+    staging_ring_t(
+      const std::shared_ptr< gct::allocator_t > &allocator,
+      vk::DeviceSize size_,
+      // 切り出す領域の先頭のアライメント
+      // ユニフォームバッファとして使う場合はminUniformBufferOffsetAlignment以上にする
+      vk::DeviceSize alignment_ = 16u,
+      vk::BufferUsageFlags usage =
+        vk::BufferUsageFlagBits::eTransferSrc |
+        vk::BufferUsageFlagBits::eUniformBuffer |
+        vk::BufferUsageFlagBits::eVertexBuffer |
+        vk::BufferUsageFlagBits::eIndexBuffer
+    ) :
+      size( size_ ),
+      alignment( std::max( alignment_, vk::DeviceSize( 1u ) ) ),
+      buffer(
+        allocator->create_buffer(
+          gct::buffer_create_info_t()
+            .set_basic(
+              vk::BufferCreateInfo()
+                .setSize( size_ )
+                .setUsage( usage )
+            ),
+          VMA_MEMORY_USAGE_CPU_ONLY
+        )
+      ),
+      mapped( buffer->map< std::uint8_t >() ),
+      head_address( &*mapped.begin() ) {
+      if( size == 0u )
+        throw std::runtime_error( "staging_ring_t : size must not be 0" );
+    }
+    // serial番目のフレームで使う領域の切り出しを始める
+    // completed番目より前のフレームの実行が完了していれば、それらに切り出した領域を解放する
+    // frame_ring_tと組み合わせる場合はframe.serialとget_completed()を渡す
+    void begin_frame( std::uint64_t serial, std::uint64_t completed ) {
+      if( in_frame )
+        throw std::runtime_error( "staging_ring_t : begin_frame called twice" );
+      while( !frames.empty() && frames.front().first < completed ) {
+        tail = frames.front().second;
+        frames.pop_front();
+      }
+      current_serial = serial;
+      in_frame = true;
+    }
+    // 現在のフレームで切り出した領域の終わりを記録する
+    void end_frame() {
+      if( !in_frame )
+        throw std::runtime_error( "staging_ring_t : end_frame called without begin_frame" );
+      if( !pending.empty() )
+        throw std::runtime_error( "staging_ring_t : end_frame called before flush" );
+      frames.emplace_back( current_serial, head );
+      in_frame = false;
+      ++frame_count;
+    }
+    // bytesバイトの領域を切り出す
+    // 空きが足りない場合は例外を投げる
+    allocation_t allocate( vk::DeviceSize bytes, vk::DeviceSize alignment_ = 0u ) {
+      if( !in_frame )
+        throw std::runtime_error( "staging_ring_t : allocate called outside of a frame" );
+      if( bytes > size )
+        throw std::runtime_error( "staging_ring_t : allocation larger than the ring" );
+      const auto a = std::max( alignment, alignment_ );
+      // headとtailは巻き戻らない通算のバイト数
+      auto begin = ( head + a - 1u ) / a * a;
+      // バッファの終わりをまたぐ場合は残りを捨てて先頭から切り出す
+      if( begin % size + bytes > size )
+        begin = ( begin / size + 1u ) * size;
+      if( begin + bytes - tail > size )
+        throw std::runtime_error( "staging_ring_t : out of space" );
+      head = begin + bytes;
+      peak = std::max( peak, head - tail );
+      ++allocation_count;
+      allocated_bytes += bytes;
+      allocation_t allocation;
+      allocation.buffer = buffer;
+      allocation.offset = begin % size;
+      allocation.size = bytes;
+      allocation.data = head_address + allocation.offset;
+      return allocation;
+    }
+    // valueを書き込んだ領域を切り出す
+    template< typename T >
+    allocation_t push( const T &value, vk::DeviceSize alignment_ = 0u ) {
+      auto allocation = allocate( sizeof( T ), alignment_ );
+      std::memcpy( allocation.data, &value, sizeof( T ) );
+      return allocation;
+    }
+    // valueをdstのdst_offsetの位置に転送する事を予約する
+    template< typename T >
+    void upload(
+      const T &value,
+      const std::shared_ptr< gct::buffer_t > &dst,
+      vk::DeviceSize dst_offset = 0u
+    ) {
+      const auto allocation = push( value );
+      auto &regions = pending[ dst ];
+      regions.push_back(
+        vk::BufferCopy()
+          .setSrcOffset( allocation.offset )
+          .setDstOffset( dst_offset )
+          .setSize( allocation.size )
+      );
+    }
+    // 予約した転送を転送先のバッファ毎に1つのvkCmdCopyBufferで記録する
+    // 転送先を読む処理との間のバリアは呼び出し側で張る
+    void flush( gct::command_buffer_recorder_t &rec ) {
+      for( const auto &[dst,regions]: pending ) {
+        rec->copyBuffer( **buffer, **dst, regions );
+        ++copy_count;
+      }
+      pending.clear();
+    }
+    const std::shared_ptr< gct::buffer_t > &get_buffer() const {
+      return buffer;
+    }
+    vk::DeviceSize get_size() const {
+      return size;
+    }
+    // まだ解放されていない領域の大きさ
+    vk::DeviceSize get_used() const {
+      return head - tail;
+    }
+    nlohmann::json dump() const {
+      nlohmann::json root;
+      root[ "size" ] = size;
+      root[ "frames" ] = frame_count;
+      root[ "allocations" ] = allocation_count;
+      root[ "allocated_bytes" ] = allocated_bytes;
+      root[ "peak_bytes" ] = peak;
+      root[ "copy_commands" ] = copy_count;
+      return root;
+    }
+  private:
+    vk::DeviceSize size;
+    vk::DeviceSize alignment;
+    std::shared_ptr< gct::buffer_t > buffer;
+    decltype( std::declval< gct::buffer_t& >().map< std::uint8_t >() ) mapped;
+    std::uint8_t *head_address = nullptr;
+    vk::DeviceSize head = 0u;
+    vk::DeviceSize tail = 0u;
+    vk::DeviceSize peak = 0u;
+    // フレームの番号とそのフレームが切り出した領域の終わり
+    std::deque< std::pair< std::uint64_t, vk::DeviceSize > > frames;
+    std::unordered_map< std::shared_ptr< gct::buffer_t >, std::vector< vk::BufferCopy > > pending;
+    std::uint64_t current_serial = 0u;
+    bool in_frame = false;
+    std::uint64_t frame_count = 0u;
+    std::uint64_t allocation_count = 0u;
+    std::uint64_t allocated_bytes = 0u;
+    std::uint64_t copy_count = 0u;
+  };
+}
+
+#endif
+
@@ -0,0 +1,47 @@
+#ifndef SAMPLES_STATISTICS_HPP
+#define SAMPLES_STATISTICS_HPP
+#include <algorithm>
+#include <numeric>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+namespace samples {
+  // 計測した値の集合の要約
+  struct statistics_t {
+    double min = 0.0;
+    double max = 0.0;
+    double mean = 0.0;
+    double median = 0.0;
+  };
+  inline statistics_t get_statistics( std::vector< double > values ) {
+    statistics_t stats;
+    if( values.empty() ) return stats;
+    std::sort( values.begin(), values.end() );
+    stats.min = values.front();
+    stats.max = values.back();
+    stats.mean = std::accumulate( values.begin(), values.end(), 0.0 ) / values.size();
+    stats.median = ( values.size() % 2u ) ?
+      values[ values.size() / 2u ] :
+      ( values[ values.size() / 2u - 1u ] + values[ values.size() / 2u ] ) / 2.0;
+    return stats;
+  }
+  // 隣り合う時刻の差を取る
+  inline std::vector< double > get_intervals( const std::vector< double > &timestamps ) {
+    std::vector< double > intervals;
+    if( timestamps.size() < 2u ) return intervals;
+    intervals.reserve( timestamps.size() - 1u );
+    for( std::size_t i = 1u; i != timestamps.size(); ++i )
+      intervals.push_back( timestamps[ i ] - timestamps[ i - 1u ] );
+    return intervals;
+  }
+  inline void to_json( nlohmann::json &dest, const statistics_t &src ) {
+    dest = nlohmann::json::object();
+    dest[ "min" ] = src.min;
+    dest[ "max" ] = src.max;
+    dest[ "mean" ] = src.mean;
+    dest[ "median" ] = src.median;
+  }
+}
+
+#endif
+
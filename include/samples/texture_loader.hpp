@@ -0,0 +1,291 @@
+#ifndef SAMPLES_TEXTURE_LOADER_HPP
+#define SAMPLES_TEXTURE_LOADER_HPP
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include <OpenImageIO/imageio.h>
+#include <vulkan/vulkan.hpp>
+#include <gct/device.hpp>
+#include <gct/queue.hpp>
+#include <gct/allocator.hpp>
+#include <gct/buffer.hpp>
+#include <gct/image.hpp>
+#include <gct/image_create_info.hpp>
+#include <gct/command_buffer_recorder.hpp>
+#include <samples/command_buffer_recycler.hpp>
+#include <samples/mipmap_generator.hpp>
+#include <samples/statistics.hpp>
+
+namespace samples {
+  // 複数のテクスチャを並列にデコードし、デコードが終わった物から順にGPUに転送する
+  //
+  // デコードはワーカースレッドで行い、OpenImageIOにマップしたステージングバッファへRGBAの並びで直接書かせる
+  // 転送のコマンドはload()を呼んだスレッドが記録し、デコードが1つ終わる毎に提出する
+  // その為転送と残りのデコードが重なる
+  //
+  // イメージはeR8G8B8A8UnormでeMutableFormatを付けて作るので、サンプルする時はsRGBのビューも作れる
+  // mipmap_generator_tを渡した場合はミップマップも作れる
+  // ミップマップを作るイメージはeStorageを持つので、sRGBのビューにはvk::ImageViewUsageCreateInfoでeSampledだけを指定する
+  class texture_loader_t {
+  public:
+    texture_loader_t(
+      const std::shared_ptr< gct::device_t > &device_,
+      const std::shared_ptr< gct::queue_t > &queue_,
+      const std::shared_ptr< gct::allocator_t > &allocator_,
+      mipmap_generator_t *mipmap_generator_ = nullptr
+    ) :
+      device( device_ ),
+      queue( queue_ ),
+      allocator( allocator_ ),
+      mipmap_generator( mipmap_generator_ ) {}
+    // 読むテクスチャを追加する
+    // 戻り値はload()の結果の中での位置
+    // mipmapがtrueの場合はfilterでミップマップを作る
+    std::size_t add(
+      const std::string &filename,
+      vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eSampled,
+      bool mipmap = false,
+      mipmap_filter_t filter = mipmap_filter_t::linear
+    ) {
+      if( mipmap && !mipmap_generator )
+        throw std::runtime_error( "texture_loader_t::add : mipmap requires mipmap_generator_t" );
+      requests.push_back( request_t{ filename, usage, mipmap, filter } );
+      return requests.size() - 1u;
+    }
+    // 追加したテクスチャを全て読み、転送が完了するまで待つ
+    // thread_countが0の場合はハードウェアのスレッド数を使う
+    std::vector< std::shared_ptr< gct::image_t > > load( std::uint32_t thread_count = 0u ) {
+      if( thread_count == 0u ) thread_count = std::max( std::thread::hardware_concurrency(), 1u );
+      thread_count = std::min< std::uint32_t >( thread_count, std::max< std::size_t >( requests.size(), 1u ) );
+      decoded.assign( requests.size(), decoded_t() );
+      ready.clear();
+      std::atomic< std::size_t > next( 0u );
+      std::vector< std::exception_ptr > errors( thread_count );
+      const auto worker = [&]( std::uint32_t thread_index ) {
+        try {
+          for( std::size_t i = next++; i < requests.size(); i = next++ ) {
+            decode( i );
+            {
+              std::lock_guard< std::mutex > lock( guard );
+              ready.push_back( i );
+            }
+            cv.notify_one();
+          }
+        }
+        catch( ... ) {
+          errors[ thread_index ] = std::current_exception();
+          // 失敗した事をload()に知らせる
+          {
+            std::lock_guard< std::mutex > lock( guard );
+            failed = true;
+          }
+          cv.notify_one();
+        }
+      };
+      const auto begin_time = std::chrono::high_resolution_clock::now();
+      std::vector< std::shared_ptr< gct::image_t > > images( requests.size() );
+      std::vector< std::thread > threads;
+      for( std::uint32_t i = 0u; i != thread_count; ++i )
+        threads.emplace_back( worker, i );
+      std::exception_ptr upload_error;
+      {
+        command_buffer_recycler_t recycler( device, queue );
+        std::vector< std::shared_ptr< gct::bound_command_buffer_t > > submitted;
+        try {
+          // デコードが終わった物から転送する
+          for( std::size_t uploaded = 0u; uploaded != requests.size(); ++uploaded ) {
+            std::size_t index = 0u;
+            {
+              std::unique_lock< std::mutex > lock( guard );
+              cv.wait( lock, [&]() { return !ready.empty() || failed; } );
+              if( ready.empty() ) break;
+              index = ready.front();
+              ready.pop_front();
+            }
+            const auto command_buffer = recycler.acquire();
+            {
+              auto rec = command_buffer->begin();
+              images[ index ] = upload( rec, index );
+            }
+            recycler.submit( command_buffer );
+            submitted.push_back( command_buffer );
+          }
+        }
+        catch( ... ) {
+          upload_error = std::current_exception();
+        }
+        // 途中で失敗した場合も、ステージングバッファとミップマップの資源を手放す前に送ったコマンドバッファの完了を待つ
+        try {
+          for( const auto &command_buffer: submitted )
+            recycler.wait( command_buffer );
+        }
+        catch( ... ) {
+          if( !upload_error ) upload_error = std::current_exception();
+        }
+        for( auto &t: threads ) t.join();
+      }
+      const auto end_time = std::chrono::high_resolution_clock::now();
+      wall_ns = double( std::chrono::duration_cast< std::chrono::nanoseconds >( end_time - begin_time ).count() );
+      used_threads = thread_count;
+      // 転送が終わったのでステージングバッファは要らない
+      for( auto &d: decoded ) d.staging.reset();
+      if( mipmap_generator ) mipmap_generator->release();
+      failed = false;
+      if( upload_error ) std::rethrow_exception( upload_error );
+      for( const auto &e: errors )
+        if( e ) std::rethrow_exception( e );
+      return images;
+    }
+    // 直前のload()の結果の要約
+    // decode_nsの合計がwall_nsより大きければデコードが並列に進んでいる
+    nlohmann::json dump() const {
+      nlohmann::json root;
+      root[ "threads" ] = used_threads;
+      root[ "textures" ] = decoded.size();
+      root[ "wall_ns" ] = wall_ns;
+      std::vector< double > decode_ns;
+      for( const auto &d: decoded ) decode_ns.push_back( d.decode_ns );
+      root[ "decode_ns" ] = get_statistics( decode_ns );
+      root[ "decode_ns" ][ "total" ] = std::accumulate( decode_ns.begin(), decode_ns.end(), 0.0 );
+      return root;
+    }
+  private:
+    struct request_t {
+      std::string filename;
+      vk::ImageUsageFlags usage;
+      bool mipmap = false;
+      mipmap_filter_t filter = mipmap_filter_t::linear;
+    };
+    struct decoded_t {
+      std::shared_ptr< gct::buffer_t > staging;
+      std::uint32_t width = 0u;
+      std::uint32_t height = 0u;
+      double decode_ns = 0.0;
+    };
+    // ワーカースレッドで呼ばれる
+    void decode( std::size_t index ) {
+      using namespace OIIO_NAMESPACE;
+      const auto begin_time = std::chrono::high_resolution_clock::now();
+      const auto &filename = requests[ index ].filename;
+      auto in = ImageInput::open( filename );
+      if( !in ) throw std::runtime_error( "texture_loader_t : unable to open " + filename );
+      const ImageSpec spec = in->spec();
+      if( spec.width <= 0 || spec.height <= 0 )
+        throw std::runtime_error( "texture_loader_t : empty image " + filename );
+      auto &d = decoded[ index ];
+      d.width = spec.width;
+      d.height = spec.height;
+      const std::uint32_t channels = std::min( spec.nchannels, 4 );
+      d.staging = allocator->create_buffer(
+        gct::buffer_create_info_t()
+          .set_basic(
+            vk::BufferCreateInfo()
+              .setSize( vk::DeviceSize( d.width ) * d.height * 4u )
+              .setUsage( vk::BufferUsageFlagBits::eTransferSrc )
+          ),
+        VMA_MEMORY_USAGE_CPU_TO_GPU
+      );
+      {
+        auto mapped = d.staging->map< std::uint8_t >();
+        auto data = &*mapped.begin();
+        // 中間のバッファを介さずにRGBAの並びで書かせる
+        if( !in->read_image( 0, 0, 0, channels, TypeDesc::UINT8, data, 4, stride_t( d.width ) * 4 ) )
+          throw std::runtime_error( "texture_loader_t : unable to read " + filename + " : " + in->geterror() );
+        if( channels != 4u ) {
+          const std::size_t pixels = std::size_t( d.width ) * d.height;
+          for( std::size_t i = 0u; i != pixels; ++i ) {
+            auto p = data + i * 4u;
+            if( channels == 3u ) p[ 3 ] = 255u;
+            else {
+              // グレースケール
+              p[ 3 ] = channels == 2u ? p[ 1 ] : 255u;
+              p[ 1 ] = p[ 0 ];
+              p[ 2 ] = p[ 0 ];
+            }
+          }
+        }
+      }
+      const auto end_time = std::chrono::high_resolution_clock::now();
+      d.decode_ns = double( std::chrono::duration_cast< std::chrono::nanoseconds >( end_time - begin_time ).count() );
+    }
+    // load()を呼んだスレッドで呼ばれる
+    std::shared_ptr< gct::image_t > upload( gct::command_buffer_recorder_t &rec, std::size_t index ) {
+      const auto &request = requests[ index ];
+      const auto &d = decoded[ index ];
+      const vk::Extent3D extent( d.width, d.height, 1u );
+      std::shared_ptr< gct::image_t > image;
+      if( request.mipmap ) image = mipmap_generator->create_image( extent, request.usage );
+      else {
+        image = allocator->create_image(
+          gct::image_create_info_t()
+            .set_basic(
+              vk::ImageCreateInfo()
+                .setFlags( vk::ImageCreateFlagBits::eMutableFormat )
+                .setImageType( vk::ImageType::e2D )
+                .setFormat( vk::Format::eR8G8B8A8Unorm )
+                .setExtent( extent )
+                .setMipLevels( 1 )
+                .setArrayLayers( 1 )
+                .setSamples( vk::SampleCountFlagBits::e1 )
+                .setTiling( vk::ImageTiling::eOptimal )
+                .setUsage( request.usage|vk::ImageUsageFlagBits::eTransferDst )
+                .setInitialLayout( vk::ImageLayout::eUndefined )
+            ),
+            VMA_MEMORY_USAGE_GPU_ONLY
+        );
+      }
+      const auto layout = request.mipmap ? vk::ImageLayout::eGeneral : vk::ImageLayout::eTransferDstOptimal;
+      rec.convert_image( image, layout );
+      rec->copyBufferToImage(
+        **d.staging,
+        **image,
+        layout,
+        vk::BufferImageCopy()
+          .setBufferOffset( 0 )
+          .setBufferRowLength( 0 )
+          .setBufferImageHeight( 0 )
+          .setImageSubresource( vk::ImageSubresourceLayers( vk::ImageAspectFlagBits::eColor, 0, 0, 1 ) )
+          .setImageOffset( { 0, 0, 0 } )
+          .setImageExtent( extent )
+      );
+      rec->pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eVertexShader|vk::PipelineStageFlagBits::eFragmentShader|vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlagBits( 0 ),
+        { vk::MemoryBarrier().setSrcAccessMask( vk::AccessFlagBits::eTransferWrite ).setDstAccessMask( vk::AccessFlagBits::eShaderRead ) },
+        {},
+        {}
+      );
+      if( request.mipmap ) mipmap_generator->generate( rec, image, request.filter );
+      else rec.convert_image( image, vk::ImageLayout::eShaderReadOnlyOptimal );
+      return image;
+    }
+    std::shared_ptr< gct::device_t > device;
+    std::shared_ptr< gct::queue_t > queue;
+    std::shared_ptr< gct::allocator_t > allocator;
+    mipmap_generator_t *mipmap_generator = nullptr;
+    std::vector< request_t > requests;
+    std::vector< decoded_t > decoded;
+    std::mutex guard;
+    std::condition_variable cv;
+    std::deque< std::size_t > ready;
+    bool failed = false;
+    double wall_ns = 0.0;
+    std::uint32_t used_threads = 0u;
+  };
+}
+
+#endif
+
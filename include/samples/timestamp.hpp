@@ -0,0 +1,87 @@
+#ifndef SAMPLES_TIMESTAMP_HPP
+#define SAMPLES_TIMESTAMP_HPP
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include <gct/device.hpp>
+#include <gct/command_buffer_recorder.hpp>
+
+namespace samples {
+  // タイムスタンプクエリを使ってGPU上でコマンドが実行された時刻を記録する
+  class timestamp_t {
+  public:
+    timestamp_t(
+      const std::shared_ptr< gct::device_t > &device_,
+      const vk::PhysicalDevice &physical_device,
+      std::uint32_t queue_family_index,
+      std::uint32_t count_
+    ) : device( device_ ), count( count_ ) {
+      // 1カウントが何ナノ秒か
+      period = physical_device.getProperties().limits.timestampPeriod;
+      // キューファミリーによってはタイムスタンプが使えない
+      const auto families = physical_device.getQueueFamilyProperties();
+      if( queue_family_index < families.size() )
+        valid_bits = families[ queue_family_index ].timestampValidBits;
+      if( valid_bits && count ) {
+        query_pool = (*device)->createQueryPoolUnique(
+          vk::QueryPoolCreateInfo()
+            .setQueryType( vk::QueryType::eTimestamp )
+            .setQueryCount( count )
+        );
+      }
+    }
+    bool is_available() const {
+      return bool( query_pool );
+    }
+    std::uint32_t size() const {
+      return count;
+    }
+    // 記録を始める前にクエリをリセットする
+    void reset( gct::command_buffer_recorder_t &rec ) const {
+      if( query_pool ) rec->resetQueryPool( *query_pool, 0u, count );
+    }
+    // 指定したステージまでの実行が完了した時刻をindex番目のクエリに書く
+    void write(
+      gct::command_buffer_recorder_t &rec,
+      std::uint32_t index,
+      vk::PipelineStageFlagBits stage = vk::PipelineStageFlagBits::eBottomOfPipe
+    ) const {
+      if( query_pool ) rec->writeTimestamp( stage, *query_pool, index );
+    }
+    // 0番目からn-1番目までのクエリについて0番目のクエリからの経過時間をナノ秒で返す
+    // 書かれていないクエリを含めると結果が揃うまで永遠に待つ事になる
+    std::vector< double > get( std::uint32_t n ) const {
+      std::vector< double > elapsed;
+      if( !query_pool || n == 0u ) return elapsed;
+      n = std::min( n, count );
+      const auto result = (*device)->getQueryPoolResults< std::uint64_t >(
+        *query_pool,
+        0u, n,
+        n * sizeof( std::uint64_t ),
+        sizeof( std::uint64_t ),
+        vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait
+      );
+      if( result.result != vk::Result::eSuccess )
+        vk::throwResultException( result.result, "getQueryPoolResults failed" );
+      // 有効なビット数が64未満の場合は上位ビットを捨てて差を取る
+      const std::uint64_t mask = valid_bits >= 64u ?
+        ~std::uint64_t( 0u ) :
+        ( std::uint64_t( 1u ) << valid_bits ) - 1u;
+      elapsed.reserve( n );
+      for( const auto &v: result.value )
+        elapsed.push_back( double( ( v - result.value[ 0 ] ) & mask ) * period );
+      return elapsed;
+    }
+  private:
+    std::shared_ptr< gct::device_t > device;
+    std::uint32_t count = 0u;
+    std::uint32_t valid_bits = 0u;
+    float period = 1.f;
+    vk::UniqueQueryPool query_pool;
+  };
+}
+
+#endif
+
@@ -0,0 +1,178 @@
+#ifndef SAMPLES_WORKGROUP_SIZE_HPP
+#define SAMPLES_WORKGROUP_SIZE_HPP
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <limits>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+#include <vulkan/vulkan.hpp>
+#include <nlohmann/json.hpp>
+
+namespace samples {
+  // ローカルワークグループの大きさ
+  // シェーダのlocal_size_x_id, local_size_y_idに特殊化定数として渡す
+  struct workgroup_size_t {
+    std::uint32_t x = 1u;
+    std::uint32_t y = 1u;
+  };
+  inline void to_json( nlohmann::json &dest, const workgroup_size_t &src ) {
+    dest = nlohmann::json::array( { src.x, src.y } );
+  }
+  inline void from_json( const nlohmann::json &src, workgroup_size_t &dest ) {
+    dest.x = src.at( 0 ).get< std::uint32_t >();
+    dest.y = src.at( 1 ).get< std::uint32_t >();
+  }
+
+  // デバイスのUUIDを16進数の文字列にする
+  inline std::string get_device_uuid( const vk::PhysicalDevice &physical_device ) {
+    const auto props = physical_device.getProperties2<
+      vk::PhysicalDeviceProperties2,
+      vk::PhysicalDeviceIDProperties
+    >();
+    const auto &uuid = props.get< vk::PhysicalDeviceIDProperties >().deviceUUID;
+    std::stringstream serialized;
+    serialized << std::hex << std::setfill( '0' );
+    for( const auto v: uuid ) serialized << std::setw( 2 ) << unsigned( v );
+    return serialized.str();
+  }
+
+  // デバイスの制限の範囲内で使えるワークグループの大きさを列挙する
+  // 各辺は2の冪で、全体のインボケーションの数がmin_invocationsからmax_invocationsの間に収まるものを選ぶ
+  // 2次元の大きさが要らない場合はmax_yを1にする
+  inline std::vector< workgroup_size_t > get_workgroup_size_candidates(
+    const vk::PhysicalDeviceLimits &limits,
+    std::uint32_t min_invocations,
+    std::uint32_t max_invocations = std::numeric_limits< std::uint32_t >::max(),
+    std::uint32_t max_y = std::numeric_limits< std::uint32_t >::max()
+  ) {
+    max_invocations = std::min( max_invocations, limits.maxComputeWorkGroupInvocations );
+    max_y = std::min( max_y, limits.maxComputeWorkGroupSize[ 1 ] );
+    std::vector< workgroup_size_t > candidates;
+    for( std::uint32_t y = 1u; y <= max_y; y *= 2u ) {
+      for( std::uint32_t x = 1u; x <= limits.maxComputeWorkGroupSize[ 0 ]; x *= 2u ) {
+        const std::uint64_t invocations = std::uint64_t( x ) * y;
+        if( invocations > max_invocations ) break;
+        if( invocations >= min_invocations )
+          candidates.push_back( workgroup_size_t{ x, y } );
+      }
+    }
+    return candidates;
+  }
+
+  // デバイス毎、カーネル毎に最も速かったワークグループの大きさを記録したファイル
+  //
+  // {
+  //   "デバイスのUUID": {
+  //     "device_name": "V3D 4.2",
+  //     "driver_version": 12345,
+  //     "kernels": {
+  //       "カーネルと問題の大きさを表す名前": { "size": [ 64, 4 ], "ns": 123.4 }
+  //     }
+  //   }
+  // }
+  class workgroup_size_table_t {
+  public:
+    workgroup_size_table_t(
+      const std::filesystem::path &filename_,
+      const vk::PhysicalDevice &physical_device
+    ) : filename( filename_ ) {
+      const auto props = physical_device.getProperties();
+      device_uuid = samples::get_device_uuid( physical_device );
+      device_name = props.deviceName.data();
+      driver_version = props.driverVersion;
+      if( std::filesystem::exists( filename ) ) {
+        std::ifstream file( filename.string() );
+        // 壊れたファイルは無かったことにして作り直す
+        table = nlohmann::json::parse( file, nullptr, false );
+        if( !table.is_object() ) table = nlohmann::json::object();
+      }
+      // ドライバが更新された場合は以前の結果を使わない
+      if(
+        !table.contains( device_uuid ) ||
+        table[ device_uuid ].value( "driver_version", 0u ) != driver_version
+      ) {
+        table[ device_uuid ] = nlohmann::json::object();
+        table[ device_uuid ][ "device_name" ] = device_name;
+        table[ device_uuid ][ "driver_version" ] = driver_version;
+        table[ device_uuid ][ "kernels" ] = nlohmann::json::object();
+      }
+    }
+    std::optional< workgroup_size_t > get( const std::string &kernel ) const {
+      const auto &kernels = table[ device_uuid ][ "kernels" ];
+      const auto found = kernels.find( kernel );
+      if( found == kernels.end() ) return std::nullopt;
+      return found->at( "size" ).get< workgroup_size_t >();
+    }
+    void set( const std::string &kernel, const workgroup_size_t &size, double ns ) {
+      auto &entry = table[ device_uuid ][ "kernels" ][ kernel ];
+      entry[ "size" ] = size;
+      entry[ "ns" ] = ns;
+    }
+    // 他のプロセスが読みかけのファイルを壊さないように一時ファイルに書いてから置き換える
+    void save() const {
+      auto temporary = filename;
+      temporary += ".tmp." + std::to_string( getpid() );
+      {
+        std::ofstream file( temporary.string(), std::ios::out | std::ios::trunc );
+        file << table.dump( 2 ) << std::endl;
+        if( !file ) throw std::runtime_error( "unable to write " + temporary.string() );
+      }
+      std::filesystem::rename( temporary, filename );
+    }
+    const std::string &get_device_uuid() const {
+      return device_uuid;
+    }
+  private:
+    std::filesystem::path filename;
+    std::string device_uuid;
+    std::string device_name;
+    std::uint32_t driver_version = 0u;
+    nlohmann::json table = nlohmann::json::object();
+  };
+
+  // 候補を全て試して最も速かった大きさを返す
+  // measureは与えられた大きさでカーネルを実行し、かかった時間をナノ秒で返す
+  // 実行できない大きさの場合は負の値を返す
+  // 全ての候補が実行できなかった場合はstd::nulloptを返す
+  inline std::optional< std::pair< workgroup_size_t, double > > find_fastest_workgroup_size(
+    const std::vector< workgroup_size_t > &candidates,
+    const std::function< double( const workgroup_size_t& ) > &measure
+  ) {
+    if( candidates.empty() ) throw std::runtime_error( "no workgroup size candidates" );
+    std::optional< std::pair< workgroup_size_t, double > > fastest;
+    for( const auto &c: candidates ) {
+      const double ns = measure( c );
+      if( ns >= 0.0 && ( !fastest || ns < fastest->second ) ) fastest = std::make_pair( c, ns );
+    }
+    return fastest;
+  }
+
+  // 表に結果があればそれを使い、無ければ候補を全て試して結果を表に保存する
+  // 全ての候補が実行できなかった場合は、測っていない大きさを表に残さずにdefault_sizeを返す
+  inline workgroup_size_t get_tuned_workgroup_size(
+    workgroup_size_table_t &table,
+    const std::string &kernel,
+    const std::vector< workgroup_size_t > &candidates,
+    const std::function< double( const workgroup_size_t& ) > &measure,
+    const workgroup_size_t &default_size
+  ) {
+    if( const auto cached = table.get( kernel ) ) return *cached;
+    const auto fastest = find_fastest_workgroup_size( candidates, measure );
+    if( !fastest ) return default_size;
+    table.set( kernel, fastest->first, fastest->second );
+    table.save();
+    return fastest->first;
+  }
+}
+
+#endif
+
@@ -11,6 +11,7 @@
 #include <gct/compute_pipeline_create_info.hpp>
 #include <gct/pipeline_cache.hpp>
 #include <gct/compute_pipeline.hpp>
+#include <samples/pipeline_cache_store.hpp>
 
 struct spec_t {
   std::uint32_t local_x_size = 0u;
@@ -67,7 +68,8 @@ int main( int argc, const char *argv[] ) {
   );
 
   // パイプラインキャッシュを作る
-  const auto pipeline_cache = device->get_pipeline_cache();
+  // 前回までに作ったパイプラインをファイルから読み戻し、終了時に保存する
+  const samples::persistent_pipeline_cache_t pipeline_cache( device, CMAKE_CURRENT_BINARY_DIR "/pipeline_cache" );
 
   // パイプラインを作る
   const auto pipeline = pipeline_cache->get_pipeline(
@@ -0,0 +1,373 @@
+#include <iostream>
+#include <chrono>
+#include <map>
+#include <optional>
+#include <boost/program_options.hpp>
+#include <nlohmann/json.hpp>
+#include <gct/get_extensions.hpp>
+#include <gct/instance.hpp>
+#include <gct/queue.hpp>
+#include <gct/device.hpp>
+#include <gct/allocator.hpp>
+#include <gct/device_create_info.hpp>
+#include <gct/descriptor_pool.hpp>
+#include <gct/descriptor_set_layout.hpp>
+#include <gct/pipeline_cache.hpp>
+#include <gct/pipeline_layout_create_info.hpp>
+#include <gct/submit_info.hpp>
+#include <gct/shader_module_create_info.hpp>
+#include <gct/shader_module.hpp>
+#include <gct/compute_pipeline_create_info.hpp>
+#include <gct/compute_pipeline.hpp>
+#include <gct/write_descriptor_set.hpp>
+#include <gct/command_buffer.hpp>
+#include <gct/command_pool.hpp>
+#include <samples/timestamp.hpp>
+#include <samples/statistics.hpp>
+#include <samples/workgroup_size.hpp>
+#include <samples/pipeline_cache_store.hpp>
+
+struct spec_t {
+  std::uint32_t local_x_size = 0u;
+  std::uint32_t local_y_size = 0u;
+};
+
+bool is_power_of_2( std::uint64_t v ) {
+  return v && !( v & ( v - 1u ) );
+}
+
+// 1回分の計測結果
+struct measurement_t {
+  // 1回のDispatch毎にかかった時間
+  std::vector< double > dispatch_ns;
+  // ウォームアップを含めて送信から完了までにかかった時間
+  double host_ns = 0.0;
+};
+
+int main( int argc, const char *argv[] ) {
+  namespace po = boost::program_options;
+  po::options_description desc( "Options" );
+  desc.add_options()
+    ( "help,h", "show this message" )
+    ( "min-size", po::value< std::uint64_t >()->default_value( 4u * 1024u ), "smallest buffer size in bytes" )
+    ( "max-size", po::value< std::uint64_t >()->default_value( 256u * 1024u * 1024u ), "largest buffer size in bytes" )
+    ( "step", po::value< std::uint32_t >()->default_value( 4u ), "buffer size multiplier between runs" )
+    ( "warmup", po::value< std::uint32_t >()->default_value( 5u ), "untimed dispatches before measurement" )
+    ( "iterations,n", po::value< std::uint32_t >()->default_value( 50u ), "timed dispatches per buffer size" )
+    ( "local-size", po::value< std::uint32_t >()->default_value( 256u ), "local_size_x used when the tuning table has no entry" )
+    ( "tune", "try every legal workgroup size for buffer sizes missing from the tuning table" )
+    ( "tuning-iterations", po::value< std::uint32_t >()->default_value( 10u ), "timed dispatches per workgroup size while tuning" )
+    ( "tuning-table", po::value< std::string >()->default_value( CMAKE_CURRENT_BINARY_DIR "/workgroup_size.json" ), "file to store the fastest workgroup sizes" );
+  po::variables_map vm;
+  po::store( po::parse_command_line( argc, argv, desc ), vm );
+  po::notify( vm );
+  if( vm.count( "help" ) ) {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+  const auto min_size = vm[ "min-size" ].as< std::uint64_t >();
+  const auto max_size = vm[ "max-size" ].as< std::uint64_t >();
+  const auto step = vm[ "step" ].as< std::uint32_t >();
+  const auto warmup = vm[ "warmup" ].as< std::uint32_t >();
+  const auto iterations = vm[ "iterations" ].as< std::uint32_t >();
+  const auto local_size = vm[ "local-size" ].as< std::uint32_t >();
+  const bool tune = vm.count( "tune" );
+  const auto tuning_iterations = vm[ "tuning-iterations" ].as< std::uint32_t >();
+  // ディスパッチの数を2の冪で分割できるようにサイズは全て2の冪にする
+  if( !is_power_of_2( min_size ) || !is_power_of_2( local_size ) || !is_power_of_2( step ) || step < 2u || iterations == 0u || tuning_iterations == 0u ) {
+    std::cerr << "min-size, local-size and step must be powers of 2, step must be at least 2 and iterations must not be 0" << std::endl;
+    return 1;
+  }
+  if( min_size < local_size * sizeof( float ) ) {
+    std::cerr << "min-size must be at least local-size * " << sizeof( float ) << std::endl;
+    return 1;
+  }
+
+  // 計測結果に影響するのでバリデーションレイヤーは使わない
+  // lavapipeのようなウィンドウシステムの無い環境でも動くようにサーフェスも使わない
+  const std::shared_ptr< gct::instance_t > instance(
+    new gct::instance_t(
+      gct::instance_create_info_t()
+        .set_application_info(
+          vk::ApplicationInfo()
+            .setPApplicationName( argc ? argv[ 0 ] : "my_application" )
+            .setApplicationVersion(  VK_MAKE_VERSION( 1, 0, 0 ) )
+            .setApiVersion( VK_API_VERSION_1_2 )
+        )
+    )
+  );
+  auto groups = instance->get_physical_devices( {} );
+  auto selected = groups[ 0 ].with_extensions( {} );
+  const auto physical_device = **selected.devices[ 0 ];
+  const auto physical_device_props = physical_device.getProperties();
+  const auto &limits = physical_device_props.limits;
+  if( local_size > limits.maxComputeWorkGroupSize[ 0 ] || local_size > limits.maxComputeWorkGroupInvocations ) {
+    std::cerr << "local-size exceeds the limit of the device" << std::endl;
+    return 1;
+  }
+
+  const auto device = selected.create_device(
+    std::vector< gct::queue_requirement_t >{
+      gct::queue_requirement_t{
+        vk::QueueFlagBits::eCompute,
+        0u,
+        vk::Extent3D(),
+#ifdef VK_EXT_GLOBAL_PRIORITY_EXTENSION_NAME
+        vk::QueueGlobalPriorityEXT(),
+#endif
+        {},
+        vk::CommandPoolCreateFlagBits::eResetCommandBuffer
+      }
+    },
+    gct::device_create_info_t()
+  );
+  const auto queue = device->get_queue( 0u );
+  const auto shader = device->get_shader_module(
+    CMAKE_CURRENT_BINARY_DIR "/shader.comp.spv"
+  );
+  const auto descriptor_set_layout = device->get_descriptor_set_layout(
+    gct::descriptor_set_layout_create_info_t()
+      .add_binding( shader->get_props().get_reflection() )
+      .rebuild_chain()
+  );
+  const auto pipeline_layout = device->get_pipeline_layout(
+    gct::pipeline_layout_create_info_t()
+      .add_descriptor_set_layout( descriptor_set_layout )
+  );
+  const auto descriptor_pool = device->get_descriptor_pool(
+    gct::descriptor_pool_create_info_t()
+      .set_basic(
+        vk::DescriptorPoolCreateInfo()
+          .setFlags( vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet )
+          .setMaxSets( 1 )
+      )
+      .set_descriptor_pool_size( vk::DescriptorType::eStorageBuffer, 1 )
+      .rebuild_chain()
+  );
+  const auto descriptor_set = descriptor_pool->allocate( descriptor_set_layout );
+  // 前回までに作ったパイプラインをファイルから読み戻し、終了時に保存する
+  const samples::persistent_pipeline_cache_t pipeline_cache( device, CMAKE_CURRENT_BINARY_DIR "/pipeline_cache" );
+
+  // ワークグループの大きさ毎にパイプラインを作る
+  std::map< std::pair< std::uint32_t, std::uint32_t >, std::shared_ptr< gct::compute_pipeline_t > > pipelines;
+  const auto get_pipeline = [&]( const samples::workgroup_size_t &size ) -> std::shared_ptr< gct::compute_pipeline_t > {
+    const auto key = std::make_pair( size.x, size.y );
+    auto existing = pipelines.find( key );
+    if( existing != pipelines.end() ) return existing->second;
+    const auto pipeline = pipeline_cache->get_pipeline(
+      gct::compute_pipeline_create_info_t()
+        .set_stage(
+          gct::pipeline_shader_stage_create_info_t()
+            .set_shader_module( shader )
+            .set_specialization_info(
+              gct::specialization_info_t< spec_t >()
+                .set_data(
+                  spec_t{ size.x, size.y }
+                )
+                .add_map< std::uint32_t >( 1, offsetof( spec_t, local_x_size ) )
+                .add_map< std::uint32_t >( 2, offsetof( spec_t, local_y_size ) )
+            )
+        )
+        .set_layout( pipeline_layout )
+    );
+    pipelines.insert( std::make_pair( key, pipeline ) );
+    return pipeline;
+  };
+  const auto allocator = device->get_allocator();
+
+  // 計測区間の前後を含めて iterations + 1 個の時刻を記録する
+  const samples::timestamp_t timestamp(
+    device,
+    physical_device,
+    queue->get_available_queue_family_index(),
+    std::max( iterations, tuning_iterations ) + 1u
+  );
+
+  // Xの方向に並べられるワークグループの数は2の冪で上限以下の最大の値にする
+  std::uint32_t max_group_count_x = 1u;
+  while( max_group_count_x * 2u <= limits.maxComputeWorkGroupCount[ 0 ] ) max_group_count_x *= 2u;
+
+  // element_count個の要素をsizeの大きさのワークグループで処理する時のワークグループの数
+  // 上限を超える場合は空を返す
+  const auto get_group_count = [&]( std::uint64_t element_count, const samples::workgroup_size_t &size ) -> std::optional< std::pair< std::uint32_t, std::uint32_t > > {
+    const std::uint64_t invocations = std::uint64_t( size.x ) * size.y;
+    if( invocations > element_count ) return std::nullopt;
+    const std::uint64_t group_count = element_count / invocations;
+    const std::uint32_t group_count_x = std::min( group_count, std::uint64_t( max_group_count_x ) );
+    const std::uint64_t group_count_y = group_count / group_count_x;
+    if( group_count_y > limits.maxComputeWorkGroupCount[ 1 ] ) return std::nullopt;
+    return std::make_pair( group_count_x, std::uint32_t( group_count_y ) );
+  };
+
+  const auto command_buffer = queue->get_command_pool()->allocate();
+
+  // bufferの全ての要素に対してシェーダを warmup + count 回実行する
+  const auto run = [&](
+    const std::shared_ptr< gct::buffer_t > &buffer,
+    const std::pair< std::uint32_t, std::uint32_t > &group_count,
+    const samples::workgroup_size_t &size,
+    std::uint32_t count
+  ) {
+    {
+      auto rec = command_buffer->begin();
+      timestamp.reset( rec );
+      // 未初期化の値を読まないようにバッファを0で埋める
+      rec->fillBuffer( **buffer, 0u, VK_WHOLE_SIZE, 0u );
+      rec.barrier(
+        vk::AccessFlagBits::eTransferWrite,
+        vk::AccessFlagBits::eShaderRead|vk::AccessFlagBits::eShaderWrite,
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlagBits( 0 ),
+        { buffer },
+        {}
+      );
+      rec.bind_descriptor_set(
+        vk::PipelineBindPoint::eCompute,
+        pipeline_layout,
+        descriptor_set
+      );
+      rec.bind_pipeline( get_pipeline( size ) );
+      for( std::uint32_t i = 0u; i != warmup + count; ++i ) {
+        // ウォームアップが終わった時点を計測の起点にする
+        if( i == warmup ) timestamp.write( rec, 0u );
+        rec->dispatch( group_count.first, group_count.second, 1 );
+        // 前のDispatchの書き込みが終わるまで次のDispatchを始めない
+        rec.barrier(
+          vk::AccessFlagBits::eShaderWrite,
+          vk::AccessFlagBits::eShaderRead|vk::AccessFlagBits::eShaderWrite,
+          vk::PipelineStageFlagBits::eComputeShader,
+          vk::PipelineStageFlagBits::eComputeShader,
+          vk::DependencyFlagBits( 0 ),
+          { buffer },
+          {}
+        );
+        if( i >= warmup ) timestamp.write( rec, i - warmup + 1u );
+      }
+    }
+    const auto begin_time = std::chrono::high_resolution_clock::now();
+    command_buffer->execute(
+      gct::submit_info_t()
+    );
+    command_buffer->wait_for_executed();
+    const auto end_time = std::chrono::high_resolution_clock::now();
+    measurement_t result;
+    result.host_ns = double( std::chrono::duration_cast< std::chrono::nanoseconds >( end_time - begin_time ).count() );
+    if( timestamp.is_available() ) {
+      result.dispatch_ns = samples::get_intervals( timestamp.get( count + 1u ) );
+    }
+    return result;
+  };
+  // 1回のDispatchにかかった時間の平均
+  // タイムスタンプが使えない場合はホスト側の時間から求める
+  const auto get_mean_ns = [&]( const measurement_t &m, std::uint32_t count ) {
+    if( !m.dispatch_ns.empty() ) return samples::get_statistics( m.dispatch_ns ).mean;
+    return m.host_ns / ( warmup + count );
+  };
+
+  samples::workgroup_size_table_t tuning_table(
+    vm[ "tuning-table" ].as< std::string >(),
+    physical_device
+  );
+  const auto candidates = samples::get_workgroup_size_candidates(
+    limits,
+    1u
+  );
+
+  nlohmann::json results = nlohmann::json::array();
+  for( std::uint64_t buffer_size = min_size; buffer_size <= max_size; buffer_size *= step ) {
+    nlohmann::json result;
+    result[ "size" ] = buffer_size;
+    // デスクリプタから見えるバッファの大きさには上限がある
+    if( buffer_size > limits.maxStorageBufferRange ) {
+      result[ "skipped" ] = "exceeds maxStorageBufferRange";
+      results.push_back( result );
+      continue;
+    }
+    const std::uint64_t element_count = buffer_size / sizeof( float );
+    const auto buffer = allocator->create_buffer(
+      gct::buffer_create_info_t()
+        .set_basic(
+          vk::BufferCreateInfo()
+            .setSize( buffer_size )
+            .setUsage(
+              vk::BufferUsageFlagBits::eStorageBuffer |
+              vk::BufferUsageFlagBits::eTransferDst
+            )
+        ),
+      VMA_MEMORY_USAGE_GPU_ONLY
+    );
+    descriptor_set->update(
+      {
+        gct::write_descriptor_set_t()
+          .set_basic( (*descriptor_set)[ "layout1" ] )
+          .add_buffer(
+            gct::descriptor_buffer_info_t()
+              .set_buffer( buffer )
+              .set_basic(
+                vk::DescriptorBufferInfo()
+                  .setOffset( 0 )
+                  .setRange( buffer_size )
+              )
+          )
+      }
+    );
+
+    // 問題の大きさ毎に最適なワークグループの大きさは変わる
+    const std::string kernel = "10_dispatch/shader.comp:" + std::to_string( element_count );
+    samples::workgroup_size_t size{ local_size, 1u };
+    if( const auto tuned = tuning_table.get( kernel ) ) {
+      size = *tuned;
+      result[ "tuned" ] = true;
+    }
+    else if( tune ) {
+      size = samples::get_tuned_workgroup_size(
+        tuning_table,
+        kernel,
+        candidates,
+        [&]( const samples::workgroup_size_t &c ) -> double {
+          const auto group_count = get_group_count( element_count, c );
+          if( !group_count ) return -1.0;
+          return get_mean_ns( run( buffer, *group_count, c, tuning_iterations ), tuning_iterations );
+        },
+        size
+      );
+      // 全ての候補が実行できなかった場合は表に残らない
+      result[ "tuned" ] = tuning_table.get( kernel ).has_value();
+    }
+    else result[ "tuned" ] = false;
+    const auto group_count = get_group_count( element_count, size );
+    if( !group_count ) {
+      result[ "skipped" ] = "exceeds maxComputeWorkGroupCount";
+      results.push_back( result );
+      continue;
+    }
+
+    const auto measured = run( buffer, *group_count, size, iterations );
+    // 1回のDispatchで全ての要素を1回読んで1回書く
+    const double bytes_per_dispatch = double( buffer_size ) * 2.0;
+    const double mean = get_mean_ns( measured, iterations );
+    result[ "elements" ] = element_count;
+    result[ "local_size" ] = size;
+    result[ "group_count" ] = { group_count->first, group_count->second, 1u };
+    result[ "warmup" ] = warmup;
+    result[ "iterations" ] = iterations;
+    // ホスト側で計った時間には送信とウォームアップと待ち合わせが含まれる
+    result[ "host_ns" ] = measured.host_ns;
+    if( !measured.dispatch_ns.empty() )
+      result[ "dispatch_ns" ] = samples::get_statistics( measured.dispatch_ns );
+    else
+      result[ "dispatch_ns" ] = nullptr;
+    result[ "gb_per_sec" ] = bytes_per_dispatch / mean;
+    result[ "dispatches_per_sec" ] = 1.0e9 / mean;
+    results.push_back( result );
+  }
+
+  nlohmann::json root;
+  root[ "device" ] = std::string( physical_device_props.deviceName.data() );
+  root[ "device_uuid" ] = tuning_table.get_device_uuid();
+  root[ "timestamp" ] = timestamp.is_available();
+  root[ "results" ] = results;
+  std::cout << root.dump( 2 ) << std::endl;
+}
+
@@ -22,6 +22,7 @@
 #include <gct/write_descriptor_set.hpp>
 #include <gct/command_buffer.hpp>
 #include <gct/command_pool.hpp>
+#include <samples/pipeline_cache_store.hpp>
 
 struct spec_t {
   std::uint32_t local_x_size = 0u;
@@ -96,7 +97,8 @@ int main( int argc, const char *argv[] ) {
       .rebuild_chain()
   );
   const auto descriptor_set = descriptor_pool->allocate( descriptor_set_layout );
-  const auto pipeline_cache = device->get_pipeline_cache();
+  // 前回までに作ったパイプラインをファイルから読み戻し、終了時に保存する
+  const samples::persistent_pipeline_cache_t pipeline_cache( device, CMAKE_CURRENT_BINARY_DIR "/pipeline_cache" );
   const auto pipeline = pipeline_cache->get_pipeline(
     gct::compute_pipeline_create_info_t()
       .set_stage(
@@ -0,0 +1,395 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <boost/program_options.hpp>
+#include <nlohmann/json.hpp>
+#include <gct/get_extensions.hpp>
+#include <gct/instance.hpp>
+#include <gct/queue.hpp>
+#include <gct/device.hpp>
+#include <gct/allocator.hpp>
+#include <gct/device_create_info.hpp>
+#include <gct/descriptor_pool.hpp>
+#include <gct/descriptor_set_layout.hpp>
+#include <gct/pipeline_cache.hpp>
+#include <gct/pipeline_layout_create_info.hpp>
+#include <gct/pipeline_layout.hpp>
+#include <gct/submit_info.hpp>
+#include <gct/shader_module_create_info.hpp>
+#include <gct/shader_module.hpp>
+#include <gct/compute_pipeline_create_info.hpp>
+#include <gct/compute_pipeline.hpp>
+#include <gct/write_descriptor_set.hpp>
+#include <gct/command_buffer.hpp>
+#include <gct/command_pool.hpp>
+#include <samples/statistics.hpp>
+#include <samples/pipeline_cache_store.hpp>
+
+struct spec_t {
+  std::uint32_t local_x_size = 0u;
+  std::uint32_t process_local_size = 0u;
+};
+
+struct push_constant_t {
+  std::uint32_t count = 0u;
+  float threshold = 0.f;
+  float value = 0.f;
+  std::uint32_t max_group_count = 0u;
+};
+
+// 1つのシェーダを動かす為の一式
+struct stage_t {
+  std::shared_ptr< gct::pipeline_layout_t > pipeline_layout;
+  std::shared_ptr< gct::compute_pipeline_t > pipeline;
+  std::shared_ptr< gct::descriptor_set_t > descriptor_set;
+};
+
+int main( int argc, const char *argv[] ) {
+  namespace po = boost::program_options;
+  po::options_description desc( "Options" );
+  desc.add_options()
+    ( "help,h", "show this message" )
+    ( "count,c", po::value< std::uint32_t >()->default_value( 1024u * 1024u ), "number of input elements" )
+    ( "threshold,t", po::value< float >()->default_value( 0.9f ), "elements not less than this value are processed" )
+    ( "iterations,n", po::value< std::uint32_t >()->default_value( 100u ), "measured runs of each path" )
+    ( "local-size", po::value< std::uint32_t >()->default_value( 256u ), "local_size_x of the shaders" );
+  po::variables_map vm;
+  po::store( po::parse_command_line( argc, argv, desc ), vm );
+  po::notify( vm );
+  if( vm.count( "help" ) ) {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+  const auto count = vm[ "count" ].as< std::uint32_t >();
+  const auto threshold = vm[ "threshold" ].as< float >();
+  const auto iterations = vm[ "iterations" ].as< std::uint32_t >();
+  const auto local_size = vm[ "local-size" ].as< std::uint32_t >();
+  if( count == 0u || iterations == 0u || local_size == 0u ) {
+    std::cerr << "count, iterations and local-size must not be 0" << std::endl;
+    return 1;
+  }
+
+  const std::shared_ptr< gct::instance_t > instance(
+    new gct::instance_t(
+      gct::instance_create_info_t()
+        .set_application_info(
+          vk::ApplicationInfo()
+            .setPApplicationName( argc ? argv[ 0 ] : "my_application" )
+            .setApplicationVersion(  VK_MAKE_VERSION( 1, 0, 0 ) )
+            .setApiVersion( VK_API_VERSION_1_2 )
+        )
+    )
+  );
+  auto groups = instance->get_physical_devices( {} );
+  auto selected = groups[ 0 ].with_extensions( {} );
+  const auto physical_device_props = (**selected.devices[ 0 ]).getProperties();
+  const auto &limits = physical_device_props.limits;
+
+  const auto device = selected.create_device(
+    std::vector< gct::queue_requirement_t >{
+      gct::queue_requirement_t{
+        vk::QueueFlagBits::eCompute,
+        0u,
+        vk::Extent3D(),
+#ifdef VK_EXT_GLOBAL_PRIORITY_EXTENSION_NAME
+        vk::QueueGlobalPriorityEXT(),
+#endif
+        {},
+        vk::CommandPoolCreateFlagBits::eResetCommandBuffer
+      }
+    },
+    gct::device_create_info_t()
+  );
+  const auto queue = device->get_queue( 0u );
+  const auto allocator = device->get_allocator();
+
+  const std::uint64_t data_size = std::uint64_t( count ) * sizeof( float );
+  const auto create_buffer = [&]( std::uint64_t size, vk::BufferUsageFlags usage, VmaMemoryUsage memory_usage ) {
+    return allocator->create_buffer(
+      gct::buffer_create_info_t()
+        .set_basic(
+          vk::BufferCreateInfo()
+            .setSize( size )
+            .setUsage( usage )
+        ),
+      memory_usage
+    );
+  };
+  const auto input = create_buffer( data_size, vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_CPU_TO_GPU );
+  const auto filtered = create_buffer( data_size, vk::BufferUsageFlagBits::eStorageBuffer|vk::BufferUsageFlagBits::eTransferSrc, VMA_MEMORY_USAGE_GPU_ONLY );
+  const auto filtered_count = create_buffer( sizeof( std::uint32_t ), vk::BufferUsageFlagBits::eStorageBuffer|vk::BufferUsageFlagBits::eTransferSrc|vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_ONLY );
+  // dispatchIndirectが読むVkDispatchIndirectCommand
+  const auto indirect_args = create_buffer( sizeof( vk::DispatchIndirectCommand ), vk::BufferUsageFlagBits::eStorageBuffer|vk::BufferUsageFlagBits::eIndirectBuffer, VMA_MEMORY_USAGE_GPU_ONLY );
+  const auto count_readback = create_buffer( sizeof( std::uint32_t ), vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_TO_CPU );
+  const auto result_readback = create_buffer( data_size, vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_TO_CPU );
+
+  std::vector< float > host_input( count );
+  {
+    std::mt19937 rng( 1u );
+    std::uniform_real_distribution< float > dist( 0.f, 1.f );
+    std::generate( host_input.begin(), host_input.end(), [&]() { return dist( rng ); } );
+    auto mapped = input->map< float >();
+    std::copy( host_input.begin(), host_input.end(), mapped.begin() );
+  }
+
+  const auto descriptor_pool = device->get_descriptor_pool(
+    gct::descriptor_pool_create_info_t()
+      .set_basic(
+        vk::DescriptorPoolCreateInfo()
+          .setFlags( vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet )
+          .setMaxSets( 3 )
+      )
+      .set_descriptor_pool_size( vk::DescriptorType::eStorageBuffer, 7 )
+      .rebuild_chain()
+  );
+  // 前回までに作ったパイプラインをファイルから読み戻し、終了時に保存する
+  const samples::persistent_pipeline_cache_t pipeline_cache( device, CMAKE_CURRENT_BINARY_DIR "/pipeline_cache" );
+  const auto create_stage = [&](
+    const std::string &name,
+    const std::vector< std::pair< std::shared_ptr< gct::buffer_t >, std::uint64_t > > &buffers
+  ) {
+    const auto shader = device->get_shader_module(
+      std::string( CMAKE_CURRENT_BINARY_DIR "/" ) + name + ".comp.spv"
+    );
+    const auto descriptor_set_layout = device->get_descriptor_set_layout(
+      gct::descriptor_set_layout_create_info_t()
+        .add_binding( shader->get_props().get_reflection() )
+        .rebuild_chain()
+    );
+    stage_t stage;
+    stage.pipeline_layout = device->get_pipeline_layout(
+      gct::pipeline_layout_create_info_t()
+        .add_descriptor_set_layout( descriptor_set_layout )
+        .add_push_constant_range(
+          vk::PushConstantRange()
+            .setStageFlags( vk::ShaderStageFlagBits::eCompute )
+            .setOffset( 0 )
+            .setSize( sizeof( push_constant_t ) )
+        )
+    );
+    stage.pipeline = pipeline_cache->get_pipeline(
+      gct::compute_pipeline_create_info_t()
+        .set_stage(
+          gct::pipeline_shader_stage_create_info_t()
+            .set_shader_module( shader )
+            .set_specialization_info(
+              gct::specialization_info_t< spec_t >()
+                .set_data(
+                  spec_t{ local_size, local_size }
+                )
+                .add_map< std::uint32_t >( 1, offsetof( spec_t, local_x_size ) )
+                .add_map< std::uint32_t >( 3, offsetof( spec_t, process_local_size ) )
+            )
+        )
+        .set_layout( stage.pipeline_layout )
+    );
+    stage.descriptor_set = descriptor_pool->allocate( descriptor_set_layout );
+    std::vector< gct::write_descriptor_set_t > writes;
+    for( std::size_t i = 0u; i != buffers.size(); ++i ) {
+      writes.push_back(
+        gct::write_descriptor_set_t()
+          .set_basic( (*stage.descriptor_set)[ "layout" + std::to_string( i + 1u ) ] )
+          .add_buffer(
+            gct::descriptor_buffer_info_t()
+              .set_buffer( buffers[ i ].first )
+              .set_basic(
+                vk::DescriptorBufferInfo()
+                  .setOffset( 0 )
+                  .setRange( buffers[ i ].second )
+              )
+          )
+      );
+    }
+    stage.descriptor_set->update( writes );
+    return stage;
+  };
+  const auto filter = create_stage( "filter", { { input, data_size }, { filtered, data_size }, { filtered_count, sizeof( std::uint32_t ) } } );
+  const auto make_args = create_stage( "make_args", { { filtered_count, sizeof( std::uint32_t ) }, { indirect_args, sizeof( vk::DispatchIndirectCommand ) } } );
+  const auto process = create_stage( "process", { { filtered, data_size }, { filtered_count, sizeof( std::uint32_t ) } } );
+
+  push_constant_t push_constant;
+  push_constant.count = count;
+  push_constant.threshold = threshold;
+  push_constant.value = 3.f;
+  push_constant.max_group_count = limits.maxComputeWorkGroupCount[ 0 ];
+
+  const auto bind = [&]( gct::command_buffer_recorder_t &rec, const stage_t &stage ) {
+    rec.bind_descriptor_set(
+      vk::PipelineBindPoint::eCompute,
+      stage.pipeline_layout,
+      stage.descriptor_set
+    );
+    rec.bind_pipeline( stage.pipeline );
+    rec->pushConstants(
+      **stage.pipeline_layout,
+      vk::ShaderStageFlagBits::eCompute,
+      0u,
+      sizeof( push_constant_t ),
+      reinterpret_cast< void* >( &push_constant )
+    );
+  };
+  // 1次元で並べきれない数のワークグループは2次元に並べる
+  const auto get_group_count = [&]( std::uint32_t n ) {
+    const std::uint32_t group_count = ( n + local_size - 1u ) / local_size;
+    const std::uint32_t x = std::min( group_count, limits.maxComputeWorkGroupCount[ 0 ] );
+    return std::make_pair( x, x ? ( group_count + x - 1u ) / x : 0u );
+  };
+  const auto record_filter = [&]( gct::command_buffer_recorder_t &rec ) {
+    rec->fillBuffer( **filtered_count, 0, sizeof( std::uint32_t ), 0u );
+    rec.barrier(
+      vk::AccessFlagBits::eTransferWrite,
+      vk::AccessFlagBits::eShaderRead|vk::AccessFlagBits::eShaderWrite,
+      vk::PipelineStageFlagBits::eTransfer,
+      vk::PipelineStageFlagBits::eComputeShader,
+      vk::DependencyFlagBits( 0 ),
+      { filtered_count },
+      {}
+    );
+    bind( rec, filter );
+    const auto [x,y] = get_group_count( count );
+    rec->dispatch( x, y, 1 );
+    rec.barrier(
+      vk::AccessFlagBits::eShaderWrite,
+      vk::AccessFlagBits::eShaderRead|vk::AccessFlagBits::eShaderWrite,
+      vk::PipelineStageFlagBits::eComputeShader,
+      vk::PipelineStageFlagBits::eComputeShader,
+      vk::DependencyFlagBits( 0 ),
+      { filtered, filtered_count },
+      {}
+    );
+  };
+  const auto record_readback = [&]( gct::command_buffer_recorder_t &rec ) {
+    rec.barrier(
+      vk::AccessFlagBits::eShaderWrite,
+      vk::AccessFlagBits::eTransferRead,
+      vk::PipelineStageFlagBits::eComputeShader,
+      vk::PipelineStageFlagBits::eTransfer,
+      vk::DependencyFlagBits( 0 ),
+      { filtered, filtered_count },
+      {}
+    );
+    rec->copyBuffer( **filtered, **result_readback, vk::BufferCopy().setSize( data_size ) );
+    rec->copyBuffer( **filtered_count, **count_readback, vk::BufferCopy().setSize( sizeof( std::uint32_t ) ) );
+  };
+
+  // GPUだけで完結する経路
+  // filterが書いた要素数からmake_argsがワークグループの数を書き、processはそれを読んで実行される
+  const auto indirect_command_buffer = queue->get_command_pool()->allocate();
+  {
+    auto rec = indirect_command_buffer->begin();
+    record_filter( rec );
+    bind( rec, make_args );
+    rec->dispatch( 1, 1, 1 );
+    // dispatchIndirectの引数の読み込みはDrawIndirectステージで行われる
+    rec.barrier(
+      vk::AccessFlagBits::eShaderWrite,
+      vk::AccessFlagBits::eIndirectCommandRead,
+      vk::PipelineStageFlagBits::eComputeShader,
+      vk::PipelineStageFlagBits::eDrawIndirect,
+      vk::DependencyFlagBits( 0 ),
+      { indirect_args },
+      {}
+    );
+    bind( rec, process );
+    rec->dispatchIndirect( **indirect_args, 0 );
+    record_readback( rec );
+  }
+
+  // 比較の為の経路
+  // filterが書いた要素数を一度CPUに読み戻してからprocessのワークグループの数を決める
+  const auto filter_command_buffer = queue->get_command_pool()->allocate();
+  {
+    auto rec = filter_command_buffer->begin();
+    record_filter( rec );
+    rec.barrier(
+      vk::AccessFlagBits::eShaderWrite,
+      vk::AccessFlagBits::eTransferRead,
+      vk::PipelineStageFlagBits::eComputeShader,
+      vk::PipelineStageFlagBits::eTransfer,
+      vk::DependencyFlagBits( 0 ),
+      { filtered_count },
+      {}
+    );
+    rec->copyBuffer( **filtered_count, **count_readback, vk::BufferCopy().setSize( sizeof( std::uint32_t ) ) );
+  }
+  const auto process_command_buffer = queue->get_command_pool()->allocate();
+  const auto run_readback_path = [&]() {
+    filter_command_buffer->execute(
+      gct::submit_info_t()
+    );
+    filter_command_buffer->wait_for_executed();
+    std::uint32_t n = 0u;
+    {
+      auto mapped = count_readback->map< std::uint32_t >();
+      n = *mapped.begin();
+    }
+    // ワークグループの数が決まるまでコマンドを積めない
+    {
+      auto rec = process_command_buffer->begin();
+      bind( rec, process );
+      const auto [x,y] = get_group_count( n );
+      if( x ) rec->dispatch( x, y, 1 );
+      record_readback( rec );
+    }
+    process_command_buffer->execute(
+      gct::submit_info_t()
+    );
+    process_command_buffer->wait_for_executed();
+  };
+  const auto run_indirect_path = [&]() {
+    indirect_command_buffer->execute(
+      gct::submit_info_t()
+    );
+    indirect_command_buffer->wait_for_executed();
+  };
+
+  // CPUで求めた結果と比べる
+  // 要素を書く順番は実行の度に変わるので並べ替えてから比べる
+  std::vector< float > expected;
+  for( const auto &v: host_input )
+    if( v >= threshold ) expected.push_back( v * push_constant.value );
+  std::sort( expected.begin(), expected.end() );
+  const auto verify = [&]() {
+    std::uint32_t n = 0u;
+    {
+      auto mapped = count_readback->map< std::uint32_t >();
+      n = *mapped.begin();
+    }
+    if( n != expected.size() ) return false;
+    auto mapped = result_readback->map< float >();
+    std::vector< float > result( mapped.begin(), std::next( mapped.begin(), n ) );
+    std::sort( result.begin(), result.end() );
+    return result == expected;
+  };
+
+  nlohmann::json root;
+  root[ "device" ] = std::string( physical_device_props.deviceName.data() );
+  root[ "count" ] = count;
+  root[ "filtered_count" ] = expected.size();
+  root[ "iterations" ] = iterations;
+  bool correct = true;
+  for( const auto &[name,run]: std::vector< std::pair< std::string, std::function< void() > > >{
+    { "readback", run_readback_path },
+    { "indirect", run_indirect_path }
+  } ) {
+    run();
+    const bool path_correct = verify();
+    correct = correct && path_correct;
+    // 送信から結果が読めるようになるまでの時間を測る
+    std::vector< double > latency;
+    latency.reserve( iterations );
+    for( std::uint32_t i = 0u; i != iterations; ++i ) {
+      const auto begin_time = std::chrono::high_resolution_clock::now();
+      run();
+      const auto end_time = std::chrono::high_resolution_clock::now();
+      latency.push_back( double( std::chrono::duration_cast< std::chrono::nanoseconds >( end_time - begin_time ).count() ) );
+    }
+    root[ name ][ "correct" ] = path_correct;
+    root[ name ][ "latency_ns" ] = samples::get_statistics( latency );
+  }
+  std::cout << root.dump( 2 ) << std::endl;
+  return correct ? 0 : 1;
+}
+
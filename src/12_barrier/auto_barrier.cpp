@@ -0,0 +1,307 @@
+#include <iostream>
+#include <array>
+#include <nlohmann/json.hpp>
+#include <gct/get_extensions.hpp>
+#include <gct/instance.hpp>
+#include <gct/queue.hpp>
+#include <gct/device.hpp>
+#include <gct/allocator.hpp>
+#include <gct/device_create_info.hpp>
+#include <gct/image_create_info.hpp>
+#include <gct/swapchain.hpp>
+#include <gct/descriptor_pool.hpp>
+#include <gct/descriptor_set_layout.hpp>
+#include <gct/pipeline_cache.hpp>
+#include <gct/pipeline_layout_create_info.hpp>
+#include <gct/pipeline_layout.hpp>
+#include <gct/buffer_view_create_info.hpp>
+#include <gct/submit_info.hpp>
+#include <gct/shader_module_create_info.hpp>
+#include <gct/shader_module.hpp>
+#include <gct/compute_pipeline_create_info.hpp>
+#include <gct/compute_pipeline.hpp>
+#include <gct/write_descriptor_set.hpp>
+#include <gct/command_buffer.hpp>
+#include <gct/command_pool.hpp>
+#include <samples/barrier_tracker.hpp>
+#include <samples/pipeline_cache_store.hpp>
+
+struct spec_t {
+  std::uint32_t local_x_size = 0u;
+  std::uint32_t local_y_size = 0u;
+};
+
+struct push_constant_t {
+  float value;
+};
+
+int main( int argc, const char *argv[] ) {
+  const std::shared_ptr< gct::instance_t > instance(
+    new gct::instance_t(
+      gct::instance_create_info_t()
+        .set_application_info(
+          vk::ApplicationInfo()
+            .setPApplicationName( argc ? argv[ 0 ] : "my_application" )
+            .setApplicationVersion(  VK_MAKE_VERSION( 1, 0, 0 ) )
+            .setApiVersion( VK_API_VERSION_1_2 )
+        )
+        .add_layer(
+          "VK_LAYER_KHRONOS_validation"
+        )
+    )
+  );
+  auto groups = instance->get_physical_devices( {} );
+  auto selected = groups[ 0 ].with_extensions( {} );
+ 
+  const auto device = selected.create_device(
+    std::vector< gct::queue_requirement_t >{
+      gct::queue_requirement_t{
+        vk::QueueFlagBits::eCompute,
+        0u,
+        vk::Extent3D(),
+#ifdef VK_EXT_GLOBAL_PRIORITY_EXTENSION_NAME
+        vk::QueueGlobalPriorityEXT(),
+#endif
+        {},
+        vk::CommandPoolCreateFlagBits::eResetCommandBuffer
+      }
+    },
+    gct::device_create_info_t()
+  );
+  const auto queue = device->get_queue( 0u );
+  const auto shader = device->get_shader_module(
+    CMAKE_CURRENT_BINARY_DIR "/shader.comp.spv"
+  );
+  const auto descriptor_set_layout = device->get_descriptor_set_layout(
+    gct::descriptor_set_layout_create_info_t()
+      .add_binding( shader->get_props().get_reflection() )
+      .rebuild_chain()
+  );
+  const auto pipeline_layout = device->get_pipeline_layout(
+    gct::pipeline_layout_create_info_t()
+      .add_descriptor_set_layout( descriptor_set_layout )
+      .add_push_constant_range(
+        vk::PushConstantRange()
+          .setStageFlags( vk::ShaderStageFlagBits::eCompute )
+          .setOffset( 0 )
+          .setSize( sizeof( push_constant_t ) )
+      )
+  );
+
+  const auto descriptor_pool = device->get_descriptor_pool(
+    gct::descriptor_pool_create_info_t()
+      .set_basic(
+        vk::DescriptorPoolCreateInfo()
+          .setFlags( vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet )
+          .setMaxSets( 10 )
+      )
+      .set_descriptor_pool_size( vk::DescriptorType::eStorageBuffer, 5 )
+      .rebuild_chain()
+  );
+  const auto descriptor_set = descriptor_pool->allocate( descriptor_set_layout );
+  // 前回までに作ったパイプラインをファイルから読み戻し、終了時に保存する
+  const samples::persistent_pipeline_cache_t pipeline_cache( device, CMAKE_CURRENT_BINARY_DIR "/pipeline_cache" );
+  const auto pipeline = pipeline_cache->get_pipeline(
+    gct::compute_pipeline_create_info_t()
+      .set_stage(
+        gct::pipeline_shader_stage_create_info_t()
+          .set_shader_module( shader )
+          .set_specialization_info(
+            gct::specialization_info_t< spec_t >()
+              .set_data(
+                spec_t{ 6, 1 }
+              )
+              .add_map< std::uint32_t >( 1, offsetof( spec_t, local_x_size ) )
+              .add_map< std::uint32_t >( 2, offsetof( spec_t, local_y_size ) )
+          )
+      )
+      .set_layout( pipeline_layout )
+  );
+  const auto allocator = device->get_allocator();
+  std::uint32_t buffer_size = 12u * sizeof( float );
+  const auto buffer = allocator->create_buffer(
+    gct::buffer_create_info_t()
+      .set_basic(
+        vk::BufferCreateInfo()
+          .setSize( buffer_size )
+          .setUsage( vk::BufferUsageFlagBits::eStorageBuffer|vk::BufferUsageFlagBits::eTransferSrc )
+      ),
+    VMA_MEMORY_USAGE_CPU_TO_GPU
+  );
+  {
+    auto mapped = buffer->map< float >();
+    std::vector< float > data{ 0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f, 8.f, 9.f, 10.f, 11.f };
+    std::copy(
+      data.begin(),
+      data.end(),
+      mapped.begin()
+    );
+  }
+  descriptor_set->update(
+    {
+      gct::write_descriptor_set_t()
+        .set_basic( (*descriptor_set)[ "layout1" ] )
+        .add_buffer(
+          gct::descriptor_buffer_info_t()
+            .set_buffer( buffer )
+            .set_basic(
+              vk::DescriptorBufferInfo()
+                .setOffset( 0 )
+                .setRange( buffer_size )
+            )
+        )
+    }
+  );
+
+  // 結果を読み戻す為のバッファ
+  const auto readback = allocator->create_buffer(
+    gct::buffer_create_info_t()
+      .set_basic(
+        vk::BufferCreateInfo()
+          .setSize( buffer_size )
+          .setUsage( vk::BufferUsageFlagBits::eTransferDst )
+      ),
+    VMA_MEMORY_USAGE_GPU_TO_CPU
+  );
+  // クリアしてから2回読むイメージ
+  const auto image = allocator->create_image(
+    gct::image_create_info_t()
+      .set_basic(
+        vk::ImageCreateInfo()
+          .setImageType( vk::ImageType::e2D )
+          .setFormat( vk::Format::eR32Sfloat )
+          .setExtent( { 12, 1, 1 } )
+          .setMipLevels( 1 )
+          .setArrayLayers( 1 )
+          .setSamples( vk::SampleCountFlagBits::e1 )
+          .setTiling( vk::ImageTiling::eOptimal )
+          .setUsage(
+            vk::ImageUsageFlagBits::eTransferSrc |
+            vk::ImageUsageFlagBits::eTransferDst
+          )
+          .setInitialLayout( vk::ImageLayout::eUndefined )
+      ),
+      VMA_MEMORY_USAGE_GPU_ONLY
+  );
+  const auto image_readback = allocator->create_buffer(
+    gct::buffer_create_info_t()
+      .set_basic(
+        vk::BufferCreateInfo()
+          .setSize( buffer_size * 2u )
+          .setUsage( vk::BufferUsageFlagBits::eTransferDst )
+      ),
+    VMA_MEMORY_USAGE_GPU_TO_CPU
+  );
+
+  const auto command_buffer = queue->get_command_pool()->allocate();
+
+  push_constant_t push_constant;
+
+  // バリアを手で書く代わりに各コマンドが触る資源を申告する
+  samples::barrier_tracker_t tracker;
+  tracker.set_name( buffer, "buffer" );
+  tracker.set_name( readback, "readback" );
+  tracker.set_name( image, "image" );
+  tracker.set_name( image_readback, "image_readback" );
+
+  {
+    auto rec = command_buffer->begin();
+    
+    rec.bind_descriptor_set(
+      vk::PipelineBindPoint::eCompute,
+      pipeline_layout,
+      descriptor_set
+    );
+    
+    rec.bind_pipeline(
+      pipeline
+    );
+
+    const auto dispatch = [&]( float value, std::uint32_t group_count ) {
+      push_constant.value = value;
+      rec->pushConstants(
+        **pipeline_layout,
+        vk::ShaderStageFlagBits::eCompute,
+        0u,
+        sizeof( push_constant_t ),
+        reinterpret_cast< void* >( &push_constant )
+      );
+      // シェーダはbufferを読んで書く
+      tracker.read( buffer, vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eShaderRead );
+      tracker.write( buffer, vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eShaderWrite );
+      tracker.flush( rec );
+      rec->dispatch( group_count, 1, 1 );
+    };
+
+    // 最初のDispatchの前にはバリアは要らない
+    dispatch( 3.f, 1 );
+    // 前のDispatchの書き込みを待つバリアが入る
+    dispatch( 2.f, 2 );
+
+    // bufferと関係の無いイメージのクリアとの間にはバリアは要らない
+    // イメージのレイアウトの変更だけが入る
+    tracker.write( image, vk::ImageLayout::eTransferDstOptimal, vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferWrite );
+    tracker.flush( rec );
+    rec->clearColorImage(
+      **image,
+      vk::ImageLayout::eTransferDstOptimal,
+      vk::ClearColorValue( std::array< float, 4u >{ 1.f, 0.f, 0.f, 0.f } ),
+      vk::ImageSubresourceRange()
+        .setAspectMask( vk::ImageAspectFlagBits::eColor )
+        .setBaseMipLevel( 0 )
+        .setLevelCount( 1 )
+        .setBaseArrayLayer( 0 )
+        .setLayerCount( 1 )
+    );
+
+    // bufferの読み戻しとイメージの読み戻しの為のバリアは1つにまとめられる
+    tracker.read( buffer, vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferRead );
+    tracker.write( readback, vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferWrite );
+    tracker.read( image, vk::ImageLayout::eTransferSrcOptimal, vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferRead );
+    tracker.write( image_readback, vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferWrite );
+    tracker.flush( rec );
+    rec->copyBuffer( **buffer, **readback, vk::BufferCopy().setSize( buffer_size ) );
+    const auto region = vk::BufferImageCopy()
+      .setImageSubresource(
+        vk::ImageSubresourceLayers()
+          .setAspectMask( vk::ImageAspectFlagBits::eColor )
+          .setMipLevel( 0 )
+          .setBaseArrayLayer( 0 )
+          .setLayerCount( 1 )
+      )
+      .setImageExtent( { 12, 1, 1 } );
+    rec->copyImageToBuffer( **image, vk::ImageLayout::eTransferSrcOptimal, **image_readback, region );
+
+    // 同じレイアウトで読み直す場合はレイアウトの変更もバリアも要らない
+    // image_readbackは書く範囲が重ならないがバッファ全体を1つの資源として扱うのでバリアが入る
+    tracker.read( image, vk::ImageLayout::eTransferSrcOptimal, vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferRead );
+    tracker.write( image_readback, vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferWrite );
+    tracker.flush( rec );
+    rec->copyImageToBuffer(
+      **image,
+      vk::ImageLayout::eTransferSrcOptimal,
+      **image_readback,
+      vk::BufferImageCopy( region ).setBufferOffset( buffer_size )
+    );
+  }
+  
+  command_buffer->execute(
+    gct::submit_info_t()
+  );
+  
+  command_buffer->wait_for_executed();
+
+  nlohmann::json json;
+  {
+    auto mapped = readback->map< float >();
+    json[ "buffer" ] = std::vector< float >( mapped.begin(), mapped.end() );
+  }
+  {
+    auto mapped = image_readback->map< float >();
+    json[ "image" ] = std::vector< float >( mapped.begin(), mapped.end() );
+  }
+  // 積んだバリアの一覧
+  json[ "barriers" ] = tracker.dump();
+  std::cout << json.dump( 2 ) << std::endl;
+}
+
@@ -0,0 +1,275 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <type_traits>
+#include <boost/program_options.hpp>
+#include <nlohmann/json.hpp>
+#include <gct/get_extensions.hpp>
+#include <gct/instance.hpp>
+#include <gct/queue.hpp>
+#include <gct/device.hpp>
+#include <gct/allocator.hpp>
+#include <gct/device_create_info.hpp>
+#include <gct/submit_info.hpp>
+#include <gct/command_buffer.hpp>
+#include <gct/command_pool.hpp>
+#include <samples/scan.hpp>
+#include <samples/pipeline_cache_store.hpp>
+#include <samples/timestamp.hpp>
+#include <samples/statistics.hpp>
+
+// CPUで求めた排他的プレフィックス和とGPUで求めた結果を比べる
+// floatは足す順番で結果が変わるので誤差を許す
+template< typename T >
+bool verify( const std::vector< T > &input, const std::vector< T > &output ) {
+  if constexpr ( std::is_floating_point_v< T > ) {
+    double sum = 0.0;
+    for( std::size_t i = 0u; i != input.size(); ++i ) {
+      if( std::abs( double( output[ i ] ) - sum ) > std::max( 1.0, std::abs( sum ) ) * 1.0e-3 ) return false;
+      sum += input[ i ];
+    }
+    return true;
+  }
+  else {
+    std::vector< T > expected( input.size() );
+    std::exclusive_scan( input.begin(), input.end(), expected.begin(), T( 0 ) );
+    return expected == output;
+  }
+}
+
+int main( int argc, const char *argv[] ) {
+  namespace po = boost::program_options;
+  po::options_description desc( "Options" );
+  desc.add_options()
+    ( "help,h", "show this message" )
+    ( "count,c", po::value< std::uint32_t >()->default_value( 16u * 1024u * 1024u ), "number of elements" )
+    ( "type,t", po::value< std::string >()->default_value( "uint" ), "element type (uint or float)" )
+    ( "iterations,n", po::value< std::uint32_t >()->default_value( 20u ), "timed scans" )
+    ( "local-size", po::value< std::uint32_t >()->default_value( 256u ), "local_size_x of the scan shaders" );
+  po::variables_map vm;
+  po::store( po::parse_command_line( argc, argv, desc ), vm );
+  po::notify( vm );
+  if( vm.count( "help" ) ) {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+  const auto count = vm[ "count" ].as< std::uint32_t >();
+  const auto type_name = vm[ "type" ].as< std::string >();
+  const auto iterations = vm[ "iterations" ].as< std::uint32_t >();
+  const auto local_size = vm[ "local-size" ].as< std::uint32_t >();
+  if( type_name != "uint" && type_name != "float" ) {
+    std::cerr << "type must be uint or float" << std::endl;
+    return 1;
+  }
+  if( count == 0u || iterations == 0u || !local_size || ( local_size & ( local_size - 1u ) ) ) {
+    std::cerr << "count and iterations must not be 0 and local-size must be a power of 2" << std::endl;
+    return 1;
+  }
+  const auto value_type = type_name == "float" ?
+    samples::scan_value_type_t::float32 :
+    samples::scan_value_type_t::uint32;
+
+  const std::shared_ptr< gct::instance_t > instance(
+    new gct::instance_t(
+      gct::instance_create_info_t()
+        .set_application_info(
+          vk::ApplicationInfo()
+            .setPApplicationName( argc ? argv[ 0 ] : "my_application" )
+            .setApplicationVersion(  VK_MAKE_VERSION( 1, 0, 0 ) )
+            .setApiVersion( VK_API_VERSION_1_2 )
+        )
+    )
+  );
+  auto groups = instance->get_physical_devices( {} );
+  auto selected = groups[ 0 ].with_extensions( {} );
+  const auto physical_device = **selected.devices[ 0 ];
+  const auto physical_device_props = physical_device.getProperties();
+
+  const auto device = selected.create_device(
+    std::vector< gct::queue_requirement_t >{
+      gct::queue_requirement_t{
+        vk::QueueFlagBits::eCompute,
+        0u,
+        vk::Extent3D(),
+#ifdef VK_EXT_GLOBAL_PRIORITY_EXTENSION_NAME
+        vk::QueueGlobalPriorityEXT(),
+#endif
+        {},
+        vk::CommandPoolCreateFlagBits::eResetCommandBuffer
+      }
+    },
+    gct::device_create_info_t()
+  );
+  const auto queue = device->get_queue( 0u );
+  const auto allocator = device->get_allocator();
+
+  const std::uint64_t buffer_size = std::uint64_t( count ) * sizeof( std::uint32_t );
+  // GPUからだけ見えるバッファ
+  const auto buffer = allocator->create_buffer(
+    gct::buffer_create_info_t()
+      .set_basic(
+        vk::BufferCreateInfo()
+          .setSize( buffer_size )
+          .setUsage(
+            vk::BufferUsageFlagBits::eStorageBuffer |
+            vk::BufferUsageFlagBits::eTransferSrc |
+            vk::BufferUsageFlagBits::eTransferDst
+          )
+      ),
+    VMA_MEMORY_USAGE_GPU_ONLY
+  );
+  // 入力をGPUに送る為のバッファ
+  const auto staging = allocator->create_buffer(
+    gct::buffer_create_info_t()
+      .set_basic(
+        vk::BufferCreateInfo()
+          .setSize( buffer_size )
+          .setUsage( vk::BufferUsageFlagBits::eTransferSrc )
+      ),
+    VMA_MEMORY_USAGE_CPU_TO_GPU
+  );
+  // 結果をCPUに戻す為のバッファ
+  const auto readback = allocator->create_buffer(
+    gct::buffer_create_info_t()
+      .set_basic(
+        vk::BufferCreateInfo()
+          .setSize( buffer_size )
+          .setUsage( vk::BufferUsageFlagBits::eTransferDst )
+      ),
+    VMA_MEMORY_USAGE_GPU_TO_CPU
+  );
+
+  std::mt19937 rng( 1u );
+  std::vector< std::uint32_t > uint_input;
+  std::vector< float > float_input;
+  {
+    if( value_type == samples::scan_value_type_t::float32 ) {
+      std::uniform_real_distribution< float > dist( 0.f, 1.f );
+      float_input.resize( count );
+      std::generate( float_input.begin(), float_input.end(), [&]() { return dist( rng ); } );
+      auto mapped = staging->map< float >();
+      std::copy( float_input.begin(), float_input.end(), mapped.begin() );
+    }
+    else {
+      std::uniform_int_distribution< std::uint32_t > dist( 0u, 255u );
+      uint_input.resize( count );
+      std::generate( uint_input.begin(), uint_input.end(), [&]() { return dist( rng ); } );
+      auto mapped = staging->map< std::uint32_t >();
+      std::copy( uint_input.begin(), uint_input.end(), mapped.begin() );
+    }
+  }
+
+  const samples::persistent_pipeline_cache_t pipeline_cache( device, CMAKE_CURRENT_BINARY_DIR "/pipeline_cache" );
+  const samples::scan_t scan(
+    device,
+    allocator,
+    pipeline_cache.get(),
+    physical_device_props.limits,
+    CMAKE_CURRENT_BINARY_DIR,
+    buffer,
+    count,
+    value_type,
+    local_size
+  );
+
+  const auto command_buffer = queue->get_command_pool()->allocate();
+
+  // 1回目は入力を送って結果を読み戻し、CPUで求めた結果と比べる
+  {
+    auto rec = command_buffer->begin();
+    rec->copyBuffer( **staging, **buffer, vk::BufferCopy().setSize( buffer_size ) );
+    rec.barrier(
+      vk::AccessFlagBits::eTransferWrite,
+      vk::AccessFlagBits::eShaderRead|vk::AccessFlagBits::eShaderWrite,
+      vk::PipelineStageFlagBits::eTransfer,
+      vk::PipelineStageFlagBits::eComputeShader,
+      vk::DependencyFlagBits( 0 ),
+      { buffer },
+      {}
+    );
+    scan( rec );
+    rec.barrier(
+      vk::AccessFlagBits::eShaderWrite,
+      vk::AccessFlagBits::eTransferRead,
+      vk::PipelineStageFlagBits::eComputeShader,
+      vk::PipelineStageFlagBits::eTransfer,
+      vk::DependencyFlagBits( 0 ),
+      { buffer },
+      {}
+    );
+    rec->copyBuffer( **buffer, **readback, vk::BufferCopy().setSize( buffer_size ) );
+  }
+  command_buffer->execute(
+    gct::submit_info_t()
+  );
+  command_buffer->wait_for_executed();
+
+  bool correct = false;
+  if( value_type == samples::scan_value_type_t::float32 ) {
+    auto mapped = readback->map< float >();
+    correct = verify( float_input, std::vector< float >( mapped.begin(), mapped.end() ) );
+  }
+  else {
+    auto mapped = readback->map< std::uint32_t >();
+    correct = verify( uint_input, std::vector< std::uint32_t >( mapped.begin(), mapped.end() ) );
+  }
+
+  // 2回目以降は結果を入力にしてプレフィックス和を求め直す事を繰り返して時間を測る
+  const samples::timestamp_t timestamp(
+    device,
+    physical_device,
+    queue->get_available_queue_family_index(),
+    iterations + 1u
+  );
+  {
+    auto rec = command_buffer->begin();
+    timestamp.reset( rec );
+    timestamp.write( rec, 0u );
+    for( std::uint32_t i = 0u; i != iterations; ++i ) {
+      scan( rec );
+      rec.barrier(
+        vk::AccessFlagBits::eShaderWrite,
+        vk::AccessFlagBits::eShaderRead|vk::AccessFlagBits::eShaderWrite,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlagBits( 0 ),
+        { buffer },
+        {}
+      );
+      timestamp.write( rec, i + 1u );
+    }
+  }
+  const auto begin_time = std::chrono::high_resolution_clock::now();
+  command_buffer->execute(
+    gct::submit_info_t()
+  );
+  command_buffer->wait_for_executed();
+  const auto end_time = std::chrono::high_resolution_clock::now();
+  const double host_ns = double( std::chrono::duration_cast< std::chrono::nanoseconds >( end_time - begin_time ).count() );
+
+  nlohmann::json root;
+  root[ "device" ] = std::string( physical_device_props.deviceName.data() );
+  root[ "type" ] = type_name;
+  root[ "count" ] = count;
+  root[ "local_size" ] = local_size;
+  root[ "levels" ] = scan.get_level_count();
+  root[ "correct" ] = correct;
+  root[ "iterations" ] = iterations;
+  root[ "host_ns" ] = host_ns;
+  double mean = host_ns / iterations;
+  if( timestamp.is_available() ) {
+    const auto stats = samples::get_statistics( samples::get_intervals( timestamp.get( iterations + 1u ) ) );
+    root[ "scan_ns" ] = stats;
+    mean = stats.mean;
+  }
+  else root[ "scan_ns" ] = nullptr;
+  root[ "elements_per_sec" ] = double( count ) * 1.0e9 / mean;
+  // 最下段で各要素を2回読んで2回書くのでこれを実効的な帯域とする
+  root[ "gb_per_sec" ] = double( buffer_size ) * 4.0 / mean;
+  std::cout << root.dump( 2 ) << std::endl;
+  return correct ? 0 : 1;
+}
+
@@ -0,0 +1,387 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <boost/program_options.hpp>
+#include <nlohmann/json.hpp>
+#include <gct/get_extensions.hpp>
+#include <gct/instance.hpp>
+#include <gct/queue.hpp>
+#include <gct/device.hpp>
+#include <gct/allocator.hpp>
+#include <gct/device_create_info.hpp>
+#include <gct/descriptor_pool.hpp>
+#include <gct/descriptor_set_layout.hpp>
+#include <gct/pipeline_cache.hpp>
+#include <gct/pipeline_layout.hpp>
+#include <gct/pipeline_layout_create_info.hpp>
+#include <gct/submit_info.hpp>
+#include <gct/shader_module_create_info.hpp>
+#include <gct/shader_module.hpp>
+#include <gct/compute_pipeline_create_info.hpp>
+#include <gct/compute_pipeline.hpp>
+#include <gct/write_descriptor_set.hpp>
+#include <gct/command_buffer.hpp>
+#include <gct/command_pool.hpp>
+#include <samples/timestamp.hpp>
+#include <samples/statistics.hpp>
+#include <samples/pipeline_cache_store.hpp>
+
+struct spec_t {
+  std::uint32_t local_x_size = 0u;
+  std::uint32_t exclusive = 0u;
+};
+
+struct push_constant_t {
+  std::uint32_t count = 0u;
+};
+
+// 比較するカーネル
+struct kernel_t {
+  std::string operation;
+  std::string implementation;
+  std::string shader;
+  bool scan = false;
+  bool exclusive = false;
+};
+
+int main( int argc, const char *argv[] ) {
+  namespace po = boost::program_options;
+  po::options_description desc( "Options" );
+  desc.add_options()
+    ( "help,h", "show this message" )
+    ( "count,c", po::value< std::uint32_t >()->default_value( 16u * 1024u * 1024u ), "number of elements" )
+    ( "iterations,n", po::value< std::uint32_t >()->default_value( 20u ), "timed dispatches per kernel" )
+    ( "local-size", po::value< std::uint32_t >()->default_value( 256u ), "local_size_x of the kernels" );
+  po::variables_map vm;
+  po::store( po::parse_command_line( argc, argv, desc ), vm );
+  po::notify( vm );
+  if( vm.count( "help" ) ) {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+  const auto count = vm[ "count" ].as< std::uint32_t >();
+  const auto iterations = vm[ "iterations" ].as< std::uint32_t >();
+  auto local_size = vm[ "local-size" ].as< std::uint32_t >();
+  if( count == 0u || iterations == 0u || !local_size || ( local_size & ( local_size - 1u ) ) ) {
+    std::cerr << "count and iterations must not be 0 and local-size must be a power of 2" << std::endl;
+    return 1;
+  }
+
+  const std::shared_ptr< gct::instance_t > instance(
+    new gct::instance_t(
+      gct::instance_create_info_t()
+        .set_application_info(
+          vk::ApplicationInfo()
+            .setPApplicationName( argc ? argv[ 0 ] : "my_application" )
+            .setApplicationVersion(  VK_MAKE_VERSION( 1, 0, 0 ) )
+            .setApiVersion( VK_API_VERSION_1_2 )
+        )
+    )
+  );
+  auto groups = instance->get_physical_devices( {} );
+  auto selected = groups[ 0 ].with_extensions( {} );
+  const auto physical_device = **selected.devices[ 0 ];
+
+  // サブグループの大きさとサブグループで使える演算を調べる
+  const auto physical_device_props = physical_device.getProperties2<
+    vk::PhysicalDeviceProperties2,
+    vk::PhysicalDeviceSubgroupProperties
+  >();
+  const auto &props = physical_device_props.get< vk::PhysicalDeviceProperties2 >().properties;
+  const auto &subgroup_props = physical_device_props.get< vk::PhysicalDeviceSubgroupProperties >();
+  const bool arithmetic_available =
+    bool( subgroup_props.supportedStages & vk::ShaderStageFlagBits::eCompute ) &&
+    bool( subgroup_props.supportedOperations & vk::SubgroupFeatureFlagBits::eBasic ) &&
+    bool( subgroup_props.supportedOperations & vk::SubgroupFeatureFlagBits::eArithmetic );
+  // ワークグループの大きさはサブグループの大きさの倍数にする
+  local_size = std::max( local_size, subgroup_props.subgroupSize );
+  if( local_size > props.limits.maxComputeWorkGroupSize[ 0 ] || local_size > props.limits.maxComputeWorkGroupInvocations ) {
+    std::cerr << "local-size exceeds the limit of the device" << std::endl;
+    return 1;
+  }
+
+  const auto device = selected.create_device(
+    std::vector< gct::queue_requirement_t >{
+      gct::queue_requirement_t{
+        vk::QueueFlagBits::eCompute,
+        0u,
+        vk::Extent3D(),
+#ifdef VK_EXT_GLOBAL_PRIORITY_EXTENSION_NAME
+        vk::QueueGlobalPriorityEXT(),
+#endif
+        {},
+        vk::CommandPoolCreateFlagBits::eResetCommandBuffer
+      }
+    },
+    gct::device_create_info_t()
+  );
+  const auto queue = device->get_queue( 0u );
+  const auto allocator = device->get_allocator();
+
+  // 共有メモリを使う実装は常に比較対象にする
+  // サブグループの算術演算を使う実装はデバイスが対応している場合だけ動かす
+  std::vector< kernel_t > kernels{
+    kernel_t{ "reduce", "shared", "reduce_shared", false, false },
+    kernel_t{ "inclusive_scan", "shared", "scan_shared", true, false },
+    kernel_t{ "exclusive_scan", "shared", "scan_shared", true, true }
+  };
+  if( arithmetic_available ) {
+    kernels.push_back( kernel_t{ "reduce", "subgroup", "reduce_subgroup", false, false } );
+    kernels.push_back( kernel_t{ "inclusive_scan", "subgroup", "scan_subgroup", true, false } );
+    kernels.push_back( kernel_t{ "exclusive_scan", "subgroup", "scan_subgroup", true, true } );
+  }
+
+  // 全てのシェーダは同じデスクリプタセットレイアウトを持っている
+  const auto layout_shader = device->get_shader_module(
+    CMAKE_CURRENT_BINARY_DIR "/reduce_shared.comp.spv"
+  );
+  const auto descriptor_set_layout = device->get_descriptor_set_layout(
+    gct::descriptor_set_layout_create_info_t()
+      .add_binding( layout_shader->get_props().get_reflection() )
+      .rebuild_chain()
+  );
+  const auto pipeline_layout = device->get_pipeline_layout(
+    gct::pipeline_layout_create_info_t()
+      .add_descriptor_set_layout( descriptor_set_layout )
+      .add_push_constant_range(
+        vk::PushConstantRange()
+          .setStageFlags( vk::ShaderStageFlagBits::eCompute )
+          .setOffset( 0 )
+          .setSize( sizeof( push_constant_t ) )
+      )
+  );
+  const auto descriptor_pool = device->get_descriptor_pool(
+    gct::descriptor_pool_create_info_t()
+      .set_basic(
+        vk::DescriptorPoolCreateInfo()
+          .setFlags( vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet )
+          .setMaxSets( 1 )
+      )
+      .set_descriptor_pool_size( vk::DescriptorType::eStorageBuffer, 2 )
+      .rebuild_chain()
+  );
+  const auto descriptor_set = descriptor_pool->allocate( descriptor_set_layout );
+  // 前回までに作ったパイプラインをファイルから読み戻し、終了時に保存する
+  const samples::persistent_pipeline_cache_t pipeline_cache( device, CMAKE_CURRENT_BINARY_DIR "/pipeline_cache" );
+
+  const std::uint32_t block_count = ( count + local_size - 1u ) / local_size;
+  const std::uint32_t group_count_x = std::min( block_count, props.limits.maxComputeWorkGroupCount[ 0 ] );
+  const std::uint32_t group_count_y = ( block_count + group_count_x - 1u ) / group_count_x;
+  const std::uint64_t data_size = std::uint64_t( count ) * sizeof( std::uint32_t );
+  const std::uint64_t sums_size = std::uint64_t( block_count ) * sizeof( std::uint32_t );
+
+  const auto create_buffer = [&]( std::uint64_t size, vk::BufferUsageFlags usage, VmaMemoryUsage memory_usage ) {
+    return allocator->create_buffer(
+      gct::buffer_create_info_t()
+        .set_basic(
+          vk::BufferCreateInfo()
+            .setSize( size )
+            .setUsage( usage )
+        ),
+      memory_usage
+    );
+  };
+  const auto data = create_buffer( data_size, vk::BufferUsageFlagBits::eStorageBuffer|vk::BufferUsageFlagBits::eTransferSrc|vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_ONLY );
+  const auto block_sums = create_buffer( sums_size, vk::BufferUsageFlagBits::eStorageBuffer|vk::BufferUsageFlagBits::eTransferSrc, VMA_MEMORY_USAGE_GPU_ONLY );
+  const auto staging = create_buffer( data_size, vk::BufferUsageFlagBits::eTransferSrc, VMA_MEMORY_USAGE_CPU_TO_GPU );
+  const auto data_readback = create_buffer( data_size, vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_TO_CPU );
+  const auto sums_readback = create_buffer( sums_size, vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_TO_CPU );
+
+  descriptor_set->update(
+    {
+      gct::write_descriptor_set_t()
+        .set_basic( (*descriptor_set)[ "layout1" ] )
+        .add_buffer(
+          gct::descriptor_buffer_info_t()
+            .set_buffer( data )
+            .set_basic(
+              vk::DescriptorBufferInfo()
+                .setOffset( 0 )
+                .setRange( data_size )
+            )
+        ),
+      gct::write_descriptor_set_t()
+        .set_basic( (*descriptor_set)[ "layout2" ] )
+        .add_buffer(
+          gct::descriptor_buffer_info_t()
+            .set_buffer( block_sums )
+            .set_basic(
+              vk::DescriptorBufferInfo()
+                .setOffset( 0 )
+                .setRange( sums_size )
+            )
+        )
+    }
+  );
+
+  std::vector< std::uint32_t > input( count );
+  {
+    std::mt19937 rng( 1u );
+    std::uniform_int_distribution< std::uint32_t > dist( 0u, 255u );
+    std::generate( input.begin(), input.end(), [&]() { return dist( rng ); } );
+    auto mapped = staging->map< std::uint32_t >();
+    std::copy( input.begin(), input.end(), mapped.begin() );
+  }
+
+  // CPUで求めたワークグループ毎のプレフィックス和と総和
+  std::vector< std::uint32_t > expected_inclusive( count );
+  std::vector< std::uint32_t > expected_sums( block_count );
+  for( std::uint32_t b = 0u; b != block_count; ++b ) {
+    std::uint32_t sum = 0u;
+    for( std::uint32_t i = b * local_size; i != std::min( ( b + 1u ) * local_size, count ); ++i ) {
+      sum += input[ i ];
+      expected_inclusive[ i ] = sum;
+    }
+    expected_sums[ b ] = sum;
+  }
+
+  const samples::timestamp_t timestamp(
+    device,
+    physical_device,
+    queue->get_available_queue_family_index(),
+    iterations + 1u
+  );
+  const auto command_buffer = queue->get_command_pool()->allocate();
+  const push_constant_t push_constant{ count };
+
+  nlohmann::json results = nlohmann::json::array();
+  for( const auto &kernel: kernels ) {
+    const auto shader = device->get_shader_module(
+      std::string( CMAKE_CURRENT_BINARY_DIR "/" ) + kernel.shader + ".comp.spv"
+    );
+    const auto pipeline = pipeline_cache->get_pipeline(
+      gct::compute_pipeline_create_info_t()
+        .set_stage(
+          gct::pipeline_shader_stage_create_info_t()
+            .set_shader_module( shader )
+            .set_specialization_info(
+              gct::specialization_info_t< spec_t >()
+                .set_data(
+                  spec_t{ local_size, kernel.exclusive ? 1u : 0u }
+                )
+                .add_map< std::uint32_t >( 1, offsetof( spec_t, local_x_size ) )
+                .add_map< std::uint32_t >( 3, offsetof( spec_t, exclusive ) )
+            )
+        )
+        .set_layout( pipeline_layout )
+    );
+    const auto dispatch = [&]( auto &rec ) {
+      rec.bind_descriptor_set(
+        vk::PipelineBindPoint::eCompute,
+        pipeline_layout,
+        descriptor_set
+      );
+      rec.bind_pipeline( pipeline );
+      rec->pushConstants(
+        **pipeline_layout,
+        vk::ShaderStageFlagBits::eCompute,
+        0u,
+        sizeof( push_constant_t ),
+        reinterpret_cast< const void* >( &push_constant )
+      );
+      rec->dispatch( group_count_x, group_count_y, 1 );
+    };
+
+    // 1回実行して結果をCPUで求めた値と比べる
+    {
+      auto rec = command_buffer->begin();
+      rec->copyBuffer( **staging, **data, vk::BufferCopy().setSize( data_size ) );
+      rec.barrier(
+        vk::AccessFlagBits::eTransferWrite,
+        vk::AccessFlagBits::eShaderRead|vk::AccessFlagBits::eShaderWrite,
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlagBits( 0 ),
+        { data },
+        {}
+      );
+      dispatch( rec );
+      rec.barrier(
+        vk::AccessFlagBits::eShaderWrite,
+        vk::AccessFlagBits::eTransferRead,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::DependencyFlagBits( 0 ),
+        { data, block_sums },
+        {}
+      );
+      rec->copyBuffer( **data, **data_readback, vk::BufferCopy().setSize( data_size ) );
+      rec->copyBuffer( **block_sums, **sums_readback, vk::BufferCopy().setSize( sums_size ) );
+    }
+    command_buffer->execute(
+      gct::submit_info_t()
+    );
+    command_buffer->wait_for_executed();
+    bool correct = true;
+    {
+      auto mapped = sums_readback->map< std::uint32_t >();
+      correct = std::equal( expected_sums.begin(), expected_sums.end(), mapped.begin() );
+    }
+    if( kernel.scan ) {
+      auto mapped = data_readback->map< std::uint32_t >();
+      for( std::uint32_t i = 0u; i != count && correct; ++i ) {
+        const auto expected = kernel.exclusive ? expected_inclusive[ i ] - input[ i ] : expected_inclusive[ i ];
+        correct = mapped.begin()[ i ] == expected;
+      }
+    }
+
+    // 同じカーネルを繰り返し実行して時間を測る
+    {
+      auto rec = command_buffer->begin();
+      timestamp.reset( rec );
+      timestamp.write( rec, 0u );
+      for( std::uint32_t i = 0u; i != iterations; ++i ) {
+        dispatch( rec );
+        rec.barrier(
+          vk::AccessFlagBits::eShaderWrite,
+          vk::AccessFlagBits::eShaderRead|vk::AccessFlagBits::eShaderWrite,
+          vk::PipelineStageFlagBits::eComputeShader,
+          vk::PipelineStageFlagBits::eComputeShader,
+          vk::DependencyFlagBits( 0 ),
+          { data, block_sums },
+          {}
+        );
+        timestamp.write( rec, i + 1u );
+      }
+    }
+    const auto begin_time = std::chrono::high_resolution_clock::now();
+    command_buffer->execute(
+      gct::submit_info_t()
+    );
+    command_buffer->wait_for_executed();
+    const auto end_time = std::chrono::high_resolution_clock::now();
+    const double host_ns = double( std::chrono::duration_cast< std::chrono::nanoseconds >( end_time - begin_time ).count() );
+
+    nlohmann::json result;
+    result[ "operation" ] = kernel.operation;
+    result[ "implementation" ] = kernel.implementation;
+    result[ "correct" ] = correct;
+    result[ "host_ns" ] = host_ns;
+    double mean = host_ns / iterations;
+    if( timestamp.is_available() ) {
+      const auto stats = samples::get_statistics( samples::get_intervals( timestamp.get( iterations + 1u ) ) );
+      result[ "dispatch_ns" ] = stats;
+      mean = stats.mean;
+    }
+    else result[ "dispatch_ns" ] = nullptr;
+    // 総和は入力を読むだけ、プレフィックス和は入力を読んで同じ数を書く
+    const double bytes = double( data_size ) * ( kernel.scan ? 2.0 : 1.0 ) + double( sums_size );
+    result[ "gb_per_sec" ] = bytes / mean;
+    result[ "elements_per_sec" ] = double( count ) * 1.0e9 / mean;
+    results.push_back( result );
+  }
+
+  nlohmann::json root;
+  root[ "device" ] = std::string( props.deviceName.data() );
+  root[ "subgroup_size" ] = subgroup_props.subgroupSize;
+  root[ "subgroup_arithmetic" ] = arithmetic_available;
+  // 実際に使う場合はサブグループの算術演算が使えればそちらを、使えなければ共有メモリの実装を選ぶ
+  root[ "selected" ] = arithmetic_available ? "subgroup" : "shared";
+  root[ "count" ] = count;
+  root[ "local_size" ] = local_size;
+  root[ "iterations" ] = iterations;
+  root[ "results" ] = results;
+  std::cout << root.dump( 2 ) << std::endl;
+}
+
@@ -1,6 +1,4 @@
-#include <fstream>
 #include <iostream>
-#include <optional>
 #include <filesystem>
 #include <gct/instance.hpp>
 #include <gct/device.hpp>
@@ -10,7 +8,7 @@
 #include <gct/descriptor_set_layout.hpp>
 #include <gct/shader_module.hpp>
 #include <vulkan/vulkan.h>
-#include <gct/mmaped_file.hpp>
+#include <samples/pipeline_cache_store.hpp>
 #include <nlohmann/json.hpp>
 #include <vulkan2json/PipelineCreationFeedbackEXT.hpp>
 
@@ -128,14 +126,13 @@ int main( int argc, const char *argv[] ) {
   pipeline_create_info.basePipelineIndex = 0;
 
   // 既にパイプラインキャッシュを保存したファイルがあったら読む
-  std::filesystem::path pipeline_cache_filename(
+  // ヘッダが今のデバイスの物と一致しない場合は使わない
+  samples::pipeline_cache_store_t pipeline_cache_store(
+    vk::Device( device ),
     CMAKE_CURRENT_BINARY_DIR "/pipeline_cache"
   );
-
-  std::optional< gct::mmaped_file > pipeline_cache_data;
-  if( std::filesystem::exists( pipeline_cache_filename ) ) {
-    pipeline_cache_data = gct::mmaped_file( pipeline_cache_filename );
-  }
+  const auto pipeline_cache_data = pipeline_cache_store.load();
+  std::cerr << "pipeline cache : " << pipeline_cache_store.get_status() << std::endl;
 
   // パイプラインキャッシュを作る
   // 既にファイルがあった場合はその内容を使う
@@ -143,14 +140,11 @@ int main( int argc, const char *argv[] ) {
   pipeline_cache_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
   pipeline_cache_create_info.pNext = nullptr;
   pipeline_cache_create_info.flags = 0u;
-  pipeline_cache_create_info.initialDataSize =
-    pipeline_cache_data ?
-    std::distance( pipeline_cache_data->begin(), pipeline_cache_data->end() ) :
-    0u;
+  pipeline_cache_create_info.initialDataSize = pipeline_cache_data.size();
   pipeline_cache_create_info.pInitialData =
-    pipeline_cache_data ?
-    pipeline_cache_data->begin() :
-    nullptr;
+    pipeline_cache_data.empty() ?
+    nullptr :
+    pipeline_cache_data.data();
   VkPipelineCache pipeline_cache;
   if( vkCreatePipelineCache(
     device,
@@ -186,23 +180,8 @@ int main( int argc, const char *argv[] ) {
   std::cout << nlohmann::json( feedback_.back() ).dump( 2 ) << std::endl;
   
   // パイプラインキャッシュをファイルに保存する
-  std::size_t serialized_size = 0u;
-  if( vkGetPipelineCacheData(
-    device,
-    pipeline_cache,
-    &serialized_size,
-    nullptr
-  ) != VK_SUCCESS ) std::abort();
-  std::vector< std::uint8_t > serialized( serialized_size );
-  if( vkGetPipelineCacheData(
-    device,
-    pipeline_cache,
-    &serialized_size,
-    serialized.data()
-  ) != VK_SUCCESS ) std::abort();
-  std::filesystem::remove( pipeline_cache_filename );
-  std::fstream pipeline_cache_output( pipeline_cache_filename.string(), std::ios_base::out );
-  pipeline_cache_output.write( reinterpret_cast< const char* >( serialized.data() ), serialized.size() );
+  // 他のプロセスが保存した内容と合わせて一時ファイルに書き、renameで置き換える
+  pipeline_cache_store.save( vk::PipelineCache( pipeline_cache ) );
 
   // パイプラインキャッシュを捨てる
   vkDestroyPipelineCache(
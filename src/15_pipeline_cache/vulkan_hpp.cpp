@@ -1,6 +1,4 @@
-#include <fstream>
 #include <iostream>
-#include <optional>
 #include <filesystem>
 #include <gct/instance.hpp>
 #include <gct/device.hpp>
@@ -11,7 +9,7 @@
 #include <gct/write_descriptor_set.hpp>
 #include <gct/shader_module.hpp>
 #include <vulkan/vulkan.hpp>
-#include <gct/mmaped_file.hpp>
+#include <samples/pipeline_cache_store.hpp>
 #include <nlohmann/json.hpp>
 #include <vulkan2json/PipelineCreationFeedbackEXT.hpp>
 
@@ -116,22 +114,20 @@ int main( int argc, const char *argv[] ) {
   };
 
   // 既にパイプラインキャッシュを保存したファイルがあったら読む
-  std::filesystem::path pipeline_cache_filename(
+  // ヘッダが今のデバイスの物と一致しない場合は使わない
+  samples::pipeline_cache_store_t pipeline_cache_store(
+    device,
     CMAKE_CURRENT_BINARY_DIR "/pipeline_cache"
   );
-  std::optional< gct::mmaped_file > pipeline_cache_data;
-  if( std::filesystem::exists( pipeline_cache_filename ) ) {
-    pipeline_cache_data = gct::mmaped_file( pipeline_cache_filename );
-  }
+  const auto pipeline_cache_data = pipeline_cache_store.load();
+  std::cerr << "pipeline cache : " << pipeline_cache_store.get_status() << std::endl;
 
   // パイプラインキャッシュを作る
   // 既にファイルがあった場合はその内容を使う
   const auto pipeline_cache = device.createPipelineCacheUnique(
-    pipeline_cache_data ?
-      vk::PipelineCacheCreateInfo()
-        .setInitialDataSize( std::distance( pipeline_cache_data->begin(), pipeline_cache_data->end() ) )
-        .setPInitialData( pipeline_cache_data->begin() ) :
-      vk::PipelineCacheCreateInfo()
+    vk::PipelineCacheCreateInfo()
+      .setInitialDataSize( pipeline_cache_data.size() )
+      .setPInitialData( pipeline_cache_data.empty() ? nullptr : pipeline_cache_data.data() )
   );
 
   // パイプラインキャッシュを付けてパイプラインを作る
@@ -148,9 +144,7 @@ int main( int argc, const char *argv[] ) {
   std::cout << nlohmann::json( feedback_.back() ).dump( 2 ) << std::endl;
 
   // パイプラインキャッシュをファイルに保存する
-  auto serialized = device.getPipelineCacheData( *pipeline_cache );
-  std::filesystem::remove( pipeline_cache_filename );
-  std::fstream pipeline_cache_output( pipeline_cache_filename.string(), std::ios_base::out );
-  pipeline_cache_output.write( reinterpret_cast< const char* >( serialized.data() ), serialized.size() );
+  // 他のプロセスが保存した内容と合わせて一時ファイルに書き、renameで置き換える
+  pipeline_cache_store.save( *pipeline_cache );
 }
 
@@ -0,0 +1,490 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <boost/program_options.hpp>
+#include <nlohmann/json.hpp>
+#include <OpenImageIO/imageio.h>
+#include <OpenImageIO/version.h>
+#include <gct/get_extensions.hpp>
+#include <gct/instance.hpp>
+#include <gct/queue.hpp>
+#include <gct/device.hpp>
+#include <gct/allocator.hpp>
+#include <gct/device_create_info.hpp>
+#include <gct/image_create_info.hpp>
+#include <gct/buffer.hpp>
+#include <gct/descriptor_pool.hpp>
+#include <gct/descriptor_set_layout.hpp>
+#include <gct/pipeline_cache.hpp>
+#include <gct/pipeline_layout_create_info.hpp>
+#include <gct/submit_info.hpp>
+#include <gct/shader_module.hpp>
+#include <gct/compute_pipeline_create_info.hpp>
+#include <gct/compute_pipeline.hpp>
+#include <gct/write_descriptor_set.hpp>
+#include <gct/command_buffer.hpp>
+#include <gct/command_pool.hpp>
+#include <samples/command_buffer_recycler.hpp>
+#include <samples/image_tiler.hpp>
+#include <samples/pipeline_cache_store.hpp>
+#include <samples/statistics.hpp>
+
+// デバイスのメモリに載らない大きさの画像をタイルに分けて処理する
+//
+// 入力画像はOpenImageIOでタイルの行毎に読み、出力画像もタイルの行が揃う毎に書くので
+// ホストのメモリも画像の幅 x タイルの高さ程度しか使わない
+// GPU側の資源(ステージングバッファ、入出力イメージ、読み戻し用のバッファ)はスロット2つ分だけ持ち、
+// 一方のスロットのタイルをGPUが処理している間にもう一方のスロットに次のタイルを詰める
+//
+// フィルタはfilter.compの箱形フィルタで、半径をhaloと同じにするのでタイルの境界は現れない
+
+struct spec_t {
+  std::uint32_t local_x_size = 0u;
+  std::uint32_t local_y_size = 0u;
+};
+
+struct push_constants_t {
+  std::int32_t offset[ 2 ];
+  std::int32_t src_size[ 2 ];
+  std::int32_t dest_size[ 2 ];
+  std::int32_t radius;
+};
+
+int main( int argc, const char *argv[] ) {
+  namespace po = boost::program_options;
+  po::options_description desc( "Options" );
+  desc.add_options()
+    ( "help,h", "show this message" )
+    ( "input,i", po::value< std::string >()->default_value( CMAKE_CURRENT_SOURCE_DIR "/test.png" ), "input image" )
+    ( "output,o", po::value< std::string >()->default_value( "out_tiled.png" ), "output image" )
+    ( "tile,t", po::value< std::uint32_t >()->default_value( 1024u ), "tile size" )
+    ( "radius,r", po::value< std::uint32_t >()->default_value( 4u ), "filter radius (= halo)" );
+  po::variables_map vm;
+  po::store( po::parse_command_line( argc, argv, desc ), vm );
+  po::notify( vm );
+  if( vm.count( "help" ) ) {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+  const auto input_filename = vm[ "input" ].as< std::string >();
+  const auto output_filename = vm[ "output" ].as< std::string >();
+  const auto tile_size = vm[ "tile" ].as< std::uint32_t >();
+  const auto radius = vm[ "radius" ].as< std::uint32_t >();
+
+  using namespace OIIO_NAMESPACE;
+  auto input = ImageInput::open( input_filename );
+  if( !input ) {
+    std::cerr << "unable to open " << input_filename << std::endl;
+    return 1;
+  }
+  const ImageSpec input_spec = input->spec();
+  const std::uint32_t width = input_spec.width;
+  const std::uint32_t height = input_spec.height;
+  const std::uint32_t channels = std::min( input_spec.nchannels, 4 );
+  const samples::image_tiler_t tiler( width, height, tile_size, radius );
+
+  auto output = ImageOutput::create( output_filename );
+  if( !output || !output->open( output_filename, ImageSpec( width, height, 4, TypeDesc::UINT8 ) ) ) {
+    std::cerr << "unable to create " << output_filename << std::endl;
+    return 1;
+  }
+
+  const std::shared_ptr< gct::instance_t > instance(
+    new gct::instance_t(
+      gct::instance_create_info_t()
+        .set_application_info(
+          vk::ApplicationInfo()
+            .setPApplicationName( argc ? argv[ 0 ] : "my_application" )
+            .setApplicationVersion(  VK_MAKE_VERSION( 1, 0, 0 ) )
+            .setApiVersion( VK_API_VERSION_1_2 )
+        )
+    )
+  );
+  auto groups = instance->get_physical_devices( {} );
+  auto selected = groups[ 0 ].with_extensions( {} );
+
+  const auto device = selected.create_device(
+    std::vector< gct::queue_requirement_t >{
+      gct::queue_requirement_t{
+        vk::QueueFlagBits::eCompute,
+        0u,
+        vk::Extent3D(),
+#ifdef VK_EXT_GLOBAL_PRIORITY_EXTENSION_NAME
+        vk::QueueGlobalPriorityEXT(),
+#endif
+        {},
+        vk::CommandPoolCreateFlagBits::eResetCommandBuffer
+      }
+    },
+    gct::device_create_info_t()
+  );
+  const auto queue = device->get_queue( 0u );
+  samples::command_buffer_recycler_t recycler( device, queue );
+  const auto shader = device->get_shader_module(
+    CMAKE_CURRENT_BINARY_DIR "/filter.comp.spv"
+  );
+  const auto descriptor_set_layout = device->get_descriptor_set_layout(
+    gct::descriptor_set_layout_create_info_t()
+      .add_binding( shader->get_props().get_reflection() )
+      .rebuild_chain()
+  );
+  const auto pipeline_layout = device->get_pipeline_layout(
+    gct::pipeline_layout_create_info_t()
+      .add_descriptor_set_layout( descriptor_set_layout )
+      .add_push_constant_range(
+        vk::PushConstantRange()
+          .setStageFlags( vk::ShaderStageFlagBits::eCompute )
+          .setOffset( 0 )
+          .setSize( sizeof( push_constants_t ) )
+      )
+  );
+  constexpr std::uint32_t slot_count = 2u;
+  const auto descriptor_pool = device->get_descriptor_pool(
+    gct::descriptor_pool_create_info_t()
+      .set_basic(
+        vk::DescriptorPoolCreateInfo()
+          .setFlags( vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet )
+          .setMaxSets( slot_count )
+      )
+      .set_descriptor_pool_size( vk::DescriptorType::eStorageImage, 2 * slot_count )
+      .rebuild_chain()
+  );
+  const samples::persistent_pipeline_cache_t pipeline_cache( device, CMAKE_CURRENT_BINARY_DIR "/pipeline_cache" );
+  const auto pipeline = pipeline_cache->get_pipeline(
+    gct::compute_pipeline_create_info_t()
+      .set_stage(
+        gct::pipeline_shader_stage_create_info_t()
+          .set_shader_module( shader )
+          .set_specialization_info(
+            gct::specialization_info_t< spec_t >()
+              .set_data(
+                spec_t{ 16, 16 }
+              )
+              .add_map< std::uint32_t >( 1, offsetof( spec_t, local_x_size ) )
+              .add_map< std::uint32_t >( 2, offsetof( spec_t, local_y_size ) )
+          )
+      )
+      .set_layout( pipeline_layout )
+  );
+  const auto allocator = device->get_allocator();
+
+  // 1つのタイルの処理に使う資源
+  // どのタイルも最大の大きさで作っておき、端のタイルでは一部だけを使う
+  const std::uint32_t max_src_width = tiler.get_max_src_width();
+  const std::uint32_t max_src_height = tiler.get_max_src_height();
+  const std::uint32_t max_dest_width = std::min( tile_size, width );
+  const std::uint32_t max_dest_height = std::min( tile_size, height );
+  const auto create_image = [&]( std::uint32_t w, std::uint32_t h, vk::ImageUsageFlags usage ) {
+    return allocator->create_image(
+      gct::image_create_info_t()
+        .set_basic(
+          vk::ImageCreateInfo()
+            .setImageType( vk::ImageType::e2D )
+            .setFormat( vk::Format::eR8G8B8A8Unorm )
+            .setExtent( { w, h, 1 } )
+            .setMipLevels( 1 )
+            .setArrayLayers( 1 )
+            .setSamples( vk::SampleCountFlagBits::e1 )
+            .setTiling( vk::ImageTiling::eOptimal )
+            .setUsage( usage|vk::ImageUsageFlagBits::eStorage )
+            .setInitialLayout( vk::ImageLayout::eUndefined )
+        ),
+        VMA_MEMORY_USAGE_GPU_ONLY
+    );
+  };
+  const auto create_buffer = [&]( vk::DeviceSize size, vk::BufferUsageFlags usage, VmaMemoryUsage memory_usage ) {
+    return allocator->create_buffer(
+      gct::buffer_create_info_t()
+        .set_basic(
+          vk::BufferCreateInfo()
+            .setSize( size )
+            .setUsage( usage )
+        ),
+      memory_usage
+    );
+  };
+  const auto get_view = []( const auto &image ) {
+    return image->get_view(
+      gct::image_view_create_info_t()
+        .set_basic(
+          vk::ImageViewCreateInfo()
+            .setSubresourceRange(
+              vk::ImageSubresourceRange()
+                .setAspectMask( vk::ImageAspectFlagBits::eColor )
+                .setBaseMipLevel( 0 )
+                .setLevelCount( 1 )
+                .setBaseArrayLayer( 0 )
+                .setLayerCount( 1 )
+            )
+            .setViewType( gct::to_image_view_type( image->get_props().get_basic().imageType, image->get_props().get_basic().arrayLayers ) )
+        )
+        .rebuild_chain()
+    );
+  };
+  struct slot_t {
+    std::shared_ptr< gct::buffer_t > staging;
+    std::shared_ptr< gct::image_t > src_image;
+    std::shared_ptr< gct::image_t > dest_image;
+    std::shared_ptr< gct::buffer_t > readback;
+    std::shared_ptr< gct::descriptor_set_t > descriptor_set;
+    std::shared_ptr< gct::bound_command_buffer_t > command_buffer;
+    // このスロットで処理中のタイルの番号
+    std::uint32_t tile = 0u;
+    bool busy = false;
+  };
+  std::array< slot_t, slot_count > slots;
+  for( auto &slot: slots ) {
+    slot.staging = create_buffer( vk::DeviceSize( max_src_width ) * max_src_height * 4u, vk::BufferUsageFlagBits::eTransferSrc, VMA_MEMORY_USAGE_CPU_TO_GPU );
+    slot.src_image = create_image( max_src_width, max_src_height, vk::ImageUsageFlagBits::eTransferDst );
+    slot.dest_image = create_image( max_dest_width, max_dest_height, vk::ImageUsageFlagBits::eTransferSrc );
+    slot.readback = create_buffer( vk::DeviceSize( max_dest_width ) * max_dest_height * 4u, vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_TO_CPU );
+    slot.descriptor_set = descriptor_pool->allocate( descriptor_set_layout );
+    // 以後のコピーとディスパッチはeGeneralのままで行う
+    recycler.execute( [&]( auto &rec ) {
+      rec.convert_image( slot.src_image, vk::ImageLayout::eGeneral );
+      rec.convert_image( slot.dest_image, vk::ImageLayout::eGeneral );
+    } );
+    slot.descriptor_set->update(
+      {
+        gct::write_descriptor_set_t()
+          .set_basic(
+            (*slot.descriptor_set)[ "src_image" ]
+          )
+          .add_image(
+            gct::descriptor_image_info_t()
+              .set_basic(
+                vk::DescriptorImageInfo()
+                  .setImageLayout( vk::ImageLayout::eGeneral )
+              )
+              .set_image_view( get_view( slot.src_image ) )
+          ),
+        gct::write_descriptor_set_t()
+          .set_basic(
+            (*slot.descriptor_set)[ "dest_image" ]
+          )
+          .add_image(
+            gct::descriptor_image_info_t()
+              .set_basic(
+                vk::DescriptorImageInfo()
+                  .setImageLayout( vk::ImageLayout::eGeneral )
+              )
+              .set_image_view( get_view( slot.dest_image ) )
+          )
+      }
+    );
+  }
+
+  // 入力画像のタイル1行分(糊代を含む)
+  // 隣り合うタイルの行は糊代の分だけ入力の行を共有する
+  // PNGやJPEGは前に戻って読めず、戻ると先頭から読み直しになるので、共有する行は前の行から持ち越して新しい行だけを読む
+  std::vector< std::uint8_t > input_strip;
+  std::uint32_t input_strip_row = ~0u;
+  std::uint32_t input_strip_y = 0u;
+  std::uint32_t input_strip_end = 0u;
+  const auto load_input_strip = [&]( std::uint32_t row ) {
+    if( input_strip_row == row ) return;
+    const auto [y0,y1] = tiler.get_src_rows( row );
+    const std::size_t row_bytes = std::size_t( width ) * 4u;
+    // 前の行と重なる部分を先頭に寄せる
+    std::uint32_t kept = 0u;
+    if( input_strip_row != ~0u && y0 >= input_strip_y && y0 < input_strip_end ) {
+      kept = std::min( input_strip_end, y1 ) - y0;
+      std::copy(
+        input_strip.begin() + std::size_t( y0 - input_strip_y ) * row_bytes,
+        input_strip.begin() + std::size_t( y0 - input_strip_y + kept ) * row_bytes,
+        input_strip.begin()
+      );
+    }
+    input_strip.resize( std::size_t( y1 - y0 ) * row_bytes );
+    const auto fresh = input_strip.data() + std::size_t( kept ) * row_bytes;
+    if( y0 + kept != y1 ) {
+      std::fill( fresh, input_strip.data() + input_strip.size(), std::uint8_t( 255u ) );
+      // 3チャンネルの画像でもアルファを255にしたRGBAとして並ぶように、1ピクセル毎に4バイト進める
+      if( !input->read_scanlines( 0, 0, y0 + kept, y1, 0, 0, channels, TypeDesc::UINT8, fresh, 4, stride_t( width ) * 4 ) )
+        throw std::runtime_error( "unable to read " + input_filename + " : " + input->geterror() );
+      if( channels < 3u ) {
+        // グレースケール
+        const std::size_t pixels = std::size_t( width ) * ( y1 - y0 - kept );
+        for( std::size_t i = 0u; i != pixels; ++i ) {
+          auto p = fresh + i * 4u;
+          p[ 3 ] = channels == 2u ? p[ 1 ] : 255u;
+          p[ 1 ] = p[ 0 ];
+          p[ 2 ] = p[ 0 ];
+        }
+      }
+    }
+    input_strip_row = row;
+    input_strip_y = y0;
+    input_strip_end = y1;
+  };
+  // 出力画像のタイル1行分
+  // 行の全てのタイルが揃ったら書き出す
+  std::map< std::uint32_t, std::pair< std::vector< std::uint8_t >, std::uint32_t > > output_strips;
+  std::uint32_t next_output_row = 0u;
+  const auto store_tile = [&]( const samples::image_tile_t &tile, const std::uint8_t *data ) {
+    auto &strip = output_strips[ tile.row ];
+    if( strip.first.empty() ) strip.first.resize( std::size_t( width ) * tile.dest_height * 4u );
+    for( std::uint32_t y = 0u; y != tile.dest_height; ++y )
+      std::copy(
+        data + std::size_t( y ) * tile.dest_width * 4u,
+        data + std::size_t( y + 1u ) * tile.dest_width * 4u,
+        strip.first.data() + ( std::size_t( y ) * width + tile.dest_x ) * 4u
+      );
+    ++strip.second;
+    // 行は上から順に完成するので、書き出しも上から順になる
+    while( !output_strips.empty() && output_strips.begin()->first == next_output_row && output_strips.begin()->second.second == tiler.get_columns() ) {
+      const auto y0 = next_output_row * tile_size;
+      const auto y1 = std::min( y0 + tile_size, height );
+      if( !output->write_scanlines( y0, y1, 0, TypeDesc::UINT8, output_strips.begin()->second.first.data() ) )
+        throw std::runtime_error( "unable to write " + output_filename + " : " + output->geterror() );
+      output_strips.erase( output_strips.begin() );
+      ++next_output_row;
+    }
+  };
+
+  std::vector< double > wait_ns;
+  std::vector< double > fill_ns;
+  // スロットのタイルの完了を待ち、結果を出力に書く
+  const auto retire = [&]( slot_t &slot ) {
+    if( !slot.busy ) return;
+    const auto begin_time = std::chrono::high_resolution_clock::now();
+    recycler.wait( slot.command_buffer );
+    const auto end_time = std::chrono::high_resolution_clock::now();
+    wait_ns.push_back( double( std::chrono::duration_cast< std::chrono::nanoseconds >( end_time - begin_time ).count() ) );
+    slot.command_buffer.reset();
+    {
+      auto mapped = slot.readback->map< std::uint8_t >();
+      store_tile( tiler[ slot.tile ], &*mapped.begin() );
+    }
+    slot.busy = false;
+  };
+
+  const auto begin_time = std::chrono::high_resolution_clock::now();
+  for( std::uint32_t index = 0u; index != tiler.size(); ++index ) {
+    auto &slot = slots[ index % slot_count ];
+    // 2つ前のタイルが終わっていればこのスロットを使える
+    retire( slot );
+    const auto tile = tiler[ index ];
+    // 1つ前のタイルをGPUが処理している間に次のタイルを詰める
+    const auto fill_begin = std::chrono::high_resolution_clock::now();
+    load_input_strip( tile.row );
+    {
+      auto mapped = slot.staging->map< std::uint8_t >();
+      for( std::uint32_t y = 0u; y != tile.src_height; ++y ) {
+        const auto src = input_strip.data() + ( std::size_t( tile.src_y - input_strip_y + y ) * width + tile.src_x ) * 4u;
+        std::copy( src, src + std::size_t( tile.src_width ) * 4u, &*mapped.begin() + std::size_t( y ) * tile.src_width * 4u );
+      }
+    }
+    const auto fill_end = std::chrono::high_resolution_clock::now();
+    fill_ns.push_back( double( std::chrono::duration_cast< std::chrono::nanoseconds >( fill_end - fill_begin ).count() ) );
+    const push_constants_t push_constants{
+      { std::int32_t( tile.dest_x - tile.src_x ), std::int32_t( tile.dest_y - tile.src_y ) },
+      { std::int32_t( tile.src_width ), std::int32_t( tile.src_height ) },
+      { std::int32_t( tile.dest_width ), std::int32_t( tile.dest_height ) },
+      std::int32_t( radius )
+    };
+    slot.command_buffer = recycler.acquire();
+    {
+      auto rec = slot.command_buffer->begin();
+      rec->copyBufferToImage(
+        **slot.staging,
+        **slot.src_image,
+        vk::ImageLayout::eGeneral,
+        vk::BufferImageCopy()
+          .setBufferOffset( 0 )
+          .setBufferRowLength( tile.src_width )
+          .setBufferImageHeight( tile.src_height )
+          .setImageSubresource( vk::ImageSubresourceLayers( vk::ImageAspectFlagBits::eColor, 0, 0, 1 ) )
+          .setImageOffset( { 0, 0, 0 } )
+          .setImageExtent( { tile.src_width, tile.src_height, 1 } )
+      );
+      rec->pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlagBits( 0 ),
+        { vk::MemoryBarrier().setSrcAccessMask( vk::AccessFlagBits::eTransferWrite ).setDstAccessMask( vk::AccessFlagBits::eShaderRead ) },
+        {},
+        {}
+      );
+      rec.bind_descriptor_set(
+        vk::PipelineBindPoint::eCompute,
+        pipeline_layout,
+        slot.descriptor_set
+      );
+      rec.bind_pipeline( pipeline );
+      rec->pushConstants(
+        **pipeline_layout,
+        vk::ShaderStageFlagBits::eCompute,
+        0u,
+        sizeof( push_constants_t ),
+        &push_constants
+      );
+      rec->dispatch( ( tile.dest_width + 15u ) / 16u, ( tile.dest_height + 15u ) / 16u, 1u );
+      rec->pipelineBarrier(
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::DependencyFlagBits( 0 ),
+        { vk::MemoryBarrier().setSrcAccessMask( vk::AccessFlagBits::eShaderWrite ).setDstAccessMask( vk::AccessFlagBits::eTransferRead ) },
+        {},
+        {}
+      );
+      rec->copyImageToBuffer(
+        **slot.dest_image,
+        vk::ImageLayout::eGeneral,
+        **slot.readback,
+        vk::BufferImageCopy()
+          .setBufferOffset( 0 )
+          .setBufferRowLength( tile.dest_width )
+          .setBufferImageHeight( tile.dest_height )
+          .setImageSubresource( vk::ImageSubresourceLayers( vk::ImageAspectFlagBits::eColor, 0, 0, 1 ) )
+          .setImageOffset( { 0, 0, 0 } )
+          .setImageExtent( { tile.dest_width, tile.dest_height, 1 } )
+      );
+      // 読み戻したバッファをホストから読めるようにする
+      rec->pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eHost,
+        vk::DependencyFlagBits( 0 ),
+        { vk::MemoryBarrier().setSrcAccessMask( vk::AccessFlagBits::eTransferWrite ).setDstAccessMask( vk::AccessFlagBits::eHostRead ) },
+        {},
+        {}
+      );
+    }
+    recycler.submit( slot.command_buffer );
+    slot.tile = index;
+    slot.busy = true;
+  }
+  // 残っているタイルを投入した順に回収する
+  for( std::uint32_t i = 0u; i != slot_count; ++i )
+    retire( slots[ ( tiler.size() + i ) % slot_count ] );
+  const auto end_time = std::chrono::high_resolution_clock::now();
+  output->close();
+
+  const double elapsed = double( std::chrono::duration_cast< std::chrono::nanoseconds >( end_time - begin_time ).count() );
+  nlohmann::json root;
+  root[ "width" ] = width;
+  root[ "height" ] = height;
+  root[ "tile_size" ] = tile_size;
+  root[ "halo" ] = radius;
+  root[ "tiles" ] = tiler.size();
+  // スロット毎にGPUに置いた資源の大きさ
+  root[ "device_bytes_per_slot" ] =
+    std::uint64_t( max_src_width ) * max_src_height * 4u * 2u +
+    std::uint64_t( max_dest_width ) * max_dest_height * 4u * 2u;
+  root[ "slots" ] = slot_count;
+  root[ "elapsed_ns" ] = elapsed;
+  root[ "megapixels_per_second" ] = double( width ) * height / ( elapsed / 1.0e3 );
+  // waitが短くfillが長ければCPU側が律速している
+  root[ "fill_ns" ] = samples::get_statistics( fill_ns );
+  root[ "wait_ns" ] = samples::get_statistics( wait_ns );
+  root[ "recycler" ] = recycler.dump();
+  std::cout << root.dump( 2 ) << std::endl;
+}
+
@@ -24,6 +24,7 @@
 #include <gct/write_descriptor_set.hpp>
 #include <gct/command_buffer.hpp>
 #include <gct/command_pool.hpp>
+#include <samples/pipeline_cache_store.hpp>
 
 struct spec_t {
   std::uint32_t local_x_size = 0u;
@@ -98,7 +99,8 @@ int main( int argc, const char *argv[] ) {
       .rebuild_chain()
   );
   const auto descriptor_set = descriptor_pool->allocate( descriptor_set_layout );
-  const auto pipeline_cache = device->get_pipeline_cache();
+  // 前回までに作ったパイプラインをファイルから読み戻し、終了時に保存する
+  const samples::persistent_pipeline_cache_t pipeline_cache( device, CMAKE_CURRENT_BINARY_DIR "/pipeline_cache" );
   const auto allocator = device->get_allocator();
 
 
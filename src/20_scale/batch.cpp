@@ -0,0 +1,624 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/program_options.hpp>
+#include <nlohmann/json.hpp>
+#include <OpenImageIO/imageio.h>
+#include <OpenImageIO/version.h>
+#include <gct/get_extensions.hpp>
+#include <gct/instance.hpp>
+#include <gct/queue.hpp>
+#include <gct/device.hpp>
+#include <gct/allocator.hpp>
+#include <gct/device_create_info.hpp>
+#include <gct/image_create_info.hpp>
+#include <gct/buffer.hpp>
+#include <gct/descriptor_pool.hpp>
+#include <gct/descriptor_set_layout.hpp>
+#include <gct/pipeline_cache.hpp>
+#include <gct/pipeline_layout.hpp>
+#include <gct/pipeline_layout_create_info.hpp>
+#include <gct/submit_info.hpp>
+#include <gct/shader_module.hpp>
+#include <gct/compute_pipeline_create_info.hpp>
+#include <gct/compute_pipeline.hpp>
+#include <gct/write_descriptor_set.hpp>
+#include <gct/command_buffer.hpp>
+#include <gct/command_pool.hpp>
+#include <samples/command_buffer_recycler.hpp>
+#include <samples/pipeline_cache_store.hpp>
+#include <samples/statistics.hpp>
+#include <samples/timestamp.hpp>
+
+// 沢山の画像を縮小する
+//
+// 1枚の画像の処理を
+//   デコードしてステージングバッファに書く(デコード用のスレッド)
+//   転送、縮小、読み戻しをGPUで実行する(メインスレッド)
+//   読み戻した画像をエンコードしてファイルに書く(エンコード用のスレッド)
+// の3段に分け、スロット毎に別の画像を流す
+// スロットはステージングバッファ、入出力のイメージ、読み戻し用のバッファ、デスクリプタセット、
+// コマンドバッファとタイムスタンプを1組ずつ持ち、3つ以上あれば3段が同時に動ける
+// スロットはエンコードが終わると空きに戻る
+
+struct spec_t {
+  std::uint32_t local_x_size = 0u;
+  std::uint32_t local_y_size = 0u;
+};
+
+struct push_constants_t {
+  std::int32_t src_size[ 2 ];
+  std::int32_t dest_size[ 2 ];
+};
+
+// スレッドの間で値を受け渡す
+// close()した後は、空になったらpop()がstd::nulloptを返す
+template< typename T >
+class channel_t {
+public:
+  void push( T value ) {
+    {
+      std::lock_guard< std::mutex > lock( guard );
+      queue.push_back( std::move( value ) );
+    }
+    cv.notify_one();
+  }
+  std::optional< T > pop() {
+    std::unique_lock< std::mutex > lock( guard );
+    cv.wait( lock, [&]() { return !queue.empty() || closed; } );
+    if( queue.empty() ) return std::nullopt;
+    T value = std::move( queue.front() );
+    queue.pop_front();
+    return value;
+  }
+  std::optional< T > try_pop() {
+    std::lock_guard< std::mutex > lock( guard );
+    if( queue.empty() ) return std::nullopt;
+    T value = std::move( queue.front() );
+    queue.pop_front();
+    return value;
+  }
+  void close() {
+    {
+      std::lock_guard< std::mutex > lock( guard );
+      closed = true;
+    }
+    cv.notify_all();
+  }
+private:
+  std::mutex guard;
+  std::condition_variable cv;
+  std::deque< T > queue;
+  bool closed = false;
+};
+
+struct slot_t {
+  // 処理中の画像
+  std::filesystem::path path;
+  std::uint32_t src_width = 0u;
+  std::uint32_t src_height = 0u;
+  std::uint32_t dest_width = 0u;
+  std::uint32_t dest_height = 0u;
+  // 入力のイメージとステージングバッファはより大きな画像が来た時に作り直す
+  std::uint32_t src_capacity_width = 0u;
+  std::uint32_t src_capacity_height = 0u;
+  std::shared_ptr< gct::buffer_t > staging;
+  std::shared_ptr< gct::image_t > src_image;
+  std::shared_ptr< gct::image_t > dest_image;
+  std::shared_ptr< gct::buffer_t > readback;
+  std::shared_ptr< gct::descriptor_set_t > descriptor_set;
+  // 作ったばかりでレイアウトを変更する必要がある
+  bool src_fresh = false;
+  bool dest_fresh = false;
+  std::shared_ptr< gct::bound_command_buffer_t > command_buffer;
+  std::shared_ptr< samples::timestamp_t > timestamp;
+  std::chrono::high_resolution_clock::time_point decode_begin;
+};
+
+int main( int argc, const char *argv[] ) {
+  namespace po = boost::program_options;
+  po::options_description desc( "Options" );
+  desc.add_options()
+    ( "help,h", "show this message" )
+    ( "input,i", po::value< std::string >()->default_value( CMAKE_CURRENT_SOURCE_DIR ), "directory or file to resize, or - to read a list of files from stdin" )
+    ( "output,o", po::value< std::string >()->default_value( "thumbnails" ), "output directory" )
+    ( "size,s", po::value< std::uint32_t >()->default_value( 256u ), "length of the longer side of the output images" )
+    ( "slots", po::value< std::uint32_t >()->default_value( 3u ), "images in flight" );
+  po::variables_map vm;
+  po::store( po::parse_command_line( argc, argv, desc ), vm );
+  po::notify( vm );
+  if( vm.count( "help" ) ) {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+  const std::string input = vm[ "input" ].as< std::string >();
+  const std::filesystem::path output_dir = vm[ "output" ].as< std::string >();
+  const auto size = std::max( vm[ "size" ].as< std::uint32_t >(), 1u );
+  const auto slot_count = std::max( vm[ "slots" ].as< std::uint32_t >(), 1u );
+
+  std::vector< std::filesystem::path > inputs;
+  if( input == "-" ) {
+    std::string line;
+    while( std::getline( std::cin, line ) )
+      if( !line.empty() ) inputs.push_back( line );
+  }
+  else if( std::filesystem::is_directory( input ) ) {
+    for( const auto &entry: std::filesystem::directory_iterator( input ) )
+      if( entry.is_regular_file() ) inputs.push_back( entry.path() );
+    std::sort( inputs.begin(), inputs.end() );
+  }
+  else inputs.push_back( input );
+  std::filesystem::create_directories( output_dir );
+
+  const std::shared_ptr< gct::instance_t > instance(
+    new gct::instance_t(
+      gct::instance_create_info_t()
+        .set_application_info(
+          vk::ApplicationInfo()
+            .setPApplicationName( argc ? argv[ 0 ] : "my_application" )
+            .setApplicationVersion(  VK_MAKE_VERSION( 1, 0, 0 ) )
+            .setApiVersion( VK_API_VERSION_1_2 )
+        )
+    )
+  );
+  auto groups = instance->get_physical_devices( {} );
+  auto selected = groups[ 0 ].with_extensions( {} );
+  const auto physical_device = **selected.devices[ 0 ];
+
+  const auto device = selected.create_device(
+    std::vector< gct::queue_requirement_t >{
+      gct::queue_requirement_t{
+        vk::QueueFlagBits::eCompute,
+        0u,
+        vk::Extent3D(),
+#ifdef VK_EXT_GLOBAL_PRIORITY_EXTENSION_NAME
+        vk::QueueGlobalPriorityEXT(),
+#endif
+        {},
+        vk::CommandPoolCreateFlagBits::eResetCommandBuffer
+      }
+    },
+    gct::device_create_info_t()
+  );
+  const auto queue = device->get_queue( 0u );
+  samples::command_buffer_recycler_t recycler( device, queue );
+  const auto shader = device->get_shader_module(
+    CMAKE_CURRENT_BINARY_DIR "/resize.comp.spv"
+  );
+  const auto descriptor_set_layout = device->get_descriptor_set_layout(
+    gct::descriptor_set_layout_create_info_t()
+      .add_binding( shader->get_props().get_reflection() )
+      .rebuild_chain()
+  );
+  const auto pipeline_layout = device->get_pipeline_layout(
+    gct::pipeline_layout_create_info_t()
+      .add_descriptor_set_layout( descriptor_set_layout )
+      .add_push_constant_range(
+        vk::PushConstantRange()
+          .setStageFlags( vk::ShaderStageFlagBits::eCompute )
+          .setOffset( 0 )
+          .setSize( sizeof( push_constants_t ) )
+      )
+  );
+  const auto descriptor_pool = device->get_descriptor_pool(
+    gct::descriptor_pool_create_info_t()
+      .set_basic(
+        vk::DescriptorPoolCreateInfo()
+          .setFlags( vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet )
+          .setMaxSets( slot_count )
+      )
+      .set_descriptor_pool_size( vk::DescriptorType::eStorageImage, 2 * slot_count )
+      .rebuild_chain()
+  );
+  const samples::persistent_pipeline_cache_t pipeline_cache( device, CMAKE_CURRENT_BINARY_DIR "/pipeline_cache" );
+  const auto pipeline = pipeline_cache->get_pipeline(
+    gct::compute_pipeline_create_info_t()
+      .set_stage(
+        gct::pipeline_shader_stage_create_info_t()
+          .set_shader_module( shader )
+          .set_specialization_info(
+            gct::specialization_info_t< spec_t >()
+              .set_data(
+                spec_t{ 16, 16 }
+              )
+              .add_map< std::uint32_t >( 1, offsetof( spec_t, local_x_size ) )
+              .add_map< std::uint32_t >( 2, offsetof( spec_t, local_y_size ) )
+          )
+      )
+      .set_layout( pipeline_layout ),
+    "resize"
+  );
+  const auto allocator = device->get_allocator();
+
+  const auto create_image = [&]( std::uint32_t w, std::uint32_t h, vk::ImageUsageFlags usage ) {
+    return allocator->create_image(
+      gct::image_create_info_t()
+        .set_basic(
+          vk::ImageCreateInfo()
+            .setImageType( vk::ImageType::e2D )
+            .setFormat( vk::Format::eR8G8B8A8Unorm )
+            .setExtent( { w, h, 1 } )
+            .setMipLevels( 1 )
+            .setArrayLayers( 1 )
+            .setSamples( vk::SampleCountFlagBits::e1 )
+            .setTiling( vk::ImageTiling::eOptimal )
+            .setUsage( usage|vk::ImageUsageFlagBits::eStorage )
+            .setInitialLayout( vk::ImageLayout::eUndefined )
+        ),
+        VMA_MEMORY_USAGE_GPU_ONLY
+    );
+  };
+  const auto create_buffer = [&]( vk::DeviceSize buffer_size, vk::BufferUsageFlags usage, VmaMemoryUsage memory_usage ) {
+    return allocator->create_buffer(
+      gct::buffer_create_info_t()
+        .set_basic(
+          vk::BufferCreateInfo()
+            .setSize( buffer_size )
+            .setUsage( usage )
+        ),
+      memory_usage
+    );
+  };
+  const auto get_view = []( const std::shared_ptr< gct::image_t > &image ) {
+    return image->get_view(
+      gct::image_view_create_info_t()
+        .set_basic(
+          vk::ImageViewCreateInfo()
+            .setSubresourceRange(
+              vk::ImageSubresourceRange()
+                .setAspectMask( vk::ImageAspectFlagBits::eColor )
+                .setBaseMipLevel( 0 )
+                .setLevelCount( 1 )
+                .setBaseArrayLayer( 0 )
+                .setLayerCount( 1 )
+            )
+            .setViewType( gct::to_image_view_type( image->get_props().get_basic().imageType, image->get_props().get_basic().arrayLayers ) )
+        )
+        .rebuild_chain()
+    );
+  };
+  const auto update_descriptor_set = [&]( slot_t &slot ) {
+    slot.descriptor_set->update(
+      {
+        gct::write_descriptor_set_t()
+          .set_basic(
+            (*slot.descriptor_set)[ "src_image" ]
+          )
+          .add_image(
+            gct::descriptor_image_info_t()
+              .set_basic(
+                vk::DescriptorImageInfo()
+                  .setImageLayout( vk::ImageLayout::eGeneral )
+              )
+              .set_image_view( get_view( slot.src_image ) )
+          ),
+        gct::write_descriptor_set_t()
+          .set_basic(
+            (*slot.descriptor_set)[ "dest_image" ]
+          )
+          .add_image(
+            gct::descriptor_image_info_t()
+              .set_basic(
+                vk::DescriptorImageInfo()
+                  .setImageLayout( vk::ImageLayout::eGeneral )
+              )
+              .set_image_view( get_view( slot.dest_image ) )
+          )
+      }
+    );
+  };
+
+  // 出力は長辺がsizeになるので、出力側の資源は最初に作っておける
+  std::vector< slot_t > slots( slot_count );
+  channel_t< slot_t* > free_slots;
+  channel_t< slot_t* > decoded;
+  channel_t< slot_t* > completed;
+  for( auto &slot: slots ) {
+    slot.dest_image = create_image( size, size, vk::ImageUsageFlagBits::eTransferSrc );
+    slot.readback = create_buffer( vk::DeviceSize( size ) * size * 4u, vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_TO_CPU );
+    slot.descriptor_set = descriptor_pool->allocate( descriptor_set_layout );
+    slot.dest_fresh = true;
+    slot.timestamp.reset( new samples::timestamp_t( device, physical_device, queue->get_available_queue_family_index(), 2u ) );
+    free_slots.push( &slot );
+  }
+
+  std::mutex stats_guard;
+  std::vector< double > decode_ns;
+  std::vector< double > gpu_ns;
+  std::vector< double > encode_ns;
+  std::vector< double > latency_ns;
+  nlohmann::json errors = nlohmann::json::array();
+  const auto record_error = [&]( const std::filesystem::path &path, const std::string &message ) {
+    std::lock_guard< std::mutex > lock( stats_guard );
+    nlohmann::json error;
+    error[ "path" ] = path.string();
+    error[ "message" ] = message;
+    errors.push_back( error );
+  };
+  const auto elapsed_ns = []( auto begin, auto end ) {
+    return double( std::chrono::duration_cast< std::chrono::nanoseconds >( end - begin ).count() );
+  };
+
+  const auto begin_time = std::chrono::high_resolution_clock::now();
+
+  // 1段目: デコードしてステージングバッファに書く
+  const std::uint32_t max_image_dimension = physical_device.getProperties().limits.maxImageDimension2D;
+  std::thread decoder( [&]() {
+    using namespace OIIO_NAMESPACE;
+    for( const auto &path: inputs ) {
+      auto slot_ = free_slots.pop();
+      if( !slot_ ) break;
+      auto &slot = **slot_;
+      // 1枚の画像の失敗で他の画像の処理を止めない
+      try {
+        const auto decode_begin = std::chrono::high_resolution_clock::now();
+        auto in = ImageInput::open( path.string() );
+        if( !in ) {
+          record_error( path, "unable to open" );
+          free_slots.push( &slot );
+          continue;
+        }
+        const ImageSpec spec = in->spec();
+        if( spec.width <= 0 || spec.height <= 0 ) {
+          record_error( path, "empty image" );
+          free_slots.push( &slot );
+          continue;
+        }
+        const std::uint32_t width = spec.width;
+        const std::uint32_t height = spec.height;
+        const std::uint32_t channels = std::min( spec.nchannels, 4 );
+        if( width > max_image_dimension || height > max_image_dimension ) {
+          record_error( path, "larger than maxImageDimension2D (" + std::to_string( max_image_dimension ) + ")" );
+          free_slots.push( &slot );
+          continue;
+        }
+        if( width > slot.src_capacity_width || height > slot.src_capacity_height ) {
+          // このスロットはGPUで使われていないので作り直してよい
+          // 作るのに失敗した場合に前の資源と大きさが食い違わないように、両方作れてから置き換える
+          const auto capacity_width = std::max( width, slot.src_capacity_width );
+          const auto capacity_height = std::max( height, slot.src_capacity_height );
+          auto staging = create_buffer( vk::DeviceSize( capacity_width ) * capacity_height * 4u, vk::BufferUsageFlagBits::eTransferSrc, VMA_MEMORY_USAGE_CPU_TO_GPU );
+          auto src_image = create_image( capacity_width, capacity_height, vk::ImageUsageFlagBits::eTransferDst );
+          slot.staging = std::move( staging );
+          slot.src_image = std::move( src_image );
+          slot.src_capacity_width = capacity_width;
+          slot.src_capacity_height = capacity_height;
+          slot.src_fresh = true;
+          update_descriptor_set( slot );
+        }
+        bool succeeded = false;
+        {
+          auto mapped = slot.staging->map< std::uint8_t >();
+          auto data = &*mapped.begin();
+          // デコーダにRGBAの並びで直接ステージングバッファに書かせる
+          succeeded = in->read_image( 0, 0, 0, channels, TypeDesc::UINT8, data, 4, stride_t( width ) * 4 );
+          if( succeeded && channels != 4u ) {
+            const std::size_t pixels = std::size_t( width ) * height;
+            for( std::size_t i = 0u; i != pixels; ++i ) {
+              auto p = data + i * 4u;
+              if( channels == 3u ) p[ 3 ] = 255u;
+              else {
+                // グレースケール
+                p[ 3 ] = channels == 2u ? p[ 1 ] : 255u;
+                p[ 1 ] = p[ 0 ];
+                p[ 2 ] = p[ 0 ];
+              }
+            }
+          }
+        }
+        if( !succeeded ) {
+          record_error( path, in->geterror() );
+          free_slots.push( &slot );
+          continue;
+        }
+        slot.path = path;
+        slot.src_width = width;
+        slot.src_height = height;
+        // 長辺をsizeにする
+        if( width >= height ) {
+          slot.dest_width = size;
+          slot.dest_height = std::max( std::uint32_t( std::uint64_t( height ) * size / width ), 1u );
+        }
+        else {
+          slot.dest_width = std::max( std::uint32_t( std::uint64_t( width ) * size / height ), 1u );
+          slot.dest_height = size;
+        }
+        slot.decode_begin = decode_begin;
+        const auto decode_end = std::chrono::high_resolution_clock::now();
+        {
+          std::lock_guard< std::mutex > lock( stats_guard );
+          decode_ns.push_back( elapsed_ns( decode_begin, decode_end ) );
+        }
+        decoded.push( &slot );
+      }
+      catch( const std::exception &e ) {
+        record_error( path, e.what() );
+        free_slots.push( &slot );
+      }
+    }
+    decoded.close();
+  } );
+
+  // 3段目: 読み戻した画像をエンコードする
+  std::thread encoder( [&]() {
+    using namespace OIIO_NAMESPACE;
+    while( auto slot_ = completed.pop() ) {
+      auto &slot = **slot_;
+      const auto encode_begin = std::chrono::high_resolution_clock::now();
+      const auto output_path = output_dir / ( slot.path.stem().string() + ".png" );
+      auto out = ImageOutput::create( output_path.string() );
+      if( !out || !out->open( output_path.string(), ImageSpec( slot.dest_width, slot.dest_height, 4, TypeDesc::UINT8 ) ) ) {
+        record_error( slot.path, "unable to create " + output_path.string() );
+      }
+      else {
+        auto mapped = slot.readback->map< std::uint8_t >();
+        if( !out->write_image( TypeDesc::UINT8, &*mapped.begin() ) )
+          record_error( slot.path, out->geterror() );
+        out->close();
+      }
+      const auto encode_end = std::chrono::high_resolution_clock::now();
+      {
+        std::lock_guard< std::mutex > lock( stats_guard );
+        encode_ns.push_back( elapsed_ns( encode_begin, encode_end ) );
+        latency_ns.push_back( elapsed_ns( slot.decode_begin, encode_end ) );
+      }
+      free_slots.push( &slot );
+    }
+  } );
+
+  // 2段目: 転送、縮小、読み戻しのコマンドを積む
+  // コマンドバッファとフェンスはこのスレッドだけが触る
+  const auto submit = [&]( slot_t &slot ) {
+    const push_constants_t push_constants{
+      { std::int32_t( slot.src_width ), std::int32_t( slot.src_height ) },
+      { std::int32_t( slot.dest_width ), std::int32_t( slot.dest_height ) }
+    };
+    slot.command_buffer = recycler.acquire();
+    {
+      auto rec = slot.command_buffer->begin();
+      slot.timestamp->reset( rec );
+      if( slot.src_fresh ) rec.convert_image( slot.src_image, vk::ImageLayout::eGeneral );
+      if( slot.dest_fresh ) rec.convert_image( slot.dest_image, vk::ImageLayout::eGeneral );
+      slot.src_fresh = false;
+      slot.dest_fresh = false;
+      slot.timestamp->write( rec, 0u, vk::PipelineStageFlagBits::eTopOfPipe );
+      rec->copyBufferToImage(
+        **slot.staging,
+        **slot.src_image,
+        vk::ImageLayout::eGeneral,
+        vk::BufferImageCopy()
+          .setBufferOffset( 0 )
+          .setBufferRowLength( slot.src_width )
+          .setBufferImageHeight( slot.src_height )
+          .setImageSubresource( vk::ImageSubresourceLayers( vk::ImageAspectFlagBits::eColor, 0, 0, 1 ) )
+          .setImageOffset( { 0, 0, 0 } )
+          .setImageExtent( { slot.src_width, slot.src_height, 1 } )
+      );
+      rec->pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlagBits( 0 ),
+        { vk::MemoryBarrier().setSrcAccessMask( vk::AccessFlagBits::eTransferWrite ).setDstAccessMask( vk::AccessFlagBits::eShaderRead ) },
+        {},
+        {}
+      );
+      rec.bind_descriptor_set(
+        vk::PipelineBindPoint::eCompute,
+        pipeline_layout,
+        slot.descriptor_set
+      );
+      rec.bind_pipeline( pipeline );
+      rec->pushConstants(
+        **pipeline_layout,
+        vk::ShaderStageFlagBits::eCompute,
+        0u,
+        sizeof( push_constants_t ),
+        &push_constants
+      );
+      rec->dispatch( ( slot.dest_width + 15u ) / 16u, ( slot.dest_height + 15u ) / 16u, 1u );
+      rec->pipelineBarrier(
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::DependencyFlagBits( 0 ),
+        { vk::MemoryBarrier().setSrcAccessMask( vk::AccessFlagBits::eShaderWrite ).setDstAccessMask( vk::AccessFlagBits::eTransferRead ) },
+        {},
+        {}
+      );
+      rec->copyImageToBuffer(
+        **slot.dest_image,
+        vk::ImageLayout::eGeneral,
+        **slot.readback,
+        vk::BufferImageCopy()
+          .setBufferOffset( 0 )
+          .setBufferRowLength( slot.dest_width )
+          .setBufferImageHeight( slot.dest_height )
+          .setImageSubresource( vk::ImageSubresourceLayers( vk::ImageAspectFlagBits::eColor, 0, 0, 1 ) )
+          .setImageOffset( { 0, 0, 0 } )
+          .setImageExtent( { slot.dest_width, slot.dest_height, 1 } )
+      );
+      rec->pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eHost,
+        vk::DependencyFlagBits( 0 ),
+        { vk::MemoryBarrier().setSrcAccessMask( vk::AccessFlagBits::eTransferWrite ).setDstAccessMask( vk::AccessFlagBits::eHostRead ) },
+        {},
+        {}
+      );
+      slot.timestamp->write( rec, 1u, vk::PipelineStageFlagBits::eBottomOfPipe );
+    }
+    recycler.submit( slot.command_buffer );
+  };
+  // 投入した順に完了を待ってエンコードに回す
+  std::deque< slot_t* > in_flight;
+  const auto retire = [&]() {
+    auto &slot = *in_flight.front();
+    in_flight.pop_front();
+    recycler.wait( slot.command_buffer );
+    slot.command_buffer.reset();
+    if( slot.timestamp->is_available() ) {
+      const auto elapsed = slot.timestamp->get( 2u );
+      std::lock_guard< std::mutex > lock( stats_guard );
+      gpu_ns.push_back( elapsed[ 1 ] );
+    }
+    completed.push( &slot );
+  };
+  for( ;; ) {
+    // デコードが済んだ物があれば先にGPUに積み、無ければ一番古い物の完了を待つ
+    if( auto slot = decoded.try_pop() ) {
+      submit( **slot );
+      in_flight.push_back( *slot );
+      continue;
+    }
+    if( !in_flight.empty() ) {
+      retire();
+      continue;
+    }
+    auto slot = decoded.pop();
+    if( !slot ) break;
+    submit( **slot );
+    in_flight.push_back( *slot );
+  }
+  completed.close();
+  decoder.join();
+  encoder.join();
+  free_slots.close();
+  const auto end_time = std::chrono::high_resolution_clock::now();
+
+  const double wall_ns = elapsed_ns( begin_time, end_time );
+  const auto sum = []( const std::vector< double > &v ) {
+    double total = 0.0;
+    for( const auto &e: v ) total += e;
+    return total;
+  };
+  nlohmann::json root;
+  root[ "inputs" ] = inputs.size();
+  root[ "images" ] = encode_ns.size();
+  root[ "slots" ] = slot_count;
+  root[ "size" ] = size;
+  root[ "elapsed_ns" ] = wall_ns;
+  root[ "images_per_second" ] = double( encode_ns.size() ) / ( wall_ns / 1.0e9 );
+  // 各段が動いていた時間の割合
+  // 一番大きい段が律速している
+  root[ "occupancy" ][ "decode" ] = sum( decode_ns ) / wall_ns;
+  root[ "occupancy" ][ "gpu" ] = gpu_ns.empty() ? nlohmann::json( nullptr ) : nlohmann::json( sum( gpu_ns ) / wall_ns );
+  root[ "occupancy" ][ "encode" ] = sum( encode_ns ) / wall_ns;
+  root[ "decode_ns" ] = samples::get_statistics( decode_ns );
+  root[ "gpu_ns" ] = samples::get_statistics( gpu_ns );
+  root[ "encode_ns" ] = samples::get_statistics( encode_ns );
+  // デコードの開始からエンコードの完了まで
+  root[ "latency_ns" ] = samples::get_statistics( latency_ns );
+  root[ "errors" ] = errors;
+  root[ "recycler" ] = recycler.dump();
+  std::cout << root.dump( 2 ) << std::endl;
+}
+
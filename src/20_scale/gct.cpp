@@ -24,6 +24,8 @@
 #include <gct/write_descriptor_set.hpp>
 #include <gct/command_buffer.hpp>
 #include <gct/command_pool.hpp>
+#include <samples/command_buffer_recycler.hpp>
+#include <samples/pipeline_cache_store.hpp>
 
 struct spec_t {
   std::uint32_t local_x_size = 0u;
@@ -65,6 +67,8 @@ int main( int argc, const char *argv[] ) {
     gct::device_create_info_t()
   );
   const auto queue = device->get_queue( 0u );
+  // 一度だけ使うコマンドバッファは実行が終わったら使い回す
+  samples::command_buffer_recycler_t recycler( device, queue );
   const auto shader = device->get_shader_module(
     CMAKE_CURRENT_BINARY_DIR "/shader.comp.spv"
   );
@@ -89,7 +93,8 @@ int main( int argc, const char *argv[] ) {
       .rebuild_chain()
   );
   const auto descriptor_set = descriptor_pool->allocate( descriptor_set_layout );
-  const auto pipeline_cache = device->get_pipeline_cache();
+  // 前回までに作ったパイプラインをファイルから読み戻し、終了時に保存する
+  const samples::persistent_pipeline_cache_t pipeline_cache( device, CMAKE_CURRENT_BINARY_DIR "/pipeline_cache" );
   const auto allocator = device->get_allocator();
 
 
@@ -185,7 +190,7 @@ int main( int argc, const char *argv[] ) {
 
 
   {
-    const auto command_buffer = queue->get_command_pool()->allocate();
+    const auto command_buffer = recycler.acquire();
     {
       auto rec = command_buffer->begin();
       rec.copy(
@@ -195,10 +200,8 @@ int main( int argc, const char *argv[] ) {
       );
       rec.convert_image( dest_image, vk::ImageLayout::eGeneral );
     }
-    command_buffer->execute(
-      gct::submit_info_t()
-    );
-    command_buffer->wait_for_executed();
+    recycler.submit( command_buffer );
+    recycler.wait( command_buffer );
   }
 
   auto sampler =
@@ -275,7 +278,7 @@ int main( int argc, const char *argv[] ) {
 
   {
 
-    const auto command_buffer = queue->get_command_pool()->allocate();
+    const auto command_buffer = recycler.acquire();
 
     {
       auto rec = command_buffer->begin();
@@ -307,10 +310,8 @@ int main( int argc, const char *argv[] ) {
         dest_buffer
       );
     }
-    command_buffer->execute(
-      gct::submit_info_t()
-    );
-    command_buffer->wait_for_executed();
+    recycler.submit( command_buffer );
+    recycler.wait( command_buffer );
   }
 
   dest_buffer->dump_image( "out.png" );
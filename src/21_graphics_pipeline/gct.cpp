@@ -1,7 +1,6 @@
 #include <iostream>
 #include <unordered_set>
 #include <utility>
-#include <fstream>
 #include <gct/get_extensions.hpp>
 #include <gct/instance.hpp>
 #include <gct/device.hpp>
@@ -9,6 +8,7 @@
 #include <gct/descriptor_pool.hpp>
 #include <gct/descriptor_set_layout.hpp>
 #include <gct/pipeline_cache.hpp>
+#include <samples/pipeline_cache_store.hpp>
 #include <gct/pipeline_layout_create_info.hpp>
 #include <gct/pipeline_viewport_state_create_info.hpp>
 #include <gct/pipeline_dynamic_state_create_info.hpp>
@@ -101,18 +101,14 @@ int main( int argc, const char *argv[] ) {
     vk::Format::eD16Unorm
   );
 
-  std::filesystem::path pipeline_cache_filename(
+  // 既にパイプラインキャッシュを保存したファイルがあったら取り込む
+  // ヘッダが今のデバイスの物と一致しない場合は使わない
+  samples::pipeline_cache_store_t pipeline_cache_store(
+    **device,
     CMAKE_CURRENT_BINARY_DIR "/pipeline_cache"
   );
-  
-  const auto pipeline_cache = device->get_pipeline_cache(
-    std::filesystem::exists( pipeline_cache_filename )  ? 
-      gct::pipeline_cache_create_info_t()
-        .load( pipeline_cache_filename.string() )
-	.rebuild_chain():
-      gct::pipeline_cache_create_info_t()
-        .rebuild_chain()
-  );
+  const auto pipeline_cache = device->get_pipeline_cache();
+  pipeline_cache_store.restore( **pipeline_cache );
 
   // 何もしないステンシルの設定
   const auto stencil_op = vk::StencilOpState()
@@ -216,7 +212,7 @@ int main( int argc, const char *argv[] ) {
       );
   
   // グラフィクスパイプラインを作る
-  auto pipeline = pipeline_cache->get_pipeline(
+  auto pipeline = samples::instrumented_pipeline_cache_t( pipeline_cache ).get_pipeline(
     gct::graphics_pipeline_create_info_t()
       .add_stage( vs )
       .add_stage( fs )
@@ -241,9 +237,7 @@ int main( int argc, const char *argv[] ) {
     std::cout << nlohmann::json( *pipeline->get_props().get_creation_feedback().pPipelineCreationFeedback ).dump( 2 ) << std::endl;
 
   // パイプラインキャッシュをファイルに保存する
-  auto serialized = (*device)->getPipelineCacheData( **pipeline_cache );
-  std::filesystem::remove( pipeline_cache_filename );
-  std::fstream pipeline_cache_output( pipeline_cache_filename.string(), std::ios_base::out );
-  pipeline_cache_output.write( reinterpret_cast< const char* >( serialized.data() ), serialized.size() );
+  // 他のプロセスが保存した内容と合わせて一時ファイルに書き、renameで置き換える
+  pipeline_cache_store.save( **pipeline_cache );
 }
 
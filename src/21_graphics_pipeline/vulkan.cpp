@@ -1,6 +1,5 @@
 #include <cmath>
 #include <iostream>
-#include <fstream>
 #include <nlohmann/json.hpp>
 #include <gct/get_extensions.hpp>
 #include <gct/instance.hpp>
@@ -12,6 +11,7 @@
 #include <gct/swapchain.hpp>
 #include <gct/descriptor_set_layout.hpp>
 #include <gct/pipeline_cache.hpp>
+#include <samples/pipeline_cache_store.hpp>
 #include <gct/pipeline_layout_create_info.hpp>
 #include <gct/buffer_view_create_info.hpp>
 #include <gct/submit_info.hpp>
@@ -84,18 +84,14 @@ int main( int argc, const char *argv[] ) {
       .add_descriptor_set_layout( gct_descriptor_set_layout )
   );
   
-  std::filesystem::path pipeline_cache_filename(
+  // 既にパイプラインキャッシュを保存したファイルがあったら取り込む
+  // ヘッダが今のデバイスの物と一致しない場合は使わない
+  samples::pipeline_cache_store_t pipeline_cache_store(
+    **gct_device,
     CMAKE_CURRENT_BINARY_DIR "/pipeline_cache"
   );
-
-  const auto gct_pipeline_cache = gct_device->get_pipeline_cache(
-    std::filesystem::exists( pipeline_cache_filename )  ? 
-      gct::pipeline_cache_create_info_t()
-        .load( pipeline_cache_filename.string() )
-	.rebuild_chain():
-      gct::pipeline_cache_create_info_t()
-        .rebuild_chain()
-  );
+  const auto gct_pipeline_cache = gct_device->get_pipeline_cache();
+  pipeline_cache_store.restore( **gct_pipeline_cache );
 
   const auto instance = VkInstance( **gct_instance );
   const auto physical_device = VkPhysicalDevice( **gct_physical_device.devices[ 0 ] );
@@ -466,23 +462,8 @@ int main( int argc, const char *argv[] ) {
   std::cout << nlohmann::json( feedback_.back() ).dump( 2 ) << std::endl;
   
   // パイプラインキャッシュをファイルに保存する
-  std::size_t serialized_size = 0u;
-  if( vkGetPipelineCacheData(
-    device,
-    pipeline_cache,
-    &serialized_size,
-    nullptr
-  ) != VK_SUCCESS ) std::abort();
-  std::vector< std::uint8_t > serialized( serialized_size );
-  if( vkGetPipelineCacheData(
-    device,
-    pipeline_cache,
-    &serialized_size,
-    serialized.data()
-  ) != VK_SUCCESS ) std::abort();
-  std::filesystem::remove( pipeline_cache_filename );
-  std::fstream pipeline_cache_output( pipeline_cache_filename.string(), std::ios_base::out );
-  pipeline_cache_output.write( reinterpret_cast< const char* >( serialized.data() ), serialized.size() );
+  // 他のプロセスが保存した内容と合わせて一時ファイルに書き、renameで置き換える
+  pipeline_cache_store.save( vk::PipelineCache( pipeline_cache ) );
  
 }
 
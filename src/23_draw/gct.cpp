@@ -22,6 +22,7 @@
 #include <gct/framebuffer.hpp>
 #include <gct/render_pass.hpp>
 #include <gct/descriptor_pool.hpp>
+#include <samples/pipeline_cache_store.hpp>
 
 int main( int argc, const char *argv[] ) {
   const std::shared_ptr< gct::instance_t > instance(
@@ -129,7 +130,8 @@ int main( int argc, const char *argv[] ) {
       )
     );
 
-  const auto pipeline_cache = device->get_pipeline_cache();
+  // 前回までに作ったパイプラインをファイルから読み戻し、終了時に保存する
+  const samples::persistent_pipeline_cache_t pipeline_cache( device, CMAKE_CURRENT_BINARY_DIR "/pipeline_cache" );
 
   const auto stencil_op = vk::StencilOpState()
     .setCompareOp( vk::CompareOp::eAlways )
@@ -1,4 +1,6 @@
+#include <iostream>
 #include <memory>
+#include <boost/program_options.hpp>
 #include <gct/get_extensions.hpp>
 #include <gct/instance.hpp>
 #include <gct/glfw.hpp>
@@ -31,6 +33,8 @@
 #include <gct/command_pool.hpp>
 #include <gct/framebuffer.hpp>
 #include <gct/render_pass.hpp>
+#include <samples/frame_ring.hpp>
+#include <samples/pipeline_cache_store.hpp>
 
 // スワップチェーンのイメージ毎に持つリソース
 struct fb_resources_t {
@@ -38,18 +42,31 @@ struct fb_resources_t {
   std::shared_ptr< gct::image_t > color;
   // スワップチェーンのイメージへのイメージビューを登録したフレームバッファ
   std::shared_ptr< gct::framebuffer_t > framebuffer;
-  // スワップチェーンのイメージが表示から外れたときに通知されるセマフォ
-  std::shared_ptr< gct::semaphore_t > image_acquired;
-  // 描画を行うコマンドバッファの実行が完了したときに通知されるセマフォ
+  // このイメージへの描画を行うコマンドバッファの実行が完了したときに通知されるセマフォ
   std::shared_ptr< gct::semaphore_t > draw_complete;
-  // 描画に必要なコマンドを積むコマンドバッファ
-  std::shared_ptr< gct::bound_command_buffer_t > command_buffer;
   // 上のフレームバッファを使ってレンダーパスを開始するための設定
   gct::render_pass_begin_info_t render_pass_begin_info;
 };
 
 
 int main( int argc, const char *argv[] ) {
+  namespace po = boost::program_options;
+  po::options_description desc( "Options" );
+  desc.add_options()
+    ( "help,h", "show this message" )
+    ( "frames-in-flight,f", po::value< std::uint32_t >()->default_value( 2u ), "frames submitted to the GPU at the same time" );
+  po::variables_map vm;
+  po::store( po::parse_command_line( argc, argv, desc ), vm );
+  po::notify( vm );
+  if( vm.count( "help" ) ) {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+  const auto frames_in_flight = vm[ "frames-in-flight" ].as< std::uint32_t >();
+  if( frames_in_flight == 0u ) {
+    std::cerr << "frames-in-flight must not be 0" << std::endl;
+    return 1;
+  }
 
   gct::glfw::get();
   std::uint32_t required_extension_count = 0u;
@@ -118,6 +135,8 @@ int main( int argc, const char *argv[] ) {
     gct::device_create_info_t()
   );
   const auto queue = device->get_queue( 0u );
+  // 同時に積むフレームの数はスワップチェーンのイメージの数とは別に決める
+  samples::frame_ring_t ring( device, queue, frames_in_flight );
 
   const auto swapchain = device->get_swapchain( surface );
   const auto swapchain_images = swapchain->get_images();
@@ -133,7 +152,8 @@ int main( int argc, const char *argv[] ) {
       .rebuild_chain()
   );
 
-  const auto pipeline_cache = device->get_pipeline_cache();
+  // 前回までに作ったパイプラインをファイルから読み戻し、終了時に保存する
+  const samples::persistent_pipeline_cache_t pipeline_cache( device, CMAKE_CURRENT_BINARY_DIR "/pipeline_cache" );
 
   VmaAllocatorCreateInfo allocator_create_info{};
   const auto allocator = device->get_allocator(
@@ -172,8 +192,6 @@ int main( int argc, const char *argv[] ) {
         image,
         framebuffer,
         device->get_semaphore(),
-        device->get_semaphore(),
-        queue->get_command_pool()->allocate(),
         gct::render_pass_begin_info_t()
           .set_basic(
             vk::RenderPassBeginInfo()
@@ -327,16 +345,15 @@ int main( int argc, const char *argv[] ) {
       .set_render_pass( render_pass, 0 )
   );
 
-  uint32_t current_frame = 0u;
   while( !close_app ) {
     const auto begin_time = std::chrono::high_resolution_clock::now();
     if( !iconified ) {
-      auto &sync = framebuffers[ current_frame ];
-      sync.command_buffer->wait_for_executed();
-      auto image_index = swapchain->acquire_next_image( sync.image_acquired );
+      // frames_in_flight前のフレームの実行が完了するまで待ってそのフレームの資源を使う
+      const auto &frame = ring.begin();
+      auto image_index = swapchain->acquire_next_image( frame.image_acquired );
       auto &fb = framebuffers[ image_index ];
       {
-        auto recorder = sync.command_buffer->begin();
+        auto recorder = frame.command_buffer->begin();
         auto render_pass_token = recorder.begin_render_pass(
           fb.render_pass_begin_info,
           vk::SubpassContents::eInline
@@ -350,22 +367,18 @@ int main( int argc, const char *argv[] ) {
         recorder.bind_vertex_buffer( vertex_buffer );
         recorder->draw( vertex_count, 1, 0, 0 );
       }
-      sync.command_buffer->execute(
-        gct::submit_info_t()
-          .add_wait_for( sync.image_acquired, vk::PipelineStageFlagBits::eColorAttachmentOutput )
-          .add_signal_to( sync.draw_complete )
-      );
+      // イメージの取得を待って実行し、完了したら描画完了とフレームの完了を通知
+      ring.submit( frame, vk::PipelineStageFlagBits::eColorAttachmentOutput, fb.draw_complete );
       queue->present(
         gct::present_info_t()
-          .add_wait_for( sync.draw_complete )
+          .add_wait_for( fb.draw_complete )
           .add_swapchain( swapchain, image_index )
       );
-      ++current_frame;
-      current_frame %= framebuffers.size();
     }
     glfwPollEvents();
     gct::wait_for_sync( begin_time );
   }
+  ring.wait_idle();
   (*queue)->waitIdle();
 }
 
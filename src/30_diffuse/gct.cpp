@@ -41,6 +41,7 @@
 #include <gct/command_pool.hpp>
 #include <gct/framebuffer.hpp>
 #include <gct/render_pass.hpp>
+#include <samples/pipeline_cache_store.hpp>
 
 struct fb_resources_t {
   std::shared_ptr< gct::image_t > color;
@@ -157,7 +158,8 @@ int main( int argc, const char *argv[] ) {
       .rebuild_chain()
   );
 
-  auto pipeline_cache = device->get_pipeline_cache();
+  // 前回までに作ったパイプラインをファイルから読み戻し、終了時に保存する
+  const samples::persistent_pipeline_cache_t pipeline_cache( device, CMAKE_CURRENT_BINARY_DIR "/pipeline_cache" );
 
   VmaAllocatorCreateInfo allocator_create_info{};
   auto allocator = device->get_allocator(
@@ -43,6 +43,8 @@
 #include <gct/command_pool.hpp>
 #include <gct/framebuffer.hpp>
 #include <gct/render_pass.hpp>
+#include <samples/pipeline_cache_store.hpp>
+#include <samples/texture_loader.hpp>
 
 struct fb_resources_t {
   std::shared_ptr< gct::image_t > color;
@@ -157,7 +159,8 @@ int main( int argc, const char *argv[] ) {
       .rebuild_chain()
   );
 
-  auto pipeline_cache = device->get_pipeline_cache();
+  // 前回までに作ったパイプラインをファイルから読み戻し、終了時に保存する
+  const samples::persistent_pipeline_cache_t pipeline_cache( device, CMAKE_CURRENT_BINARY_DIR "/pipeline_cache" );
 
   VmaAllocatorCreateInfo allocator_create_info{};
   auto allocator = device->get_allocator(
@@ -228,24 +231,6 @@ int main( int argc, const char *argv[] ) {
         host_vertex_buffer.size(),
         vk::BufferUsageFlagBits::eVertexBuffer
       );
-      base_color_image = recorder.load_image(
-        allocator,
-        CMAKE_CURRENT_SOURCE_DIR "/globe_color.png",
-        vk::ImageUsageFlagBits::eSampled,
-        false, gct::integer_attribute_t::srgb
-      );
-      normal_image = recorder.load_image(
-        allocator,
-        CMAKE_CURRENT_SOURCE_DIR "/globe_normal.png",
-        vk::ImageUsageFlagBits::eSampled,
-        false, gct::integer_attribute_t::normalized
-      );
-      roughness_image = recorder.load_image(
-        allocator,
-        CMAKE_CURRENT_SOURCE_DIR "/globe_roughness.png",
-        vk::ImageUsageFlagBits::eSampled,
-        false, gct::integer_attribute_t::normalized
-      );
       recorder.barrier(
         vk::AccessFlagBits::eTransferWrite,
         vk::AccessFlagBits::eVertexAttributeRead,
@@ -253,7 +238,7 @@ int main( int argc, const char *argv[] ) {
         vk::PipelineStageFlagBits::eVertexInput,
         vk::DependencyFlagBits( 0 ),
         { vertex_buffer },
-        { base_color_image, normal_image, roughness_image }
+        {}
       );
     }
     command_buffer->execute(
@@ -261,6 +246,17 @@ int main( int argc, const char *argv[] ) {
     );
     command_buffer->wait_for_executed();
   }
+  // テクスチャはワーカースレッドで並列にデコードし、デコードが終わった物から転送する
+  {
+    samples::texture_loader_t loader( device, queue, allocator );
+    const auto base_color_index = loader.add( CMAKE_CURRENT_SOURCE_DIR "/globe_color.png" );
+    const auto normal_index = loader.add( CMAKE_CURRENT_SOURCE_DIR "/globe_normal.png" );
+    const auto roughness_index = loader.add( CMAKE_CURRENT_SOURCE_DIR "/globe_roughness.png" );
+    const auto images = loader.load();
+    base_color_image = images[ base_color_index ];
+    normal_image = images[ normal_index ];
+    roughness_image = images[ roughness_index ];
+  }
   auto base_color_image_view = base_color_image->get_view(
     gct::image_view_create_info_t()
       .set_basic(
@@ -44,6 +44,9 @@
 #include <gct/command_pool.hpp>
 #include <gct/framebuffer.hpp>
 #include <gct/render_pass.hpp>
+#include <samples/mipmap_generator.hpp>
+#include <samples/pipeline_cache_store.hpp>
+#include <samples/texture_loader.hpp>
 
 struct fb_resources_t {
   std::shared_ptr< gct::image_t > color;
@@ -158,7 +161,8 @@ int main( int argc, const char *argv[] ) {
       .rebuild_chain()
   );
 
-  auto pipeline_cache = device->get_pipeline_cache();
+  // 前回までに作ったパイプラインをファイルから読み戻し、終了時に保存する
+  const samples::persistent_pipeline_cache_t pipeline_cache( device, CMAKE_CURRENT_BINARY_DIR "/pipeline_cache" );
 
   VmaAllocatorCreateInfo allocator_create_info{};
   auto allocator = device->get_allocator(
@@ -215,6 +219,12 @@ int main( int argc, const char *argv[] ) {
 
   const auto [input_assembly,host_vertex_buffer,vertex_count] = gct::primitive::create_sphere( vamap, stride, 12u, 6u );
 
+  samples::mipmap_generator_t mipmap_generator(
+    device,
+    allocator,
+    pipeline_cache.get(),
+    CMAKE_CURRENT_BINARY_DIR "/mipmap.comp.spv"
+  );
   std::shared_ptr< gct::buffer_t > vertex_buffer;
   std::shared_ptr< gct::image_t > base_color_image;
   std::shared_ptr< gct::image_t > normal_image;
@@ -230,30 +240,6 @@ int main( int argc, const char *argv[] ) {
         host_vertex_buffer.size(),
         vk::BufferUsageFlagBits::eVertexBuffer
       );
-      base_color_image = recorder.load_image(
-        allocator,
-        CMAKE_CURRENT_SOURCE_DIR "/globe_color.png",
-        vk::ImageUsageFlagBits::eSampled,
-        false, gct::integer_attribute_t::srgb
-      );
-      normal_image = recorder.load_image(
-        allocator,
-        CMAKE_CURRENT_SOURCE_DIR "/globe_normal.png",
-        vk::ImageUsageFlagBits::eSampled,
-        false, gct::integer_attribute_t::normalized
-      );
-      roughness_image = recorder.load_image(
-        allocator,
-        CMAKE_CURRENT_SOURCE_DIR "/globe_roughness.png",
-        vk::ImageUsageFlagBits::eSampled,
-        false, gct::integer_attribute_t::normalized
-      );
-      environment_image = recorder.load_image(
-        allocator,
-        CMAKE_CURRENT_SOURCE_DIR "/environment.png",
-        vk::ImageUsageFlagBits::eSampled,
-        true, gct::integer_attribute_t::srgb
-      );
       recorder.barrier(
         vk::AccessFlagBits::eTransferWrite,
         vk::AccessFlagBits::eVertexAttributeRead,
@@ -261,7 +247,7 @@ int main( int argc, const char *argv[] ) {
         vk::PipelineStageFlagBits::eVertexInput,
         vk::DependencyFlagBits( 0 ),
         { vertex_buffer },
-        { base_color_image, normal_image, roughness_image, environment_image }
+        {}
       );
     }
     command_buffer->execute(
@@ -269,6 +255,21 @@ int main( int argc, const char *argv[] ) {
     );
     command_buffer->wait_for_executed();
   }
+  // テクスチャはワーカースレッドで並列にデコードし、デコードが終わった物から転送する
+  // ミップマップはレベル毎のblitではなく1回のディスパッチで作る
+  // sRGBの画像は線形の空間で平均し、法線マップは平均した後で正規化する
+  {
+    samples::texture_loader_t loader( device, queue, allocator, &mipmap_generator );
+    const auto base_color_index = loader.add( CMAKE_CURRENT_SOURCE_DIR "/globe_color.png", vk::ImageUsageFlagBits::eSampled, true, samples::mipmap_filter_t::srgb );
+    const auto normal_index = loader.add( CMAKE_CURRENT_SOURCE_DIR "/globe_normal.png", vk::ImageUsageFlagBits::eSampled, true, samples::mipmap_filter_t::normal );
+    const auto roughness_index = loader.add( CMAKE_CURRENT_SOURCE_DIR "/globe_roughness.png", vk::ImageUsageFlagBits::eSampled, true, samples::mipmap_filter_t::linear );
+    const auto environment_index = loader.add( CMAKE_CURRENT_SOURCE_DIR "/environment.png", vk::ImageUsageFlagBits::eSampled, true, samples::mipmap_filter_t::srgb );
+    const auto images = loader.load();
+    base_color_image = images[ base_color_index ];
+    normal_image = images[ normal_index ];
+    roughness_image = images[ roughness_index ];
+    environment_image = images[ environment_index ];
+  }
   auto base_color_image_view = base_color_image->get_view(
     gct::image_view_create_info_t()
       .set_basic(
@@ -284,6 +285,12 @@ int main( int argc, const char *argv[] ) {
           .setViewType( gct::to_image_view_type( base_color_image->get_props().get_basic().imageType, base_color_image->get_props().get_basic().arrayLayers ) )
           .setFormat( vk::Format::eR8G8B8A8Srgb )
       )
+      // イメージはストレージとして書く為にeStorageを持つが、sRGBのフォーマットはストレージイメージにできない
+      // このビューはサンプルするだけなので、ビューの用途をeSampledに絞る
+      .set_usage(
+        vk::ImageViewUsageCreateInfo()
+          .setUsage( vk::ImageUsageFlagBits::eSampled )
+      )
       .rebuild_chain()
   );
   auto normal_image_view = normal_image->get_view(
@@ -0,0 +1,357 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include <boost/program_options.hpp>
+#include <nlohmann/json.hpp>
+#include <OpenImageIO/imageio.h>
+#include <samples/astc_cache.hpp>
+#include <samples/ktx2.hpp>
+
+// add_astcから呼ばれる
+//
+// 画像のミップマップを全てのレベルについて作り、各々をastcencでASTCに変換する
+// 変換結果は入力の画素と設定から求めたキーでキャッシュディレクトリに置き、同じキーの物があればastcencを呼ばない
+// キャッシュに無いレベルは並列に変換する
+// 出力はレベル毎の.astcファイルと、それらをレベル0から順に並べたマニフェスト(JSON)
+// --ktx2を指定した場合は全てのレベルを1つのKTX2ファイルにもまとめる
+
+namespace {
+  struct level_t {
+    std::uint32_t width = 0u;
+    std::uint32_t height = 0u;
+    // 平均を取る空間での値
+    std::vector< float > value;
+    // astcencに渡すRGBA8
+    std::vector< std::uint8_t > pixels;
+    std::string key;
+    std::filesystem::path output;
+    bool hit = false;
+  };
+  float srgb_to_linear( float v ) {
+    return v <= 0.04045f ? v / 12.92f : std::pow( ( v + 0.055f ) / 1.055f, 2.4f );
+  }
+  float linear_to_srgb( float v ) {
+    v = std::clamp( v, 0.f, 1.f );
+    return v <= 0.0031308f ? v * 12.92f : 1.055f * std::pow( v, 1.f / 2.4f ) - 0.055f;
+  }
+  std::uint8_t to_unorm8( float v ) {
+    return std::uint8_t( std::lround( std::clamp( v, 0.f, 1.f ) * 255.f ) );
+  }
+  // RGBA8を平均を取れる空間に移す
+  void decode( samples::astc_role_t role, const std::vector< std::uint8_t > &src, std::vector< float > &dest ) {
+    dest.resize( src.size() );
+    for( std::size_t i = 0u; i != src.size(); ++i ) {
+      const float v = src[ i ] / 255.f;
+      const bool alpha = i % 4u == 3u;
+      if( role == samples::astc_role_t::color && !alpha ) dest[ i ] = srgb_to_linear( v );
+      else if( role == samples::astc_role_t::normal && !alpha ) dest[ i ] = v * 2.f - 1.f;
+      else dest[ i ] = v;
+    }
+  }
+  void encode( samples::astc_role_t role, const std::vector< float > &src, std::vector< std::uint8_t > &dest ) {
+    dest.resize( src.size() );
+    for( std::size_t i = 0u; i != src.size(); i += 4u ) {
+      if( role == samples::astc_role_t::color ) {
+        for( std::size_t c = 0u; c != 3u; ++c ) dest[ i + c ] = to_unorm8( linear_to_srgb( src[ i + c ] ) );
+      }
+      else if( role == samples::astc_role_t::normal ) {
+        // 平均した法線は短くなるので正規化し直す
+        const float l = std::sqrt( src[ i ] * src[ i ] + src[ i + 1 ] * src[ i + 1 ] + src[ i + 2 ] * src[ i + 2 ] );
+        for( std::size_t c = 0u; c != 3u; ++c )
+          dest[ i + c ] = to_unorm8( ( l > 0.f ? src[ i + c ] / l : ( c == 2u ? 1.f : 0.f ) ) * 0.5f + 0.5f );
+      }
+      else {
+        for( std::size_t c = 0u; c != 3u; ++c ) dest[ i + c ] = to_unorm8( src[ i + c ] );
+      }
+      dest[ i + 3 ] = to_unorm8( src[ i + 3 ] );
+    }
+  }
+  // 縦横半分のレベルを作る
+  // 奇数の幅の場合は端のピクセルを繰り返す
+  level_t downsample( const level_t &src ) {
+    level_t dest;
+    dest.width = std::max( src.width / 2u, 1u );
+    dest.height = std::max( src.height / 2u, 1u );
+    dest.value.resize( std::size_t( dest.width ) * dest.height * 4u );
+    for( std::uint32_t y = 0u; y != dest.height; ++y ) {
+      for( std::uint32_t x = 0u; x != dest.width; ++x ) {
+        for( std::uint32_t c = 0u; c != 4u; ++c ) {
+          float sum = 0.f;
+          for( std::uint32_t dy = 0u; dy != 2u; ++dy ) {
+            for( std::uint32_t dx = 0u; dx != 2u; ++dx ) {
+              const auto sx = std::min( x * 2u + dx, src.width - 1u );
+              const auto sy = std::min( y * 2u + dy, src.height - 1u );
+              sum += src.value[ ( std::size_t( sy ) * src.width + sx ) * 4u + c ];
+            }
+          }
+          dest.value[ ( std::size_t( y ) * dest.width + x ) * 4u + c ] = sum * 0.25f;
+        }
+      }
+    }
+    return dest;
+  }
+  std::string quote( const std::filesystem::path &path ) {
+    std::string quoted = "'";
+    for( const auto c: path.string() ) {
+      if( c == '\'' ) quoted += "'\\''";
+      else quoted += c;
+    }
+    return quoted + "'";
+  }
+  // キャッシュのキーに含めるastcencの識別子
+  // astcencを更新した時に古い変換結果を使わないように、実行ファイルの中身から求める
+  // ファイルとして開けない場合(PATHから探される名前の場合)は-versionの出力を使う
+  std::string get_astcenc_id( const std::string &astcenc ) {
+    std::ifstream file( astcenc, std::ios::in|std::ios::binary );
+    if( file ) {
+      const std::vector< char > binary(
+        ( std::istreambuf_iterator< char >( file ) ),
+        std::istreambuf_iterator< char >()
+      );
+      return samples::astc_hash_t().add( binary.data(), binary.size() ).get_hex();
+    }
+    const auto command = quote( astcenc ) + " -version";
+    std::unique_ptr< FILE, decltype( &pclose ) > pipe( popen( command.c_str(), "r" ), &pclose );
+    if( !pipe ) throw std::runtime_error( "unable to run " + command );
+    std::string version;
+    std::array< char, 256u > buffer;
+    while( const auto size = std::fread( buffer.data(), 1u, buffer.size(), pipe.get() ) )
+      version.append( buffer.data(), size );
+    if( version.empty() ) throw std::runtime_error( "unable to get the version of astcenc : " + command );
+    return version;
+  }
+  // 他のプロセスと同じファイルを書いても壊れないように、一時ファイルに書いてから置き換える
+  std::filesystem::path get_temporary( const std::filesystem::path &path ) {
+    return path.string() + ".tmp" + std::to_string( getpid() ) + "_" + std::to_string( std::hash< std::thread::id >()( std::this_thread::get_id() ) );
+  }
+}
+
+int main( int argc, const char *argv[] ) {
+  namespace po = boost::program_options;
+  po::options_description desc( "Options" );
+  desc.add_options()
+    ( "help,h", "show this message" )
+    ( "astcenc", po::value< std::string >(), "path to astcenc" )
+    ( "input,i", po::value< std::string >(), "input image" )
+    ( "output,o", po::value< std::string >(), "output manifest" )
+    ( "ktx2", po::value< std::string >(), "also write all levels into a KTX2 file" )
+    ( "role,r", po::value< std::string >()->default_value( "color" ), "color, normal or roughness" )
+    ( "block,b", po::value< std::string >(), "block size (overrides the role default)" )
+    ( "quality,q", po::value< std::string >(), "astcenc quality (overrides the role default)" )
+    ( "cache,c", po::value< std::string >(), "cache directory" )
+    ( "threads,j", po::value< std::uint32_t >()->default_value( 0u ), "number of threads (0: all cores)" );
+  po::variables_map vm;
+  po::store( po::parse_command_line( argc, argv, desc ), vm );
+  po::notify( vm );
+  if( vm.count( "help" ) || !vm.count( "astcenc" ) || !vm.count( "input" ) || !vm.count( "output" ) || !vm.count( "cache" ) ) {
+    std::cerr << desc << std::endl;
+    return vm.count( "help" ) ? 0 : 1;
+  }
+  try {
+    const std::string astcenc = vm[ "astcenc" ].as< std::string >();
+    const std::filesystem::path input = vm[ "input" ].as< std::string >();
+    const std::filesystem::path output = vm[ "output" ].as< std::string >();
+    const std::filesystem::path cache_dir = vm[ "cache" ].as< std::string >();
+    const auto role = samples::get_astc_role( vm[ "role" ].as< std::string >() );
+    auto settings = samples::get_astc_settings( role );
+    if( vm.count( "block" ) ) settings.block = vm[ "block" ].as< std::string >();
+    if( vm.count( "quality" ) ) settings.quality = vm[ "quality" ].as< std::string >();
+    const std::uint32_t cores = std::max( std::thread::hardware_concurrency(), 1u );
+    const std::uint32_t thread_count = vm[ "threads" ].as< std::uint32_t >() ? vm[ "threads" ].as< std::uint32_t >() : cores;
+    std::filesystem::create_directories( cache_dir );
+
+    // レベル0
+    std::vector< level_t > levels( 1u );
+    {
+      using namespace OIIO_NAMESPACE;
+      auto in = ImageInput::open( input.string() );
+      if( !in ) throw std::runtime_error( "unable to open " + input.string() );
+      const ImageSpec spec = in->spec();
+      if( spec.width <= 0 || spec.height <= 0 ) throw std::runtime_error( "empty image " + input.string() );
+      auto &level = levels[ 0 ];
+      level.width = spec.width;
+      level.height = spec.height;
+      const std::uint32_t channels = std::min( spec.nchannels, 4 );
+      level.pixels.assign( std::size_t( level.width ) * level.height * 4u, 255u );
+      if( !in->read_image( 0, 0, 0, channels, TypeDesc::UINT8, level.pixels.data(), 4, stride_t( level.width ) * 4 ) )
+        throw std::runtime_error( "unable to read " + input.string() + " : " + in->geterror() );
+      if( channels < 3u ) {
+        for( std::size_t i = 0u; i != level.pixels.size(); i += 4u ) {
+          // グレースケール
+          level.pixels[ i + 3 ] = channels == 2u ? level.pixels[ i + 1 ] : 255u;
+          level.pixels[ i + 1 ] = level.pixels[ i ];
+          level.pixels[ i + 2 ] = level.pixels[ i ];
+        }
+      }
+      decode( role, level.pixels, level.value );
+    }
+    // 1x1になるまで縮める
+    while( levels.back().width > 1u || levels.back().height > 1u ) {
+      levels.push_back( downsample( levels.back() ) );
+      encode( role, levels.back().value, levels.back().pixels );
+      levels[ levels.size() - 2u ].value.clear();
+    }
+    levels.back().value.clear();
+
+    // キーにはastcencに渡す画素と設定を全て含める
+    const std::string color_mode = settings.srgb ? "-cs" : "-cl";
+    const auto output_dir = output.parent_path();
+    const auto output_name = output.filename().string();
+    // 出力のファイル名は マニフェストの名前から.jsonを除いた物.レベル.astc
+    const auto output_stem = output_name.size() > 5u && output_name.ends_with( ".json" ) ?
+      output_name.substr( 0u, output_name.size() - 5u ) :
+      output_name;
+    const auto astcenc_id = get_astcenc_id( astcenc );
+    std::vector< std::size_t > misses;
+    for( std::size_t i = 0u; i != levels.size(); ++i ) {
+      auto &level = levels[ i ];
+      level.key = samples::astc_hash_t()
+        .add( astcenc_id )
+        .add( color_mode )
+        .add( settings.block )
+        .add( settings.quality )
+        .add( &level.width, sizeof( level.width ) )
+        .add( &level.height, sizeof( level.height ) )
+        .add( level.pixels.data(), level.pixels.size() )
+        .get_hex();
+      level.output = output_dir / ( output_stem + "." + std::to_string( i ) + ".astc" );
+      const auto cached = cache_dir / ( level.key + ".astc" );
+      if( std::filesystem::exists( cached ) ) {
+        level.hit = true;
+        std::filesystem::copy_file( cached, level.output, std::filesystem::copy_options::overwrite_existing );
+      }
+      else misses.push_back( i );
+    }
+
+    // キャッシュに無いレベルを変換する
+    // レベル0が大半を占めるので、並列に走らせるastcencの数で割ったスレッド数をastcencにも使わせる
+    const std::uint32_t jobs = std::max< std::uint32_t >( std::min< std::size_t >( thread_count, misses.size() ), 1u );
+    const std::uint32_t threads_per_job = std::max( thread_count / jobs, 1u );
+    std::atomic< std::size_t > next( 0u );
+    std::vector< std::exception_ptr > errors( jobs );
+    const auto worker = [&]( std::uint32_t job_index ) {
+      try {
+        for( std::size_t m = next++; m < misses.size(); m = next++ ) {
+          auto &level = levels[ misses[ m ] ];
+          const auto png = get_temporary( level.output ).string() + ".png";
+          {
+            using namespace OIIO_NAMESPACE;
+            auto out = ImageOutput::create( png );
+            if( !out || !out->open( png, ImageSpec( level.width, level.height, 4, TypeDesc::UINT8 ) ) )
+              throw std::runtime_error( "unable to create " + png );
+            if( !out->write_image( TypeDesc::UINT8, level.pixels.data() ) )
+              throw std::runtime_error( "unable to write " + png + " : " + out->geterror() );
+            out->close();
+          }
+          const auto cached = cache_dir / ( level.key + ".astc" );
+          const auto temporary = get_temporary( cached );
+          const auto command =
+            quote( astcenc ) + " " + color_mode + " " + quote( png ) + " " + quote( temporary ) + " " +
+            settings.block + " " + settings.quality + " -j " + std::to_string( threads_per_job ) + " -silent";
+          const int status = std::system( command.c_str() );
+          std::filesystem::remove( png );
+          if( status != 0 ) throw std::runtime_error( "astcenc failed : " + command );
+          std::filesystem::rename( temporary, cached );
+          std::filesystem::copy_file( cached, level.output, std::filesystem::copy_options::overwrite_existing );
+        }
+      }
+      catch( ... ) {
+        errors[ job_index ] = std::current_exception();
+      }
+    };
+    {
+      std::vector< std::thread > threads;
+      for( std::uint32_t i = 1u; i < jobs; ++i )
+        threads.emplace_back( worker, i );
+      worker( 0u );
+      for( auto &t: threads ) t.join();
+    }
+    for( const auto &e: errors )
+      if( e ) std::rethrow_exception( e );
+
+    std::filesystem::path ktx2;
+    if( vm.count( "ktx2" ) ) {
+      ktx2 = vm[ "ktx2" ].as< std::string >();
+      std::vector< std::vector< std::uint8_t > > payloads;
+      std::uint32_t block_width = 0u;
+      std::uint32_t block_height = 0u;
+      for( const auto &level: levels ) {
+        std::ifstream file( level.output, std::ios::in|std::ios::binary );
+        if( !file ) throw std::runtime_error( "unable to open " + level.output.string() );
+        const std::vector< std::uint8_t > data{ std::istreambuf_iterator< char >( file ), std::istreambuf_iterator< char >() };
+        samples::astc_file_header_t header;
+        if( data.size() < sizeof( header ) ) throw std::runtime_error( level.output.string() + " is truncated" );
+        std::memcpy( &header, data.data(), sizeof( header ) );
+        if( header.magic != samples::astc_file_magic ) throw std::runtime_error( level.output.string() + " is not an ASTC file" );
+        if(
+          samples::get_astc_file_size( header.x_size ) != level.width ||
+          samples::get_astc_file_size( header.y_size ) != level.height ||
+          header.block_z != 1u
+        ) throw std::runtime_error( level.output.string() + " does not match the level" );
+        block_width = header.block_x;
+        block_height = header.block_y;
+        payloads.emplace_back( std::next( data.begin(), sizeof( header ) ), data.end() );
+      }
+      const auto format = samples::get_astc_format( block_width, block_height, settings.srgb );
+      if( format == vk::Format::eUndefined ) throw std::runtime_error( "unsupported block size " + settings.block );
+      samples::ktx2_header_t header;
+      header.vk_format = std::uint32_t( format );
+      // 圧縮されたフォーマットの場合は1
+      header.type_size = 1u;
+      header.pixel_width = levels[ 0 ].width;
+      header.pixel_height = levels[ 0 ].height;
+      const auto temporary = get_temporary( ktx2 );
+      samples::write_ktx2( temporary, header, samples::create_astc_dfd( block_width, block_height, settings.srgb ), 16u, payloads );
+      std::filesystem::rename( temporary, ktx2 );
+    }
+
+    nlohmann::json manifest;
+    manifest[ "source" ] = input.filename().string();
+    manifest[ "role" ] = samples::to_string( role );
+    manifest[ "block" ] = settings.block;
+    manifest[ "quality" ] = settings.quality;
+    manifest[ "srgb" ] = settings.srgb;
+    manifest[ "width" ] = levels[ 0 ].width;
+    manifest[ "height" ] = levels[ 0 ].height;
+    manifest[ "levels" ] = nlohmann::json::array();
+    manifest[ "keys" ] = nlohmann::json::array();
+    if( !ktx2.empty() ) manifest[ "ktx2" ] = ktx2.filename().string();
+    for( const auto &level: levels ) {
+      manifest[ "levels" ].push_back( level.output.filename().string() );
+      manifest[ "keys" ].push_back( level.key );
+    }
+    {
+      const auto temporary = get_temporary( output );
+      {
+        std::ofstream file( temporary, std::ios::out|std::ios::trunc );
+        file << manifest.dump( 2 ) << std::endl;
+        if( !file ) throw std::runtime_error( "unable to write " + temporary.string() );
+      }
+      std::filesystem::rename( temporary, output );
+    }
+    std::cout << input.filename().string() << ": " << levels.size() << " levels, " << settings.block << ", "
+      << ( levels.size() - misses.size() ) << " cached, " << misses.size() << " encoded" << std::endl;
+  }
+  catch( const std::exception &e ) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+}
+
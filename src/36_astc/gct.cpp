@@ -5,6 +5,7 @@
 #include <glm/ext/matrix_clip_space.hpp>
 #include <glm/gtx/string_cast.hpp>
 #include <glm/gtx/transform.hpp>
+#include <boost/program_options.hpp>
 #include <gct/get_extensions.hpp>
 #include <gct/setter.hpp>
 #include <gct/instance.hpp>
@@ -43,13 +44,14 @@
 #include <gct/command_pool.hpp>
 #include <gct/framebuffer.hpp>
 #include <gct/render_pass.hpp>
+#include <samples/frame_ring.hpp>
+#include <samples/pipeline_cache_store.hpp>
+#include <samples/astc_transcoder.hpp>
 
 struct fb_resources_t {
   std::shared_ptr< gct::image_t > color;
   std::shared_ptr< gct::framebuffer_t > framebuffer;
-  std::shared_ptr< gct::semaphore_t > image_acquired;
   std::shared_ptr< gct::semaphore_t > draw_complete;
-  std::shared_ptr< gct::bound_command_buffer_t > command_buffer;
   gct::render_pass_begin_info_t render_pass_begin_info;
   std::shared_ptr< gct::descriptor_set_t > descriptor_set;
   std::shared_ptr< gct::buffer_t > uniform_staging;
@@ -73,6 +75,24 @@ struct uniform_t {
 
 
 int main( int argc, const char *argv[] ) {
+  namespace po = boost::program_options;
+  po::options_description desc( "Options" );
+  desc.add_options()
+    ( "help,h", "show this message" )
+    ( "frames-in-flight,f", po::value< std::uint32_t >()->default_value( 2u ), "frames submitted to the GPU at the same time" )
+    ( "force-transcode", po::bool_switch()->default_value( false ), "decode ASTC textures on the GPU even if the device can sample them" );
+  po::variables_map vm;
+  po::store( po::parse_command_line( argc, argv, desc ), vm );
+  po::notify( vm );
+  if( vm.count( "help" ) ) {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+  const auto frames_in_flight = vm[ "frames-in-flight" ].as< std::uint32_t >();
+  if( frames_in_flight == 0u ) {
+    std::cerr << "frames-in-flight must not be 0" << std::endl;
+    return 1;
+  }
 
   gct::glfw::get();
   std::uint32_t required_extension_count = 0u;
@@ -103,6 +123,7 @@ int main( int argc, const char *argv[] ) {
     VK_KHR_SWAPCHAIN_EXTENSION_NAME,
     VK_KHR_SWAPCHAIN_MUTABLE_FORMAT_EXTENSION_NAME
   } );
+  const auto physical_device = **selected.devices[ 0 ];
 
   std::uint32_t width = 1024u;
   std::uint32_t height = 1024u;
@@ -141,6 +162,8 @@ int main( int argc, const char *argv[] ) {
     gct::device_create_info_t()
   );
   auto queue = device->get_queue( 0u );
+  // 同時に積むフレームの数はスワップチェーンのイメージの数とは別に決める
+  samples::frame_ring_t ring( device, queue, frames_in_flight );
 
   auto swapchain = device->get_swapchain( surface );
   auto swapchain_images = swapchain->get_images();
@@ -157,7 +180,8 @@ int main( int argc, const char *argv[] ) {
       .rebuild_chain()
   );
 
-  auto pipeline_cache = device->get_pipeline_cache();
+  // 前回までに作ったパイプラインをファイルから読み戻し、終了時に保存する
+  const samples::persistent_pipeline_cache_t pipeline_cache( device, CMAKE_CURRENT_BINARY_DIR "/pipeline_cache" );
 
   VmaAllocatorCreateInfo allocator_create_info{};
   auto allocator = device->get_allocator(
@@ -219,6 +243,16 @@ int main( int argc, const char *argv[] ) {
   std::shared_ptr< gct::image_t > base_color_image;
   std::shared_ptr< gct::image_t > normal_image;
   std::shared_ptr< gct::image_t > roughness_image;
+  // 全てのミップマップを含むKTX2ファイルを、テクスチャ毎に1回のコピーで転送する
+  // デバイスがASTCをサンプルできない場合はGPUでR8G8B8A8に展開する
+  samples::astc_transcoder_t transcoder(
+    device,
+    physical_device,
+    allocator,
+    pipeline_cache.get(),
+    CMAKE_CURRENT_BINARY_DIR "/astc_decode.comp.spv",
+    vm[ "force-transcode" ].as< bool >()
+  );
   {
     auto command_buffer = queue->get_command_pool()->allocate();
     {
@@ -229,29 +263,20 @@ int main( int argc, const char *argv[] ) {
         host_vertex_buffer.size(),
         vk::BufferUsageFlagBits::eVertexBuffer
       );
-      base_color_image = recorder.load_astc(
-        allocator,
-	{
-        ( tex_dir / "globe_color.png.astc" ).string()
-        },
-        vk::ImageUsageFlagBits::eSampled,
-        true
+      base_color_image = transcoder.load(
+        recorder,
+        tex_dir / "globe_color.png.ktx2",
+        vk::ImageUsageFlagBits::eSampled
       );
-      normal_image = recorder.load_astc(
-        allocator,
-	{
-        ( tex_dir / "globe_normal.png.astc" ).string()
-	},
-        vk::ImageUsageFlagBits::eSampled,
-        false
+      normal_image = transcoder.load(
+        recorder,
+        tex_dir / "globe_normal.png.ktx2",
+        vk::ImageUsageFlagBits::eSampled
       );
-      roughness_image = recorder.load_astc(
-        allocator,
-	{
-        ( tex_dir / "globe_roughness.png.astc" ).string()
-	},
-        vk::ImageUsageFlagBits::eSampled,
-        false
+      roughness_image = transcoder.load(
+        recorder,
+        tex_dir / "globe_roughness.png.ktx2",
+        vk::ImageUsageFlagBits::eSampled
       );
       recorder.barrier(
         vk::AccessFlagBits::eTransferWrite,
@@ -267,6 +292,7 @@ int main( int argc, const char *argv[] ) {
       gct::submit_info_t()
     );
     command_buffer->wait_for_executed();
+    transcoder.release();
   }
   auto base_color_image_view = base_color_image->get_view(
     gct::image_view_create_info_t()
@@ -281,7 +307,13 @@ int main( int argc, const char *argv[] ) {
               .setLayerCount( base_color_image->get_props().get_basic().arrayLayers )
           )
           .setViewType( gct::to_image_view_type( base_color_image->get_props().get_basic().imageType, base_color_image->get_props().get_basic().arrayLayers ) )
-          .setFormat( vk::Format::eR8G8B8A8Srgb )
+          .setFormat( base_color_image->get_props().get_basic().format )
+      )
+      // 展開したイメージはストレージとして書く為にeStorageを持つが、eR8G8B8A8Srgbはストレージイメージにできない
+      // このビューはサンプルするだけなので、ビューの用途をeSampledに絞る
+      .set_usage(
+        vk::ImageViewUsageCreateInfo()
+          .setUsage( vk::ImageUsageFlagBits::eSampled )
       )
       .rebuild_chain()
   );
@@ -298,7 +330,11 @@ int main( int argc, const char *argv[] ) {
               .setLayerCount( normal_image->get_props().get_basic().arrayLayers )
           )
           .setViewType( gct::to_image_view_type( normal_image->get_props().get_basic().imageType, normal_image->get_props().get_basic().arrayLayers ) )
-          .setFormat( vk::Format::eR8G8B8A8Unorm )
+          .setFormat( normal_image->get_props().get_basic().format )
+      )
+      .set_usage(
+        vk::ImageViewUsageCreateInfo()
+          .setUsage( vk::ImageUsageFlagBits::eSampled )
       )
       .rebuild_chain()
   );
@@ -315,7 +351,11 @@ int main( int argc, const char *argv[] ) {
               .setLayerCount( roughness_image->get_props().get_basic().arrayLayers )
           )
           .setViewType( gct::to_image_view_type( roughness_image->get_props().get_basic().imageType, roughness_image->get_props().get_basic().arrayLayers ) )
-          .setFormat( vk::Format::eR8G8B8A8Unorm )
+          .setFormat( roughness_image->get_props().get_basic().format )
+      )
+      .set_usage(
+        vk::ImageViewUsageCreateInfo()
+          .setUsage( vk::ImageUsageFlagBits::eSampled )
       )
       .rebuild_chain()
   );
@@ -435,8 +475,6 @@ int main( int argc, const char *argv[] ) {
         image,
         framebuffer,
         device->get_semaphore(),
-        device->get_semaphore(),
-        queue->get_command_pool()->allocate(),
         gct::render_pass_begin_info_t()
           .set_basic(
             vk::RenderPassBeginInfo()
@@ -559,7 +597,6 @@ int main( int argc, const char *argv[] ) {
     .set_light_pos( glm::vec4( 2.0, -2.0, 2.0, 1.0 ) )
     .set_light_energy( 5.0 );
 
-  uint32_t current_frame = 0u;
   float angle = 0.f;
   while( !close_app ) {
     const auto begin_time = std::chrono::high_resolution_clock::now();
@@ -575,12 +612,11 @@ int main( int argc, const char *argv[] ) {
       );
 
     if( !iconified ) {
-      auto &sync = framebuffers[ current_frame ];
-      sync.command_buffer->wait_for_executed();
-      auto image_index = swapchain->acquire_next_image( sync.image_acquired );
+      const auto &frame = ring.begin();
+      auto image_index = swapchain->acquire_next_image( frame.image_acquired );
       auto &fb = framebuffers[ image_index ];
       {
-        auto recorder = sync.command_buffer->begin();
+        auto recorder = frame.command_buffer->begin();
         recorder.copy(
           uniforms,
           fb.uniform_staging,
@@ -608,22 +644,17 @@ int main( int argc, const char *argv[] ) {
         recorder.bind_vertex_buffer( vertex_buffer );
         recorder->draw( vertex_count, 1, 0, 0 );
       }
-      sync.command_buffer->execute(
-        gct::submit_info_t()
-          .add_wait_for( sync.image_acquired, vk::PipelineStageFlagBits::eColorAttachmentOutput )
-          .add_signal_to( sync.draw_complete )
-      );
+      ring.submit( frame, vk::PipelineStageFlagBits::eColorAttachmentOutput, fb.draw_complete );
       queue->present(
         gct::present_info_t()
-          .add_wait_for( sync.draw_complete )
+          .add_wait_for( fb.draw_complete )
           .add_swapchain( swapchain, image_index )
       );
-      ++current_frame;
-      current_frame %= framebuffers.size();
     }
     glfwPollEvents();
     gct::wait_for_sync( begin_time );
   }
+  ring.wait_idle();
   (*queue)->waitIdle();
 }
 
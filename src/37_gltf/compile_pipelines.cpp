@@ -0,0 +1,222 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/program_options.hpp>
+#include <nlohmann/json.hpp>
+#include <gct/get_extensions.hpp>
+#include <gct/instance.hpp>
+#include <gct/device.hpp>
+#include <gct/device_create_info.hpp>
+#include <gct/descriptor_set_layout.hpp>
+#include <gct/pipeline_cache.hpp>
+#include <gct/graphics_pipeline_create_info.hpp>
+#include <gct/graphics_pipeline.hpp>
+#include <gct/pipeline_shader_stage_create_info.hpp>
+#include <gct/render_pass.hpp>
+#include <gct/shader_module.hpp>
+#include <samples/pipeline_compiler.hpp>
+#include <samples/shader_variant_cache.hpp>
+#include <samples/pipeline_cache_store.hpp>
+#include <samples/gltf_pipelines.hpp>
+
+// shadersにある全てのフラグメントシェーダの変種についてglTFの描画に使うパイプラインを作り、
+// 1スレッドで作った場合と複数のスレッドで作った場合の時間を比べる
+//
+// gct::gltf::load_gltfはシーンが使うパイプラインを読み込みの途中で1つずつ作る
+// ここではそれらを先に全て集めてからpipeline_compiler_tで同時に作る
+int main( int argc, const char *argv[] ) {
+  namespace po = boost::program_options;
+  po::options_description desc( "Options" );
+  desc.add_options()
+    ( "help,h", "show this message" )
+    ( "threads,t", po::value< std::uint32_t >()->default_value( std::max( std::thread::hardware_concurrency(), 1u ) ), "number of compile threads" )
+    ( "serial,s", po::value< bool >()->default_value( true ), "also compile on a single thread for comparison" )
+    ( "uber,u", po::value< bool >()->default_value( true ), "also compile the same feature sets from the specialization constant uber shader" );
+  po::variables_map vm;
+  po::store( po::parse_command_line( argc, argv, desc ), vm );
+  po::notify( vm );
+  if( vm.count( "help" ) ) {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+  const auto thread_count = vm[ "threads" ].as< std::uint32_t >();
+  const auto serial = vm[ "serial" ].as< bool >();
+  const auto uber = vm[ "uber" ].as< bool >();
+
+  const std::shared_ptr< gct::instance_t > instance(
+    new gct::instance_t(
+      gct::instance_create_info_t()
+        .set_application_info(
+          vk::ApplicationInfo()
+            .setPApplicationName( argc ? argv[ 0 ] : "my_application" )
+            .setApplicationVersion(  VK_MAKE_VERSION( 1, 0, 0 ) )
+            .setApiVersion( VK_API_VERSION_1_2 )
+        )
+    )
+  );
+  auto groups = instance->get_physical_devices( {} );
+  auto selected = groups[ 0 ].with_extensions( {
+    VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME
+  } );
+  const auto physical_device_props = selected.devices[ 0 ]->get_props().get_basic();
+
+  const auto device = selected.create_device(
+    std::vector< gct::queue_requirement_t >{
+      gct::queue_requirement_t{
+        vk::QueueFlagBits::eGraphics,
+        0u,
+        vk::Extent3D(),
+#ifdef VK_EXT_GLOBAL_PRIORITY_EXTENSION_NAME
+        vk::QueueGlobalPriorityEXT(),
+#endif
+        {},
+        vk::CommandPoolCreateFlagBits::eResetCommandBuffer
+      }
+    },
+    gct::device_create_info_t()
+  );
+
+  // フレーム毎に変わるユニフォーム
+  const auto dynamic_descriptor_set_layout = device->get_descriptor_set_layout(
+    gct::descriptor_set_layout_create_info_t()
+      .add_binding(
+        vk::DescriptorSetLayoutBinding()
+          .setBinding( 0 )
+          .setDescriptorType( vk::DescriptorType::eUniformBuffer )
+          .setDescriptorCount( 1u )
+          .setStageFlags( vk::ShaderStageFlagBits::eVertex|vk::ShaderStageFlagBits::eFragment )
+      )
+  );
+  // 環境マップ
+  const auto env_descriptor_set_layout = device->get_descriptor_set_layout(
+    gct::descriptor_set_layout_create_info_t()
+      .add_binding(
+        vk::DescriptorSetLayoutBinding()
+          .setBinding( 0 )
+          .setDescriptorType( vk::DescriptorType::eCombinedImageSampler )
+          .setDescriptorCount( 1u )
+          .setStageFlags( vk::ShaderStageFlagBits::eFragment )
+      )
+  );
+  const auto render_pass = device->get_render_pass(
+    vk::Format::eR8G8B8A8Unorm,
+    vk::Format::eD16Unorm
+  );
+
+  const samples::gltf_pipeline_factory_t factory(
+    device,
+    render_pass,
+    CMAKE_CURRENT_BINARY_DIR "/shaders",
+    dynamic_descriptor_set_layout,
+    env_descriptor_set_layout,
+    vk::Extent2D( 1024u, 1024u )
+  );
+  const auto &shader_dir = factory.get_shader_dir();
+
+  std::vector< std::filesystem::path > fragment_shaders;
+  for( const auto &entry: std::filesystem::directory_iterator( shader_dir ) ) {
+    const auto filename = entry.path().filename().string();
+    // uber_world.fragとuber_tangent.fragは変種ではない
+    if( filename.compare( 0u, 5u, "uber_" ) == 0 ) continue;
+    if( filename.size() > 9u && filename.compare( filename.size() - 9u, 9u, ".frag.spv" ) == 0 )
+      fragment_shaders.push_back( entry.path() );
+  }
+  std::sort( fragment_shaders.begin(), fragment_shaders.end() );
+  if( fragment_shaders.empty() ) {
+    std::cerr << "no fragment shaders in " << shader_dir << std::endl;
+    return 1;
+  }
+
+  // シェーダモジュールの読み込みはパイプラインの作成とは別に先に済ませておく
+  std::vector< std::pair< std::string, gct::graphics_pipeline_create_info_t > > create_infos;
+  for( const auto &path: fragment_shaders ) {
+    const auto name = path.filename().string();
+    create_infos.emplace_back( name, factory.get_create_info( name ) );
+  }
+
+  // 他のサンプルと同じ形式で保存されるパイプラインキャッシュ
+  // ここで作ったパイプラインは全てこれに取り込む
+  const samples::persistent_pipeline_cache_t pipeline_cache( device, CMAKE_CURRENT_BINARY_DIR "/pipeline_cache" );
+
+  // 比較の条件を揃える為に毎回空のパイプラインキャッシュから作り、作り終えたら保存する方に取り込む
+  // ドライバが独自にシェーダのキャッシュを持っている場合は2回目以降が速くなる事がある
+  const auto run = [&]( std::uint32_t threads ) {
+    const auto scratch = device->get_pipeline_cache();
+    samples::pipeline_compiler_t compiler( scratch );
+    for( const auto &[name,create_info]: create_infos )
+      compiler.add( name, create_info );
+    compiler.compile( threads );
+    pipeline_cache.merge( scratch );
+    auto result = compiler.dump();
+    auto slowest = compiler.get_results();
+    std::sort(
+      slowest.begin(), slowest.end(),
+      []( const auto &l, const auto &r ) { return l.host_ns > r.host_ns; }
+    );
+    result[ "slowest" ] = nlohmann::json::array();
+    for( std::size_t i = 0u; i != std::min< std::size_t >( slowest.size(), 5u ); ++i ) {
+      nlohmann::json entry;
+      entry[ "name" ] = slowest[ i ].name;
+      entry[ "host_ns" ] = slowest[ i ].host_ns;
+      entry[ "feedback_ns" ] = slowest[ i ].feedback_ns;
+      result[ "slowest" ].push_back( entry );
+    }
+    return result;
+  };
+
+  // 同じ機能の組み合わせをuberシェーダの特殊化定数で作る
+  // 変種のSPIR-Vは2つだけで、パイプラインは初めて要求された時に作られる
+  const auto run_uber = [&]( std::uint32_t threads ) {
+    const auto uber_world_fs = device->get_shader_module( ( shader_dir / "uber_world.frag.spv" ).string() );
+    const auto uber_tangent_fs = device->get_shader_module( ( shader_dir / "uber_tangent.frag.spv" ).string() );
+    const auto scratch = device->get_pipeline_cache();
+    samples::shader_variant_cache_t variants(
+      scratch,
+      [&]( std::uint32_t mask ) {
+        const bool tangent = samples::has_feature( mask, samples::shader_feature_t::tangent );
+        return factory.get_create_info(
+          tangent,
+          gct::pipeline_shader_stage_create_info_t()
+            .set_shader_module( tangent ? uber_tangent_fs : uber_world_fs )
+            .set_specialization_info( samples::get_specialization_info( mask ) )
+        );
+      }
+    );
+    std::atomic< std::size_t > next( 0u );
+    const auto worker = [&]() {
+      for( std::size_t i = next++; i < create_infos.size(); i = next++ )
+        variants.get( samples::get_feature_mask( create_infos[ i ].first ) );
+    };
+    const auto begin_time = std::chrono::high_resolution_clock::now();
+    {
+      std::vector< std::thread > workers;
+      for( std::uint32_t i = 1u; i < threads; ++i )
+        workers.emplace_back( worker );
+      worker();
+      for( auto &w: workers ) w.join();
+    }
+    const auto end_time = std::chrono::high_resolution_clock::now();
+    pipeline_cache.merge( scratch );
+    auto result = variants.dump();
+    result[ "threads" ] = threads;
+    result[ "wall_ns" ] = double( std::chrono::duration_cast< std::chrono::nanoseconds >( end_time - begin_time ).count() );
+    return result;
+  };
+
+  nlohmann::json root;
+  root[ "device" ] = std::string( physical_device_props.deviceName.data() );
+  root[ "variants" ] = create_infos.size();
+  root[ "parallel" ] = run( thread_count );
+  if( serial ) {
+    root[ "serial" ] = run( 1u );
+    root[ "speedup" ] = root[ "serial" ][ "wall_ns" ].get< double >() / root[ "parallel" ][ "wall_ns" ].get< double >();
+  }
+  if( uber ) root[ "uber" ] = run_uber( thread_count );
+  std::cout << root.dump( 2 ) << std::endl;
+}
+
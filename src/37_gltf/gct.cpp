@@ -1,8 +1,11 @@
+#include <algorithm>
 #include <iostream>
+#include <thread>
 #include <unordered_set>
 #include <glm/ext/matrix_transform.hpp>
 #include <glm/ext/matrix_clip_space.hpp>
 #include <glm/gtx/string_cast.hpp>
+#include <boost/program_options.hpp>
 #include <gct/get_extensions.hpp>
 #include <gct/instance.hpp>
 #include <gct/glfw.hpp>
@@ -26,18 +29,41 @@
 #include <gct/command_pool.hpp>
 #include <gct/framebuffer.hpp>
 #include <gct/render_pass.hpp>
+#include <samples/frame_ring.hpp>
+#include <samples/command_buffer_recycler.hpp>
+#include <samples/staging_ring.hpp>
+#include <samples/pipeline_cache_store.hpp>
+#include <samples/pipeline_compiler.hpp>
+#include <samples/gltf_pipelines.hpp>
 
 struct fb_resources_t {
   std::shared_ptr< gct::image_t > color;
   std::shared_ptr< gct::framebuffer_t > framebuffer;
-  std::shared_ptr< gct::semaphore_t > image_acquired;
   std::shared_ptr< gct::semaphore_t > draw_complete;
-  std::shared_ptr< gct::bound_command_buffer_t > command_buffer;
   gct::render_pass_begin_info_t render_pass_begin_info;
-  bool initial = true;
 };
 
 int main( int argc, const char *argv[] ) {
+  namespace po = boost::program_options;
+  po::options_description desc( "Options" );
+  desc.add_options()
+    ( "help,h", "show this message" )
+    ( "frames-in-flight,f", po::value< std::uint32_t >()->default_value( 2u ), "frames submitted to the GPU at the same time" )
+    ( "compile-threads,c", po::value< std::uint32_t >()->default_value( std::max( std::thread::hardware_concurrency(), 1u ) ), "threads used to pre-build the scene's pipelines (0 to skip)" );
+  po::variables_map vm;
+  po::store( po::parse_command_line( argc, argv, desc ), vm );
+  po::notify( vm );
+  if( vm.count( "help" ) ) {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+  const auto frames_in_flight = vm[ "frames-in-flight" ].as< std::uint32_t >();
+  if( frames_in_flight == 0u ) {
+    std::cerr << "frames-in-flight must not be 0" << std::endl;
+    return 1;
+  }
+  const auto compile_threads = vm[ "compile-threads" ].as< std::uint32_t >();
+  const std::string gltf_path = CMAKE_CURRENT_SOURCE_DIR "/gltf/pi_simple.gltf";
 
   gct::glfw::get();
   std::uint32_t required_extension_count = 0u;
@@ -96,7 +122,10 @@ int main( int argc, const char *argv[] ) {
     gct::device_create_info_t()
   );
   auto queue = device->get_queue( 0u );
-  auto gcb = queue->get_command_pool()->allocate();
+  // 同時に積むフレームの数はスワップチェーンのイメージの数とは別に決める
+  samples::frame_ring_t ring( device, queue, frames_in_flight );
+  // 読み込み時に一度だけ使うコマンドバッファは実行が終わったら使い回す
+  samples::command_buffer_recycler_t recycler( device, queue );
 
   auto swapchain = device->get_swapchain( surface );
   auto swapchain_images = swapchain->get_images();
@@ -113,8 +142,6 @@ int main( int argc, const char *argv[] ) {
       .rebuild_chain()
   );
 
-  auto pipeline_cache = device->get_pipeline_cache();
-
   auto render_pass = device->get_render_pass(
     gct::select_simple_surface_format( surface->get_caps().get_formats() ).basic.format,
     vk::Format::eD16Unorm
@@ -137,21 +164,12 @@ int main( int argc, const char *argv[] ) {
           .setStageFlags( vk::ShaderStageFlagBits::eVertex|vk::ShaderStageFlagBits::eFragment )
       )
   );
-  std::vector< std::shared_ptr< gct::buffer_t > > staging_dynamic_uniform;
+  // フレーム毎に変わるユニフォームはリングバッファに書いてから纏めて転送する
+  // 転送先とデスクリプタセットは同時に積むフレームの数だけ用意する
+  samples::staging_ring_t staging_ring( allocator, 64u * 1024u );
   std::vector< std::shared_ptr< gct::buffer_t > > dynamic_uniform;
   std::vector< std::shared_ptr< gct::descriptor_set_t > > dynamic_descriptor_set;
-  for( std::size_t i = 0u; i != swapchain_images.size(); ++i ) {
-    staging_dynamic_uniform.emplace_back(
-      allocator->create_buffer(
-        gct::buffer_create_info_t()
-          .set_basic(
-            vk::BufferCreateInfo()
-              .setSize( sizeof( gct::gltf::dynamic_uniforms_t ) )
-              .setUsage( vk::BufferUsageFlagBits::eTransferSrc )
-          ),
-          VMA_MEMORY_USAGE_CPU_TO_GPU
-       )
-    );
+  for( std::size_t i = 0u; i != ring.get_depth(); ++i ) {
     dynamic_uniform.emplace_back(
       allocator->create_buffer(
         gct::buffer_create_info_t()
@@ -218,8 +236,6 @@ int main( int argc, const char *argv[] ) {
         image,
         framebuffer,
         device->get_semaphore(),
-        device->get_semaphore(),
-        queue->get_command_pool()->allocate(),
         gct::render_pass_begin_info_t()
           .set_basic(
             vk::RenderPassBeginInfo()
@@ -256,7 +272,7 @@ int main( int argc, const char *argv[] ) {
 
   std::shared_ptr< gct::image_t > environment_image;
   {
-    auto command_buffer = queue->get_command_pool()->allocate();
+    const auto command_buffer = recycler.acquire();
     {
       auto recorder = command_buffer->begin();
       environment_image = recorder.load_image(
@@ -275,10 +291,8 @@ int main( int argc, const char *argv[] ) {
         { environment_image }
       );
     }
-    command_buffer->execute(
-      gct::submit_info_t()
-    );
-    command_buffer->wait_for_executed();
+    recycler.submit( command_buffer );
+    recycler.wait( command_buffer );
   }
   
   auto environment_image_view = environment_image->get_view(
@@ -336,32 +350,53 @@ int main( int argc, const char *argv[] ) {
   env_descriptor_set->update( updates );
 
 
-  gct::gltf::document_t doc;
-  {
-    auto rec = gcb->begin();
-    doc = gct::gltf::load_gltf(
-      CMAKE_CURRENT_SOURCE_DIR "/gltf/pi_simple.gltf",
+  // シーンが使う変種のパイプラインを読み込みの前に複数のスレッドで作り、
+  // gct-gltf_compile_pipelinesと共有するパイプラインキャッシュに入れておく
+  // load_gltfはパイプラインキャッシュを受け取らずにパイプラインを1つずつ作るので、
+  // ここで作った物が読み込みを速くするのはドライバが独自のシェーダキャッシュを持っている場合に限られる
+  if( compile_threads ) {
+    const samples::persistent_pipeline_cache_t pipeline_cache( device, CMAKE_CURRENT_BINARY_DIR "/pipeline_cache" );
+    const samples::gltf_pipeline_factory_t factory(
       device,
-      rec,
-      allocator,
-      descriptor_pool,
-      { render_pass },
-      { CMAKE_CURRENT_BINARY_DIR "/shaders" },
-      0,
-      framebuffers.size(),
-      0,
-      float( width ) / float( height ),
-      false,
-      {
-        dynamic_descriptor_set_layout,
-        env_descriptor_set_layout
-      }
+      render_pass,
+      CMAKE_CURRENT_BINARY_DIR "/shaders",
+      dynamic_descriptor_set_layout,
+      env_descriptor_set_layout,
+      vk::Extent2D( width, height )
     );
+    samples::pipeline_compiler_t compiler( pipeline_cache.get() );
+    for( const auto &name: samples::get_gltf_variant_names( gltf_path, true ) )
+      compiler.add( name, factory.get_create_info( name ) );
+    compiler.compile( compile_threads );
+  }
+
+  gct::gltf::document_t doc;
+  {
+    const auto command_buffer = recycler.acquire();
+    {
+      auto rec = command_buffer->begin();
+      doc = gct::gltf::load_gltf(
+        gltf_path,
+        device,
+        rec,
+        allocator,
+        descriptor_pool,
+        { render_pass },
+        { CMAKE_CURRENT_BINARY_DIR "/shaders" },
+        0,
+        framebuffers.size(),
+        0,
+        float( width ) / float( height ),
+        false,
+        {
+          dynamic_descriptor_set_layout,
+          env_descriptor_set_layout
+        }
+      );
+    }
+    recycler.submit( command_buffer );
+    recycler.wait( command_buffer );
   }
-  gcb->execute(
-    gct::submit_info_t()
-  );
-  gcb->wait_for_executed();
 
   auto center = ( doc.node.min + doc.node.max ) / 2.f;
   auto scale = std::abs( glm::length( doc.node.max - doc.node.min ) );
@@ -396,8 +431,6 @@ int main( int argc, const char *argv[] ) {
       pressed_keys.insert( key );
   } );
 
-  uint32_t current_frame = 0u;
-  uint32_t last_image_index = framebuffers.size();
   while( pressed_keys.find( GLFW_KEY_Q ) == pressed_keys.end() ) {
     const auto begin_time = std::chrono::high_resolution_clock::now();
     if( pressed_keys.find( GLFW_KEY_A ) != pressed_keys.end() )
@@ -431,33 +464,28 @@ int main( int argc, const char *argv[] ) {
       camera_pos + camera_direction,
       glm::vec3{ 0.f, camera_pos[ 1 ] + 100.f*scale, 0.f }
     );
-    auto &sync = framebuffers[ current_frame ];
-    if( !sync.initial ) {
-      sync.command_buffer->wait_for_executed();
-    }
-    else sync.initial = false;
-    auto image_index = swapchain->acquire_next_image( sync.image_acquired );
+    const auto &frame = ring.begin();
+    auto image_index = swapchain->acquire_next_image( frame.image_acquired );
     auto &fb = framebuffers[ image_index ];
     {
-      auto rec = sync.command_buffer->begin();
+      auto rec = frame.command_buffer->begin();
       auto dynamic_data = gct::gltf::dynamic_uniforms_t()
         .set_projection_matrix( projection )
         .set_camera_matrix( lookat )
         .set_eye_pos( glm::vec4( camera_pos, 1.0 ) )
         .set_light_pos( glm::vec4( light_pos, 1.0 ) )
         .set_light_energy( light_energy );
-      rec.copy(
-        dynamic_data,
-        staging_dynamic_uniform[ image_index ],
-        dynamic_uniform[ image_index ]
-      );
+      staging_ring.begin_frame( frame.serial, ring.get_completed() );
+      staging_ring.upload( dynamic_data, dynamic_uniform[ frame.index ] );
+      staging_ring.flush( rec );
+      staging_ring.end_frame();
       rec.barrier(
-        vk::AccessFlagBits::eTransferRead,
-        vk::AccessFlagBits::eShaderRead,
+        vk::AccessFlagBits::eTransferWrite,
+        vk::AccessFlagBits::eUniformRead,
         vk::PipelineStageFlagBits::eTransfer,
-        vk::PipelineStageFlagBits::eVertexShader,
+        vk::PipelineStageFlagBits::eVertexShader|vk::PipelineStageFlagBits::eFragmentShader,
         vk::DependencyFlagBits( 0 ),
-        { dynamic_uniform[ image_index ] },
+        { dynamic_uniform[ frame.index ] },
         {}
       );
 
@@ -474,27 +502,21 @@ int main( int argc, const char *argv[] ) {
         doc.buffer,
         0u,
         {
-          dynamic_descriptor_set[ image_index ],
+          dynamic_descriptor_set[ frame.index ],
           env_descriptor_set,
         }
       );
     }
-    sync.command_buffer->execute(
-      gct::submit_info_t()
-        .add_wait_for( sync.image_acquired, vk::PipelineStageFlagBits::eColorAttachmentOutput )
-        .add_signal_to( sync.draw_complete )
-    );
+    ring.submit( frame, vk::PipelineStageFlagBits::eColorAttachmentOutput, fb.draw_complete );
     queue->present(
       gct::present_info_t()
-        .add_wait_for( sync.draw_complete )
+        .add_wait_for( fb.draw_complete )
         .add_swapchain( swapchain, image_index )
     );
-    last_image_index = image_index;
     glfwPollEvents();
-    ++current_frame;
-    current_frame %= framebuffers.size();
     gct::wait_for_sync( begin_time );
   }
+  ring.wait_idle();
   (*queue)->waitIdle();
 }
 
@@ -0,0 +1,59 @@
+// 全てのマテリアルの変種を1つにまとめたフラグメントシェーダ
+// テクスチャの有無とシャドウの有無を特殊化定数で切り替える
+// 特殊化定数の値はパイプラインを作る時に決まるので、使われない分岐はドライバが取り除く
+layout(constant_id = 0) const bool use_base_color = false;
+layout(constant_id = 1) const bool use_metallic_roughness = false;
+layout(constant_id = 2) const bool use_occlusion = false;
+layout(constant_id = 3) const bool use_emissive = false;
+layout(constant_id = 4) const bool use_normal_map = false;
+layout(constant_id = 5) const bool use_shadow = false;
+
+layout(binding = 1) uniform sampler2D base_color;
+layout(binding = 2) uniform sampler2D metallic_roughness;
+layout(binding = 3) uniform sampler2D normal_map;
+layout(binding = 4) uniform sampler2D occlusion;
+layout(binding = 5) uniform sampler2D emissive;
+
+void main()  {
+  vec3 normal = normalize( input_normal.xyz );
+  vec3 pos = input_position.xyz;
+#ifdef USE_TANGENT
+  vec3 tangent = normalize( input_tangent.xyz );
+  vec3 binormal = cross( tangent, normal );
+  mat3 ts = transpose( mat3( tangent, binormal, normal ) );
+  vec3 N = use_normal_map ?
+    normalize( texture( normal_map, input_texcoord ).rgb * vec3( uniforms.normal_scale, uniforms.normal_scale, 1 ) * 2.0 - 1.0 ) :
+    vec3( 0, 0, 1 );
+  vec3 V = ts * normalize( dynamic_uniforms.eye_pos.xyz-pos );
+  vec3 L = ts * normalize( dynamic_uniforms.light_pos.xyz-pos );
+#else
+  vec3 N = normal;
+  vec3 V = normalize( dynamic_uniforms.eye_pos.xyz-pos );
+  vec3 L = normalize( dynamic_uniforms.light_pos.xyz-pos );
+#endif
+  float roughness = uniforms.roughness;
+  float metallicness = uniforms.metalness;
+  if( use_metallic_roughness ) {
+    vec4 mr = texture( metallic_roughness, input_texcoord );
+    roughness *= mr.g;
+    metallicness *= mr.b;
+  }
+  vec4 diffuse_color = uniforms.base_color;
+  if( use_base_color ) diffuse_color *= texture( base_color, input_texcoord );
+  float ambient = 1.0;
+  if( use_occlusion ) ambient *= mix( 1 - uniforms.occlusion_strength, 1, texture( occlusion, input_texcoord ).r );
+  vec3 emissive_color = uniforms.emissive.rgb;
+  if( use_emissive ) emissive_color *= texture( emissive, input_texcoord ).rgb;
+  vec3 WV = normalize( dynamic_uniforms.eye_pos.xyz-pos );
+  vec3 WN = normal;
+  vec3 linear;
+  if( use_shadow ) {
+    float sh = shadow( input_shadow0, input_shadow1, input_shadow2, input_shadow3 );
+    linear = light_with_mask( L, V, N, WV, WN, diffuse_color.rgb, roughness, metallicness, ambient, emissive_color, dynamic_uniforms.light_energy, sh );
+  }
+  else {
+    linear = light( L, V, N, WV, WN, diffuse_color.rgb, roughness, metallicness, ambient, emissive_color, dynamic_uniforms.light_energy );
+  }
+  output_color = vec4( gamma(linear), diffuse_color.a );
+}
+
@@ -0,0 +1,13 @@
+#version 450
+#extension GL_GOOGLE_include_directive : enable
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+#define USE_TANGENT
+#include "io_with_tangent.h"
+#include "constants.h"
+#include "push_constants.h"
+#include "lighting.h"
+#include "shadow.h"
+#include "uber.h"
+
@@ -0,0 +1,515 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <boost/program_options.hpp>
+#include <nlohmann/json.hpp>
+#include <gct/get_extensions.hpp>
+#include <gct/instance.hpp>
+#include <gct/queue.hpp>
+#include <gct/device.hpp>
+#include <gct/allocator.hpp>
+#include <gct/device_create_info.hpp>
+#include <gct/image_create_info.hpp>
+#include <gct/pipeline_cache.hpp>
+#include <gct/pipeline_layout_create_info.hpp>
+#include <gct/submit_info.hpp>
+#include <gct/shader_module_create_info.hpp>
+#include <gct/shader_module.hpp>
+#include <gct/graphics_pipeline_create_info.hpp>
+#include <gct/graphics_pipeline.hpp>
+#include <gct/pipeline_layout.hpp>
+#include <gct/render_pass_begin_info.hpp>
+#include <gct/command_buffer.hpp>
+#include <gct/command_buffer_recorder.hpp>
+#include <gct/command_pool.hpp>
+#include <gct/framebuffer.hpp>
+#include <gct/render_pass.hpp>
+#include <samples/parallel_recorder.hpp>
+#include <samples/statistics.hpp>
+#include <samples/pipeline_cache_store.hpp>
+
+// ノード毎に変わる値
+struct push_constants_t {
+  // xyは平行移動 zは拡大率 wは深度
+  float transform[ 4 ];
+  float color[ 4 ];
+};
+
+int main( int argc, const char *argv[] ) {
+  namespace po = boost::program_options;
+  po::options_description desc( "Options" );
+  desc.add_options()
+    ( "help,h", "show this message" )
+    ( "nodes,n", po::value< std::vector< std::uint32_t > >()->multitoken()->default_value( std::vector< std::uint32_t >{ 1000u, 10000u, 100000u }, "1000 10000 100000" ), "number of nodes to draw" )
+    ( "max-threads,t", po::value< std::uint32_t >()->default_value( std::max( std::thread::hardware_concurrency(), 1u ) ), "maximum number of recording threads" )
+    ( "iterations,i", po::value< std::uint32_t >()->default_value( 20u ), "recordings per configuration" );
+  po::variables_map vm;
+  po::store( po::parse_command_line( argc, argv, desc ), vm );
+  po::notify( vm );
+  if( vm.count( "help" ) ) {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+  const auto node_counts = vm[ "nodes" ].as< std::vector< std::uint32_t > >();
+  const auto max_threads = vm[ "max-threads" ].as< std::uint32_t >();
+  const auto iterations = vm[ "iterations" ].as< std::uint32_t >();
+  if( max_threads == 0u || iterations == 0u ) {
+    std::cerr << "max-threads and iterations must not be 0" << std::endl;
+    return 1;
+  }
+
+  const std::shared_ptr< gct::instance_t > instance(
+    new gct::instance_t(
+      gct::instance_create_info_t()
+        .set_application_info(
+          vk::ApplicationInfo()
+            .setPApplicationName( argc ? argv[ 0 ] : "my_application" )
+            .setApplicationVersion(  VK_MAKE_VERSION( 1, 0, 0 ) )
+            .setApiVersion( VK_API_VERSION_1_2 )
+        )
+    )
+  );
+  auto groups = instance->get_physical_devices( {} );
+  auto selected = groups[ 0 ].with_extensions( {} );
+  const auto physical_device_props = ( **selected.devices[ 0 ] ).getProperties();
+
+  const auto device = selected.create_device(
+    std::vector< gct::queue_requirement_t >{
+      gct::queue_requirement_t{
+        vk::QueueFlagBits::eGraphics,
+        0u,
+        vk::Extent3D(),
+#ifdef VK_EXT_GLOBAL_PRIORITY_EXTENSION_NAME
+        vk::QueueGlobalPriorityEXT(),
+#endif
+        {},
+        vk::CommandPoolCreateFlagBits::eResetCommandBuffer
+      }
+    },
+    gct::device_create_info_t()
+  );
+  const auto queue = device->get_queue( 0u );
+  const auto allocator = device->get_allocator();
+
+  const auto vs = device->get_shader_module(
+    CMAKE_CURRENT_BINARY_DIR "/shader.vert.spv"
+  );
+  const auto fs = device->get_shader_module(
+    CMAKE_CURRENT_BINARY_DIR "/shader.frag.spv"
+  );
+
+  const auto pipeline_layout = device->get_pipeline_layout(
+    gct::pipeline_layout_create_info_t()
+      .add_push_constant_range(
+        vk::PushConstantRange()
+          .setStageFlags( vk::ShaderStageFlagBits::eVertex )
+          .setOffset( 0 )
+          .setSize( sizeof( push_constants_t ) )
+      )
+  );
+
+  const auto render_pass = device->get_render_pass(
+    gct::render_pass_create_info_t()
+      .add_attachment(
+        vk::AttachmentDescription()
+          .setFormat( vk::Format::eR8G8B8A8Unorm )
+          .setSamples( vk::SampleCountFlagBits::e1 )
+          .setLoadOp( vk::AttachmentLoadOp::eClear )
+          .setStoreOp( vk::AttachmentStoreOp::eStore )
+          .setStencilLoadOp( vk::AttachmentLoadOp::eDontCare )
+          .setStencilStoreOp( vk::AttachmentStoreOp::eDontCare )
+          .setInitialLayout( vk::ImageLayout::eUndefined )
+          .setFinalLayout( vk::ImageLayout::eColorAttachmentOptimal )
+      )
+      .add_attachment(
+        vk::AttachmentDescription()
+          .setFormat( vk::Format::eD16Unorm )
+          .setSamples( vk::SampleCountFlagBits::e1 )
+          .setLoadOp( vk::AttachmentLoadOp::eClear )
+          .setStoreOp( vk::AttachmentStoreOp::eDontCare )
+          .setStencilLoadOp( vk::AttachmentLoadOp::eDontCare )
+          .setStencilStoreOp( vk::AttachmentStoreOp::eDontCare )
+          .setInitialLayout( vk::ImageLayout::eUndefined )
+          .setFinalLayout( vk::ImageLayout::eDepthStencilAttachmentOptimal )
+      )
+      .add_subpass(
+        gct::subpass_description_t()
+          .add_color_attachment( 0, vk::ImageLayout::eColorAttachmentOptimal )
+          .set_depth_stencil_attachment( 1, vk::ImageLayout::eDepthStencilAttachmentOptimal )
+          .rebuild_chain()
+      )
+    );
+
+  // 前回までに作ったパイプラインをファイルから読み戻し、終了時に保存する
+  const samples::persistent_pipeline_cache_t pipeline_cache( device, CMAKE_CURRENT_BINARY_DIR "/pipeline_cache" );
+
+  const auto stencil_op = vk::StencilOpState()
+    .setCompareOp( vk::CompareOp::eAlways )
+    .setFailOp( vk::StencilOp::eKeep )
+    .setPassOp( vk::StencilOp::eKeep );
+
+  auto vistat = gct::pipeline_vertex_input_state_create_info_t()
+    .add_vertex_input_binding_description(
+      vk::VertexInputBindingDescription()
+        .setBinding( 0 )
+        .setInputRate( vk::VertexInputRate::eVertex )
+        .setStride( sizeof( float ) * 3 )
+    )
+    .add_vertex_input_attribute_description(
+      vk::VertexInputAttributeDescription()
+        .setLocation( 0 )
+        .setFormat( vk::Format::eR32G32B32Sfloat )
+        .setBinding( 0 )
+        .setOffset( 0 )
+    );
+
+  const auto input_assembly =
+    gct::pipeline_input_assembly_state_create_info_t()
+      .set_basic(
+        vk::PipelineInputAssemblyStateCreateInfo()
+          .setTopology( vk::PrimitiveTopology::eTriangleList )
+      );
+
+  // 記録にかかる時間を測るのが目的なので描画先は小さくてよい
+  const std::uint32_t width = 256u;
+  const std::uint32_t height = 256u;
+
+  const auto viewport =
+    gct::pipeline_viewport_state_create_info_t()
+      .add_viewport(
+        vk::Viewport()
+          .setWidth( width )
+          .setHeight( height )
+          .setMinDepth( 0.0f )
+          .setMaxDepth( 1.0f )
+      )
+      .add_scissor(
+        vk::Rect2D()
+          .setOffset( { 0, 0 } )
+          .setExtent( { width, height } )
+      )
+      .rebuild_chain();
+
+  const auto rasterization =
+    gct::pipeline_rasterization_state_create_info_t()
+      .set_basic(
+        vk::PipelineRasterizationStateCreateInfo()
+          .setDepthClampEnable( false )
+          .setRasterizerDiscardEnable( false )
+          .setPolygonMode( vk::PolygonMode::eFill )
+          .setCullMode( vk::CullModeFlagBits::eNone )
+          .setFrontFace( vk::FrontFace::eClockwise )
+          .setDepthBiasEnable( false )
+          .setLineWidth( 1.0f )
+      );
+
+  const auto multisample =
+    gct::pipeline_multisample_state_create_info_t()
+      .set_basic(
+        vk::PipelineMultisampleStateCreateInfo()
+      );
+
+  const auto depth_stencil =
+    gct::pipeline_depth_stencil_state_create_info_t()
+      .set_basic(
+        vk::PipelineDepthStencilStateCreateInfo()
+          .setDepthTestEnable( true )
+          .setDepthWriteEnable( true )
+          .setDepthCompareOp( vk::CompareOp::eLessOrEqual )
+          .setDepthBoundsTestEnable( false )
+          .setStencilTestEnable( false )
+          .setFront( stencil_op )
+          .setBack( stencil_op )
+      );
+
+  const auto color_blend =
+    gct::pipeline_color_blend_state_create_info_t()
+      .add_attachment(
+        vk::PipelineColorBlendAttachmentState()
+          .setBlendEnable( false )
+          .setColorWriteMask(
+            vk::ColorComponentFlagBits::eR |
+            vk::ColorComponentFlagBits::eG |
+            vk::ColorComponentFlagBits::eB |
+            vk::ColorComponentFlagBits::eA
+          )
+      );
+
+  const auto dynamic =
+    gct::pipeline_dynamic_state_create_info_t();
+
+  const auto pipeline = pipeline_cache->get_pipeline(
+    gct::graphics_pipeline_create_info_t()
+      .add_stage( vs )
+      .add_stage( fs )
+      .set_vertex_input( vistat )
+      .set_input_assembly( input_assembly )
+      .set_viewport( viewport )
+      .set_rasterization( rasterization )
+      .set_multisample( multisample )
+      .set_depth_stencil( depth_stencil )
+      .set_color_blend( color_blend )
+      .set_dynamic( dynamic )
+      .set_layout( pipeline_layout )
+      .set_render_pass( render_pass, 0 )
+  );
+
+  auto dest_image = allocator->create_image(
+    gct::image_create_info_t()
+      .set_basic(
+        vk::ImageCreateInfo()
+          .setImageType( vk::ImageType::e2D )
+          .setFormat( vk::Format::eR8G8B8A8Unorm )
+          .setExtent( { width, height, 1 } )
+          .setUsage(
+            vk::ImageUsageFlagBits::eTransferSrc |
+            vk::ImageUsageFlagBits::eColorAttachment
+          )
+          .setMipLevels( 1 )
+          .setArrayLayers( 1 )
+          .setSamples( vk::SampleCountFlagBits::e1 )
+          .setTiling( vk::ImageTiling::eOptimal )
+          .setInitialLayout( vk::ImageLayout::eUndefined )
+      ),
+    VMA_MEMORY_USAGE_GPU_ONLY
+  );
+
+  const auto dest_buffer = allocator->create_pixel_buffer(
+    vk::BufferUsageFlagBits::eTransferDst,
+    VMA_MEMORY_USAGE_GPU_TO_CPU,
+    dest_image->get_props().get_basic().extent,
+    vk::Format::eR8G8B8A8Unorm
+  );
+
+  auto depth = allocator->create_image(
+    gct::image_create_info_t()
+      .set_basic(
+        vk::ImageCreateInfo()
+          .setImageType( vk::ImageType::e2D )
+          .setFormat( vk::Format::eD16Unorm )
+          .setExtent( dest_image->get_props().get_basic().extent )
+          .setUsage( vk::ImageUsageFlagBits::eDepthStencilAttachment )
+          .setMipLevels( 1 )
+          .setArrayLayers( 1 )
+          .setSamples( vk::SampleCountFlagBits::e1 )
+          .setTiling( vk::ImageTiling::eOptimal )
+          .setInitialLayout( vk::ImageLayout::eUndefined )
+      ),
+    VMA_MEMORY_USAGE_GPU_ONLY
+  );
+
+  auto depth_view = depth->get_view( vk::ImageAspectFlagBits::eDepth );
+  auto color_view = dest_image->get_view( vk::ImageAspectFlagBits::eColor );
+
+  auto framebuffer = render_pass->get_framebuffer(
+    gct::framebuffer_create_info_t()
+      .add_attachment( color_view )
+      .add_attachment( depth_view )
+  );
+
+  const auto command_buffer = queue->get_command_pool()->allocate();
+  std::shared_ptr< gct::buffer_t > vertex_buffer;
+  {
+    auto rec = command_buffer->begin();
+    const std::vector< float > vertex{
+      0.f, 0.f, 0.f,
+      1.f, 0.f, 0.f,
+      0.f, 1.f, 0.f
+    };
+    vertex_buffer = rec.load_buffer(
+      allocator,
+      vertex.data(),
+      sizeof( float ) * vertex.size(),
+      vk::BufferUsageFlagBits::eVertexBuffer
+    );
+    rec.barrier(
+      vk::AccessFlagBits::eTransferWrite,
+      vk::AccessFlagBits::eVertexAttributeRead,
+      vk::PipelineStageFlagBits::eTransfer,
+      vk::PipelineStageFlagBits::eVertexInput,
+      vk::DependencyFlagBits( 0 ),
+      { vertex_buffer },
+      {}
+    );
+  }
+  command_buffer->execute(
+    gct::submit_info_t()
+  );
+  command_buffer->wait_for_executed();
+
+  const auto render_pass_begin_info = gct::render_pass_begin_info_t()
+    .set_basic(
+      vk::RenderPassBeginInfo()
+        .setRenderPass( **render_pass )
+        .setFramebuffer( **framebuffer )
+        .setRenderArea( vk::Rect2D( vk::Offset2D(0, 0), vk::Extent2D( width, height ) ) )
+    )
+    .add_clear_value( vk::ClearColorValue( std::array< float, 4u >{ 1.0f, 1.0f, 1.0f, 1.0f } ) )
+    .add_clear_value( vk::ClearDepthStencilValue( 1.f, 0 ) )
+    .rebuild_chain();
+
+  // セカンダリコマンドバッファはパイプラインや頂点バッファの状態を引き継がないので
+  // 範囲毎に設定し直す
+  const auto record_nodes = [&]( vk::CommandBuffer cb, const std::vector< push_constants_t > &nodes, std::size_t begin, std::size_t end ) {
+    cb.bindPipeline( vk::PipelineBindPoint::eGraphics, **pipeline );
+    cb.bindVertexBuffers( 0, { **vertex_buffer }, { 0 } );
+    for( std::size_t i = begin; i != end; ++i ) {
+      cb.pushConstants(
+        **pipeline_layout,
+        vk::ShaderStageFlagBits::eVertex,
+        0u,
+        sizeof( push_constants_t ),
+        &nodes[ i ]
+      );
+      cb.draw( 3, 1, 0, 0 );
+    }
+  };
+
+  // 描画したイメージを読み戻す
+  const auto read_back = [&]( vk::SubpassContents contents, const std::function< void( gct::command_buffer_recorder_t& ) > &draw ) {
+    {
+      auto rec = command_buffer->begin();
+      // 前回の読み戻しでコピー元にしたレイアウトを戻しておく
+      rec.convert_image(
+        dest_image,
+        vk::ImageLayout::eColorAttachmentOptimal
+      );
+      {
+        auto render_pass_token = rec.begin_render_pass(
+          render_pass_begin_info,
+          contents
+        );
+        draw( rec );
+      }
+      rec.barrier(
+        vk::AccessFlagBits::eColorAttachmentWrite,
+        vk::AccessFlagBits::eTransferRead,
+        vk::PipelineStageFlagBits::eColorAttachmentOutput,
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::DependencyFlagBits( 0 ),
+        {},
+        { dest_image }
+      );
+      rec.convert_image(
+        dest_image,
+        vk::ImageLayout::eTransferSrcOptimal
+      );
+      rec.copy(
+        dest_image,
+        dest_buffer
+      );
+    }
+    command_buffer->execute(
+      gct::submit_info_t()
+    );
+    command_buffer->wait_for_executed();
+    auto mapped = dest_buffer->map< std::uint8_t >();
+    return std::vector< std::uint8_t >( mapped.begin(), mapped.end() );
+  };
+
+  const auto elapsed_ns = []( auto begin_time, auto end_time ) {
+    return double( std::chrono::duration_cast< std::chrono::nanoseconds >( end_time - begin_time ).count() );
+  };
+
+  nlohmann::json root;
+  root[ "device" ] = std::string( physical_device_props.deviceName.data() );
+  root[ "iterations" ] = iterations;
+  root[ "results" ] = nlohmann::json::array();
+  bool correct = true;
+  for( const auto node_count: node_counts ) {
+    // ノードを格子状に並べる
+    // 後のノードほど手前に描くので、描く順序が変わると結果が変わる
+    std::vector< push_constants_t > nodes( node_count );
+    const std::uint32_t columns = std::max( std::uint32_t( std::ceil( std::sqrt( double( node_count ) ) ) ), 1u );
+    for( std::uint32_t i = 0u; i != node_count; ++i ) {
+      const float size = 2.f / columns;
+      nodes[ i ] = push_constants_t{
+        {
+          -1.f + size * ( i % columns ),
+          -1.f + size * ( i / columns ),
+          size * 1.5f,
+          1.f - float( i + 1u ) / float( node_count + 1u )
+        },
+        {
+          float( i % 7u ) / 6.f,
+          float( i % 5u ) / 4.f,
+          float( i % 3u ) / 2.f,
+          1.f
+        }
+      };
+    }
+    nlohmann::json result;
+    result[ "nodes" ] = node_count;
+
+    // 比較の為の1スレッドでプライマリコマンドバッファに直接記録する場合
+    std::vector< double > inline_ns;
+    std::vector< std::uint8_t > expected;
+    for( std::uint32_t i = 0u; i != iterations; ++i ) {
+      expected = read_back(
+        vk::SubpassContents::eInline,
+        [&]( gct::command_buffer_recorder_t& ) {
+          const auto begin_time = std::chrono::high_resolution_clock::now();
+          record_nodes( **command_buffer, nodes, 0u, nodes.size() );
+          const auto end_time = std::chrono::high_resolution_clock::now();
+          inline_ns.push_back( elapsed_ns( begin_time, end_time ) );
+        }
+      );
+    }
+    result[ "inline_ns" ] = samples::get_statistics( inline_ns );
+
+    result[ "secondary" ] = nlohmann::json::array();
+    for( std::uint32_t thread_count = 1u; thread_count <= max_threads; ++thread_count ) {
+      samples::parallel_recorder_t recorder(
+        device,
+        queue->get_available_queue_family_index(),
+        thread_count
+      );
+      const auto inheritance = vk::CommandBufferInheritanceInfo()
+        .setRenderPass( **render_pass )
+        .setSubpass( 0u )
+        .setFramebuffer( **framebuffer );
+      std::vector< double > record_ns;
+      bool same = true;
+      for( std::uint32_t i = 0u; i != iterations; ++i ) {
+        const auto begin_time = std::chrono::high_resolution_clock::now();
+        const auto secondary = recorder.record(
+          0u,
+          inheritance,
+          nodes.size(),
+          [&]( vk::CommandBuffer cb, std::size_t begin, std::size_t end ) {
+            record_nodes( cb, nodes, begin, end );
+          }
+        );
+        const auto end_time = std::chrono::high_resolution_clock::now();
+        record_ns.push_back( elapsed_ns( begin_time, end_time ) );
+        const auto image = read_back(
+          vk::SubpassContents::eSecondaryCommandBuffers,
+          [&]( gct::command_buffer_recorder_t &rec ) {
+            rec->executeCommands( secondary );
+          }
+        );
+        // 分けて記録しても1スレッドで記録した場合と同じ絵になる事を確かめる
+        if( i == 0u ) same = image == expected;
+      }
+      correct = correct && same;
+      nlohmann::json entry;
+      entry[ "threads" ] = thread_count;
+      entry[ "correct" ] = same;
+      const auto stats = samples::get_statistics( record_ns );
+      entry[ "record_ns" ] = stats;
+      entry[ "nodes_per_sec" ] = double( node_count ) * 1.0e9 / stats.mean;
+      entry[ "speedup" ] = samples::get_statistics( inline_ns ).mean / stats.mean;
+      result[ "secondary" ].push_back( entry );
+    }
+    root[ "results" ].push_back( result );
+  }
+  root[ "correct" ] = correct;
+  std::cout << root.dump( 2 ) << std::endl;
+  return correct ? 0 : 1;
+}
+
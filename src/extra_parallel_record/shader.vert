@@ -0,0 +1,24 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+layout (location = 0) in vec3 input_position;
+layout (location = 0) out vec3 output_color;
+out gl_PerVertex
+{
+    vec4 gl_Position;
+};
+
+// ノード毎に変わる値
+layout(push_constant) uniform PushConstants {
+  // xyは平行移動 zは拡大率 wは深度
+  vec4 transform;
+  vec4 color;
+} push_constants;
+
+void main() {
+  output_color = push_constants.color.rgb;
+  gl_Position = vec4( input_position.xy * push_constants.transform.z + push_constants.transform.xy, push_constants.transform.w, 1.0 );
+}
+
@@ -30,6 +30,7 @@
 #include <vulkan2json/PipelineCreationFeedbackEXT.hpp>
 #include <vulkan2json/PipelineExecutablePropertiesKHR.hpp>
 #include <vulkan2json/PipelineExecutableInternalRepresentationKHR.hpp>
+#include <samples/pipeline_cache_store.hpp>
 
 int main( int argc, const char *argv[] ) {
   const std::shared_ptr< gct::instance_t > instance(
@@ -105,7 +106,7 @@ int main( int argc, const char *argv[] ) {
   );
 
   
-  const auto pipeline_cache = device->get_pipeline_cache();
+  const samples::persistent_pipeline_cache_t pipeline_cache( device, CMAKE_CURRENT_BINARY_DIR "/pipeline_cache" );
 
   // 何もしないステンシルの設定
   const auto stencil_op = vk::StencilOpState()
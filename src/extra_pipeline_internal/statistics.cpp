@@ -0,0 +1,353 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <boost/program_options.hpp>
+#include <nlohmann/json.hpp>
+#include <gct/get_extensions.hpp>
+#include <gct/instance.hpp>
+#include <gct/device.hpp>
+#include <gct/device_create_info.hpp>
+#include <gct/descriptor_set_layout.hpp>
+#include <gct/pipeline_cache.hpp>
+#include <gct/pipeline_layout_create_info.hpp>
+#include <gct/pipeline_viewport_state_create_info.hpp>
+#include <gct/pipeline_dynamic_state_create_info.hpp>
+#include <gct/pipeline_input_assembly_state_create_info.hpp>
+#include <gct/pipeline_vertex_input_state_create_info.hpp>
+#include <gct/pipeline_multisample_state_create_info.hpp>
+#include <gct/pipeline_rasterization_state_create_info.hpp>
+#include <gct/pipeline_depth_stencil_state_create_info.hpp>
+#include <gct/pipeline_color_blend_state_create_info.hpp>
+#include <gct/pipeline_shader_stage_create_info.hpp>
+#include <gct/graphics_pipeline_create_info.hpp>
+#include <gct/graphics_pipeline.hpp>
+#include <gct/compute_pipeline_create_info.hpp>
+#include <gct/compute_pipeline.hpp>
+#include <gct/pipeline_layout.hpp>
+#include <gct/render_pass.hpp>
+#include <gct/shader_module.hpp>
+#include <gct/vertex_attributes.hpp>
+#include <samples/pipeline_statistics.hpp>
+#include <samples/pipeline_telemetry.hpp>
+
+// ビルドされた全てのシェーダからパイプラインを作り、VK_KHR_pipeline_executable_propertiesの統計情報を集める
+//
+// --outputを指定すると結果を基準としてファイルに書く
+// --baselineを指定すると基準と比べ、許容量を超えて増えた統計があれば報告して1で終了する
+//
+// .comp.spvからはコンピュートパイプラインを作る
+// .frag.spvからは同じディレクトリの頂点シェーダと組み合わせたグラフィクスパイプラインを作る
+// 頂点シェーダはファイル名の最初の_までが一致する物を優先し、無ければディレクトリにある最初の物を使う
+// デスクリプタセットレイアウトはシェーダのリフレクションから作るので、作れないパイプラインはerrorsに記録して飛ばす
+int main( int argc, const char *argv[] ) {
+  namespace po = boost::program_options;
+  po::options_description desc( "Options" );
+  desc.add_options()
+    ( "help,h", "show this message" )
+    ( "dir,d", po::value< std::string >()->default_value( CMAKE_BINARY_DIR "/src" ), "directory to search .spv files" )
+    ( "output,o", po::value< std::string >(), "write the statistics to this file as a new baseline" )
+    ( "baseline,b", po::value< std::string >(), "compare the statistics with this baseline" )
+    ( "threshold,t", po::value< double >()->default_value( 0.1 ), "allowed relative increase of each statistic" )
+    ( "statistic-threshold,s", po::value< std::vector< std::string > >()->multitoken(), "allowed relative increase of a specific statistic in NAME=RATIO form" );
+  po::variables_map vm;
+  po::store( po::parse_command_line( argc, argv, desc ), vm );
+  po::notify( vm );
+  if( vm.count( "help" ) ) {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+  const std::filesystem::path root_dir( vm[ "dir" ].as< std::string >() );
+  samples::statistics_threshold_t threshold;
+  threshold.default_ratio = vm[ "threshold" ].as< double >();
+  if( vm.count( "statistic-threshold" ) ) {
+    for( const auto &s: vm[ "statistic-threshold" ].as< std::vector< std::string > >() ) {
+      const auto eq = s.rfind( '=' );
+      if( eq == std::string::npos ) {
+        std::cerr << "invalid statistic threshold " << s << std::endl;
+        return 1;
+      }
+      threshold.ratio[ s.substr( 0u, eq ) ] = std::stod( s.substr( eq + 1u ) );
+    }
+  }
+
+  const std::shared_ptr< gct::instance_t > instance(
+    new gct::instance_t(
+      gct::instance_create_info_t()
+        .set_application_info(
+          vk::ApplicationInfo()
+            .setPApplicationName( argc ? argv[ 0 ] : "my_application" )
+            .setApplicationVersion(  VK_MAKE_VERSION( 1, 0, 0 ) )
+            .setApiVersion( VK_API_VERSION_1_2 )
+        )
+    )
+  );
+  auto groups = instance->get_physical_devices( {} );
+  auto physical_device = groups[ 0 ].with_extensions( {
+    VK_KHR_PIPELINE_EXECUTABLE_PROPERTIES_EXTENSION_NAME
+  } );
+  const auto physical_device_props = physical_device.devices[ 0 ]->get_props().get_basic();
+
+  const auto device = physical_device.create_device(
+    std::vector< gct::queue_requirement_t >{
+      gct::queue_requirement_t{
+        vk::QueueFlagBits::eGraphics,
+        0u,
+        vk::Extent3D(),
+#ifdef VK_EXT_GLOBAL_PRIORITY_EXTENSION_NAME
+        vk::QueueGlobalPriorityEXT(),
+#endif
+        {},
+        vk::CommandPoolCreateFlagBits::eResetCommandBuffer
+      }
+    },
+    gct::device_create_info_t()
+  );
+
+  // シェーダが使うプッシュコンスタントの大きさはわからないので、保証されている最大の範囲を取っておく
+  const std::uint32_t push_constant_size = std::min( 128u, physical_device_props.limits.maxPushConstantsSize );
+
+  const auto render_pass = device->get_render_pass(
+    vk::Format::eR8G8B8A8Unorm,
+    vk::Format::eD16Unorm
+  );
+  // 統計情報は前回までのキャッシュの有無に左右されないように毎回空のキャッシュから作る
+  const samples::instrumented_pipeline_cache_t pipeline_cache( device->get_pipeline_cache() );
+
+  // 統計情報を取り出せるようにパイプラインを作る
+  const auto capture_flags =
+    vk::PipelineCreateFlagBits::eCaptureStatisticsKHR;
+
+  const auto stencil_op = vk::StencilOpState()
+    .setCompareOp( vk::CompareOp::eAlways )
+    .setFailOp( vk::StencilOp::eKeep )
+    .setPassOp( vk::StencilOp::eKeep );
+  const std::uint32_t width = 1024u;
+  const std::uint32_t height = 1024u;
+  const auto input_assembly =
+    gct::pipeline_input_assembly_state_create_info_t()
+      .set_basic(
+        vk::PipelineInputAssemblyStateCreateInfo()
+          .setTopology( vk::PrimitiveTopology::eTriangleList )
+      );
+  const auto viewport =
+    gct::pipeline_viewport_state_create_info_t()
+      .add_viewport(
+        vk::Viewport()
+          .setWidth( width )
+          .setHeight( height )
+          .setMinDepth( 0.0f )
+          .setMaxDepth( 1.0f )
+      )
+      .add_scissor(
+        vk::Rect2D()
+          .setOffset( { 0, 0 } )
+          .setExtent( { width, height } )
+      )
+      .rebuild_chain();
+  const auto rasterization =
+    gct::pipeline_rasterization_state_create_info_t()
+      .set_basic(
+        vk::PipelineRasterizationStateCreateInfo()
+          .setDepthClampEnable( false )
+          .setRasterizerDiscardEnable( false )
+          .setPolygonMode( vk::PolygonMode::eFill )
+          .setCullMode( vk::CullModeFlagBits::eNone )
+          .setFrontFace( vk::FrontFace::eClockwise )
+          .setDepthBiasEnable( false )
+          .setLineWidth( 1.0f )
+      );
+  const auto multisample =
+    gct::pipeline_multisample_state_create_info_t()
+      .set_basic(
+        vk::PipelineMultisampleStateCreateInfo()
+      );
+  const auto depth_stencil =
+    gct::pipeline_depth_stencil_state_create_info_t()
+      .set_basic(
+        vk::PipelineDepthStencilStateCreateInfo()
+          .setDepthTestEnable( true )
+          .setDepthWriteEnable( true )
+          .setDepthCompareOp( vk::CompareOp::eLessOrEqual )
+          .setDepthBoundsTestEnable( false )
+          .setStencilTestEnable( false )
+          .setFront( stencil_op )
+          .setBack( stencil_op )
+      );
+  const auto color_blend =
+    gct::pipeline_color_blend_state_create_info_t()
+      .add_attachment(
+        vk::PipelineColorBlendAttachmentState()
+          .setBlendEnable( false )
+          .setColorWriteMask(
+            vk::ColorComponentFlagBits::eR |
+            vk::ColorComponentFlagBits::eG |
+            vk::ColorComponentFlagBits::eB |
+            vk::ColorComponentFlagBits::eA
+          )
+      );
+
+  // ディレクトリ毎に.spvを集める
+  std::map< std::filesystem::path, std::vector< std::filesystem::path > > vertex_shaders;
+  std::vector< std::filesystem::path > fragment_shaders;
+  std::vector< std::filesystem::path > compute_shaders;
+  const auto ends_with = []( const std::string &s, const std::string &suffix ) {
+    return s.size() >= suffix.size() && s.compare( s.size() - suffix.size(), suffix.size(), suffix ) == 0;
+  };
+  for( const auto &entry: std::filesystem::recursive_directory_iterator( root_dir ) ) {
+    if( !entry.is_regular_file() ) continue;
+    const auto filename = entry.path().filename().string();
+    if( ends_with( filename, ".vert.spv" ) ) vertex_shaders[ entry.path().parent_path() ].push_back( entry.path() );
+    else if( ends_with( filename, ".frag.spv" ) ) fragment_shaders.push_back( entry.path() );
+    else if( ends_with( filename, ".comp.spv" ) ) compute_shaders.push_back( entry.path() );
+  }
+  for( auto &v: vertex_shaders ) std::sort( v.second.begin(), v.second.end() );
+  std::sort( fragment_shaders.begin(), fragment_shaders.end() );
+  std::sort( compute_shaders.begin(), compute_shaders.end() );
+  const auto get_prefix = []( const std::filesystem::path &path ) {
+    const auto filename = path.filename().string();
+    return filename.substr( 0u, filename.find_first_of( "_." ) );
+  };
+  const auto get_name = [&]( const std::filesystem::path &path ) {
+    return std::filesystem::relative( path, root_dir ).generic_string();
+  };
+
+  nlohmann::json current;
+  current[ "device" ][ "name" ] = std::string( physical_device_props.deviceName.data() );
+  current[ "device" ][ "driver_version" ] = physical_device_props.driverVersion;
+  current[ "pipelines" ] = nlohmann::json::object();
+  current[ "errors" ] = nlohmann::json::object();
+
+  for( const auto &path: compute_shaders ) {
+    const auto name = get_name( path );
+    try {
+      const auto cs = device->get_shader_module( path.string() );
+      const auto descriptor_set_layout = device->get_descriptor_set_layout(
+        gct::descriptor_set_layout_create_info_t()
+          .add_binding( cs->get_props().get_reflection() )
+          .rebuild_chain()
+      );
+      const auto pipeline_layout = device->get_pipeline_layout(
+        gct::pipeline_layout_create_info_t()
+          .add_descriptor_set_layout( descriptor_set_layout )
+          .add_push_constant_range(
+            vk::PushConstantRange()
+              .setStageFlags( vk::ShaderStageFlagBits::eCompute )
+              .setOffset( 0 )
+              .setSize( push_constant_size )
+          )
+      );
+      const auto pipeline = pipeline_cache.get_pipeline(
+        gct::compute_pipeline_create_info_t()
+          .set_basic(
+            vk::ComputePipelineCreateInfo()
+              .setFlags( capture_flags )
+          )
+          .set_stage(
+            gct::pipeline_shader_stage_create_info_t()
+              .set_shader_module( cs )
+          )
+          .set_layout( pipeline_layout ),
+        name
+      );
+      current[ "pipelines" ][ name ][ "shaders" ] = nlohmann::json::array( { name } );
+      current[ "pipelines" ][ name ][ "executables" ] = samples::get_pipeline_statistics( **device, **pipeline );
+    }
+    catch( const std::exception &e ) {
+      current[ "errors" ][ name ] = e.what();
+    }
+  }
+
+  for( const auto &path: fragment_shaders ) {
+    const auto name = get_name( path );
+    try {
+      const auto dir = vertex_shaders.find( path.parent_path() );
+      if( dir == vertex_shaders.end() || dir->second.empty() )
+        throw std::runtime_error( "no vertex shader in the same directory" );
+      auto vs_path = dir->second.front();
+      for( const auto &v: dir->second )
+        if( get_prefix( v ) == get_prefix( path ) ) vs_path = v;
+      const auto vs = device->get_shader_module( vs_path.string() );
+      const auto fs = device->get_shader_module( path.string() );
+      const auto descriptor_set_layout = device->get_descriptor_set_layout(
+        gct::descriptor_set_layout_create_info_t()
+          .add_binding( vs->get_props().get_reflection() )
+          .add_binding( fs->get_props().get_reflection() )
+          .rebuild_chain()
+      );
+      const auto pipeline_layout = device->get_pipeline_layout(
+        gct::pipeline_layout_create_info_t()
+          .add_descriptor_set_layout( descriptor_set_layout )
+          .add_push_constant_range(
+            vk::PushConstantRange()
+              .setStageFlags( vk::ShaderStageFlagBits::eVertex|vk::ShaderStageFlagBits::eFragment )
+              .setOffset( 0 )
+              .setSize( push_constant_size )
+          )
+      );
+      auto [vistat,vamap,stride] = gct::get_vertex_attributes(
+        *device,
+        vs->get_props().get_reflection()
+      );
+      const auto pipeline = pipeline_cache.get_pipeline(
+        gct::graphics_pipeline_create_info_t()
+          .set_basic(
+            vk::GraphicsPipelineCreateInfo()
+              .setFlags( capture_flags )
+          )
+          .add_stage( vs )
+          .add_stage( fs )
+          .set_vertex_input( vistat )
+          .set_input_assembly( input_assembly )
+          .set_viewport( viewport )
+          .set_rasterization( rasterization )
+          .set_multisample( multisample )
+          .set_depth_stencil( depth_stencil )
+          .set_color_blend( color_blend )
+          .set_dynamic(
+            gct::pipeline_dynamic_state_create_info_t()
+          )
+          .set_layout( pipeline_layout )
+          .set_render_pass( render_pass, 0 ),
+        name
+      );
+      current[ "pipelines" ][ name ][ "shaders" ] = nlohmann::json::array( { get_name( vs_path ), name } );
+      current[ "pipelines" ][ name ][ "executables" ] = samples::get_pipeline_statistics( **device, **pipeline );
+    }
+    catch( const std::exception &e ) {
+      current[ "errors" ][ name ] = e.what();
+    }
+  }
+
+  if( vm.count( "output" ) ) {
+    std::ofstream file( vm[ "output" ].as< std::string >(), std::ios::out|std::ios::trunc );
+    file << current.dump( 2 ) << std::endl;
+    if( !file ) {
+      std::cerr << "unable to write " << vm[ "output" ].as< std::string >() << std::endl;
+      return 1;
+    }
+  }
+
+  if( vm.count( "baseline" ) ) {
+    std::ifstream file( vm[ "baseline" ].as< std::string >() );
+    if( !file ) {
+      std::cerr << "unable to open " << vm[ "baseline" ].as< std::string >() << std::endl;
+      return 1;
+    }
+    const auto baseline = nlohmann::json::parse( file );
+    auto report = samples::compare_pipeline_statistics( baseline, current, threshold );
+    report[ "errors" ] = current[ "errors" ];
+    if( baseline.contains( "device" ) && baseline[ "device" ] != current[ "device" ] )
+      // 別のデバイスやドライバで取った基準とは数値が一致しない事がある
+      report[ "device_changed" ] = true;
+    std::cout << report.dump( 2 ) << std::endl;
+    return report[ "regressions" ].empty() ? 0 : 1;
+  }
+  if( !vm.count( "output" ) )
+    std::cout << current.dump( 2 ) << std::endl;
+}
+
@@ -0,0 +1,262 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <random>
+#include <boost/program_options.hpp>
+#include <nlohmann/json.hpp>
+#include <gct/get_extensions.hpp>
+#include <gct/instance.hpp>
+#include <gct/queue.hpp>
+#include <gct/device.hpp>
+#include <gct/allocator.hpp>
+#include <gct/device_create_info.hpp>
+#include <gct/submit_info.hpp>
+#include <gct/command_buffer.hpp>
+#include <gct/command_pool.hpp>
+#include <samples/radix_sort.hpp>
+#include <samples/pipeline_cache_store.hpp>
+#include <samples/timestamp.hpp>
+#include <samples/statistics.hpp>
+
+int main( int argc, const char *argv[] ) {
+  namespace po = boost::program_options;
+  po::options_description desc( "Options" );
+  desc.add_options()
+    ( "help,h", "show this message" )
+    ( "count,c", po::value< std::uint32_t >()->default_value( 16u * 1024u * 1024u ), "number of keys" )
+    ( "mode,m", po::value< std::string >()->default_value( "key" ), "key or key_value" )
+    ( "iterations,n", po::value< std::uint32_t >()->default_value( 10u ), "timed sorts" )
+    ( "local-size", po::value< std::uint32_t >()->default_value( 256u ), "local_size_x of the sort shaders" );
+  po::variables_map vm;
+  po::store( po::parse_command_line( argc, argv, desc ), vm );
+  po::notify( vm );
+  if( vm.count( "help" ) ) {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+  const auto count = vm[ "count" ].as< std::uint32_t >();
+  const auto mode = vm[ "mode" ].as< std::string >();
+  const auto iterations = vm[ "iterations" ].as< std::uint32_t >();
+  const auto local_size = vm[ "local-size" ].as< std::uint32_t >();
+  if( mode != "key" && mode != "key_value" ) {
+    std::cerr << "mode must be key or key_value" << std::endl;
+    return 1;
+  }
+  if( count == 0u || iterations == 0u ) {
+    std::cerr << "count and iterations must not be 0" << std::endl;
+    return 1;
+  }
+  const bool key_value = mode == "key_value";
+
+  const std::shared_ptr< gct::instance_t > instance(
+    new gct::instance_t(
+      gct::instance_create_info_t()
+        .set_application_info(
+          vk::ApplicationInfo()
+            .setPApplicationName( argc ? argv[ 0 ] : "my_application" )
+            .setApplicationVersion(  VK_MAKE_VERSION( 1, 0, 0 ) )
+            .setApiVersion( VK_API_VERSION_1_2 )
+        )
+    )
+  );
+  auto groups = instance->get_physical_devices( {} );
+  auto selected = groups[ 0 ].with_extensions( {} );
+  const auto physical_device = **selected.devices[ 0 ];
+  const auto physical_device_props = physical_device.getProperties();
+
+  const auto device = selected.create_device(
+    std::vector< gct::queue_requirement_t >{
+      gct::queue_requirement_t{
+        vk::QueueFlagBits::eCompute,
+        0u,
+        vk::Extent3D(),
+#ifdef VK_EXT_GLOBAL_PRIORITY_EXTENSION_NAME
+        vk::QueueGlobalPriorityEXT(),
+#endif
+        {},
+        vk::CommandPoolCreateFlagBits::eResetCommandBuffer
+      }
+    },
+    gct::device_create_info_t()
+  );
+  const auto queue = device->get_queue( 0u );
+  const auto allocator = device->get_allocator();
+
+  const std::uint64_t buffer_size = std::uint64_t( count ) * sizeof( std::uint32_t );
+  const auto create_buffer = [&]( vk::BufferUsageFlags usage, VmaMemoryUsage memory_usage ) {
+    return allocator->create_buffer(
+      gct::buffer_create_info_t()
+        .set_basic(
+          vk::BufferCreateInfo()
+            .setSize( buffer_size )
+            .setUsage( usage )
+        ),
+      memory_usage
+    );
+  };
+  const auto device_usage =
+    vk::BufferUsageFlagBits::eStorageBuffer |
+    vk::BufferUsageFlagBits::eTransferSrc |
+    vk::BufferUsageFlagBits::eTransferDst;
+  const auto keys = create_buffer( device_usage, VMA_MEMORY_USAGE_GPU_ONLY );
+  const auto key_staging = create_buffer( vk::BufferUsageFlagBits::eTransferSrc, VMA_MEMORY_USAGE_CPU_TO_GPU );
+  const auto key_readback = create_buffer( vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_TO_CPU );
+  std::shared_ptr< gct::buffer_t > values;
+  std::shared_ptr< gct::buffer_t > value_staging;
+  std::shared_ptr< gct::buffer_t > value_readback;
+  if( key_value ) {
+    values = create_buffer( device_usage, VMA_MEMORY_USAGE_GPU_ONLY );
+    value_staging = create_buffer( vk::BufferUsageFlagBits::eTransferSrc, VMA_MEMORY_USAGE_CPU_TO_GPU );
+    value_readback = create_buffer( vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_TO_CPU );
+  }
+
+  // キーは32bitの全域から乱数で選ぶ(1600万個程度あれば重複も数万個含まれる)
+  // 値には元の位置を入れる
+  std::vector< std::uint32_t > input_keys( count );
+  std::vector< std::uint32_t > input_values( count );
+  {
+    std::mt19937 rng( 1u );
+    std::uniform_int_distribution< std::uint32_t > dist;
+    std::generate( input_keys.begin(), input_keys.end(), [&]() { return dist( rng ); } );
+    std::iota( input_values.begin(), input_values.end(), 0u );
+    auto mapped_keys = key_staging->map< std::uint32_t >();
+    std::copy( input_keys.begin(), input_keys.end(), mapped_keys.begin() );
+    if( key_value ) {
+      auto mapped_values = value_staging->map< std::uint32_t >();
+      std::copy( input_values.begin(), input_values.end(), mapped_values.begin() );
+    }
+  }
+
+  const samples::persistent_pipeline_cache_t pipeline_cache( device, CMAKE_CURRENT_BINARY_DIR "/pipeline_cache" );
+  const samples::radix_sort_t sort(
+    device,
+    allocator,
+    pipeline_cache.get(),
+    physical_device_props.limits,
+    CMAKE_CURRENT_BINARY_DIR,
+    SCAN_SHADER_DIR,
+    keys,
+    values,
+    count,
+    local_size
+  );
+
+  const auto command_buffer = queue->get_command_pool()->allocate();
+  std::vector< std::shared_ptr< gct::buffer_t > > device_buffers{ keys };
+  if( key_value ) device_buffers.push_back( values );
+
+  // 1回目は入力を送って結果を読み戻し、CPUで並べ替えた結果と比べる
+  {
+    auto rec = command_buffer->begin();
+    rec->copyBuffer( **key_staging, **keys, vk::BufferCopy().setSize( buffer_size ) );
+    if( key_value )
+      rec->copyBuffer( **value_staging, **values, vk::BufferCopy().setSize( buffer_size ) );
+    rec.barrier(
+      vk::AccessFlagBits::eTransferWrite,
+      vk::AccessFlagBits::eShaderRead|vk::AccessFlagBits::eShaderWrite,
+      vk::PipelineStageFlagBits::eTransfer,
+      vk::PipelineStageFlagBits::eComputeShader,
+      vk::DependencyFlagBits( 0 ),
+      device_buffers,
+      {}
+    );
+    sort( rec );
+    rec.barrier(
+      vk::AccessFlagBits::eShaderWrite,
+      vk::AccessFlagBits::eTransferRead,
+      vk::PipelineStageFlagBits::eComputeShader,
+      vk::PipelineStageFlagBits::eTransfer,
+      vk::DependencyFlagBits( 0 ),
+      device_buffers,
+      {}
+    );
+    rec->copyBuffer( **keys, **key_readback, vk::BufferCopy().setSize( buffer_size ) );
+    if( key_value )
+      rec->copyBuffer( **values, **value_readback, vk::BufferCopy().setSize( buffer_size ) );
+  }
+  command_buffer->execute(
+    gct::submit_info_t()
+  );
+  command_buffer->wait_for_executed();
+
+  bool correct = false;
+  double std_sort_ns = 0.0;
+  {
+    const auto cpu_begin_time = std::chrono::high_resolution_clock::now();
+    std::vector< std::uint32_t > expected_keys = input_keys;
+    std::sort( expected_keys.begin(), expected_keys.end() );
+    const auto cpu_end_time = std::chrono::high_resolution_clock::now();
+    auto mapped_keys = key_readback->map< std::uint32_t >();
+    correct = std::equal( expected_keys.begin(), expected_keys.end(), mapped_keys.begin() );
+    if( correct && key_value ) {
+      // 基数ソートは安定なので同じキーの値は元の位置の順に並んでいなければならない
+      std::vector< std::uint32_t > expected_values = input_values;
+      std::stable_sort(
+        expected_values.begin(), expected_values.end(),
+        [&]( std::uint32_t l, std::uint32_t r ) { return input_keys[ l ] < input_keys[ r ]; }
+      );
+      auto mapped_values = value_readback->map< std::uint32_t >();
+      correct = std::equal( expected_values.begin(), expected_values.end(), mapped_values.begin() );
+    }
+    std_sort_ns = double( std::chrono::duration_cast< std::chrono::nanoseconds >( cpu_end_time - cpu_begin_time ).count() );
+  }
+
+  // 2回目以降は並べ替え済みの列を並べ替え直す事を繰り返して時間を測る
+  // 基数ソートの手間はキーの並びに依らない
+  const samples::timestamp_t timestamp(
+    device,
+    physical_device,
+    queue->get_available_queue_family_index(),
+    iterations + 1u
+  );
+  {
+    auto rec = command_buffer->begin();
+    timestamp.reset( rec );
+    timestamp.write( rec, 0u );
+    for( std::uint32_t i = 0u; i != iterations; ++i ) {
+      sort( rec );
+      rec.barrier(
+        vk::AccessFlagBits::eShaderWrite,
+        vk::AccessFlagBits::eShaderRead|vk::AccessFlagBits::eShaderWrite,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlagBits( 0 ),
+        device_buffers,
+        {}
+      );
+      timestamp.write( rec, i + 1u );
+    }
+  }
+  const auto begin_time = std::chrono::high_resolution_clock::now();
+  command_buffer->execute(
+    gct::submit_info_t()
+  );
+  command_buffer->wait_for_executed();
+  const auto end_time = std::chrono::high_resolution_clock::now();
+  const double host_ns = double( std::chrono::duration_cast< std::chrono::nanoseconds >( end_time - begin_time ).count() );
+
+  nlohmann::json root;
+  root[ "device" ] = std::string( physical_device_props.deviceName.data() );
+  root[ "mode" ] = mode;
+  root[ "count" ] = count;
+  root[ "local_size" ] = local_size;
+  root[ "blocks" ] = sort.get_block_count();
+  root[ "correct" ] = correct;
+  root[ "iterations" ] = iterations;
+  root[ "host_ns" ] = host_ns;
+  double mean = host_ns / iterations;
+  if( timestamp.is_available() ) {
+    const auto stats = samples::get_statistics( samples::get_intervals( timestamp.get( iterations + 1u ) ) );
+    root[ "sort_ns" ] = stats;
+    mean = stats.mean;
+  }
+  else root[ "sort_ns" ] = nullptr;
+  root[ "keys_per_sec" ] = double( count ) * 1.0e9 / mean;
+  // 比較の為のCPUでの結果
+  root[ "std_sort_ns" ] = std_sort_ns;
+  root[ "std_sort_keys_per_sec" ] = double( count ) * 1.0e9 / std_sort_ns;
+  std::cout << root.dump( 2 ) << std::endl;
+  return correct ? 0 : 1;
+}
+
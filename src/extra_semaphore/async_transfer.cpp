@@ -0,0 +1,487 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <boost/program_options.hpp>
+#include <nlohmann/json.hpp>
+#include <gct/get_extensions.hpp>
+#include <gct/instance.hpp>
+#include <gct/queue.hpp>
+#include <gct/device.hpp>
+#include <gct/allocator.hpp>
+#include <gct/device_create_info.hpp>
+#include <gct/descriptor_pool.hpp>
+#include <gct/descriptor_set_layout.hpp>
+#include <gct/pipeline_cache.hpp>
+#include <gct/pipeline_layout_create_info.hpp>
+#include <gct/pipeline_layout.hpp>
+#include <gct/submit_info.hpp>
+#include <gct/shader_module_create_info.hpp>
+#include <gct/shader_module.hpp>
+#include <gct/compute_pipeline_create_info.hpp>
+#include <gct/compute_pipeline.hpp>
+#include <gct/write_descriptor_set.hpp>
+#include <gct/command_buffer.hpp>
+#include <gct/command_pool.hpp>
+#include <vulkan/vulkan.hpp>
+#include <samples/pipeline_cache_store.hpp>
+
+struct spec_t {
+  std::uint32_t local_x_size = 0u;
+};
+
+struct push_constant_t {
+  std::uint32_t count = 0u;
+  std::uint32_t rounds = 0u;
+};
+
+// 1つのチャンクを処理する為の資源
+// depth個用意して順番に使い回す
+struct slot_t {
+  std::shared_ptr< gct::buffer_t > staging;
+  std::shared_ptr< gct::buffer_t > data;
+  std::shared_ptr< gct::buffer_t > readback;
+  std::shared_ptr< gct::descriptor_set_t > descriptor_set;
+  std::shared_ptr< gct::command_buffer_t > upload;
+  std::shared_ptr< gct::command_buffer_t > compute;
+  std::shared_ptr< gct::command_buffer_t > download;
+  // このスロットで処理中のチャンク
+  std::uint64_t chunk = 0u;
+  bool in_use = false;
+};
+
+// CPUで求めた期待値
+std::uint32_t expected_value( std::uint32_t value, std::uint32_t rounds ) {
+  for( std::uint32_t i = 0u; i != rounds; ++i )
+    value = value * 1664525u + 1013904223u;
+  return value;
+}
+
+int main( int argc, const char *argv[] ) {
+  namespace po = boost::program_options;
+  po::options_description desc( "Options" );
+  desc.add_options()
+    ( "help,h", "show this message" )
+    ( "chunk-size", po::value< std::uint32_t >()->default_value( 4u * 1024u * 1024u ), "bytes per chunk" )
+    ( "chunks", po::value< std::uint32_t >()->default_value( 64u ), "number of chunks" )
+    ( "depth", po::value< std::uint32_t >()->default_value( 3u ), "chunks in flight" )
+    ( "rounds", po::value< std::uint32_t >()->default_value( 64u ), "arithmetic per element in the compute pass" )
+    ( "local-size", po::value< std::uint32_t >()->default_value( 256u ), "local_size_x of the compute pass" );
+  po::variables_map vm;
+  po::store( po::parse_command_line( argc, argv, desc ), vm );
+  po::notify( vm );
+  if( vm.count( "help" ) ) {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+  const auto chunk_size = vm[ "chunk-size" ].as< std::uint32_t >() / sizeof( std::uint32_t ) * sizeof( std::uint32_t );
+  const auto chunk_count = vm[ "chunks" ].as< std::uint32_t >();
+  const auto depth = vm[ "depth" ].as< std::uint32_t >();
+  const auto rounds = vm[ "rounds" ].as< std::uint32_t >();
+  const auto local_size = vm[ "local-size" ].as< std::uint32_t >();
+  if( chunk_size == 0u || chunk_count == 0u || local_size == 0u ) {
+    std::cerr << "chunk-size, chunks and local-size must not be 0" << std::endl;
+    return 1;
+  }
+  // アップロード、計算、読み戻しの3段を同時に動かすには3つ以上のスロットが要る
+  if( depth < 3u ) {
+    std::cerr << "depth must be 3 or more" << std::endl;
+    return 1;
+  }
+  const std::uint32_t element_count = chunk_size / sizeof( std::uint32_t );
+
+  const std::shared_ptr< gct::instance_t > instance(
+    new gct::instance_t(
+      gct::instance_create_info_t()
+        .set_application_info(
+          vk::ApplicationInfo()
+            .setPApplicationName( argc ? argv[ 0 ] : "my_application" )
+            .setApplicationVersion(  VK_MAKE_VERSION( 1, 0, 0 ) )
+            .setApiVersion( VK_API_VERSION_1_2 )
+        )
+    )
+  );
+  auto groups = instance->get_physical_devices( {} );
+  auto selected = groups[ 0 ].with_extensions( {} );
+  const auto physical_device = **selected.devices[ 0 ];
+  const auto physical_device_props = physical_device.getProperties();
+  const auto group_count = ( element_count + local_size - 1u ) / local_size;
+  if( group_count > physical_device_props.limits.maxComputeWorkGroupCount[ 0 ] ) {
+    std::cerr << "chunk-size is too large for the device" << std::endl;
+    return 1;
+  }
+
+  // チャンクの受け渡しにはタイムラインセマフォを使う
+  const auto features = physical_device.getFeatures2<
+    vk::PhysicalDeviceFeatures2,
+    vk::PhysicalDeviceVulkan12Features
+  >();
+  if( !features.get< vk::PhysicalDeviceVulkan12Features >().timelineSemaphore ) {
+    std::cerr << "timeline semaphore is not supported" << std::endl;
+    return 1;
+  }
+
+  // グラフィックスとコンピュートに対応せず転送だけができるキューファミリーがあれば、
+  // 転送をそちらのキューに流して計算と並行させる
+  const auto families = physical_device.getQueueFamilyProperties();
+  const bool dedicated_transfer = std::find_if(
+    families.begin(), families.end(),
+    []( const auto &family ) {
+      return
+        ( family.queueFlags & vk::QueueFlagBits::eTransfer ) &&
+        !( family.queueFlags & ( vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute ) );
+    }
+  ) != families.end();
+  std::vector< gct::queue_requirement_t > queue_requirements{
+    gct::queue_requirement_t{
+      vk::QueueFlagBits::eCompute,
+      0u,
+      vk::Extent3D(),
+#ifdef VK_EXT_GLOBAL_PRIORITY_EXTENSION_NAME
+      vk::QueueGlobalPriorityEXT(),
+#endif
+      {},
+      vk::CommandPoolCreateFlagBits::eResetCommandBuffer
+    }
+  };
+  if( dedicated_transfer ) {
+    queue_requirements.push_back(
+      gct::queue_requirement_t{
+        vk::QueueFlagBits::eTransfer,
+        0u,
+        vk::Extent3D(),
+#ifdef VK_EXT_GLOBAL_PRIORITY_EXTENSION_NAME
+        vk::QueueGlobalPriorityEXT(),
+#endif
+        {},
+        vk::CommandPoolCreateFlagBits::eResetCommandBuffer
+      }
+    );
+  }
+  const auto device = selected.create_device(
+    queue_requirements,
+    gct::device_create_info_t()
+  );
+  const auto compute_queue = device->get_queue( 0u );
+  // 転送専用のキューが無い場合は同じキューに流す
+  // それでもCPUが待たずに次のチャンクを積める分だけは重なる
+  const auto transfer_queue = dedicated_transfer ? device->get_queue( 1u ) : compute_queue;
+  const auto compute_family = compute_queue->get_available_queue_family_index();
+  const auto transfer_family = transfer_queue->get_available_queue_family_index();
+  const auto allocator = device->get_allocator();
+
+  const auto shader = device->get_shader_module(
+    CMAKE_CURRENT_BINARY_DIR "/async_transfer.comp.spv"
+  );
+  const auto descriptor_set_layout = device->get_descriptor_set_layout(
+    gct::descriptor_set_layout_create_info_t()
+      .add_binding( shader->get_props().get_reflection() )
+      .rebuild_chain()
+  );
+  const auto pipeline_layout = device->get_pipeline_layout(
+    gct::pipeline_layout_create_info_t()
+      .add_descriptor_set_layout( descriptor_set_layout )
+      .add_push_constant_range(
+        vk::PushConstantRange()
+          .setStageFlags( vk::ShaderStageFlagBits::eCompute )
+          .setOffset( 0 )
+          .setSize( sizeof( push_constant_t ) )
+      )
+  );
+  const auto descriptor_pool = device->get_descriptor_pool(
+    gct::descriptor_pool_create_info_t()
+      .set_basic(
+        vk::DescriptorPoolCreateInfo()
+          .setFlags( vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet )
+          .setMaxSets( depth )
+      )
+      .set_descriptor_pool_size( vk::DescriptorType::eStorageBuffer, depth )
+      .rebuild_chain()
+  );
+  const samples::persistent_pipeline_cache_t pipeline_cache( device, CMAKE_CURRENT_BINARY_DIR "/pipeline_cache" );
+  const auto pipeline = pipeline_cache->get_pipeline(
+    gct::compute_pipeline_create_info_t()
+      .set_stage(
+        gct::pipeline_shader_stage_create_info_t()
+          .set_shader_module( shader )
+          .set_specialization_info(
+            gct::specialization_info_t< spec_t >()
+              .set_data(
+                spec_t{ local_size }
+              )
+              .add_map< std::uint32_t >( 1, offsetof( spec_t, local_x_size ) )
+          )
+      )
+      .set_layout( pipeline_layout )
+  );
+  const push_constant_t push_constant{ element_count, rounds };
+
+  // キューファミリーが異なる場合は両方から触れるバッファにして所有権の移動を省く
+  const std::vector< std::uint32_t > shared_families{ compute_family, transfer_family };
+  const auto create_buffer = [&]( vk::BufferUsageFlags usage, VmaMemoryUsage memory_usage ) {
+    auto create_info = vk::BufferCreateInfo()
+      .setSize( chunk_size )
+      .setUsage( usage );
+    if( compute_family != transfer_family ) {
+      create_info
+        .setSharingMode( vk::SharingMode::eConcurrent )
+        .setQueueFamilyIndices( shared_families );
+    }
+    return allocator->create_buffer(
+      gct::buffer_create_info_t()
+        .set_basic( create_info ),
+      memory_usage
+    );
+  };
+
+  std::vector< slot_t > slots( depth );
+  for( auto &slot: slots ) {
+    slot.staging = create_buffer( vk::BufferUsageFlagBits::eTransferSrc, VMA_MEMORY_USAGE_CPU_TO_GPU );
+    slot.data = create_buffer( vk::BufferUsageFlagBits::eStorageBuffer|vk::BufferUsageFlagBits::eTransferSrc|vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_ONLY );
+    slot.readback = create_buffer( vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_TO_CPU );
+    slot.descriptor_set = descriptor_pool->allocate( descriptor_set_layout );
+    slot.descriptor_set->update(
+      {
+        gct::write_descriptor_set_t()
+          .set_basic( (*slot.descriptor_set)[ "layout1" ] )
+          .add_buffer(
+            gct::descriptor_buffer_info_t()
+              .set_buffer( slot.data )
+              .set_basic(
+                vk::DescriptorBufferInfo()
+                  .setOffset( 0 )
+                  .setRange( chunk_size )
+              )
+          )
+      }
+    );
+    // スロットの資源は変わらないのでコマンドバッファは1度だけ記録して使い回す
+    slot.upload = transfer_queue->get_command_pool()->allocate();
+    {
+      auto rec = slot.upload->begin();
+      rec->copyBuffer( **slot.staging, **slot.data, vk::BufferCopy().setSize( chunk_size ) );
+    }
+    slot.compute = compute_queue->get_command_pool()->allocate();
+    {
+      auto rec = slot.compute->begin();
+      rec.bind_descriptor_set(
+        vk::PipelineBindPoint::eCompute,
+        pipeline_layout,
+        slot.descriptor_set
+      );
+      rec.bind_pipeline( pipeline );
+      rec->pushConstants(
+        **pipeline_layout,
+        vk::ShaderStageFlagBits::eCompute,
+        0u,
+        sizeof( push_constant_t ),
+        reinterpret_cast< const void* >( &push_constant )
+      );
+      rec->dispatch( group_count, 1, 1 );
+    }
+    slot.download = transfer_queue->get_command_pool()->allocate();
+    {
+      auto rec = slot.download->begin();
+      rec->copyBuffer( **slot.data, **slot.readback, vk::BufferCopy().setSize( chunk_size ) );
+      // セマフォを待った後にCPUから結果を読めるようにする
+      rec.barrier(
+        vk::AccessFlagBits::eTransferWrite,
+        vk::AccessFlagBits::eHostRead,
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eHost,
+        vk::DependencyFlagBits( 0 ),
+        { slot.readback },
+        {}
+      );
+    }
+  }
+
+  // チャンクの中身は何番目の要素かで決まる
+  const auto fill = [&]( const slot_t &slot, std::uint64_t chunk ) {
+    auto mapped = slot.staging->map< std::uint32_t >();
+    const std::uint32_t base = std::uint32_t( chunk * element_count );
+    std::uint32_t i = 0u;
+    for( auto &v: mapped ) v = base + i++;
+  };
+  const auto verify = [&]( const slot_t &slot, std::uint64_t chunk ) {
+    auto mapped = slot.readback->map< std::uint32_t >();
+    const std::uint32_t base = std::uint32_t( chunk * element_count );
+    std::uint32_t i = 0u;
+    for( const auto &v: mapped )
+      if( v != expected_value( base + i++, rounds ) ) return false;
+    return true;
+  };
+
+  // 比較の為の経路
+  // 1つのキューでアップロード、計算、読み戻しを1チャンクずつ終わるまで待つ
+  bool sequential_correct = true;
+  double sequential_ns = 0.0;
+  {
+    auto &slot = slots[ 0 ];
+    const auto command_buffer = compute_queue->get_command_pool()->allocate();
+    {
+      auto rec = command_buffer->begin();
+      rec->copyBuffer( **slot.staging, **slot.data, vk::BufferCopy().setSize( chunk_size ) );
+      rec.barrier(
+        vk::AccessFlagBits::eTransferWrite,
+        vk::AccessFlagBits::eShaderRead|vk::AccessFlagBits::eShaderWrite,
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlagBits( 0 ),
+        { slot.data },
+        {}
+      );
+      rec.bind_descriptor_set(
+        vk::PipelineBindPoint::eCompute,
+        pipeline_layout,
+        slot.descriptor_set
+      );
+      rec.bind_pipeline( pipeline );
+      rec->pushConstants(
+        **pipeline_layout,
+        vk::ShaderStageFlagBits::eCompute,
+        0u,
+        sizeof( push_constant_t ),
+        reinterpret_cast< const void* >( &push_constant )
+      );
+      rec->dispatch( group_count, 1, 1 );
+      rec.barrier(
+        vk::AccessFlagBits::eShaderWrite,
+        vk::AccessFlagBits::eTransferRead,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::DependencyFlagBits( 0 ),
+        { slot.data },
+        {}
+      );
+      rec->copyBuffer( **slot.data, **slot.readback, vk::BufferCopy().setSize( chunk_size ) );
+    }
+    const auto begin_time = std::chrono::high_resolution_clock::now();
+    for( std::uint64_t chunk = 0u; chunk != chunk_count; ++chunk ) {
+      fill( slot, chunk );
+      command_buffer->execute(
+        gct::submit_info_t()
+      );
+      command_buffer->wait_for_executed();
+      sequential_correct = verify( slot, chunk ) && sequential_correct;
+    }
+    const auto end_time = std::chrono::high_resolution_clock::now();
+    sequential_ns = double( std::chrono::duration_cast< std::chrono::nanoseconds >( end_time - begin_time ).count() );
+  }
+
+  // チャンク毎の段の完了を通知するタイムラインセマフォ
+  // n番目のチャンクの段が完了するとその段のセマフォの値がn+1になる
+  const auto create_timeline = [&]() {
+    vk::StructureChain< vk::SemaphoreCreateInfo, vk::SemaphoreTypeCreateInfo > create_info{
+      vk::SemaphoreCreateInfo(),
+      vk::SemaphoreTypeCreateInfo()
+        .setSemaphoreType( vk::SemaphoreType::eTimeline )
+        .setInitialValue( 0u )
+    };
+    return (*device)->createSemaphoreUnique( create_info.get< vk::SemaphoreCreateInfo >() );
+  };
+  const auto uploaded = create_timeline();
+  const auto computed = create_timeline();
+  const auto downloaded = create_timeline();
+
+  // waitがnullの場合は何も待たない
+  const auto submit = [&](
+    const std::shared_ptr< gct::queue_t > &queue,
+    const std::shared_ptr< gct::command_buffer_t > &command_buffer,
+    vk::Semaphore wait,
+    std::uint64_t wait_value,
+    vk::PipelineStageFlags wait_stage,
+    vk::Semaphore signal,
+    std::uint64_t signal_value
+  ) {
+    const auto raw_command_buffer = **command_buffer;
+    auto timeline_info = vk::TimelineSemaphoreSubmitInfo()
+      .setSignalSemaphoreValueCount( 1u )
+      .setPSignalSemaphoreValues( &signal_value );
+    auto submit_info = vk::SubmitInfo()
+      .setCommandBufferCount( 1u )
+      .setPCommandBuffers( &raw_command_buffer )
+      .setSignalSemaphoreCount( 1u )
+      .setPSignalSemaphores( &signal );
+    if( wait ) {
+      timeline_info
+        .setWaitSemaphoreValueCount( 1u )
+        .setPWaitSemaphoreValues( &wait_value );
+      submit_info
+        .setWaitSemaphoreCount( 1u )
+        .setPWaitSemaphores( &wait )
+        .setPWaitDstStageMask( &wait_stage );
+    }
+    submit_info.setPNext( &timeline_info );
+    (**queue).submit( submit_info, vk::Fence() );
+  };
+  const auto wait_for = [&]( vk::Semaphore semaphore, std::uint64_t value ) {
+    const auto result = (*device)->waitSemaphores(
+      vk::SemaphoreWaitInfo()
+        .setSemaphoreCount( 1u )
+        .setPSemaphores( &semaphore )
+        .setPValues( &value ),
+      std::numeric_limits< std::uint64_t >::max()
+    );
+    if( result != vk::Result::eSuccess )
+      vk::throwResultException( result, "waitSemaphores failed" );
+  };
+
+  // n回目の繰り返しでn番目のアップロードとn番目の計算とn-1番目の読み戻しを積む
+  // 転送キューにはn番目のアップロードがn-1番目の読み戻しより先に積まれるので、
+  // n-1番目の計算が終わるのを待っている間にn番目のアップロードが進む
+  bool pipelined_correct = true;
+  double pipelined_ns = 0.0;
+  {
+    const auto begin_time = std::chrono::high_resolution_clock::now();
+    for( std::uint64_t n = 0u; n != std::uint64_t( chunk_count ) + 1u; ++n ) {
+      if( n != chunk_count ) {
+        auto &slot = slots[ n % depth ];
+        // スロットの前のチャンクの読み戻しが終わるまでスロットの資源は使えない
+        if( slot.in_use ) {
+          wait_for( *downloaded, slot.chunk + 1u );
+          pipelined_correct = verify( slot, slot.chunk ) && pipelined_correct;
+        }
+        slot.chunk = n;
+        slot.in_use = true;
+        fill( slot, n );
+        submit( transfer_queue, slot.upload, vk::Semaphore(), 0u, vk::PipelineStageFlags(), *uploaded, n + 1u );
+        submit( compute_queue, slot.compute, *uploaded, n + 1u, vk::PipelineStageFlagBits::eComputeShader, *computed, n + 1u );
+      }
+      if( n != 0u ) {
+        auto &slot = slots[ ( n - 1u ) % depth ];
+        submit( transfer_queue, slot.download, *computed, n, vk::PipelineStageFlagBits::eTransfer, *downloaded, n );
+      }
+    }
+    wait_for( *downloaded, chunk_count );
+    // 最後に各スロットで処理したチャンクはまだ確かめていない
+    for( auto &slot: slots ) {
+      if( slot.in_use )
+        pipelined_correct = verify( slot, slot.chunk ) && pipelined_correct;
+    }
+    const auto end_time = std::chrono::high_resolution_clock::now();
+    pipelined_ns = double( std::chrono::duration_cast< std::chrono::nanoseconds >( end_time - begin_time ).count() );
+  }
+
+  const double total_size = double( chunk_size ) * chunk_count;
+  nlohmann::json root;
+  root[ "device" ] = std::string( physical_device_props.deviceName.data() );
+  root[ "dedicated_transfer_queue" ] = dedicated_transfer;
+  root[ "compute_queue_family" ] = compute_family;
+  root[ "transfer_queue_family" ] = transfer_family;
+  root[ "chunk_size" ] = chunk_size;
+  root[ "chunks" ] = chunk_count;
+  root[ "depth" ] = depth;
+  root[ "rounds" ] = rounds;
+  root[ "sequential" ][ "correct" ] = sequential_correct;
+  root[ "sequential" ][ "ns" ] = sequential_ns;
+  root[ "sequential" ][ "gb_per_sec" ] = total_size / sequential_ns;
+  root[ "pipelined" ][ "correct" ] = pipelined_correct;
+  root[ "pipelined" ][ "ns" ] = pipelined_ns;
+  root[ "pipelined" ][ "gb_per_sec" ] = total_size / pipelined_ns;
+  root[ "speedup" ] = sequential_ns / pipelined_ns;
+  std::cout << root.dump( 2 ) << std::endl;
+  return ( sequential_correct && pipelined_correct ) ? 0 : 1;
+}
+
@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <boost/program_options.hpp>
+#include <nlohmann/json.hpp>
+#include <gct/get_extensions.hpp>
+#include <gct/instance.hpp>
+#include <gct/device.hpp>
+#include <gct/device_create_info.hpp>
+#include <samples/spirv_bundle.hpp>
+#include <samples/statistics.hpp>
+
+// 37_gltfの全てのシェーダについて
+// .spvを1つずつ開いてシェーダモジュールを作る場合と
+// shaders.spvbを1回mmapしてマップされた領域から直接シェーダモジュールを作る場合の時間を比べる
+//
+// 1回目はページキャッシュに載っていない可能性があるので別に表示する
+// 完全にキャッシュに無い状態を測るには実行前にecho 3 > /proc/sys/vm/drop_cachesする
+int main( int argc, const char *argv[] ) {
+  namespace po = boost::program_options;
+  po::options_description desc( "Options" );
+  desc.add_options()
+    ( "help,h", "show this message" )
+    ( "bundle,b", po::value< std::string >()->default_value( SHADER_DIR "/shaders.spvb" ), "SPIR-V bundle" )
+    ( "dir,d", po::value< std::string >()->default_value( SHADER_DIR ), "directory that contains the original .spv files" )
+    ( "iterations,i", po::value< std::uint32_t >()->default_value( 10u ), "number of iterations" );
+  po::variables_map vm;
+  po::store( po::parse_command_line( argc, argv, desc ), vm );
+  po::notify( vm );
+  if( vm.count( "help" ) ) {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+  const std::filesystem::path bundle_path( vm[ "bundle" ].as< std::string >() );
+  const std::filesystem::path shader_dir( vm[ "dir" ].as< std::string >() );
+  const auto iterations = std::max( vm[ "iterations" ].as< std::uint32_t >(), 1u );
+
+  const std::shared_ptr< gct::instance_t > instance(
+    new gct::instance_t(
+      gct::instance_create_info_t()
+        .set_application_info(
+          vk::ApplicationInfo()
+            .setPApplicationName( argc ? argv[ 0 ] : "my_application" )
+            .setApplicationVersion(  VK_MAKE_VERSION( 1, 0, 0 ) )
+            .setApiVersion( VK_API_VERSION_1_2 )
+        )
+    )
+  );
+  auto groups = instance->get_physical_devices( {} );
+  auto selected = groups[ 0 ].with_extensions( {} );
+
+  const auto device = selected.create_device(
+    std::vector< gct::queue_requirement_t >{
+      gct::queue_requirement_t{
+        vk::QueueFlagBits::eGraphics,
+        0u,
+        vk::Extent3D(),
+#ifdef VK_EXT_GLOBAL_PRIORITY_EXTENSION_NAME
+        vk::QueueGlobalPriorityEXT(),
+#endif
+        {},
+        vk::CommandPoolCreateFlagBits::eResetCommandBuffer
+      }
+    },
+    gct::device_create_info_t()
+  );
+
+  // 比べる対象の名前は元の.spvのディレクトリから得る
+  // バンドルの目次を読むと測る前にバンドルがページキャッシュに載ってしまう
+  // バンドルの中の名前はディレクトリからの相対パス
+  std::vector< std::string > names;
+  for( const auto &entry: std::filesystem::recursive_directory_iterator( shader_dir ) ) {
+    // uber_world.fragとuber_tangent.fragはgct-gltf_compile_pipelinesの物でバンドルには入らない
+    if( entry.path().filename().string().compare( 0u, 5u, "uber_" ) == 0 ) continue;
+    if( entry.is_regular_file() && entry.path().extension() == ".spv" )
+      names.push_back( std::filesystem::relative( entry.path(), shader_dir ).generic_string() );
+  }
+  std::sort( names.begin(), names.end() );
+
+  // .spvを1つずつ読む
+  const auto load_files = [&]() {
+    std::vector< vk::UniqueShaderModule > modules;
+    for( const auto &name: names ) {
+      std::ifstream file( shader_dir / name, std::ios::in|std::ios::binary );
+      if( !file ) throw std::runtime_error( "unable to open " + ( shader_dir / name ).string() );
+      const std::vector< char > code(
+        ( std::istreambuf_iterator< char >( file ) ),
+        std::istreambuf_iterator< char >()
+      );
+      modules.push_back( ( *device )->createShaderModuleUnique(
+        vk::ShaderModuleCreateInfo()
+          .setCodeSize( code.size() )
+          .setPCode( reinterpret_cast< const std::uint32_t* >( code.data() ) )
+      ) );
+    }
+    return modules.size();
+  };
+  // バンドルを開き、マップされた領域から作る
+  const auto load_bundle = [&]() {
+    const samples::spirv_bundle_t bundle( bundle_path );
+    std::vector< vk::UniqueShaderModule > modules;
+    for( const auto &name: names )
+      modules.push_back( bundle.create_shader_module( **device, name ) );
+    return modules.size();
+  };
+  const auto measure = [&]( const auto &f ) {
+    const auto begin_time = std::chrono::high_resolution_clock::now();
+    f();
+    const auto end_time = std::chrono::high_resolution_clock::now();
+    return double( std::chrono::duration_cast< std::chrono::nanoseconds >( end_time - begin_time ).count() );
+  };
+
+  std::vector< double > files_ns;
+  std::vector< double > bundle_ns;
+  // 測る順番による偏りが出ないように、毎回順番を入れ替える
+  for( std::uint32_t i = 0u; i != iterations; ++i ) {
+    if( i % 2u ) {
+      bundle_ns.push_back( measure( load_bundle ) );
+      files_ns.push_back( measure( load_files ) );
+    }
+    else {
+      files_ns.push_back( measure( load_files ) );
+      bundle_ns.push_back( measure( load_bundle ) );
+    }
+  }
+
+  nlohmann::json root;
+  root[ "shaders" ] = names.size();
+  root[ "bundle_size" ] = std::filesystem::file_size( bundle_path );
+  root[ "files" ][ "first_ns" ] = files_ns.front();
+  root[ "files" ][ "ns" ] = samples::get_statistics( files_ns );
+  root[ "bundle" ][ "first_ns" ] = bundle_ns.front();
+  root[ "bundle" ][ "ns" ] = samples::get_statistics( bundle_ns );
+  std::cout << root.dump( 2 ) << std::endl;
+}
+
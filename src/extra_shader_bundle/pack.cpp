@@ -0,0 +1,46 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+#include <samples/spirv_bundle.hpp>
+
+// add_shader_bundleから呼ばれる
+// spirv_bundle_pack 出力 基準のディレクトリ SPIR-V...
+int main( int argc, const char *argv[] ) {
+  if( argc < 3 ) {
+    std::cerr << "usage: " << argv[ 0 ] << " OUTPUT BASE_DIR [SPIRV...]" << std::endl;
+    return 1;
+  }
+  const std::filesystem::path output( argv[ 1 ] );
+  const std::filesystem::path base_dir( argv[ 2 ] );
+  std::vector< std::pair< std::string, std::vector< std::uint8_t > > > shaders;
+  for( int i = 3; i < argc; ++i ) {
+    const std::filesystem::path input( argv[ i ] );
+    std::ifstream file( input, std::ios::in|std::ios::binary );
+    if( !file ) {
+      std::cerr << "unable to open " << input << std::endl;
+      return 1;
+    }
+    shaders.emplace_back(
+      std::filesystem::relative( input, base_dir ).generic_string(),
+      std::vector< std::uint8_t >(
+        ( std::istreambuf_iterator< char >( file ) ),
+        std::istreambuf_iterator< char >()
+      )
+    );
+  }
+  try {
+    // 一時ファイルに書いてから置き換える
+    const auto temporary = output.string() + ".tmp";
+    samples::write_spirv_bundle( temporary, shaders );
+    std::filesystem::rename( temporary, output );
+  }
+  catch( const std::exception &e ) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+}
+